@@ -7,6 +7,7 @@
 #include <iomanip>
 #include <sstream>
 #include <fstream>
+#include <cstdio>
 
 #include "rbdl/rbdl.h"
 #include "model_generator.h"
@@ -42,8 +43,12 @@ bool benchmark_run_id_rnea = true;
 bool benchmark_run_crba = true;
 bool benchmark_run_nle = true;
 bool benchmark_run_calc_minv_times_tau = true;
+bool benchmark_run_opspace_inertia = true;
 bool benchmark_run_contacts = false;
 bool benchmark_run_ik = false;
+bool benchmark_run_model_construction = false;
+bool benchmark_run_luamodel_load = false;
+bool benchmark_run_id_derivatives = false;
 
 bool json_output = false;
 
@@ -348,6 +353,227 @@ double run_contacts_kokkevis_benchmark (Model *model, ConstraintSet *constraint_
   return sample_data.durations.sum();
 }
 
+double run_opspace_inverse_inertia_benchmark (Model *model,
+    const vector<unsigned int> &body_ids, const vector<Vector3d> &points,
+    int sample_count) {
+  SampleData sample_data;
+  sample_data.fillRandom(model->dof_count, sample_count);
+
+  MatrixNd LambdaInv (MatrixNd::Zero (6 * body_ids.size(), 6 * body_ids.size()));
+
+  TimerInfo tinfo;
+
+  for (int i = 0; i < sample_count; i++) {
+    timer_start (&tinfo);
+    CalcOperationalSpaceInverseInertia (*model, sample_data.q[i], body_ids, points, LambdaInv);
+    sample_data.durations[i] = timer_stop (&tinfo);
+  }
+
+  report_constraints_run(*model, sample_data, "CalcOperationalSpaceInverseInertia");
+
+  return sample_data.durations.sum();
+}
+
+double run_opspace_inverse_inertia_dense_benchmark (Model *model,
+    const vector<unsigned int> &body_ids, const vector<Vector3d> &points,
+    int sample_count) {
+  SampleData sample_data;
+  sample_data.fillRandom(model->dof_count, sample_count);
+
+  MatrixNd H (MatrixNd::Zero (model->dof_count, model->dof_count));
+  MatrixNd G (MatrixNd::Zero (6, model->dof_count));
+  MatrixNd J (MatrixNd::Zero (6 * body_ids.size(), model->dof_count));
+  MatrixNd LambdaInv (MatrixNd::Zero (6 * body_ids.size(), 6 * body_ids.size()));
+
+  TimerInfo tinfo;
+
+  for (int i = 0; i < sample_count; i++) {
+    timer_start (&tinfo);
+    CompositeRigidBodyAlgorithm (*model, sample_data.q[i], H, true);
+    for (unsigned int k = 0; k < body_ids.size(); k++) {
+      G.setZero();
+      CalcPointJacobian6D (*model, sample_data.q[i], body_ids[k], points[k], G, false);
+      J.block(6 * k, 0, 6, model->dof_count) = G;
+    }
+    LambdaInv = J * H.inverse() * J.transpose();
+    sample_data.durations[i] = timer_stop (&tinfo);
+  }
+
+  report_constraints_run(*model, sample_data, "OperationalSpaceInverseInertiaDense");
+
+  return sample_data.durations.sum();
+}
+
+void opspace_inertia_benchmark (int sample_count) {
+  Model *model = new Model();
+  generate_human36model(model);
+
+  const char* frame_names[] = { "foot_r", "foot_l", "hand_r", "hand_l" };
+  const unsigned int frame_counts[] = { 1, 2, 4 };
+
+  if (!json_output) {
+    cout << "= #DOF: " << setw(3) << model->dof_count << endl;
+    cout << "= #samples: " << sample_count << endl;
+  }
+
+  for (unsigned int c = 0; c < 3; c++) {
+    vector<unsigned int> body_ids;
+    vector<Vector3d> points;
+    for (unsigned int k = 0; k < frame_counts[c]; k++) {
+      body_ids.push_back (model->GetBodyId (frame_names[k]));
+      points.push_back (Vector3d (0.1, 0., -0.05));
+    }
+
+    ostringstream model_name_stream;
+    model_name_stream << "Human36_" << frame_counts[c] << "Frames";
+
+    model_name = model_name_stream.str() + "_Recursive";
+    run_opspace_inverse_inertia_benchmark (model, body_ids, points, sample_count);
+
+    model_name = model_name_stream.str() + "_Dense";
+    run_opspace_inverse_inertia_dense_benchmark (model, body_ids, points, sample_count);
+  }
+
+  delete model;
+}
+
+double run_inverse_dynamics_derivatives_benchmark (Model *model, int sample_count) {
+  SampleData sample_data;
+  sample_data.fillRandom(model->dof_count, sample_count);
+
+  InverseDynamicsDerivatives derivatives;
+  if (!derivatives.Bind (*model)) {
+    cerr << "Model not supported by CalcInverseDynamicsDerivatives()." << endl;
+    return 0.;
+  }
+
+  TimerInfo tinfo;
+
+  for (int i = 0; i < sample_count; i++) {
+    timer_start (&tinfo);
+    CalcInverseDynamicsDerivatives (*model,
+        sample_data.q[i],
+        sample_data.qdot[i],
+        sample_data.qddot[i],
+        sample_data.tau[i],
+        derivatives
+        );
+    sample_data.durations[i] = timer_stop (&tinfo);
+  }
+
+  report_constraints_run(*model, sample_data, "CalcInverseDynamicsDerivatives");
+
+  return sample_data.durations.sum();
+}
+
+/** Computes the dense second-order derivatives of the inverse dynamics
+ * with nested central differences (as the reference for
+ * CalcInverseDynamicsDerivatives()). */
+double run_inverse_dynamics_derivatives_fd_benchmark (Model *model, int sample_count) {
+  SampleData sample_data;
+  sample_data.fillRandom(model->dof_count, sample_count);
+
+  unsigned int n = model->dof_count;
+  double h = 1.0e-4;
+  VectorNd tau[4];
+  vector<MatrixNd> d2tau_dq_dq (n, MatrixNd::Zero (n, n));
+  vector<MatrixNd> d2tau_dq_dqdot (n, MatrixNd::Zero (n, n));
+  vector<MatrixNd> d2tau_dqdot_dqdot (n, MatrixNd::Zero (n, n));
+  for (unsigned int s = 0; s < 4; s++) {
+    tau[s] = VectorNd::Zero (n);
+  }
+
+  TimerInfo tinfo;
+
+  for (int i = 0; i < sample_count; i++) {
+    timer_start (&tinfo);
+
+    // blocks: 0 = (q, q), 1 = (q, qdot), 2 = (qdot, qdot)
+    for (unsigned int block = 0; block < 3; block++) {
+      for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int k = (block == 1) ? 0 : j; k < n; k++) {
+          for (unsigned int s = 0; s < 4; s++) {
+            VectorNd q = sample_data.q[i];
+            VectorNd qdot = sample_data.qdot[i];
+            double delta_j = (s < 2) ? h : -h;
+            double delta_k = (s % 2 == 0) ? h : -h;
+
+            if (block == 2) {
+              qdot[j] += delta_j;
+            } else {
+              q[j] += delta_j;
+            }
+            if (block == 0) {
+              q[k] += delta_k;
+            } else {
+              qdot[k] += delta_k;
+            }
+
+            InverseDynamics (*model, q, qdot, sample_data.qddot[i], tau[s]);
+          }
+
+          VectorNd d2tau = (tau[0] - tau[1] - tau[2] + tau[3]) / (4. * h * h);
+          for (unsigned int r = 0; r < n; r++) {
+            if (block == 0) {
+              d2tau_dq_dq[r](j, k) = d2tau_dq_dq[r](k, j) = d2tau[r];
+            } else if (block == 1) {
+              d2tau_dq_dqdot[r](j, k) = d2tau[r];
+            } else {
+              d2tau_dqdot_dqdot[r](j, k) = d2tau_dqdot_dqdot[r](k, j) = d2tau[r];
+            }
+          }
+        }
+      }
+    }
+
+    sample_data.durations[i] = timer_stop (&tinfo);
+  }
+
+  report_constraints_run(*model, sample_data, "InverseDynamicsDerivativesFiniteDifferences");
+
+  return sample_data.durations.sum();
+}
+
+void inverse_dynamics_derivatives_benchmark (int sample_count) {
+  // the nested finite differences are expensive
+  sample_count = std::max (1, std::min (sample_count, 100));
+
+  if (!json_output) {
+    cout << "= #samples: " << sample_count << endl;
+  }
+
+  Model *model = NULL;
+
+  for (int depth = 1; depth <= benchmark_model_max_depth; depth++) {
+    model = new Model();
+    model->gravity = Vector3d (0., -9.81, 0.);
+
+    generate_planar_tree (model, depth);
+
+    ostringstream model_name_stream;
+    model_name_stream << "planar_model_depth_" << depth;
+
+    model_name = model_name_stream.str() + "_Analytic";
+    run_inverse_dynamics_derivatives_benchmark (model, sample_count);
+
+    model_name = model_name_stream.str() + "_FiniteDifferences";
+    run_inverse_dynamics_derivatives_fd_benchmark (model, sample_count);
+
+    delete model;
+  }
+
+  model = new Model();
+  generate_human36model(model);
+
+  model_name = "Human36_Analytic";
+  run_inverse_dynamics_derivatives_benchmark (model, sample_count);
+
+  model_name = "Human36_FiniteDifferences";
+  run_inverse_dynamics_derivatives_fd_benchmark (model, sample_count);
+
+  delete model;
+}
+
 void contacts_benchmark (int sample_count, ContactsMethod contacts_method) {
   // initialize the human model
   Model *model = new Model();
@@ -661,6 +887,144 @@ double run_all_inverse_kinematics_benchmark (unsigned int sample_count){
   return duration;
 }
 
+double run_model_construction_benchmark (unsigned int body_count, bool use_builder) {
+  Body body (1., Vector3d (0., -0.1, 0.), Vector3d (0.1, 0.1, 0.1));
+  Joint joint (JointTypeRevoluteZ);
+
+  TimerInfo tinfo;
+  timer_start (&tinfo);
+
+  Model *model = new Model();
+
+  if (use_builder) {
+    ModelBuilder builder (*model, body_count);
+    for (unsigned int i = 0; i < body_count; i++) {
+      builder.AppendBody (Xtrans (Vector3d (0., -0.2, 0.)), joint, body);
+    }
+    builder.Finalize();
+  } else {
+    for (unsigned int i = 0; i < body_count; i++) {
+      model->AppendBody (Xtrans (Vector3d (0., -0.2, 0.)), joint, body);
+    }
+  }
+
+  double duration = timer_stop (&tinfo);
+
+  delete model;
+
+  return duration;
+}
+
+void model_construction_benchmark () {
+  const unsigned int body_counts[] = { 100, 1000, 10000 };
+
+  for (unsigned int i = 0; i < 3; i++) {
+    double duration_add_body = run_model_construction_benchmark (body_counts[i], false);
+    double duration_builder = run_model_construction_benchmark (body_counts[i], true);
+
+    cout << "#Bodies: " << setw(6) << body_counts[i]
+      << " Model::AddBody: " << setw(10) << duration_add_body << "(s)"
+      << " ModelBuilder: " << setw(10) << duration_builder << "(s)" << endl;
+  }
+}
+
+#ifdef RBDL_BUILD_ADDON_LUAMODEL
+double run_luamodel_load_benchmark (const char *filename, int load_count) {
+  TimerInfo tinfo;
+  timer_start (&tinfo);
+
+  for (int i = 0; i < load_count; i++) {
+    Model model;
+    RigidBodyDynamics::Addons::LuaModelReadFromFile (filename, &model);
+  }
+
+  return timer_stop (&tinfo);
+}
+
+void luamodel_load_benchmark (int sample_count) {
+  const char *filename = "benchmark_luamodel.lua";
+  const int frame_count = 500;
+  const int load_count = std::max (1, std::min (sample_count, 100));
+
+  // a branched model of frame_count frames with all optional fields
+  ofstream model_file (filename);
+  model_file << "return {" << endl;
+  model_file << "  gravity = { 0., 0., -9.81 }," << endl;
+  model_file << "  frames = {" << endl;
+  for (int i = 0; i < frame_count; i++) {
+    model_file << "    {" << endl;
+    model_file << "      name = \"body_" << i << "\"," << endl;
+    if (i == 0) {
+      model_file << "      parent = \"ROOT\"," << endl;
+    } else {
+      model_file << "      parent = \"body_" << (i - 1) / 2 << "\"," << endl;
+    }
+    model_file << "      body = {" << endl;
+    model_file << "        mass = 1.," << endl;
+    model_file << "        com = { 0., -0.1, 0. }," << endl;
+    model_file << "        inertia = { { 0.1, 0., 0. }, { 0., 0.1, 0. }, { 0., 0., 0.1 } }," << endl;
+    model_file << "      }," << endl;
+    model_file << "      joint = { { 0., 0., 1., 0., 0., 0. } }," << endl;
+    model_file << "      joint_frame = {" << endl;
+    model_file << "        r = { 0., -0.2, 0. }," << endl;
+    model_file << "        E = { { 1., 0., 0. }, { 0., 1., 0. }, { 0., 0., 1. } }," << endl;
+    model_file << "      }," << endl;
+    model_file << "    }," << endl;
+  }
+  model_file << "  }" << endl;
+  model_file << "}" << endl;
+  model_file.close();
+
+  double duration = run_luamodel_load_benchmark (filename, load_count);
+
+  // the same number of models loaded with all hardware threads
+  std::vector<std::string> filenames (load_count, filename);
+  std::vector<Model*> models (load_count);
+  for (int i = 0; i < load_count; i++) {
+    models[i] = new Model();
+  }
+
+  TimerInfo tinfo;
+  timer_start (&tinfo);
+  RigidBodyDynamics::Addons::LuaModelReadFromFiles (filenames, models);
+  double duration_parallel = timer_stop (&tinfo);
+
+  for (int i = 0; i < load_count; i++) {
+    delete models[i];
+  }
+  remove (filename);
+
+  if (json_output) {
+    BenchmarkRun run;
+    run.model_name = filename;
+    run.model_dof = frame_count;
+    run.benchmark = "LuaModelReadFromFile";
+    run.sample_count = load_count;
+    run.duration = duration;
+    run.avg = duration / load_count;
+    run.min = run.avg;
+    run.max = run.avg;
+    benchmark_runs.push_back (run);
+
+    run.benchmark = "LuaModelReadFromFiles";
+    run.duration = duration_parallel;
+    run.avg = duration_parallel / load_count;
+    run.min = run.avg;
+    run.max = run.avg;
+    benchmark_runs.push_back (run);
+  } else {
+    cout << "#Frames: " << setw(6) << frame_count
+      << " #loads: " << setw(6) << load_count
+      << " duration = " << setw(10) << duration << "(s)"
+      << " (~" << setw(10) << duration / load_count << "(s) per load)" << endl;
+    cout << "#Frames: " << setw(6) << frame_count
+      << " #loads: " << setw(6) << load_count
+      << " duration = " << setw(10) << duration_parallel << "(s)"
+      << " (parallel)" << endl;
+  }
+}
+#endif
+
 void print_usage () {
 #if defined (RBDL_BUILD_ADDON_LUAMODEL) || defined (RBDL_BUILD_ADDON_URDFREADER)
   cout << "Usage: benchmark [--count|-c <sample_count>] [--depth|-d <depth>] <model.lua>" << endl;
@@ -688,8 +1052,16 @@ void print_usage () {
   cout << "                                body algorithm." << endl;
   cout << "  --no-nle                    : disables benchmark for the nonlinear effects." << endl;
   cout << "  --no-calc-minv              : disables benchmark M^-1 * tau benchmark." << endl;
+  cout << "  --no-opspace-inertia        : disables benchmark for the operational space" << endl;
+  cout << "                                inverse inertia (recursive vs. dense)." << endl;
   cout << "  --only-contacts | -C        : only runs contact model benchmarks." << endl;
   cout << "  --only-ik                   : only runs inverse kinematics benchmarks." << endl;
+  cout << "  --only-construction         : only runs model construction benchmarks." << endl;
+  cout << "  --only-id-derivatives       : only runs the benchmark of the inverse dynamics" << endl;
+  cout << "                                derivatives (analytic vs. finite differences)." << endl;
+#if defined RBDL_BUILD_ADDON_LUAMODEL
+  cout << "  --only-luamodel-load        : only runs the Lua model loading benchmark." << endl;
+#endif
   cout << "  --help | -h                 : prints this help." << endl;
 }
 
@@ -700,6 +1072,7 @@ void disable_all_benchmarks () {
   benchmark_run_crba = false;
   benchmark_run_nle = false;
   benchmark_run_calc_minv_times_tau = false;
+  benchmark_run_opspace_inertia = false;
   benchmark_run_contacts = false;
 }
 
@@ -757,12 +1130,25 @@ void parse_args (int argc, char* argv[]) {
       benchmark_run_nle = false;
     } else if (arg == "--no-calc-minv" ) {
       benchmark_run_calc_minv_times_tau = false;
+    } else if (arg == "--no-opspace-inertia" ) {
+      benchmark_run_opspace_inertia = false;
     } else if (arg == "--only-contacts" || arg == "-C") {
       disable_all_benchmarks();
       benchmark_run_contacts = true;
     } else if (arg == "--only-ik") {
       disable_all_benchmarks();
       benchmark_run_ik = true;
+    } else if (arg == "--only-construction") {
+      disable_all_benchmarks();
+      benchmark_run_model_construction = true;
+    } else if (arg == "--only-id-derivatives") {
+      disable_all_benchmarks();
+      benchmark_run_id_derivatives = true;
+#ifdef RBDL_BUILD_ADDON_LUAMODEL
+    } else if (arg == "--only-luamodel-load") {
+      disable_all_benchmarks();
+      benchmark_run_luamodel_load = true;
+#endif
 #if defined (RBDL_BUILD_ADDON_LUAMODEL) || defined (RBDL_BUILD_ADDON_URDFREADER)
     } else if (model_name == "") {
       model_name = arg;
@@ -923,6 +1309,11 @@ int main (int argc, char *argv[]) {
     }
   }
 
+  if (benchmark_run_opspace_inertia) {
+    report_section("Operational Space Inverse Inertia");
+    opspace_inertia_benchmark (benchmark_sample_count);
+  }
+
   if (benchmark_run_contacts) {
     report_section("Contacts: ForwardDynamicsConstraintsDirect");
     contacts_benchmark (benchmark_sample_count, ConstraintsMethodDirect);
@@ -942,6 +1333,23 @@ int main (int argc, char *argv[]) {
     run_all_inverse_kinematics_benchmark(benchmark_sample_count);
   }
 
+  if (benchmark_run_model_construction) {
+    report_section("Model Construction");
+    model_construction_benchmark();
+  }
+
+  if (benchmark_run_id_derivatives) {
+    report_section("Inverse Dynamics Derivatives");
+    inverse_dynamics_derivatives_benchmark (benchmark_sample_count);
+  }
+
+#ifdef RBDL_BUILD_ADDON_LUAMODEL
+  if (benchmark_run_luamodel_load) {
+    report_section("Lua Model Loading");
+    luamodel_load_benchmark (benchmark_sample_count);
+  }
+#endif
+
   if (json_output) {
     cout.precision(15);
     cout << "{" << endl;
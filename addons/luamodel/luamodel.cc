@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <map>
+#include <cstring>
+#include <thread>
+#include <atomic>
 
 #include "luatables.h"
 
@@ -258,7 +261,6 @@ bool LuaModelReadConstraintsFromTable (
 );
 
 typedef map<string, unsigned int> StringIntMap;
-StringIntMap body_table_id_map;
 
 RBDL_DLLAPI
 bool LuaModelReadFromLuaState (lua_State* L, Model* model, bool verbose) {
@@ -282,6 +284,67 @@ bool LuaModelReadFromFile (const char* filename, Model* model, bool verbose) {
   return LuaModelReadFromTable (model_table, model, verbose);
 }
 
+/** \brief Worker that reads models from a shared queue of files. */
+static void LuaModelReadFromFilesWorker (
+  const std::vector<std::string> *filenames,
+  std::vector<Model*> *models,
+  std::atomic<unsigned int> *next_file,
+  std::vector<char> *results
+) {
+  unsigned int i = (*next_file)++;
+
+  while (i < filenames->size()) {
+    (*results)[i] = LuaModelReadFromFile ((*filenames)[i].c_str(),
+        (*models)[i], false);
+    i = (*next_file)++;
+  }
+}
+
+RBDL_DLLAPI
+bool LuaModelReadFromFiles (
+  const std::vector<std::string> &filenames,
+  std::vector<Model*> &models,
+  unsigned int thread_count
+) {
+  if (models.size() != filenames.size()) {
+    std::cerr << "Number of models different from the number of files."
+      << std::endl;
+    assert(false);
+    abort();
+  }
+
+  if (thread_count == 0) {
+    thread_count = std::thread::hardware_concurrency();
+  }
+  if (thread_count == 0) {
+    thread_count = 1;
+  }
+  if (thread_count > filenames.size()) {
+    thread_count = filenames.size();
+  }
+
+  std::atomic<unsigned int> next_file (0);
+  std::vector<char> results (filenames.size(), 0);
+
+  // the calling thread is one of the workers
+  std::vector<std::thread> threads;
+  for (unsigned int t = 1; t < thread_count; t++) {
+    threads.push_back (std::thread (LuaModelReadFromFilesWorker, &filenames,
+          &models, &next_file, &results));
+  }
+  LuaModelReadFromFilesWorker (&filenames, &models, &next_file, &results);
+
+  for (unsigned int t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+
+  bool result = true;
+  for (unsigned int i = 0; i < results.size(); i++) {
+    result = result && results[i] != 0;
+  }
+
+  return result;
+}
 
 RBDL_DLLAPI
 std::vector<std::string> LuaModelGetConstraintSetNames(const char* filename) {
@@ -343,6 +406,347 @@ bool LuaModelReadFromFileWithConstraints (
 }
 
 
+//
+// Single pass readers that decode a table on top of the Lua stack by
+// visiting each of its fields exactly once.
+//
+static size_t LuaRawLength (lua_State *L, int index) {
+#if LUA_VERSION_NUM == 501
+  return lua_objlen (L, index);
+#else
+  return lua_rawlen (L, index);
+#endif
+}
+
+static void LuaReadNumbers (
+  lua_State *L,
+  int index,
+  double *values,
+  size_t count,
+  const char *description
+) {
+  if (lua_type (L, index) != LUA_TTABLE
+      || LuaRawLength (L, index) != count) {
+    cerr << "LuaModel Error: invalid " << description << "!" << endl;
+    abort();
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    lua_rawgeti (L, index, i + 1);
+    values[i] = lua_tonumber (L, -1);
+    lua_pop (L, 1);
+  }
+}
+
+static Vector3d LuaReadVector3d (lua_State *L, int index) {
+  double values[3];
+  LuaReadNumbers (L, index, values, 3, "3d vector");
+
+  return Vector3d (values[0], values[1], values[2]);
+}
+
+static SpatialVector LuaReadSpatialVector (lua_State *L, int index) {
+  double values[6];
+  LuaReadNumbers (L, index, values, 6, "6d vector");
+
+  return SpatialVector (values[0], values[1], values[2],
+      values[3], values[4], values[5]);
+}
+
+static Matrix3d LuaReadMatrix3d (lua_State *L, int index) {
+  if (lua_type (L, index) != LUA_TTABLE || LuaRawLength (L, index) != 3) {
+    cerr << "LuaModel Error: invalid 3d matrix!" << endl;
+    abort();
+  }
+
+  Matrix3d result;
+  for (int i = 0; i < 3; i++) {
+    double values[3];
+    lua_rawgeti (L, index, i + 1);
+    LuaReadNumbers (L, lua_gettop (L), values, 3, "3d matrix");
+    lua_pop (L, 1);
+
+    result(i,0) = values[0];
+    result(i,1) = values[1];
+    result(i,2) = values[2];
+  }
+
+  return result;
+}
+
+/// Returns the string key of the current lua_next() entry or NULL.
+static const char* LuaCurrentStringKey (lua_State *L) {
+  // lua_tostring() must not be used on non-string keys as it would modify
+  // the key and confuse lua_next().
+  if (lua_type (L, -2) != LUA_TSTRING) {
+    return NULL;
+  }
+
+  return lua_tostring (L, -2);
+}
+
+static std::string LuaReadString (lua_State *L, int index) {
+  if (!lua_isstring (L, index)) {
+    return "";
+  }
+
+  return lua_tostring (L, index);
+}
+
+static SpatialTransform LuaReadSpatialTransform (lua_State *L, int index) {
+  SpatialTransform result;
+
+  lua_pushnil (L);
+  while (lua_next (L, index) != 0) {
+    const char *key = LuaCurrentStringKey (L);
+    int value = lua_gettop (L);
+
+    if (key != NULL) {
+      if (strcmp (key, "r") == 0) {
+        result.r = LuaReadVector3d (L, value);
+      } else if (strcmp (key, "E") == 0) {
+        result.E = LuaReadMatrix3d (L, value);
+      }
+    }
+
+    lua_pop (L, 1);
+  }
+
+  return result;
+}
+
+static Joint LuaReadJoint (lua_State *L, int index, int frame_index) {
+  size_t joint_dofs = LuaRawLength (L, index);
+
+  if (joint_dofs == 1) {
+    lua_rawgeti (L, index, 1);
+
+    if (lua_type (L, -1) == LUA_TSTRING) {
+      string dof_string = lua_tostring (L, -1);
+      lua_pop (L, 1);
+
+      if (dof_string == "JointTypeSpherical") {
+        return Joint(JointTypeSpherical);
+      } else if (dof_string == "JointTypeEulerZYX") {
+        return Joint(JointTypeEulerZYX);
+      } else if (dof_string == "JointTypeEulerXYZ") {
+        return Joint(JointTypeEulerXYZ);
+      } else if (dof_string == "JointTypeEulerYXZ") {
+        return Joint(JointTypeEulerYXZ);
+      } else if (dof_string == "JointTypeTranslationXYZ") {
+        return Joint(JointTypeTranslationXYZ);
+      }
+
+      cerr << "LuaModel Error: invalid joint type " << dof_string
+        << " of frame " << frame_index << endl;
+      abort();
+    }
+
+    lua_pop (L, 1);
+  }
+
+  if (joint_dofs > 6) {
+    cerr << "Invalid number of DOFs for joint." << endl;
+    abort();
+  }
+
+  SpatialVector axes[6];
+  for (size_t i = 0; i < joint_dofs; i++) {
+    lua_rawgeti (L, index, i + 1);
+
+    if (lua_type (L, -1) != LUA_TTABLE || LuaRawLength (L, -1) != 6) {
+      cerr << "LuaModel Error: invalid joint motion subspace description of "
+        << "frame " << frame_index << endl;
+      abort();
+    }
+
+    axes[i] = LuaReadSpatialVector (L, lua_gettop (L));
+    lua_pop (L, 1);
+  }
+
+  switch (joint_dofs) {
+  case 0:
+    return Joint(JointTypeFixed);
+  case 1:
+    return Joint (axes[0]);
+  case 2:
+    return Joint (axes[0], axes[1]);
+  case 3:
+    return Joint (axes[0], axes[1], axes[2]);
+  case 4:
+    return Joint (axes[0], axes[1], axes[2], axes[3]);
+  case 5:
+    return Joint (axes[0], axes[1], axes[2], axes[3], axes[4]);
+  default:
+    break;
+  }
+
+  return Joint (axes[0], axes[1], axes[2], axes[3], axes[4], axes[5]);
+}
+
+static Body LuaReadBody (lua_State *L, int index, int frame_index) {
+  bool has_mass = false;
+  double mass = 0.;
+  Vector3d com (Vector3d::Zero(3));
+  Matrix3d inertia (Matrix3d::Identity(3,3));
+
+  lua_pushnil (L);
+  while (lua_next (L, index) != 0) {
+    const char *key = LuaCurrentStringKey (L);
+    int value = lua_gettop (L);
+
+    if (key != NULL) {
+      if (strcmp (key, "mass") == 0) {
+        mass = lua_tonumber (L, value);
+        has_mass = true;
+      } else if (strcmp (key, "com") == 0) {
+        com = LuaReadVector3d (L, value);
+      } else if (strcmp (key, "inertia") == 0) {
+        inertia = LuaReadMatrix3d (L, value);
+      }
+    }
+
+    lua_pop (L, 1);
+  }
+
+  if (!has_mass) {
+    cerr << "Error: could not find value mass of the body of frame "
+      << frame_index << "." << endl;
+    abort();
+  }
+
+  return Body (mass, com, inertia);
+}
+
+/// Values of a Frame Information Table.
+struct LuaFrameInfo {
+  LuaFrameInfo() :
+    has_parent (false),
+    joint (JointTypeFixed)
+  {}
+
+  std::string name;
+  std::string parent;
+  bool has_parent;
+  SpatialTransform joint_frame;
+  Joint joint;
+  Body body;
+};
+
+static void LuaReadFrame (
+  lua_State *L,
+  int index,
+  int frame_index,
+  LuaFrameInfo &frame
+) {
+  lua_pushnil (L);
+  while (lua_next (L, index) != 0) {
+    const char *key = LuaCurrentStringKey (L);
+    int value = lua_gettop (L);
+
+    if (key != NULL) {
+      if (strcmp (key, "name") == 0) {
+        frame.name = LuaReadString (L, value);
+      } else if (strcmp (key, "parent") == 0) {
+        frame.parent = LuaReadString (L, value);
+        frame.has_parent = true;
+      } else if (strcmp (key, "joint_frame") == 0) {
+        frame.joint_frame = LuaReadSpatialTransform (L, value);
+      } else if (strcmp (key, "joint") == 0) {
+        frame.joint = LuaReadJoint (L, value, frame_index);
+      } else if (strcmp (key, "body") == 0) {
+        frame.body = LuaReadBody (L, value, frame_index);
+      }
+    }
+
+    lua_pop (L, 1);
+  }
+}
+
+/// Values of a Constraint Information Table.
+struct LuaConstraintInfo {
+  LuaConstraintInfo() :
+    has_constraint_type (false),
+    has_body (false),
+    point (Vector3d::Zero()),
+    normal (Vector3d::Zero()),
+    normal_acceleration (0.),
+    has_predecessor_body (false),
+    has_successor_body (false),
+    axis (SpatialVector::Zero()),
+    enable_stabilization (false),
+    stabilization_parameter (0.1)
+  {}
+
+  std::string constraint_type;
+  bool has_constraint_type;
+  std::string name;
+
+  std::string body;
+  bool has_body;
+  Vector3d point;
+  Vector3d normal;
+  double normal_acceleration;
+
+  std::string predecessor_body;
+  bool has_predecessor_body;
+  std::string successor_body;
+  bool has_successor_body;
+  SpatialTransform predecessor_transform;
+  SpatialTransform successor_transform;
+  SpatialVector axis;
+  bool enable_stabilization;
+  double stabilization_parameter;
+};
+
+static void LuaReadConstraint (
+  lua_State *L,
+  int index,
+  LuaConstraintInfo &constraint
+) {
+  lua_pushnil (L);
+  while (lua_next (L, index) != 0) {
+    const char *key = LuaCurrentStringKey (L);
+    int value = lua_gettop (L);
+
+    if (key != NULL) {
+      if (strcmp (key, "constraint_type") == 0) {
+        constraint.constraint_type = LuaReadString (L, value);
+        constraint.has_constraint_type = true;
+      } else if (strcmp (key, "name") == 0) {
+        constraint.name = LuaReadString (L, value);
+      } else if (strcmp (key, "body") == 0) {
+        constraint.body = LuaReadString (L, value);
+        constraint.has_body = true;
+      } else if (strcmp (key, "point") == 0) {
+        constraint.point = LuaReadVector3d (L, value);
+      } else if (strcmp (key, "normal") == 0) {
+        constraint.normal = LuaReadVector3d (L, value);
+      } else if (strcmp (key, "normal_acceleration") == 0) {
+        constraint.normal_acceleration = lua_tonumber (L, value);
+      } else if (strcmp (key, "predecessor_body") == 0) {
+        constraint.predecessor_body = LuaReadString (L, value);
+        constraint.has_predecessor_body = true;
+      } else if (strcmp (key, "successor_body") == 0) {
+        constraint.successor_body = LuaReadString (L, value);
+        constraint.has_successor_body = true;
+      } else if (strcmp (key, "predecessor_transform") == 0) {
+        constraint.predecessor_transform = LuaReadSpatialTransform (L, value);
+      } else if (strcmp (key, "successor_transform") == 0) {
+        constraint.successor_transform = LuaReadSpatialTransform (L, value);
+      } else if (strcmp (key, "axis") == 0) {
+        constraint.axis = LuaReadSpatialVector (L, value);
+      } else if (strcmp (key, "enable_stabilization") == 0) {
+        constraint.enable_stabilization = lua_toboolean (L, value);
+      } else if (strcmp (key, "stabilization_parameter") == 0) {
+        constraint.stabilization_parameter = lua_tonumber (L, value);
+      }
+    }
+
+    lua_pop (L, 1);
+  }
+}
+
 bool LuaModelReadFromTable (LuaTable &model_table, Model* model, bool verbose) {
   if (model_table["gravity"].exists()) {
     model->gravity = model_table["gravity"].get<Vector3d>();
@@ -351,43 +755,51 @@ bool LuaModelReadFromTable (LuaTable &model_table, Model* model, bool verbose) {
       cout << "gravity = " << model->gravity.transpose() << endl;
   }
 
-  int frame_count = model_table["frames"].length();
-
+  // the ids are kept per call such that models can be read concurrently
+  StringIntMap body_table_id_map;
   body_table_id_map["ROOT"] = 0;
 
-  for (int i = 1; i <= frame_count; i++) {
-    if (!model_table["frames"][i]["parent"].exists()) {
-      cerr << "Parent not defined for frame " << i << "." << endl;
-      abort();
-    }
+  LuaTableNode frames_node = model_table["frames"];
 
-    string body_name = model_table["frames"][i]["name"].getDefault<string>("");
-    string parent_name = model_table["frames"][i]["parent"].get<string>();
-    unsigned int parent_id = body_table_id_map[parent_name];
+  if (frames_node.stackQueryValue()) {
+    lua_State *L = model_table.L;
+    int frames_index = lua_gettop (L);
+    int frame_count = static_cast<int>(LuaRawLength (L, frames_index));
 
-    SpatialTransform joint_frame 
-      = model_table["frames"][i]["joint_frame"].getDefault(SpatialTransform());
-    Joint joint 
-      = model_table["frames"][i]["joint"].getDefault(Joint(JointTypeFixed));
-    Body body = model_table["frames"][i]["body"].getDefault<Body>(Body());
+    for (int i = 1; i <= frame_count; i++) {
+      lua_rawgeti (L, frames_index, i);
 
-    unsigned int body_id 
-      = model->AddBody (parent_id, joint_frame, joint, body, body_name);
-    body_table_id_map[body_name] = body_id;
+      LuaFrameInfo frame;
+      LuaReadFrame (L, lua_gettop (L), i, frame);
+      lua_pop (L, 1);
 
-    if (verbose) {
-      cout << "==== Added Body ====" << endl;
-      cout << "  body_name  : " << body_name << endl;
-      cout << "  body id    : " << body_id << endl;
-      cout << "  parent_id  : " << parent_id << endl;
-      cout << "  joint dofs : " << joint.mDoFCount << endl;
-      for (unsigned int j = 0; j < joint.mDoFCount; j++) {
-        cout << "    " << j << ": " << joint.mJointAxes[j].transpose() << endl;
+      if (!frame.has_parent) {
+        cerr << "Parent not defined for frame " << i << "." << endl;
+        abort();
+      }
+
+      unsigned int parent_id = body_table_id_map[frame.parent];
+
+      unsigned int body_id = model->AddBody (parent_id, frame.joint_frame,
+          frame.joint, frame.body, frame.name);
+      body_table_id_map[frame.name] = body_id;
+
+      if (verbose) {
+        cout << "==== Added Body ====" << endl;
+        cout << "  body_name  : " << frame.name << endl;
+        cout << "  body id    : " << body_id << endl;
+        cout << "  parent_id  : " << parent_id << endl;
+        cout << "  joint dofs : " << frame.joint.mDoFCount << endl;
+        for (unsigned int j = 0; j < frame.joint.mDoFCount; j++) {
+          cout << "    " << j << ": " << frame.joint.mJointAxes[j].transpose() << endl;
+        }
+        cout << "  joint_frame: " << frame.joint_frame << endl;
       }
-      cout << "  joint_frame: " << joint_frame << endl;
     }
   }
 
+  frames_node.stackRestore();
+
   return true;
 }
 
@@ -397,88 +809,74 @@ bool LuaModelReadConstraintsFromTable (
   std::vector<ConstraintSet>& constraint_sets,
   const std::vector<std::string>& constraint_set_names,
   bool verbose
-) { 
+) {
   for(size_t i = 0; i < constraint_set_names.size(); ++i) {
     if (verbose) {
       std::cout << "==== Constraint Set: " << constraint_set_names[i] << std::endl;
     }
 
-    if(!model_table["constraint_sets"][constraint_set_names[i].c_str()]
-      .exists()) {
-      cerr << "Constraint set not existing: " << constraint_set_names[i] << "." 
+    LuaTableNode sets_node = model_table["constraint_sets"];
+    LuaTableNode set_node = sets_node[constraint_set_names[i].c_str()];
+
+    if (!set_node.stackQueryValue()) {
+      cerr << "Constraint set not existing: " << constraint_set_names[i] << "."
         << endl;
       assert(false);
       abort();
     }
 
-    size_t num_constraints = model_table["constraint_sets"]
-      [constraint_set_names[i].c_str()]
-      .length();
+    lua_State *L = model_table.L;
+    int set_index = lua_gettop (L);
+    size_t num_constraints = LuaRawLength (L, set_index);
 
     for(size_t ci = 0; ci < num_constraints; ++ci) {
       if (verbose) {
         std::cout << "== Constraint " << ci << "/" << num_constraints << " ==" << std::endl;
       }
 
-      if(!model_table["constraint_sets"]
-        [constraint_set_names[i].c_str()][ci + 1]["constraint_type"].exists()) {
+      lua_rawgeti (L, set_index, ci + 1);
+
+      LuaConstraintInfo constraint;
+      LuaReadConstraint (L, lua_gettop (L), constraint);
+      lua_pop (L, 1);
+
+      if(!constraint.has_constraint_type) {
         cerr << "constraint_type not specified." << endl;
         assert(false);
         abort();
       }
-      string constraintType = model_table["constraint_sets"]
-        [constraint_set_names[i].c_str()][ci + 1]["constraint_type"]
-        .getDefault<string>("");
-      std::string constraint_name = model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-        ["name"].getDefault<string>("");
-
-      if(constraintType == "contact") {
-        if(!model_table["constraint_sets"][constraint_set_names[i].c_str()]
-          [ci + 1]["body"].exists()) {
+
+      if(constraint.constraint_type == "contact") {
+        if(!constraint.has_body) {
           cerr << "body not specified." << endl;
           assert(false);
           abort();
         }
+
         constraint_sets[i].AddContactConstraint
-          (model->GetBodyId(model_table["constraint_sets"]
-            [constraint_set_names[i].c_str()][ci + 1]["body"]
-            .getDefault<string>("").c_str())
-          , model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["point"].getDefault<Vector3d>(Vector3d::Zero())
-          , model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["normal"].getDefault<Vector3d>(Vector3d::Zero())
-          , model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["name"].getDefault<string>("").c_str()
-          , model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["normal_acceleration"].getDefault<double>(0.));
+          (model->GetBodyId(constraint.body.c_str())
+          , constraint.point
+          , constraint.normal
+          , constraint.name.c_str()
+          , constraint.normal_acceleration);
+
         if(verbose) {
           cout << "  type = contact" << endl;
-          cout << "  name = " << constraint_name << std::endl;
-          cout << "  body = " 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["body"].getDefault<string>("") << endl;
-          cout << "  body point = " 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["point"].getDefault<Vector3d>(Vector3d::Zero()).transpose() 
-            << endl;
-          cout << "  world normal = " 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["normal"].getDefault<Vector3d>(Vector3d::Zero()).transpose() 
+          cout << "  name = " << constraint.name << std::endl;
+          cout << "  body = " << constraint.body << endl;
+          cout << "  body point = " << constraint.point.transpose() << endl;
+          cout << "  world normal = " << constraint.normal.transpose() << endl;
+          cout << "  normal acceleration = " << constraint.normal_acceleration
             << endl;
-          cout << "  normal acceleration = "
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["normal_acceleration"].getDefault<double>(0.) << endl;
         }
       }
-      else if(constraintType == "loop") {
-        if(!model_table["constraint_sets"][constraint_set_names[i].c_str()]
-          [ci + 1]["predecessor_body"].exists()) {
+      else if(constraint.constraint_type == "loop") {
+        if(!constraint.has_predecessor_body) {
           cerr << "predecessor_body not specified." << endl;
           assert(false);
           abort();
         }
-        if(!model_table["constraint_sets"][constraint_set_names[i].c_str()]
-          [ci + 1]["successor_body"].exists()) {
+        if(!constraint.has_successor_body) {
           cerr << "successor_body not specified." << endl;
           assert(false);
           abort();
@@ -488,75 +886,58 @@ bool LuaModelReadConstraintsFromTable (
         // and set the actual stabilization cofficients for the Baumgarte
         // stabilization afterwards if enabled.
         unsigned int constraint_id;
-        constraint_id = constraint_sets[i].AddLoopConstraint(model->GetBodyId
-          (model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["predecessor_body"].getDefault<string>("").c_str())
-          , model->GetBodyId(model_table["constraint_sets"]
-            [constraint_set_names[i].c_str()][ci + 1]["successor_body"]
-            .getDefault<string>("").c_str())
-          , model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["predecessor_transform"].getDefault<SpatialTransform>(SpatialTransform())
-          , model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["successor_transform"].getDefault<SpatialTransform>(SpatialTransform())
-          , model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["axis"].getDefault<SpatialVector>(SpatialVector::Zero())
+        constraint_id = constraint_sets[i].AddLoopConstraint(
+          model->GetBodyId(constraint.predecessor_body.c_str())
+          , model->GetBodyId(constraint.successor_body.c_str())
+          , constraint.predecessor_transform
+          , constraint.successor_transform
+          , constraint.axis
           , false
           , 0.0
-          , constraint_name.c_str());
-
-        bool enable_stabilization = model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["enable_stabilization"].getDefault<bool>(false);
-        double stabilization_parameter = 0.0;
-        if (enable_stabilization) {
-          stabilization_parameter = model_table["constraint_sets"][constraint_set_names[i].c_str()][ci + 1]
-            ["stabilization_parameter"].getDefault<double>(0.1);
-          if (stabilization_parameter <= 0.0) {
-            std::cerr << "Invalid stabilization parameter: " << stabilization_parameter
+          , constraint.name.c_str());
+
+        if (constraint.enable_stabilization) {
+          if (constraint.stabilization_parameter <= 0.0) {
+            std::cerr << "Invalid stabilization parameter: "
+              << constraint.stabilization_parameter
               << " must be > 0.0" << std::endl;
             abort();
           }
-          double stabilization_coefficient = 1.0 / stabilization_parameter;
-          constraint_sets[i].baumgarteParameters[i] = Vector2d(
+          double stabilization_coefficient
+            = 1.0 / constraint.stabilization_parameter;
+          constraint_sets[i].baumgarteParameters[constraint_id] = Vector2d(
               stabilization_coefficient, stabilization_coefficient);
         }
 
         if(verbose) {
           cout << "  type = loop" << endl;
-          cout << "  name = " << constraint_name << std::endl;
-          cout << "  predecessor body = " 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["predecessor_body"].getDefault<string>("") << endl;
-          cout << "  successor body = " 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["successor_body"].getDefault<string>("") << endl;
-          cout << "  predecessor body transform = " << endl 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["predecessor_transform"]
-            .getDefault<SpatialTransform>(SpatialTransform()) << endl;
-          cout << "  successor body transform = " << endl 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["successor_transform"]
-            .getDefault<SpatialTransform>(SpatialTransform()) << endl;
-          cout << "  constraint axis (in predecessor frame) = " 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["axis"].getDefault<SpatialVector>(SpatialVector::Zero())
-            .transpose() << endl;
-          cout << "  enable_stabilization = " << enable_stabilization 
-            << endl; 
-          if (enable_stabilization) {
-            cout << "  stabilization_parameter = " << stabilization_parameter 
-              << endl; 
+          cout << "  name = " << constraint.name << std::endl;
+          cout << "  predecessor body = " << constraint.predecessor_body
+            << endl;
+          cout << "  successor body = " << constraint.successor_body << endl;
+          cout << "  predecessor body transform = " << endl
+            << constraint.predecessor_transform << endl;
+          cout << "  successor body transform = " << endl
+            << constraint.successor_transform << endl;
+          cout << "  constraint axis (in predecessor frame) = "
+            << constraint.axis.transpose() << endl;
+          cout << "  enable_stabilization = " << constraint.enable_stabilization
+            << endl;
+          if (constraint.enable_stabilization) {
+            cout << "  stabilization_parameter = "
+              << constraint.stabilization_parameter << endl;
           }
-          cout << "  constraint name = " 
-            << model_table["constraint_sets"][constraint_set_names[i].c_str()]
-            [ci + 1]["name"].getDefault<string>("").c_str() << endl;
+          cout << "  constraint name = " << constraint.name << endl;
         }
       }
       else {
-        cerr << "Invalid constraint type: " << constraintType << endl;
+        cerr << "Invalid constraint type: " << constraint.constraint_type
+          << endl;
         abort();
       }
     }
+
+    set_node.stackRestore();
   }
 
   return true;
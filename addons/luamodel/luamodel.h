@@ -35,6 +35,10 @@ namespace Addons {
 * 
 * Note: this addon is not even remotely as thoroughly tested as the RBDL
 * itself so please use it with some suspicion.
+*
+* All reading functions are reentrant, i.e. different models can be read
+* concurrently from different threads as each call uses its own Lua state.
+* LuaModelReadFromFiles() reads a list of model files in parallel.
 * 
 * \section luamodel_format Format Overview 
 * 
@@ -264,6 +268,28 @@ bool LuaModelReadFromFile (
   Model* model,
   bool verbose = false);
 
+/** \brief Reads several models from Lua files in parallel.
+ *
+ * The files are distributed over thread_count threads (including the
+ * calling thread) and each file is read with LuaModelReadFromFile() into
+ * its own Model.
+ *
+ * \param filenames the names of the Lua files.
+ * \param models pointers to the output Model structures (one per file).
+ * \param thread_count the number of threads or 0 to use the number of
+ * hardware threads (default: 0).
+ *
+ * \returns true if all models were read successfully.
+ *
+ * \note The models must be distinct objects. Logging (RBDL_ENABLE_LOGGING)
+ * writes to a global stream and must be disabled when loading in parallel.
+ */
+RBDL_DLLAPI
+bool LuaModelReadFromFiles (
+  const std::vector<std::string> &filenames,
+  std::vector<Model*> &models,
+  unsigned int thread_count = 0);
+
 /** \brief Reads a model file and returns the names of all constraint sets.
  */
 RBDL_DLLAPI
@@ -0,0 +1,71 @@
+#include "rbdl_tests.h"
+
+#include <string>
+#include <vector>
+
+#include "rbdl/rbdl.h"
+#include "luamodel.h"
+
+using namespace std;
+using namespace RigidBodyDynamics;
+using namespace RigidBodyDynamics::Addons;
+using namespace RigidBodyDynamics::Math;
+
+const double TEST_PREC = 1.0e-14;
+
+/** \brief Checks that two models that were read from the same file have
+ * the same structure, joints, transformations and inertias.
+ */
+static void CheckModelsEqual (const Model &model_a, const Model &model_b) {
+  REQUIRE (model_a.q_size == model_b.q_size);
+  REQUIRE (model_a.qdot_size == model_b.qdot_size);
+  REQUIRE (model_a.mBodies.size() == model_b.mBodies.size());
+  REQUIRE (model_a.mFixedBodies.size() == model_b.mFixedBodies.size());
+  REQUIRE (model_a.mBodyNameMap == model_b.mBodyNameMap);
+  REQUIRE (model_a.lambda == model_b.lambda);
+
+  for (unsigned int i = 1; i < model_a.mBodies.size(); i++) {
+    REQUIRE (model_a.mJoints[i].mJointType == model_b.mJoints[i].mJointType);
+    REQUIRE (model_a.mJoints[i].q_index == model_b.mJoints[i].q_index);
+    REQUIRE_THAT (model_a.X_T[i].toMatrix(),
+        AllCloseMatrix(model_b.X_T[i].toMatrix(), TEST_PREC, TEST_PREC));
+    REQUIRE_THAT (model_a.I[i].toMatrix(),
+        AllCloseMatrix(model_b.I[i].toMatrix(), TEST_PREC, TEST_PREC));
+  }
+}
+
+TEST_CASE (__FILE__"_LuaModelReadFromFilesMatchesSequential", "") {
+  std::vector<std::string> filenames;
+  for (unsigned int k = 0; k < 3; k++) {
+    filenames.push_back (std::string (LUAMODEL_SAMPLES_DIR)
+        + "/samplemodel.lua");
+    filenames.push_back (std::string (LUAMODEL_SAMPLES_DIR)
+        + "/sampleconstrainedmodel.lua");
+  }
+
+  std::vector<Model*> sequential_models (filenames.size());
+  for (unsigned int i = 0; i < filenames.size(); i++) {
+    sequential_models[i] = new Model;
+    REQUIRE (LuaModelReadFromFile (filenames[i].c_str(),
+          sequential_models[i], false));
+  }
+
+  unsigned int thread_counts[] = { 1, 2, 0 };
+  for (unsigned int t = 0; t < 3; t++) {
+    std::vector<Model*> models (filenames.size());
+    for (unsigned int i = 0; i < filenames.size(); i++) {
+      models[i] = new Model;
+    }
+
+    REQUIRE (LuaModelReadFromFiles (filenames, models, thread_counts[t]));
+
+    for (unsigned int i = 0; i < filenames.size(); i++) {
+      CheckModelsEqual (*sequential_models[i], *models[i]);
+      delete models[i];
+    }
+  }
+
+  for (unsigned int i = 0; i < filenames.size(); i++) {
+    delete sequential_models[i];
+  }
+}
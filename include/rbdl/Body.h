@@ -196,6 +196,12 @@ struct RBDL_DLLAPI FixedBody {
   /// \brief Transforms spatial quantities expressed for the parent to the
   // fixed body. 
   Math::SpatialTransform mParentTransform;
+  /// \brief Id of the (movable or fixed) body that was passed as parent to
+  /// Model::AddBody().
+  unsigned int mParent;
+  /// \brief The joint frame relative to mParent, i.e. mParentTransform is
+  /// mJointFrame composed with the parent transform of mParent.
+  Math::SpatialTransform mJointFrame;
   Math::SpatialTransform mBaseTransform;
 
   static FixedBody CreateFromBody (const Body& body) {
@@ -204,6 +210,9 @@ struct RBDL_DLLAPI FixedBody {
     fbody.mMass = body.mMass;
     fbody.mCenterOfMass = body.mCenterOfMass;
     fbody.mInertia = body.mInertia;
+    fbody.mMovableParent = 0;
+    fbody.mParent = 0;
+    fbody.mJointFrame = Math::SpatialTransform();
 
     return fbody;
   }
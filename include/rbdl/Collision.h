@@ -0,0 +1,237 @@
+/*
+ * RBDL - Rigid Body Dynamics Library
+ * Copyright (c) 2011-2018 Martin Felis <martin@fysx.org>
+ *
+ * Licensed under the zlib license. See LICENSE for more details.
+ */
+
+#ifndef RBDL_COLLISION_H
+#define RBDL_COLLISION_H
+
+#include <vector>
+
+#include <rbdl/rbdl_math.h>
+#include <rbdl/rbdl_mathutils.h>
+
+namespace RigidBodyDynamics {
+
+struct Model;
+struct ConstraintSet;
+
+/** \page collision_page Collision
+ *
+ * All functions related to collision detection are specified in the \ref
+ * collision_group "Collision Module".
+ *
+ * \defgroup collision_group Collision
+ *
+ * Bodies (including fixed bodies) can be equipped with primitive collision
+ * shapes (spheres, capsules and boxes) that are collected in a
+ * CollisionWorld. Shapes that are attached to the base (body id 0)
+ * describe the static environment.
+ *
+ * After the kinematics of the model were updated (e.g. with
+ * UpdateKinematics()) CollisionWorld::UpdateTransforms() copies the
+ * transformations of the bodies from Model::X_base. Then
+ * CollisionWorld::CalcContacts() finds the overlapping axis-aligned bounding
+ * boxes with a sweep-and-prune broadphase along the x-axis and evaluates
+ * the closest points of the overlapping shapes. The sort order of the
+ * sweep is kept between calls such that the sorting is close to linear
+ * when the bodies move only a little between two calls.
+ *
+ * Contacts between a body and the environment can be added as contact
+ * constraints with AddCollisionContactConstraints().
+ *
+ * @{
+ */
+
+/// The types of collision shapes.
+enum CollisionShapeType {
+  CollisionShapeSphere = 0,
+  CollisionShapeCapsule,
+  CollisionShapeBox
+};
+
+/** \brief A primitive collision shape that is attached to a body. */
+struct RBDL_DLLAPI CollisionShape {
+  CollisionShape() :
+    type (CollisionShapeSphere),
+    body_id (0),
+    radius (0.),
+    half_length (0.),
+    half_extents (Math::Vector3d::Zero())
+  {}
+
+  /// The type of the shape.
+  CollisionShapeType type;
+  /// The (movable or fixed) body the shape is attached to.
+  unsigned int body_id;
+  /** The transformation from the body frame to the shape frame, i.e. the
+   * shape is centered at frame.r. */
+  Math::SpatialTransform frame;
+  /// The radius of spheres and capsules.
+  double radius;
+  /// Half the length of the axis of a capsule (along the z-axis of the shape frame).
+  double half_length;
+  /// Half the side lengths of a box (in the shape frame).
+  Math::Vector3d half_extents;
+};
+
+/** \brief A contact between two collision shapes. */
+struct RBDL_DLLAPI CollisionContact {
+  CollisionContact() :
+    shape_a (0), shape_b (0),
+    body_a (0), body_b (0),
+    movable_a (0), movable_b (0),
+    point_a (Math::Vector3d::Zero()),
+    point_b (Math::Vector3d::Zero()),
+    body_point_a (Math::Vector3d::Zero()),
+    body_point_b (Math::Vector3d::Zero()),
+    normal (Math::Vector3d::Zero()),
+    depth (0.)
+  {}
+
+  /// The indices of the shapes in CollisionWorld::shapes.
+  unsigned int shape_a, shape_b;
+  /// The bodies of the shapes.
+  unsigned int body_a, body_b;
+  /** The movable bodies of body_a and body_b (0 for the base and for fixed
+   * bodies that are attached to the base). */
+  unsigned int movable_a, movable_b;
+  /// The deepest point of shape a inside of shape b in base coordinates.
+  Math::Vector3d point_a;
+  /// The deepest point of shape b inside of shape a in base coordinates.
+  Math::Vector3d point_b;
+  /// point_a in coordinates of body_a.
+  Math::Vector3d body_point_a;
+  /// point_b in coordinates of body_b.
+  Math::Vector3d body_point_b;
+  /// The unit contact normal (in base coordinates) pointing from a to b.
+  Math::Vector3d normal;
+  /// The penetration depth along the normal.
+  double depth;
+};
+
+/** \brief Collection of collision shapes and workspace of the collision
+ * detection.
+ */
+struct RBDL_DLLAPI CollisionWorld {
+  CollisionWorld() :
+    exclude_adjacent_bodies (true)
+  {}
+
+  /** \brief Adds a sphere to a body.
+   *
+   * \param body_id the (movable or fixed) body or 0 for the environment
+   * \param frame the transformation from the body frame to the shape frame
+   * \param radius the radius of the sphere
+   *
+   * \returns the index of the shape
+   */
+  unsigned int AddSphere (unsigned int body_id,
+      const Math::SpatialTransform &frame,
+      double radius);
+
+  /** \brief Adds a capsule (whose axis is the z-axis of the shape frame)
+   * to a body.
+   *
+   * \param body_id the (movable or fixed) body or 0 for the environment
+   * \param frame the transformation from the body frame to the shape frame
+   * \param radius the radius of the capsule
+   * \param half_length half the length of the axis of the capsule
+   *
+   * \returns the index of the shape
+   */
+  unsigned int AddCapsule (unsigned int body_id,
+      const Math::SpatialTransform &frame,
+      double radius,
+      double half_length);
+
+  /** \brief Adds a box to a body.
+   *
+   * \param body_id the (movable or fixed) body or 0 for the environment
+   * \param frame the transformation from the body frame to the shape frame
+   * \param half_extents half the side lengths of the box
+   *
+   * \returns the index of the shape
+   */
+  unsigned int AddBox (unsigned int body_id,
+      const Math::SpatialTransform &frame,
+      const Math::Vector3d &half_extents);
+
+  /** \brief Updates the transformations of all shapes from Model::X_base.
+   *
+   * The kinematics of the model have to be updated beforehand.
+   */
+  void UpdateTransforms (Model &model);
+
+  /** \brief Computes the contacts of all shapes.
+   *
+   * Shapes of the same movable body never collide with each other. If
+   * exclude_adjacent_bodies is set also shapes of bodies that are directly
+   * connected by a joint are skipped.
+   *
+   * \note Box-box contacts are computed from the corners of each box
+   * inside of the other box (i.e. edge-edge contacts are not detected) and
+   * capsule-box contacts from the point of the capsule axis closest to the
+   * box. This point is found with alternating projections onto the box and
+   * the capsule axis that stop once the point moves less than 1.0e-10
+   * between two projections or after at most 32 projections. In the
+   * latter case the error of the point along the axis is bounded by the
+   * last step length.
+   *
+   * \param contacts (output) the contacts
+   *
+   * \returns the number of contacts
+   */
+  unsigned int CalcContacts (std::vector<CollisionContact> &contacts);
+
+  /// The collision shapes.
+  std::vector<CollisionShape> shapes;
+  /// Whether shapes of a body and its parent should not collide.
+  bool exclude_adjacent_bodies;
+
+  /// Position of the shape centers in base coordinates.
+  std::vector<Math::Vector3d> mShapePositions;
+  /// Orientation of the shapes whose columns are the shape axes in base coordinates.
+  std::vector<Math::Matrix3d> mShapeOrientations;
+  /// Transformations from base to the body frames of the shapes.
+  std::vector<Math::SpatialTransform> mBodyTransforms;
+  /// Movable bodies of the shapes (Model::GetMovableBodyId() of the bodies).
+  std::vector<unsigned int> mMovableBodies;
+  /// Non-virtual parents of the movable bodies of the shapes.
+  std::vector<unsigned int> mParentBodies;
+  /// Lower corners of the axis-aligned bounding boxes.
+  std::vector<Math::Vector3d> mBoundsMin;
+  /// Upper corners of the axis-aligned bounding boxes.
+  std::vector<Math::Vector3d> mBoundsMax;
+  /// Shape indices sorted by the lower bound along the x-axis.
+  std::vector<unsigned int> mSweepOrder;
+};
+
+/** \brief Adds contact constraints for contacts between bodies and the
+ * environment.
+ *
+ * For each contact between a shape of a body and a shape of the
+ * environment (i.e. the base or a fixed body that is attached to the base,
+ * see CollisionContact::movable_a) a contact constraint along the contact
+ * normal is added at the contact point of the body. Contacts between two bodies
+ * are skipped as they cannot be expressed by contact constraints.
+ *
+ * \param contacts the contacts, e.g. from CollisionWorld::CalcContacts()
+ * \param CS the (unbound) constraint set
+ *
+ * \returns the number of added constraints
+ */
+RBDL_DLLAPI
+unsigned int AddCollisionContactConstraints (
+    const std::vector<CollisionContact> &contacts,
+    ConstraintSet &CS
+    );
+
+/** @} */
+
+} /* namespace RigidBodyDynamics */
+
+/* RBDL_COLLISION_H */
+#endif
@@ -192,6 +192,15 @@ namespace RigidBodyDynamics {
  * - CalcAssemblyQ()
  * - CalcAssemblyQDot()
  *
+ * For closed-loop mechanisms with few independent degrees of freedom the
+ * generalized coordinates can instead be partitioned into independent and
+ * dependent coordinates with a CoordinatePartitioning. Then only the
+ * independent coordinates have to be integrated while the dependent ones
+ * are computed with CalcDependentQ() and CalcDependentQDot(), which reuse
+ * a cached factorization of the constraint Jacobian, and the dynamics are
+ * solved in the independent coordinates with
+ * ForwardDynamicsConstraintsPartitioned().
+ *
  * \subsection baumgarte_stabilization Baumgarte Stabilization
  *
  * The constrained dynamic equations are correct at the acceleration level
@@ -247,6 +256,16 @@ namespace RigidBodyDynamics {
  * For Loop- and CustomConstraints Baumgarte stabilization is enabled by
  * default and uses the stabilization parameter \f$T_\textit{stab} = 0.1\f$.
  *
+ * \subsection constraint_projection Constraint Projection
+ *
+ * Alternatively (or additionally) the drift can be removed after each
+ * integration step with ProjectOntoConstraints(). It moves \f$q\f$ and
+ * \f$\dot{q}\f$ back onto the constraint manifold with minimal norm
+ * corrections and reuses the QR decomposition of \f$G^T\f$ that was
+ * computed by ForwardDynamicsConstraintsNullSpace() during the dynamics
+ * solve of the step, such that each correction only costs a triangular
+ * solve and a product with \f$Y\f$.
+ *
  * @{
  */
 
@@ -254,6 +273,39 @@ struct Model;
 
 struct RBDL_DLLAPI CustomConstraint;
 
+/** \brief Kinematic quantities of the two frames of a CustomConstraint.
+ *
+ * This structure is filled by CalcConstraintsTerms() for custom
+ * constraints that set CustomConstraint::mUsesFrameKinematics such that
+ * CustomConstraint::CalcConstraintTerms() does not have to evaluate the
+ * kinematics of the predecessor and successor frames again. All quantities
+ * are expressed in base coordinates and follow the conventions of
+ * CalcBodyWorldOrientation(), CalcPointVelocity6D(),
+ * CalcPointAcceleration6D() and CalcPointJacobian6D().
+ */
+struct RBDL_DLLAPI CustomConstraintFrameKinematics {
+  /// Orientation of the predecessor frame.
+  Math::Matrix3d E_p;
+  /// Orientation of the successor frame.
+  Math::Matrix3d E_s;
+  /// Origin of the predecessor frame.
+  Math::Vector3d r_p;
+  /// Origin of the successor frame.
+  Math::Vector3d r_s;
+  /// Spatial velocity of the predecessor frame origin.
+  Math::SpatialVector v_p;
+  /// Spatial velocity of the successor frame origin.
+  Math::SpatialVector v_s;
+  /// Spatial acceleration of the predecessor frame origin for \f$\ddot{q} = 0\f$.
+  Math::SpatialVector a_p;
+  /// Spatial acceleration of the successor frame origin for \f$\ddot{q} = 0\f$.
+  Math::SpatialVector a_s;
+  /// 6-D point Jacobian of the predecessor frame origin.
+  Math::MatrixNd G_p;
+  /// 6-D point Jacobian of the successor frame origin.
+  Math::MatrixNd G_s;
+};
+
 /** \brief Structure that contains both constraint information and workspace memory.
  *
  * This structure is used to reduce the amount of memory allocations that
@@ -392,6 +444,11 @@ struct RBDL_DLLAPI ConstraintSet {
    * The values of ConstraintSet::acceleration may still be
    * modified after the set is bound to the model.
    *
+   * Binding also groups the contact constraints by their body point and
+   * the loop constraints by their frames such that the kinematics of each
+   * distinct point or pair of frames are evaluated only once, independent
+   * of the order in which the constraints were added.
+   *
    */
   bool Bind (const Model &model);
 
@@ -420,6 +477,12 @@ struct RBDL_DLLAPI ConstraintSet {
   std::vector<unsigned int> body;
   std::vector<Math::Vector3d> point;
   std::vector<Math::Vector3d> normal;
+  /** Contact constraint indices ordered such that constraints on the same
+   * body point are adjacent (computed by Bind()). */
+  std::vector<unsigned int> mContactGroupConstraintIndices;
+  /** Start of each group of contact constraints on the same body point in
+   * mContactGroupConstraintIndices (followed by the total count). */
+  std::vector<unsigned int> mContactGroupOffsets;
 
   // Loop constraints variables.
   std::vector<unsigned int> body_p;
@@ -427,6 +490,12 @@ struct RBDL_DLLAPI ConstraintSet {
   std::vector<Math::SpatialTransform> X_p;
   std::vector<Math::SpatialTransform> X_s;
   std::vector<Math::SpatialVector> constraintAxis;
+  /** Loop constraint indices ordered such that constraints between the
+   * same frames are adjacent (computed by Bind()). */
+  std::vector<unsigned int> mLoopGroupConstraintIndices;
+  /** Start of each group of loop constraints between the same frames in
+   * mLoopGroupConstraintIndices (followed by the total count). */
+  std::vector<unsigned int> mLoopGroupOffsets;
   /** Baumgarte stabilization parameter */
   std::vector<Math::Vector2d> baumgarteParameters;
   /** Position error for the Baumgarte stabilization */
@@ -516,6 +585,9 @@ struct RBDL_DLLAPI ConstraintSet {
 
   //CustomConstraint variables.
 
+  /// Workspace for the kinematics of the loop and custom constraint frames
+  /// (also passed to CustomConstraint::CalcConstraintTerms())
+  CustomConstraintFrameKinematics custom_frames;
 
 };
 
@@ -586,6 +658,43 @@ void CalcConstraintsVelocityError(
   bool update_kinematics = true
 );
 
+/** \brief Computes the constraint Jacobian, the position and velocity
+  * errors and \f$\gamma\f$ in a single pass over the constraints.
+  *
+  * This is equivalent to calling CalcConstraintsJacobian(),
+  * CalcConstraintsPositionError() and CalcConstraintsVelocityError() and
+  * evaluating \f$\gamma\f$ (including the terms of the \ref
+  * baumgarte_stabilization) but visits each constraint only once. The
+  * kinematic quantities of a constraint frame are evaluated once and
+  * reused for all consecutive constraints that act on the same frames.
+  *
+  * \param model the model
+  * \param Q the generalized positions of the joints
+  * \param QDot the generalized velocities of the joints
+  * \param CS the constraint set
+  * \param G (output) the constraint Jacobian (size CS.size() x
+  * model.dof_count)
+  * \param err (output) the position errors (size CS.size())
+  * \param errd (output) the velocity errors (size CS.size())
+  * \param gamma (output) the acceleration independent part of the
+  * constraints (size CS.size())
+  * \param update_kinematics whether the kinematics of the model should be
+  * updated from Q, QDot and \f$\ddot{q} = 0\f$. If false the model
+  * kinematics must have been updated with these values.
+  */
+RBDL_DLLAPI
+void CalcConstraintsTerms (
+  Model &model,
+  const Math::VectorNd &Q,
+  const Math::VectorNd &QDot,
+  ConstraintSet &CS,
+  Math::MatrixNd &G,
+  Math::VectorNd &err,
+  Math::VectorNd &errd,
+  Math::VectorNd &gamma,
+  bool update_kinematics = true
+);
+
 /** \brief Computes the terms \f$H\f$, \f$G\f$, and \f$\gamma\f$ of the
   * constrained dynamic problem and stores them in the ConstraintSet.
   *
@@ -659,6 +768,238 @@ void CalcAssemblyQDot(
   const Math::VectorNd &weights
 );
 
+/** \brief Projects the generalized positions and velocities onto the
+ * constraint manifold.
+ *
+ * Computes minimal norm corrections \f$\Delta q\f$ and \f$\Delta
+ * \dot{q}\f$ such that \f$\phi(q) = 0\f$ and \f$G(q) \dot{q} = 0\f$,
+ * i.e. \f[
+ *   \Delta q = - Y R^{-T} \phi(q), \quad
+ *   \Delta \dot{q} = - Y R^{-T} G \dot{q}
+ * \f] where \f$G^T = Y R\f$ is the QR decomposition that is stored in
+ * ConstraintSet::GT_qr and ConstraintSet::Y by
+ * ForwardDynamicsConstraintsNullSpace() (or
+ * ComputeConstraintImpulsesNullSpace()). As the decomposition belongs to the
+ * generalized positions of the last dynamics solve the position correction
+ * is repeated (a simplified Newton iteration) until the error is below the
+ * tolerance. Spherical joints are updated on the quaternion as in
+ * CalcAssemblyQ().
+ *
+ * \note The constraints must be linearly independent. If the last dynamics
+ * solve did not use the null space method set update_factorization to
+ * true.
+ *
+ * \param model the model
+ * \param Q (input/output) the generalized positions
+ * \param QDot (input/output) the generalized velocities
+ * \param CS the constraint set
+ * \param tolerance the norm of the position and velocity errors below which
+ * no further corrections are applied (defaults to 1e-12)
+ * \param max_iter the maximum number of corrections of the positions and
+ * of the velocities (defaults to 5)
+ * \param update_factorization whether the QR decomposition should be
+ * recomputed at Q before the projection (defaults to false)
+ *
+ * \returns true if both errors are below the tolerance
+ */
+RBDL_DLLAPI
+bool ProjectOntoConstraints (
+  Model &model,
+  Math::VectorNd &Q,
+  Math::VectorNd &QDot,
+  ConstraintSet &CS,
+  double tolerance = 1e-12,
+  unsigned int max_iter = 5,
+  bool update_factorization = false
+);
+
+/** \brief Partitioning of the generalized coordinates of a constrained
+ * model into independent and dependent coordinates.
+ *
+ * With generalized coordinate partitioning the constraints \f$\phi (q) =
+ * 0\f$ are used to compute the \f$m\f$ dependent coordinates \f$q_d\f$ from
+ * the \f$n - m\f$ independent coordinates \f$q_i\f$ such that only the
+ * independent coordinates have to be integrated. Bind() chooses the
+ * dependent coordinates once by Gauss elimination with full pivoting of the
+ * constraint Jacobian such that the block \f$G_d\f$ of the dependent
+ * coordinates is well conditioned and stores the LU factorization of
+ * \f$G_d\f$. The factorization is updated by
+ * ForwardDynamicsConstraintsPartitioned() and CalcDependentQDot() and
+ * reused by the Newton iterations of CalcDependentQ(). A typical
+ * integration step is:
+ *
+ * \code
+ * ForwardDynamicsConstraintsPartitioned (model, Q, QDot, Tau, CS,
+ *     partitioning, QDDot);
+ * // integrate (at least) the independent coordinates
+ * QDot += h * QDDot;
+ * Q += h * QDot;
+ * CalcDependentQ (model, Q, CS, partitioning);
+ * CalcDependentQDot (model, Q, QDot, CS, partitioning);
+ * \endcode
+ *
+ * \note The coordinates of spherical joints are never chosen as dependent
+ * coordinates. The constraints must not be redundant.
+ */
+struct RBDL_DLLAPI CoordinatePartitioning {
+  CoordinatePartitioning() :
+    bound (false)
+  {}
+
+  /** \brief Chooses the independent coordinates at the configuration Q
+   * and factorizes the dependent block of the constraint Jacobian.
+   *
+   * \returns false if the constraint Jacobian does not have full rank.
+   */
+  bool Bind (Model &model, const Math::VectorNd &Q, ConstraintSet &CS);
+
+  /** \brief Uses the given independent coordinates (indices into qdot)
+   * and factorizes the dependent block of the constraint Jacobian at Q.
+   *
+   * \returns false if the dependent block is singular.
+   */
+  bool Bind (Model &model,
+      const Math::VectorNd &Q,
+      ConstraintSet &CS,
+      const std::vector<unsigned int> &independent_dofs);
+
+  /** \brief Computes the constraint Jacobian at Q and updates the
+   * factorization of its dependent block.
+   */
+  void UpdateFactorization (Model &model,
+      const Math::VectorNd &Q,
+      ConstraintSet &CS,
+      bool update_kinematics = true);
+
+  /// Indices of the independent coordinates in qdot.
+  std::vector<unsigned int> independent;
+  /// Indices of the dependent coordinates in qdot (and q).
+  std::vector<unsigned int> dependent;
+  /// Whether the partitioning was bound to a model and constraint set.
+  bool bound;
+
+  /// Workspace for the constraint Jacobian.
+  Math::MatrixNd mG;
+  /// Workspace for the dependent block of the constraint Jacobian.
+  Math::MatrixNd mGd;
+  /// LU factorization of mGd.
+#ifdef RBDL_USE_SIMPLE_MATH
+  SimpleMath::PartialPivLU<Math::MatrixNd> mGd_lu;
+#else
+  Eigen::PartialPivLU<Math::MatrixNd> mGd_lu;
+#endif
+  /// Workspace for \f$G_d^{-1} G_i\f$.
+  Math::MatrixNd mGdInvGi;
+  /// Workspace for the map from independent to all velocities.
+  Math::MatrixNd mT;
+  /// Workspace for \f$H T\f$.
+  Math::MatrixNd mHT;
+  /// Workspace for the inertia matrix of the independent coordinates.
+  Math::MatrixNd mHi;
+  /// Cholesky factorization of mHi.
+#ifdef RBDL_USE_SIMPLE_MATH
+  SimpleMath::LLT<Math::MatrixNd> mHi_llt;
+#else
+  Eigen::LLT<Math::MatrixNd> mHi_llt;
+#endif
+  /// Workspace for the constraint errors.
+  Math::VectorNd mErr;
+  /// Workspace for the updates of the dependent coordinates.
+  Math::VectorNd mDelta;
+  /// Workspace for the accelerations for zero independent accelerations.
+  Math::VectorNd mQDDot0;
+  /// Workspace for the independent accelerations.
+  Math::VectorNd mQDDotIndependent;
+  /// Workspace for the generalized forces of the independent coordinates.
+  Math::VectorNd mTauIndependent;
+  /// Workspace for the residual of the equations of motion.
+  Math::VectorNd mResidual;
+};
+
+/** \brief Computes the dependent generalized positions such that the
+ * position level constraints are satisfied.
+ *
+ * The independent coordinates of Q are kept. The dependent coordinates
+ * are computed by Newton iterations that reuse the factorization stored
+ * in the partitioning. The factorization is only updated if the error is
+ * not reduced sufficiently.
+ *
+ * \param model the model
+ * \param Q (input/output) the generalized positions
+ * \param CS the constraint set
+ * \param partitioning the (bound) coordinate partitioning
+ * \param tolerance the function returns successfully if the norm of the
+ * constraint position errors is lower than this value.
+ * \param max_iter the maximum number of iterations
+ *
+ * \return true if the constraints are satisfied, false otherwise.
+ */
+RBDL_DLLAPI
+bool CalcDependentQ (
+  Model &model,
+  Math::VectorNd &Q,
+  ConstraintSet &CS,
+  CoordinatePartitioning &partitioning,
+  double tolerance = 1e-12,
+  unsigned int max_iter = 20
+);
+
+/** \brief Computes the dependent generalized velocities such that the
+ * velocity level constraints are satisfied.
+ *
+ * \param model the model
+ * \param Q the generalized positions that satisfy the constraints
+ * \param QDot (input/output) the generalized velocities whose independent
+ * coordinates are kept
+ * \param CS the constraint set
+ * \param partitioning the (bound) coordinate partitioning whose
+ * factorization is updated at Q
+ */
+RBDL_DLLAPI
+void CalcDependentQDot (
+  Model &model,
+  const Math::VectorNd &Q,
+  Math::VectorNd &QDot,
+  ConstraintSet &CS,
+  CoordinatePartitioning &partitioning
+);
+
+/** \brief Computes forward dynamics of a constrained model in the
+ * independent coordinates.
+ *
+ * The accelerations of the dependent coordinates are eliminated with
+ * \f$\ddot{q}_d = G_d^{-1} (\gamma - G_i \ddot{q}_i)\f$ such that only the
+ * system \f$T^T H T \ddot{q}_i = T^T (\tau - C - H \ddot{q}_0)\f$ of the
+ * size of the independent coordinates has to be solved, where \f$T\f$ maps
+ * the independent velocities to all velocities and \f$\ddot{q}_0\f$ are
+ * the accelerations for \f$\ddot{q}_i = 0\f$. The factorization of the
+ * partitioning is updated at Q.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the internal joints
+ * \param QDot  velocity vector of the internal joints
+ * \param Tau   actuations of the internal joints
+ * \param CS    the description of all acting constraints
+ * \param partitioning the (bound) coordinate partitioning
+ * \param QDDot accelerations of the internals joints (output)
+ * \param f_ext External forces acting on the body in base coordinates (optional, defaults to NULL)
+ *
+ * \note During execution of this function values such as
+ * ConstraintSet::force get modified and will contain the constraint
+ * forces.
+ */
+RBDL_DLLAPI
+void ForwardDynamicsConstraintsPartitioned (
+  Model &model,
+  const Math::VectorNd &Q,
+  const Math::VectorNd &QDot,
+  const Math::VectorNd &Tau,
+  ConstraintSet &CS,
+  CoordinatePartitioning &partitioning,
+  Math::VectorNd &QDDot,
+  std::vector<Math::SpatialVector> *f_ext = NULL
+);
+
 /** \brief Computes forward dynamics with contact by constructing and solving
  *  the full lagrangian equation
  *
@@ -1049,7 +1390,14 @@ struct RBDL_DLLAPI CustomConstraint {
     unsigned int mConstraintCount;
     //unsigned int mAssemblyConstraintCount;
 
-    CustomConstraint(unsigned int constraintCount):mConstraintCount(constraintCount){}
+    /** Whether CalcConstraintsTerms() should evaluate the
+     * kinematics of the constraint frames and pass them to
+     * CalcConstraintTerms() (defaults to false). */
+    bool mUsesFrameKinematics;
+
+    CustomConstraint(unsigned int constraintCount)
+      : mConstraintCount(constraintCount),
+      mUsesFrameKinematics(false) {}
 
     virtual ~CustomConstraint(){};
 
@@ -1088,6 +1436,42 @@ struct RBDL_DLLAPI CustomConstraint {
                                     Math::VectorNd &err,
                                     unsigned int errStartIndex) = 0;
 
+    /** \brief Evaluates the Jacobian, gamma, position and velocity error of
+     * the constraint in a single call.
+     *
+     * This function is used by CalcConstraintsTerms() (and thus
+     * by all ForwardDynamicsConstraints*() functions) instead of the
+     * separate calls to CalcConstraintsJacobianAndConstraintAxis(),
+     * CalcPositionError(), CalcVelocityError() and CalcGamma(). The default
+     * implementation calls exactly these functions. Constraints that
+     * override it can evaluate the terms they share only once and, if
+     * mUsesFrameKinematics is set, use the precomputed quantities in frames
+     * instead of calling the kinematics functions themselves.
+     *
+     * When this function is called the model kinematics are updated with
+     * Q, QDot and \f$\ddot{q} = 0\f$. The Baumgarte stabilization terms
+     * are added to gamma by the caller.
+     *
+     * \param frames the kinematics of the constraint frames (only valid if
+     * mUsesFrameKinematics is set)
+     * \param G (output) the constraint Jacobian rows starting at startIdx
+     * \param gamma (output) the gamma entries starting at startIdx
+     * \param errPos (output) the position errors starting at startIdx
+     * \param errVel (output) the velocity errors starting at startIdx
+     * \param startIdx index of the first row of this constraint
+     */
+    virtual void CalcConstraintTerms( Model &model,
+                                      unsigned int custom_constraint_id,
+                                      const Math::VectorNd &Q,
+                                      const Math::VectorNd &QDot,
+                                      ConstraintSet &CS,
+                                      const CustomConstraintFrameKinematics &frames,
+                                      Math::MatrixNd &G,
+                                      Math::VectorNd &gamma,
+                                      Math::VectorNd &errPos,
+                                      Math::VectorNd &errVel,
+                                      unsigned int startIdx);
+
 };
 
 
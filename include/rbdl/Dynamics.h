@@ -19,6 +19,7 @@
 namespace RigidBodyDynamics {
 
 struct Model;
+struct Body;
 
 /** \page dynamics_page Dynamics
  *
@@ -71,6 +72,75 @@ RBDL_DLLAPI void NonlinearEffects (
     std::vector<Math::SpatialVector> *f_ext = NULL
     );
 
+/** \brief Computes the regressor matrix of the inertial parameters
+ *
+ * The regressor \f$Y(q, \dot{q}, \ddot{q})\f$ is the matrix for which the
+ * generalized forces of InverseDynamics() (without external forces) are
+ *   \f$ \tau = Y(q, \dot{q}, \ddot{q}) \pi \f$
+ * where \f$\pi\f$ is the vector of inertial parameters as returned by
+ * GetInertialParameters(). Each movable body contributes 10 parameters
+ * that are ordered as the members of Math::SpatialRigidBodyInertia, i.e.
+ * \f$(m, h_x, h_y, h_z, I_{xx}, I_{yx}, I_{yy}, I_{zx}, I_{zy}, I_{zz})\f$
+ * where \f$h\f$ is the first mass moment and \f$I\f$ the rotational
+ * inertia, both expressed at the origin of the body frame. Fixed bodies
+ * are part of the parameters of their movable parent.
+ *
+ * The force of each body is propagated along its support chain which
+ * results in \f$O(n^2)\f$ complexity.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the internal joints
+ * \param QDot  velocity vector of the internal joints
+ * \param QDDot accelerations of the internals joints
+ * \param Y     regressor matrix of size qdot_size x (10 * (mBodies.size() - 1)) (output)
+ * \param update_kinematics whether the kinematics should be updated (defaults to true)
+ *
+ * \note Columns of virtual bodies are zero as these do not take part in
+ * the dynamics.
+ */
+RBDL_DLLAPI void CalcInertialParameterRegressor (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    const Math::VectorNd &QDDot,
+    Math::MatrixNd &Y,
+    bool update_kinematics = true
+    );
+
+/** \brief Computes the stacked regressor matrix of multiple samples
+ *
+ * The regressors of all samples (Q[s], QDot[s], QDDot[s]) are stacked on
+ * top of each other such that Y has the size
+ * (Q.size() * qdot_size) x (10 * (mBodies.size() - 1)). Together with the
+ * stacked measured generalized forces this forms the linear least squares
+ * problem for the identification of the inertial parameters.
+ *
+ * \param model rigid body model
+ * \param Q     states of the samples
+ * \param QDot  velocities of the samples
+ * \param QDDot accelerations of the samples
+ * \param Y     stacked regressor matrix (output)
+ */
+RBDL_DLLAPI void CalcInertialParameterRegressor (
+    Model &model,
+    const std::vector<Math::VectorNd> &Q,
+    const std::vector<Math::VectorNd> &QDot,
+    const std::vector<Math::VectorNd> &QDDot,
+    Math::MatrixNd &Y
+    );
+
+/** \brief Returns the inertial parameters of all movable bodies
+ *
+ * \param model rigid body model
+ * \param params vector of size 10 * (mBodies.size() - 1) that is filled
+ * with the parameters in the order used by CalcInertialParameterRegressor()
+ * (output)
+ */
+RBDL_DLLAPI void GetInertialParameters (
+    const Model &model,
+    Math::VectorNd &params
+    );
+
 /** \brief Computes the joint space inertia matrix by using the Composite Rigid Body Algorithm
  *
  * This function computes the joint space inertia matrix from a given model and
@@ -93,6 +163,171 @@ RBDL_DLLAPI void CompositeRigidBodyAlgorithm (
     bool update_kinematics = true
     );
 
+/** \brief Computes the joint space inertia matrix and the nonlinear
+ * effects in a single pass
+ *
+ * This function computes the results of CompositeRigidBodyAlgorithm() and
+ * NonlinearEffects() with a single evaluation of the joint
+ * transformations and a single backward pass over the bodies.
+ * Additionally it can compute the generalized forces that are caused by
+ * gravity alone (i.e. NonlinearEffects() for zero velocities).
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the internal joints
+ * \param QDot  velocity vector of the internal joints
+ * \param H     a matrix where the joint space inertia matrix will be stored in
+ * \param C     the nonlinear effects (output)
+ * \param gravity_effects the generalized forces due to gravity (optional
+ *              output, defaults to NULL)
+ * \param f_ext External forces acting on the body in base coordinates (optional, defaults to NULL)
+ *
+ * \note As for CompositeRigidBodyAlgorithm() only the non-zero entries of H
+ * are evaluated and H has to be set to zero beforehand.
+ *
+ * \note This function also updates the transformations Model::X_base.
+ */
+RBDL_DLLAPI void CalcJointSpaceInertiaAndNonlinearEffects (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    Math::MatrixNd &H,
+    Math::VectorNd &C,
+    Math::VectorNd *gravity_effects = NULL,
+    std::vector<Math::SpatialVector> *f_ext = NULL
+    );
+
+/** \brief Computes the matrix of the Coriolis and centrifugal effects
+ *
+ * This function computes the matrix \f$ C(q, \dot{q}) \f$ such that
+ * \f$ C(q, \dot{q}) \dot{q} \f$ are the Coriolis and centrifugal effects
+ * (i.e. NonlinearEffects() without gravity) and \f$ \dot{M} - 2 C \f$ is
+ * skew-symmetric. It uses the recursive algorithm of Echeandia and
+ * Wensing that traverses the bodies like the
+ * CompositeRigidBodyAlgorithm() and runs in \f$O(n_{dof}^2)\f$.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the internal joints
+ * \param QDot  velocity vector of the internal joints
+ * \param C     a matrix where the result will be stored in
+ * \param update_kinematics  whether the kinematics should be updated (safer, but at a higher computational cost!)
+ *
+ * \note Custom joints are not supported.
+ */
+RBDL_DLLAPI void CalcCoriolisMatrix (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    Math::MatrixNd &C,
+    bool update_kinematics = true
+    );
+
+/** \brief First- and second-order partial derivatives of the inverse
+ * dynamics.
+ *
+ * The second-order derivatives \f$ \frac{\partial^2 \tau}{\partial x_i
+ * \partial y_j} \f$ vanish unless one of the degrees of freedom i and j
+ * supports the other one (or i = j). They are therefore only stored for
+ * the pairs of degrees of freedom that lie on a common path to the root:
+ * column p of the second-order derivatives contains the derivatives with
+ * respect to the degrees of freedom pair_first[p] and pair_second[p], where
+ * pair_first[p] is the supporting (or the same) degree of freedom.
+ *
+ * The sizes of the derivatives and of the internal workspace are set by
+ * Bind().
+ */
+struct RBDL_DLLAPI InverseDynamicsDerivatives {
+  InverseDynamicsDerivatives() :
+    bound (false)
+  {}
+
+  /** \brief Initializes the pairs of degrees of freedom and allocates the
+   * derivatives and the workspace for a model.
+   *
+   * \note Only models whose joints have a single degree of freedom and a
+   * constant motion subspace (e.g. revolute and prismatic joints or the
+   * emulated multi-DoF joints) are supported. Models with spherical,
+   * Euler, floating base, helical or custom joints are rejected.
+   *
+   * \returns true if the model is supported, otherwise false (and bound
+   * remains false).
+   */
+  bool Bind (const Model &model);
+
+  /// Whether Bind() was called.
+  bool bound;
+
+  /// \f$ \partial \tau / \partial q \f$ (dof_count x dof_count).
+  Math::MatrixNd dtau_dq;
+  /// \f$ \partial \tau / \partial \dot{q} \f$ (dof_count x dof_count).
+  Math::MatrixNd dtau_dqdot;
+
+  /// The supporting degree of freedom of each pair.
+  std::vector<unsigned int> pair_first;
+  /// The supported degree of freedom of each pair (or pair_first[p]).
+  std::vector<unsigned int> pair_second;
+
+  /** Column p: \f$ \partial^2 \tau / (\partial q_{first} \partial
+   * q_{second}) \f$ (dof_count x number of pairs). */
+  Math::MatrixNd d2tau_dq_dq;
+  /** Column p: \f$ \partial^2 \tau / (\partial \dot{q}_{first} \partial
+   * \dot{q}_{second}) \f$. */
+  Math::MatrixNd d2tau_dqdot_dqdot;
+  /** Column p: \f$ \partial^2 \tau / (\partial q_{first} \partial
+   * \dot{q}_{second}) \f$. */
+  Math::MatrixNd d2tau_dq_dqdot;
+  /** Column p: \f$ \partial^2 \tau / (\partial \dot{q}_{first} \partial
+   * q_{second}) \f$. */
+  Math::MatrixNd d2tau_dqdot_dq;
+
+  /// Workspace: the body of each degree of freedom.
+  std::vector<unsigned int> mDoFBodies;
+  /** Workspace: first-order derivatives of the body velocities with respect
+   * to each q (first dof_count blocks) and qdot (last dof_count blocks). */
+  std::vector<Math::SpatialVector> mV;
+  /// Workspace: first-order derivatives of the body accelerations.
+  std::vector<Math::SpatialVector> mA;
+  /// Workspace: first-order derivatives of the accumulated body forces.
+  std::vector<Math::SpatialVector> mF;
+  /// Workspace: second-order derivatives of the body velocities.
+  std::vector<Math::SpatialVector> mV2;
+  /// Workspace: second-order derivatives of the body accelerations.
+  std::vector<Math::SpatialVector> mA2;
+  /// Workspace: second-order derivatives of the accumulated body forces.
+  std::vector<Math::SpatialVector> mF2;
+  /// Workspace: whether a body is in the subtree of the current body.
+  std::vector<bool> mInSubtree;
+  /// Workspace: whether a body supports the current body.
+  std::vector<bool> mSupporting;
+};
+
+/** \brief Computes the first- and second-order partial derivatives of the
+ * inverse dynamics with respect to the generalized positions and
+ * velocities
+ *
+ * The derivatives are computed analytically by propagating the
+ * derivatives of the body velocities, accelerations and forces through
+ * the recursive Newton-Euler algorithm. The propagation for a degree of
+ * freedom only visits its subtree and its supporting bodies and pairs of
+ * degrees of freedom that do not lie on a common path to the root are
+ * skipped entirely.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the internal joints
+ * \param QDot  velocity vector of the internal joints
+ * \param QDDot accelerations of the internals joints
+ * \param Tau   actuations of the internal joints (output)
+ * \param derivatives the derivatives (output, has to be bound to the model
+ * with InverseDynamicsDerivatives::Bind())
+ */
+RBDL_DLLAPI void CalcInverseDynamicsDerivatives (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    const Math::VectorNd &QDDot,
+    Math::VectorNd &Tau,
+    InverseDynamicsDerivatives &derivatives
+    );
+
 /** \brief Computes forward dynamics with the Articulated Body Algorithm
  *
  * This function computes the generalized accelerations from given
@@ -117,6 +352,38 @@ RBDL_DLLAPI void ForwardDynamics (
     std::vector<Math::SpatialVector> *f_ext = NULL
     );
 
+/** \brief Computes hybrid dynamics where for each degree of freedom either
+ * the acceleration or the force is known
+ *
+ * For the degrees of freedom marked in qddot_known the accelerations are
+ * prescribed and the required generalized forces are computed. For all
+ * other degrees of freedom the generalized forces are given and the
+ * resulting accelerations are computed. It uses a variant of the
+ * Articulated %Body Algorithm that runs in \f$O(n_{dof})\f$ and includes
+ * ForwardDynamics() (no acceleration known) and InverseDynamics() (all
+ * accelerations known) as special cases.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the internal joints
+ * \param QDot  velocity vector of the internal joints
+ * \param QDDot accelerations of the internal joints. Entries marked in
+ *              qddot_known are inputs, all others are outputs.
+ * \param Tau   actuations of the internal joints. Entries not marked in
+ *              qddot_known are inputs, all others are outputs.
+ * \param qddot_known mask of size qdot_size that is true for the degrees
+ *              of freedom whose accelerations are prescribed
+ * \param f_ext External forces acting on the body in base coordinates (optional, defaults to NULL)
+ */
+RBDL_DLLAPI void HybridDynamics (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    Math::VectorNd &QDDot,
+    Math::VectorNd &Tau,
+    const std::vector<bool> &qddot_known,
+    std::vector<Math::SpatialVector> *f_ext = NULL
+    );
+
 /** \brief Computes forward dynamics by building and solving the full Lagrangian equation
  *
  * This method builds and solves the linear system
@@ -176,6 +443,132 @@ RBDL_DLLAPI void CalcMInvTimesTau (
     bool update_kinematics=true
     );
 
+/** \brief Computes the effect of multiplying the inverse of the joint
+ * space inertia matrix with a matrix in linear time.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the generalized positions
+ * \param Tau   the matrix of size qdot_size x k that should be multiplied
+ *              with the inverse of the joint space inertia matrix
+ * \param QDDot matrix of size qdot_size x k where the result will be stored
+ * \param update_kinematics whether the kinematics should be updated (safer, but at a higher computational cost)
+ *
+ * This is the same as calling CalcMInvTimesTau() for each column of Tau,
+ * however the articulated body inertias are only computed once and the
+ * sweeps over the bodies are performed for all columns simultaneously.
+ * This is useful to compute e.g. \f$ H^{-1} G^T \f$ for constraint
+ * Jacobians G.
+ */
+RBDL_DLLAPI void CalcMInvTimesTau (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::MatrixNd &Tau,
+    Math::MatrixNd &QDDot,
+    bool update_kinematics=true
+    );
+
+/** \brief Computes the derivatives of the forward dynamics with respect
+ * to the inertial parameters
+ *
+ * Computes \f$ \partial \ddot{q} / \partial \pi \f$ where \f$\pi\f$ are
+ * the inertial parameters of all movable bodies as described in
+ * CalcInertialParameterRegressor(). Using the regressor \f$Y\f$ evaluated
+ * at the forward dynamics accelerations the derivatives are
+ *   \f$ \partial \ddot{q} / \partial \pi = -H^{-1} Y(q, \dot{q}, \ddot{q}) \f$
+ * which is evaluated with a single forward dynamics call, one regressor
+ * evaluation and one call of the matrix variant of CalcMInvTimesTau().
+ *
+ * The derivatives of InverseDynamics() with respect to the inertial
+ * parameters are the regressor itself as the generalized forces are linear
+ * in the parameters. Derivatives with respect to the mass, center of mass
+ * and inertia of a Body can be obtained with
+ * CalcBodyInertialParameterJacobian().
+ *
+ * \note As for CalcInertialParameterRegressor() the columns of virtual
+ * bodies are zero.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the internal joints
+ * \param QDot  velocity vector of the internal joints
+ * \param Tau   actuations of the internal joints
+ * \param QDDot_params derivatives of size qdot_size x (10 * (mBodies.size() - 1)) (output)
+ * \param QDDot accelerations of the internal joints (optional output, defaults to NULL)
+ * \param f_ext External forces acting on the body in base coordinates (optional, defaults to NULL)
+ */
+RBDL_DLLAPI void CalcForwardDynamicsParameterDerivatives (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    const Math::VectorNd &Tau,
+    Math::MatrixNd &QDDot_params,
+    Math::VectorNd *QDDot = NULL,
+    std::vector<Math::SpatialVector> *f_ext = NULL
+    );
+
+/** \brief Computes the derivatives of the inertial parameters of a body
+ * with respect to its mass, center of mass and inertia
+ *
+ * The 10 x 10 matrix J contains the derivatives of the parameters
+ * \f$(m, h_x, h_y, h_z, I_{xx}, I_{yx}, I_{yy}, I_{zx}, I_{zy}, I_{zz})\f$
+ * (see CalcInertialParameterRegressor()) with respect to
+ * \f$(m, c_x, c_y, c_z, I^C_{xx}, I^C_{yx}, I^C_{yy}, I^C_{zx}, I^C_{zy},
+ * I^C_{zz})\f$ where \f$c\f$ is Body::mCenterOfMass and \f$I^C\f$ is
+ * Body::mInertia expressed at the center of mass. Multiplying derivatives
+ * with respect to the inertial parameters of a body with J from the right
+ * yields the derivatives with respect to the body properties.
+ *
+ * \param body the body (for models with fixed bodies this is the merged
+ * body Model::mBodies[i])
+ * \param J 10 x 10 matrix (output)
+ */
+RBDL_DLLAPI void CalcBodyInertialParameterJacobian (
+    const Body &body,
+    Math::MatrixNd &J
+    );
+
+/** \brief Computes the inverse of the operational space inertia matrix for
+ * a set of operational frames without forming the joint space inertia
+ * matrix.
+ *
+ * \param model rigid body model
+ * \param Q     state vector of the generalized positions
+ * \param body_id the ids of the bodies the operational frames are attached to
+ * \param point_position the origins of the operational frames in the
+ *              coordinates of the respective bodies
+ * \param LambdaInv (output) the inverse operational space inertia matrix of
+ *              size 6k x 6k where k is the number of frames
+ * \param update_kinematics whether the kinematics and articulated body
+ *              inertias should be updated (safer, but at a higher
+ *              computational cost)
+ *
+ * This function computes
+ *
+ *   \f$ \Lambda^{-1} = J H^{-1} J^T \f$
+ *
+ * where \f$J\f$ is the stacked Jacobian of the frames as returned by
+ * CalcPointJacobian6D(), i.e. each frame is located at the given point and
+ * aligned with the base coordinate system. It uses the articulated body
+ * inertias of the Articulated %Body Algorithm and propagates the inverse
+ * inertias of the bodies outward using the force propagators of the
+ * joints which results in \f$O(n_{\textit{dof}} + k^2 d)\f$ time where
+ * \f$d\f$ is the depth of the tree. The operational space inertia matrix
+ * \f$\Lambda\f$ itself is then obtained by a single \f$6k \times 6k\f$
+ * inversion.
+ *
+ * \note When calling this function with update_kinematics set to false
+ * the articulated body inertias must have been computed for the same
+ * values of Q by a previous call to this function or CalcMInvTimesTau()
+ * and the transformations X_base must be up to date.
+ */
+RBDL_DLLAPI void CalcOperationalSpaceInverseInertia (
+    Model &model,
+    const Math::VectorNd &Q,
+    const std::vector<unsigned int> &body_id,
+    const std::vector<Math::Vector3d> &point_position,
+    Math::MatrixNd &LambdaInv,
+    bool update_kinematics=true
+    );
+
 /** @} */
 
 }
@@ -202,6 +202,122 @@ RBDL_DLLAPI void CalcBodySpatialJacobian (
     bool update_kinematics = true
     );
 
+/** \brief Computes the time derivative of the point jacobian
+ *
+ * Computes \f$\dot{G}(q, \dot{q})\f$ of the point jacobian \f$G(q)\f$
+ * computed by CalcPointJacobian(). The product \f$\dot{G}\dot{q}\f$ is
+ * the linear acceleration of the point for \f$\ddot{q} = 0\f$.
+ *
+ * The derivative is evaluated in a single pass over the joints that
+ * support the body using the body velocities and transformations that are
+ * stored in the model.
+ *
+ * \param model   rigid body model
+ * \param Q       state vector of the internal joints
+ * \param QDot    velocity vector of the internal joints
+ * \param body_id the id of the body
+ * \param point_position the position of the point in body-local data
+ * \param G       a matrix of dimensions 3 x \#qdot_size where the result will be stored in
+ * \param update_kinematics whether UpdateKinematics() should be called or not (default: true)
+ *
+ * \note This function only evaluates the entries of G that are non-zero.
+ * Before calling this function one has to ensure that all other values
+ * have been set to zero, e.g. by calling G.setZero().
+ *
+ * \note Custom joints with more than one degree of freedom are not
+ * supported as their motion subspace derivative is not available.
+ */
+RBDL_DLLAPI void CalcPointJacobianDot (Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    unsigned int body_id,
+    const Math::Vector3d &point_position,
+    Math::MatrixNd &G,
+    bool update_kinematics = true
+    );
+
+/** \brief Computes the time derivative of the point jacobian for multiple
+ * points
+ *
+ * Stacks the results of CalcPointJacobianDot() for the given points. The
+ * derivatives of the joint motion subspaces are evaluated only once for
+ * each joint that supports any of the points.
+ *
+ * \param model   rigid body model
+ * \param Q       state vector of the internal joints
+ * \param QDot    velocity vector of the internal joints
+ * \param body_id the ids of the bodies
+ * \param point_position the positions of the points in body-local data
+ * \param G       a matrix of dimensions (3 * \#points) x \#qdot_size where the result will be stored in
+ * \param update_kinematics whether UpdateKinematics() should be called or not (default: true)
+ *
+ * \note This function only evaluates the entries of G that are non-zero.
+ * Before calling this function one has to ensure that all other values
+ * have been set to zero, e.g. by calling G.setZero().
+ */
+RBDL_DLLAPI void CalcPointJacobianDot (Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    const std::vector<unsigned int> &body_id,
+    const std::vector<Math::Vector3d> &point_position,
+    Math::MatrixNd &G,
+    bool update_kinematics = true
+    );
+
+/** \brief Computes the time derivative of the 6-D point jacobian
+ *
+ * Computes \f$\dot{G}(q, \dot{q})\f$ of the 6-D jacobian computed by
+ * CalcPointJacobian6D(). The product \f$\dot{G}\dot{q}\f$ equals the
+ * result of CalcPointAcceleration6D() for \f$\ddot{q} = 0\f$.
+ *
+ * \param model   rigid body model
+ * \param Q       state vector of the internal joints
+ * \param QDot    velocity vector of the internal joints
+ * \param body_id the id of the body
+ * \param point_position the position of the point in body-local data
+ * \param G       a matrix of dimensions 6 x \#qdot_size where the result will be stored in
+ * \param update_kinematics whether UpdateKinematics() should be called or not (default: true)
+ *
+ * \note This function only evaluates the entries of G that are non-zero.
+ * Before calling this function one has to ensure that all other values
+ * have been set to zero, e.g. by calling G.setZero().
+ */
+RBDL_DLLAPI void CalcPointJacobian6DDot (Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    unsigned int body_id,
+    const Math::Vector3d &point_position,
+    Math::MatrixNd &G,
+    bool update_kinematics = true
+    );
+
+/** \brief Computes the time derivative of the spatial jacobian for a body
+ *
+ * Computes \f$\dot{G}(q, \dot{q})\f$ of the spatial body jacobian
+ * computed by CalcBodySpatialJacobian(). The product \f$\dot{G}\dot{q}\f$
+ * is the spatial acceleration of the body (in body coordinates) for
+ * \f$\ddot{q} = 0\f$.
+ *
+ * \param model   rigid body model
+ * \param Q       state vector of the internal joints
+ * \param QDot    velocity vector of the internal joints
+ * \param body_id the id of the body
+ * \param G       a matrix of size 6 x \#qdot_size where the result will be stored in
+ * \param update_kinematics whether UpdateKinematics() should be called or not (default: true)
+ *
+ * \note This function only evaluates the entries of G that are non-zero.
+ * Before calling this function one has to ensure that all other values
+ * have been set to zero, e.g. by calling G.setZero().
+ */
+RBDL_DLLAPI void CalcBodySpatialJacobianDot (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    unsigned int body_id,
+    Math::MatrixNd &G,
+    bool update_kinematics = true
+    );
+
 /** \brief Computes the velocity of a point on a body 
  *
  * \param model   rigid body model
@@ -311,6 +427,159 @@ RBDL_DLLAPI
       bool update_kinematics = true
       );
 
+/// \brief Memory layouts of the poses written by CalcBodyPoses().
+enum PoseLayout {
+  /** 7 values per body: the position x, y, z followed by the orientation
+   * as quaternion x, y, z, w (as Math::Quaternion) */
+  PoseLayoutPositionQuaternion = 0,
+  /** 12 values per body: the 3 x 4 matrix [R | p] in row-major order
+   * where R rotates body coordinates into base coordinates and p is the
+   * origin of the body */
+  PoseLayoutMatrix3x4
+};
+
+/** \brief Returns the number of values that CalcBodyPoses() writes for a
+ * single configuration.
+ *
+ * \param model rigid body model
+ * \param layout the layout of the poses
+ * \param fixed_bodies whether the poses of the fixed bodies are included
+ *        (default: true)
+ */
+RBDL_DLLAPI
+  unsigned int GetBodyPosesSize (
+      const Model &model,
+      PoseLayout layout,
+      bool fixed_bodies = true
+      );
+
+/** \brief Writes the poses of all bodies in base coordinates into a
+ * buffer
+ *
+ * The poses are written in the order of the body ids, i.e. the pose of
+ * movable body i (including virtual bodies) starts at (i - 1) * 7 (or 12)
+ * and the poses of the fixed bodies follow in the order of
+ * Model::mFixedBodies. Only the transformations of the joints are
+ * evaluated (no velocities or dynamics).
+ *
+ * \param model  rigid body model
+ * \param Q      state vector of the internal joints
+ * \param layout the layout of the poses
+ * \param buffer (output) memory for at least GetBodyPosesSize() values
+ * \param fixed_bodies whether the poses of the fixed bodies are written
+ *        (default: true)
+ * \param update_kinematics whether the transformations of the bodies
+ *        should be computed from Q or taken from Model::X_base (default: true)
+ */
+RBDL_DLLAPI
+  void CalcBodyPoses (
+      Model &model,
+      const Math::VectorNd &Q,
+      PoseLayout layout,
+      double *buffer,
+      bool fixed_bodies = true,
+      bool update_kinematics = true
+      );
+
+/** \brief Writes the poses of all bodies for many configurations into a
+ * buffer
+ *
+ * The poses of configuration k start at k * GetBodyPosesSize() and are
+ * laid out as in CalcBodyPoses().
+ *
+ * \param model  rigid body model
+ * \param Qs     the configurations (one configuration per column)
+ * \param layout the layout of the poses
+ * \param buffer (output) memory for at least Qs.cols() *
+ *        GetBodyPosesSize() values
+ * \param fixed_bodies whether the poses of the fixed bodies are written
+ *        (default: true)
+ */
+RBDL_DLLAPI
+  void CalcBodyPosesBatch (
+      Model &model,
+      const Math::MatrixNd &Qs,
+      PoseLayout layout,
+      double *buffer,
+      bool fixed_bodies = true
+      );
+
+/** \brief The kinematics of all operational frames of a model in
+ * contiguous arrays.
+ *
+ * Column (or block) k of each array belongs to the operational frame with
+ * id k (see Model::AddOperationalFrame()). The velocities, accelerations
+ * and Jacobians use the same representation as CalcPointVelocity6D(),
+ * CalcPointAcceleration6D() and CalcPointJacobian6D(), i.e. the angular
+ * and linear quantities of the frame origin in base coordinates.
+ */
+struct RBDL_DLLAPI OperationalFrameKinematics {
+  OperationalFrameKinematics() :
+    bound (false)
+  {}
+
+  /** \brief Allocates the arrays for the operational frames of a model.
+   *
+   * Has to be called again after frames were added to the model.
+   */
+  void Bind (const Model &model);
+
+  /// Whether Bind() was called.
+  bool bound;
+
+  /// The origins of the frames in base coordinates (3 x number of frames).
+  Math::MatrixNd positions;
+  /** The orientations of the frames (3 x 3 * number of frames), where
+   * block k transforms base coordinates to coordinates of frame k (as
+   * CalcBodyWorldOrientation()). */
+  Math::MatrixNd orientations;
+  /// The angular and linear velocities of the frames (6 x number of frames).
+  Math::MatrixNd velocities;
+  /// The angular and linear accelerations of the frames (6 x number of frames).
+  Math::MatrixNd accelerations;
+  /** The 6-D Jacobians of the frames (6 * number of frames x qdot_size),
+   * where rows 6k to 6k + 5 belong to frame k. */
+  Math::MatrixNd jacobians;
+
+  /// Workspace: the motion subspaces of all joints in base coordinates.
+  Math::MatrixNd mMotionSubspaces;
+};
+
+/** \brief Computes the poses, velocities, accelerations and Jacobians of
+ * all operational frames in a single pass
+ *
+ * The kinematics of the model are updated once and the motion subspaces
+ * of the joints are transformed to base coordinates once and shared by
+ * the Jacobians of all frames. This is considerably faster than querying
+ * each frame with CalcBodyToBaseCoordinates(), CalcPointVelocity6D(),
+ * etc.
+ *
+ * \param model   rigid body model
+ * \param Q       state vector of the internal joints
+ * \param QDot    velocity vector of the internal joints (if NULL the
+ *                velocities and accelerations are not computed)
+ * \param QDDot   acceleration vector of the internal joints (if NULL the
+ *                accelerations are not computed)
+ * \param kinematics (output) the kinematics of the frames (has to be
+ *                bound to the model with OperationalFrameKinematics::Bind())
+ * \param compute_jacobians whether the Jacobians should be computed
+ *                (default: true)
+ * \param update_kinematics whether UpdateKinematicsCustom() should be called or not (default: true)
+ *
+ * \note As for CalcPointAcceleration6D() the accelerations do not contain
+ * the gravity acceleration.
+ */
+RBDL_DLLAPI
+  void CalcOperationalFrameKinematics (
+      Model &model,
+      const Math::VectorNd &Q,
+      const Math::VectorNd *QDot,
+      const Math::VectorNd *QDDot,
+      OperationalFrameKinematics &kinematics,
+      bool compute_jacobians = true,
+      bool update_kinematics = true
+      );
+
 /** \brief Computes the inverse kinematics iteratively using a damped Levenberg-Marquardt method (also known as Damped Least Squares method)
  *
  * \param model rigid body model
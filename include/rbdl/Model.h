@@ -101,6 +101,31 @@ namespace RigidBodyDynamics {
  * RigidBodyDynamics::Addons::URDFReadFromFile \endlink.
  */
 
+/** \brief A named frame that is rigidly attached to a (movable or fixed)
+ * body, e.g. the frame of a sensor or of an end-effector.
+ *
+ * Operational frames do not alter the dynamics of the model and are added
+ * with Model::AddOperationalFrame(). The kinematics of all frames can be
+ * computed at once with CalcOperationalFrameKinematics().
+ */
+struct RBDL_DLLAPI OperationalFrame {
+  OperationalFrame() :
+    body_id (0),
+    movable_body_id (0)
+  {}
+
+  /// The name of the frame.
+  std::string name;
+  /// The (movable or fixed) body that was passed to Model::AddOperationalFrame().
+  unsigned int body_id;
+  /// The transformation from the frame of body_id to the operational frame.
+  Math::SpatialTransform body_transform;
+  /// The movable body that the frame is attached to.
+  unsigned int movable_body_id;
+  /// The transformation from the frame of movable_body_id to the operational frame.
+  Math::SpatialTransform movable_transform;
+};
+
 /** \brief Contains all information about the rigid body model
  *
  * This class contains all information required to perform the forward
@@ -158,6 +183,12 @@ struct RBDL_DLLAPI Model {
   /// \brief Id of the previously added body, required for Model::AppendBody()
   unsigned int previously_added_body_id;
 
+  /** \brief Whether Model::AddBody() postpones the update of q_size,
+   * the joint update order and the workspaces d and u (used by
+   * ModelBuilder)
+   */
+  bool defer_index_update;
+
   /// \brief the cartesian vector of the gravity
   Math::Vector3d gravity;
 
@@ -215,11 +246,39 @@ struct RBDL_DLLAPI Model {
   Math::VectorNd d;
   /// \brief Temporary variable u (RBDA p. 130)
   Math::VectorNd u;
+  /// \brief Columns of the motion subspace of the multi dof joints with
+  /// known accelerations (used only by HybridDynamics())
+  std::vector<Math::MatrixNd> hybrid_S_known;
+  /// \brief Columns of the motion subspace of the multi dof joints with
+  /// known forces (used only by HybridDynamics())
+  std::vector<Math::MatrixNd> hybrid_S_free;
+  /// \brief Temporary variable U_i of the joints with known forces (used
+  /// only by HybridDynamics())
+  std::vector<Math::MatrixNd> hybrid_U_free;
+  /// \brief Temporary variable D_i^-1 of the joints with known forces (used
+  /// only by HybridDynamics())
+  std::vector<Math::MatrixNd> hybrid_Dinv_free;
+  /// \brief Temporary variable u_i of the joints with known forces (used
+  /// only by HybridDynamics())
+  std::vector<Math::VectorNd> hybrid_u_free;
+  /// \brief External forces of the penalty contacts (used only by
+  /// ForwardDynamicsContactsPenalty())
+  std::vector<Math::SpatialVector> f_penalty;
+  /// \brief Motion subspaces of the joints in base coordinates (used only
+  /// by CalcPointJacobianDot() and CalcPointJacobian6DDot())
+  Math::MatrixNd S_base;
+  /// \brief Time derivatives of Model::S_base
+  Math::MatrixNd S_base_dot;
+  /// \brief Marks the bodies whose columns of Model::S_base are up to date
+  std::vector<bool> S_base_valid;
   /// \brief Internal forces on the body (used only InverseDynamics())
   std::vector<Math::SpatialVector> f;
   /// \brief The spatial inertia of body i (used only in 
   ///  CompositeRigidBodyAlgorithm())
   std::vector<Math::SpatialRigidBodyInertia> I;
+  /// \brief The spatial inertia of body i without the inertias of the
+  /// fixed bodies that were merged into I
+  std::vector<Math::SpatialRigidBodyInertia> I_body;
   std::vector<Math::SpatialRigidBodyInertia> Ic;
   std::vector<Math::SpatialVector> hc;
   std::vector<Math::SpatialVector> hdotc;
@@ -235,6 +294,15 @@ struct RBDL_DLLAPI Model {
   std::vector<Math::SpatialTransform> X_lambda;
   /// \brief Transformation from the base to bodies reference frame
   std::vector<Math::SpatialTransform> X_base;
+  /// \brief Id of the fixed body that body i was added to or 0 if it was
+  /// added to a movable body
+  std::vector<unsigned int> mFixedParent;
+  /** \brief Joint frame of body i relative to the fixed body
+   * Model::mFixedParent[i] such that X_T[i] is X_T_fixed[i] composed with
+   * the parent transform of the fixed body (only used if
+   * Model::mFixedParent[i] != 0).
+   */
+  std::vector<Math::SpatialTransform> X_T_fixed;
 
   /// \brief All bodies that are attached to a body via a fixed joint.
   std::vector<FixedBody> mFixedBodies;
@@ -264,6 +332,12 @@ struct RBDL_DLLAPI Model {
   /// \brief Human readable names for the bodies
   std::map<std::string, unsigned int> mBodyNameMap;
 
+  /// \brief Operational frames that are attached to the bodies
+  std::vector<OperationalFrame> mOperationalFrames;
+
+  /// \brief Names of the operational frames
+  std::map<std::string, unsigned int> mOperationalFrameNameMap;
+
   /** \brief Connects a given body to the model
    *
    * When adding a body there are basically informations required:
@@ -350,6 +424,35 @@ struct RBDL_DLLAPI Model {
     return mBodyNameMap.find(body_name)->second;
   }
 
+  /** \brief Attaches a named operational frame to a body
+   *
+   * \param body_id the id of a movable or fixed body (or 0 for the base)
+   * \param frame the transformation from the body frame to the
+   *              operational frame
+   * \param frame_name the unique name of the frame
+   *
+   * \returns the id of the frame, i.e. its index in
+   * Model::mOperationalFrames
+   */
+  unsigned int AddOperationalFrame (
+      unsigned int body_id,
+      const Math::SpatialTransform &frame,
+      const std::string &frame_name
+      );
+
+  /** \brief Returns the id of an operational frame
+   *
+   * \returns the id of the frame or \c std::numeric_limits\<unsigned
+   *          int\>::max() if the frame was not found.
+   */
+  unsigned int GetOperationalFrameId (const char *frame_name) const {
+    if (mOperationalFrameNameMap.count(frame_name) == 0) {
+      return std::numeric_limits<unsigned int>::max();
+    }
+
+    return mOperationalFrameNameMap.find(frame_name)->second;
+  }
+
   /** \brief Returns the name of a body for a given body id */
   std::string GetBodyName (unsigned int body_id) const {
     std::map<std::string, unsigned int>::const_iterator iter 
@@ -376,6 +479,16 @@ struct RBDL_DLLAPI Model {
     return false;
   }
 
+  /** \brief Returns the id of the movable body that a (movable or fixed)
+   * body is attached to.
+   */
+  unsigned int GetMovableBodyId (unsigned int id) {
+    if (IsFixedBodyId (id)) {
+      return mFixedBodies[id - fixed_body_discriminator].mMovableParent;
+    }
+    return id;
+  }
+
   bool IsBodyId (unsigned int id) {
     if (id > 0 && id < mBodies.size())
       return true;
@@ -430,27 +543,36 @@ struct RBDL_DLLAPI Model {
 
   /** Sets the joint frame transformtion, i.e. the second argument to 
   Model::AddBody().
+
+  For fixed bodies the transformation is relative to the movable parent
+  (as returned by GetJointFrame()). The inertia of the movable parent is
+  recomputed and all bodies and operational frames that were attached to
+  the fixed body move along with it.
     */
   void SetJointFrame (unsigned int id, 
-      const Math::SpatialTransform &transform) {
-    if (id >= fixed_body_discriminator) {
-      std::cerr << "Error: setting of parent transform "
-        << "not supported for fixed bodies!" << std::endl;
-      abort();
-    }
+      const Math::SpatialTransform &transform);
 
-    unsigned int child_id = id;
-    unsigned int parent_id = lambda[id];
-    if (mBodies[parent_id].mIsVirtual) {
-      while (mBodies[parent_id].mIsVirtual) {
-        child_id = parent_id;
-        parent_id = lambda[child_id];
-      }
-      X_T[child_id] = transform;
-    } else if (id > 0) {
-      X_T[id] = transform;
-    }
-  }
+  /** \brief Sets the mass, center of mass and inertia of a body.
+   *
+   * This updates the body in place such that the model does not have to
+   * be rebuilt, e.g. in parameter sweeps or during online identification.
+   * The parameters are interpreted as those of the Body that was passed to
+   * AddBody() and fixed bodies that were merged into a movable body are
+   * taken into account, i.e. Model::mBodies and Model::I contain the
+   * merged properties afterwards.
+   *
+   * \param id     the id of a movable or a fixed body
+   * \param mass   the mass of the body
+   * \param com    the center of mass in body coordinates
+   * \param inertia_C the inertia at the center of mass
+   *
+   * \note The gravity has no derived quantities and can be changed by
+   * assigning Model::gravity directly.
+   */
+  void SetBodyInertialProperties (unsigned int id,
+      double mass,
+      const Math::Vector3d &com,
+      const Math::Matrix3d &inertia_C);
 
   /** Gets the quaternion for body i (only valid if body i is connected by
    * a JointTypeSpherical joint)
@@ -485,6 +607,181 @@ struct RBDL_DLLAPI Model {
   }
 };
 
+/** \brief Constructs large models in linear time.
+ *
+ * After each call Model::AddBody() updates the quantities that depend on
+ * all joints (e.g. Model::q_size, Model::mJointUpdateOrder and the
+ * workspaces Model::d and Model::u) which results in quadratic
+ * construction time for models with many bodies. The ModelBuilder adds
+ * the bodies to a model without these updates, optionally reserves the
+ * memory for all bodies in advance and finalizes the model once all
+ * bodies were added:
+ *
+ * \code
+ * Model model;
+ * ModelBuilder builder (model, 10000);
+ *
+ * for (unsigned int i = 0; i < 10000; i++) {
+ *   builder.AppendBody (Xtrans (Vector3d (0., -0.1, 0.)), joint, body);
+ * }
+ *
+ * builder.Finalize();
+ * \endcode
+ *
+ * \note The model must not be used before ModelBuilder::Finalize() was
+ * called. The destructor of the ModelBuilder finalizes the model if this
+ * has not been done before.
+ */
+struct RBDL_DLLAPI ModelBuilder {
+  /** \brief Starts the construction of the given model.
+   *
+   * \param model the model to which the bodies are added
+   * \param body_count expected number of movable bodies that will be added
+   * (optional, used to reserve memory)
+   */
+  ModelBuilder (Model &model, unsigned int body_count = 0);
+  ~ModelBuilder ();
+
+  /// \brief Reserves the memory of the per body quantities for the given number of movable bodies.
+  void Reserve (unsigned int body_count);
+
+  /// \brief Same as Model::AddBody()
+  unsigned int AddBody (
+      const unsigned int parent_id,
+      const Math::SpatialTransform &joint_frame,
+      const Joint &joint,
+      const Body &body,
+      std::string body_name = ""
+      );
+
+  /// \brief Same as Model::AppendBody()
+  unsigned int AppendBody (
+      const Math::SpatialTransform &joint_frame,
+      const Joint &joint,
+      const Body &body,
+      std::string body_name = ""
+      );
+
+  /// \brief Same as Model::AddBodyCustomJoint()
+  unsigned int AddBodyCustomJoint (
+      const unsigned int parent_id,
+      const Math::SpatialTransform &joint_frame,
+      CustomJoint *custom_joint,
+      const Body &body,
+      std::string body_name = ""
+      );
+
+  /** \brief Validates the structure of the model and updates all
+   * quantities that depend on all joints in a single pass.
+   */
+  void Finalize ();
+
+  Model &model;
+  bool finalized;
+};
+
+/** \brief A model in which some degrees of freedom of another model are
+ * locked.
+ *
+ * The joints whose degrees of freedom are locked are replaced by fixed
+ * joints at the configuration of the locking such that their bodies are
+ * merged into their movable parents with Body::Join(). The remaining
+ * joints keep their order and all bodies, fixed bodies and operational
+ * frames keep their names. This allows to run the dynamics of e.g. a
+ * manipulator with only few active joints on a model whose size is the
+ * number of active degrees of freedom:
+ *
+ * \code
+ * ReducedModel reduced;
+ * CreateReducedModel (model, Q, locked_dofs, reduced);
+ *
+ * reduced.ReduceQ (Q, Q_reduced);
+ * reduced.ReduceQDot (QDot, QDot_reduced);
+ * reduced.ReduceQDot (Tau, Tau_reduced);
+ * ForwardDynamics (reduced.model, Q_reduced, QDot_reduced, Tau_reduced,
+ *     QDDot_reduced);
+ * reduced.ExpandQDot (QDDot_reduced, QDDot);
+ * \endcode
+ *
+ * \note The fixed bodies of the original model are added to the reduced
+ * model as massless bodies as their inertias are already contained in the
+ * bodies of their movable parents. Custom joints are shared with the
+ * original model.
+ */
+struct RBDL_DLLAPI ReducedModel {
+  /** \brief Copies the entries of the unlocked degrees of freedom of
+   * a generalized position of the original model.
+   */
+  void ReduceQ (const Math::VectorNd &Q, Math::VectorNd &Q_reduced) const;
+
+  /** \brief Copies the entries of the unlocked degrees of freedom of
+   * a generalized velocity, acceleration or force of the original model.
+   */
+  void ReduceQDot (const Math::VectorNd &QDot,
+      Math::VectorNd &QDot_reduced) const;
+
+  /** \brief Computes the generalized position of the original model in
+   * which the locked degrees of freedom are at the configuration of the
+   * locking.
+   */
+  void ExpandQ (const Math::VectorNd &Q_reduced, Math::VectorNd &Q) const;
+
+  /** \brief Computes the generalized velocity, acceleration or force of
+   * the original model whose entries of locked degrees of freedom are
+   * zero.
+   */
+  void ExpandQDot (const Math::VectorNd &QDot_reduced,
+      Math::VectorNd &QDot) const;
+
+  /** \brief Returns the id of a (movable or fixed) body of the original
+   * model in the reduced model.
+   */
+  unsigned int GetReducedBodyId (unsigned int id) const {
+    if (id >= fixed_body_discriminator) {
+      return fixed_body_map[id - fixed_body_discriminator];
+    }
+    return body_map[id];
+  }
+
+  /// \brief The reduced model.
+  Model model;
+  /// \brief The generalized positions of the original model at which the
+  /// degrees of freedom are locked.
+  Math::VectorNd q_locked;
+  /// \brief Index in the original q of each entry of the reduced q.
+  std::vector<unsigned int> q_map;
+  /// \brief Index in the original qdot of each entry of the reduced qdot.
+  std::vector<unsigned int> qdot_map;
+  /// \brief Reduced body id of each movable body of the original model.
+  std::vector<unsigned int> body_map;
+  /// \brief Reduced body id of each fixed body of the original model.
+  std::vector<unsigned int> fixed_body_map;
+  /// \brief Model::fixed_body_discriminator of the original model.
+  unsigned int fixed_body_discriminator;
+};
+
+/** \brief Creates a model in which some degrees of freedom are locked.
+ *
+ * The reduced model is built with a ModelBuilder from the joints, joint
+ * frames and bodies of the original model. A joint is locked if all of
+ * its degrees of freedom are locked, a joint with 3 degrees of freedom
+ * (e.g. spherical joints) cannot be locked partially. Joints with multiple
+ * axes (JointType1DoF ... JointType6DoF) consist of a chain of single
+ * degree of freedom joints and can therefore be locked per axis.
+ *
+ * \param model the original model
+ * \param Q the generalized positions at which the joints are locked
+ * \param locked_dofs whether a degree of freedom is locked (size
+ * model.qdot_size)
+ * \param reduced (output) the reduced model and the index maps
+ */
+RBDL_DLLAPI void CreateReducedModel (
+    Model &model,
+    const Math::VectorNd &Q,
+    const std::vector<bool> &locked_dofs,
+    ReducedModel &reduced
+    );
+
 /** @} */
 }
 
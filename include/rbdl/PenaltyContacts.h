@@ -0,0 +1,205 @@
+/*
+ * RBDL - Rigid Body Dynamics Library
+ * Copyright (c) 2011-2018 Martin Felis <martin@fysx.org>
+ *
+ * Licensed under the zlib license. See LICENSE for more details.
+ */
+
+#ifndef RBDL_PENALTY_CONTACTS_H
+#define RBDL_PENALTY_CONTACTS_H
+
+#include <rbdl/rbdl_math.h>
+#include <rbdl/rbdl_mathutils.h>
+
+namespace RigidBodyDynamics {
+
+struct Model;
+struct ConstraintSet;
+
+/** \page penalty_contacts_page Penalty Contacts
+ *
+ * All functions related to compliant contacts are specified in the \ref
+ * penalty_contacts_group "Penalty Contacts Module".
+ *
+ * \defgroup penalty_contacts_group Penalty Contacts
+ *
+ * Instead of enforcing contacts as rigid constraints (see \ref
+ * constraints_group) contacts can be modelled as stiff nonlinear
+ * spring-dampers. The contact points are taken from the contact
+ * constraints of a ConstraintSet and the resulting forces are passed as
+ * external forces to ForwardDynamics(). This only requires the
+ * evaluation of the contact point kinematics and a single run of the
+ * Articulated Body Algorithm, i.e. no constraint Jacobian has to be
+ * formed or factorized.
+ *
+ * The normal force is computed with the Hunt-Crossley model
+ *   \f[
+ *     f_n = \max(0, k \delta^n (1 + c \dot{\delta}))
+ *   \f]
+ * where \f$\delta\f$ is the penetration depth, \f$\dot{\delta}\f$ the
+ * penetration velocity, \f$k\f$ the stiffness, \f$n\f$ the exponent and
+ * \f$c\f$ the dissipation coefficient. The friction force opposes the
+ * tangential velocity \f$v_t\f$ of the contact point and uses a
+ * regularized Coulomb model
+ *   \f[
+ *     f_t = -\mu f_n \frac{v_t}{\sqrt{|v_t|^2 + v_s^2}}
+ *   \f]
+ * with friction coefficient \f$\mu\f$ and transition velocity \f$v_s\f$.
+ *
+ * The geometry of the environment is described by a ContactSurface, e.g.
+ * a ContactPlane.
+ *
+ * @{
+ */
+
+/** \brief Interface of surfaces that contact points can penetrate. */
+struct RBDL_DLLAPI ContactSurface {
+  virtual ~ContactSurface() {};
+
+  /** \brief Computes the penetration of a point into the surface.
+   *
+   * \param point the point in base coordinates
+   * \param depth (output) penetration depth (only valid if the point
+   * penetrates the surface)
+   * \param normal (output) unit normal of the surface at the contact that
+   * points away from the surface (only valid if the point penetrates the
+   * surface)
+   *
+   * \returns true if the point penetrates the surface
+   */
+  virtual bool CalcPenetration (
+      const Math::Vector3d &point,
+      double &depth,
+      Math::Vector3d &normal) const = 0;
+};
+
+/** \brief An infinite plane, e.g. the ground. */
+struct RBDL_DLLAPI ContactPlane : public ContactSurface {
+  /** \brief Creates the plane z = 0. */
+  ContactPlane() :
+    origin (0., 0., 0.),
+    normal (0., 0., 1.)
+  {}
+  /** \brief Creates a plane through origin with the given normal. */
+  ContactPlane (const Math::Vector3d &origin, const Math::Vector3d &normal) :
+    origin (origin),
+    normal (normal.normalized())
+  {}
+
+  virtual bool CalcPenetration (
+      const Math::Vector3d &point,
+      double &depth,
+      Math::Vector3d &normal) const;
+
+  /// A point on the plane.
+  Math::Vector3d origin;
+  /// The unit normal of the plane that points away from the plane.
+  Math::Vector3d normal;
+};
+
+/** \brief Parameters of the Hunt-Crossley contact model. */
+struct RBDL_DLLAPI HuntCrossleyParameters {
+  HuntCrossleyParameters() :
+    stiffness (1.0e5),
+    exponent (1.5),
+    dissipation (1.),
+    friction_coefficient (0.8),
+    transition_velocity (1.0e-2)
+  {}
+  HuntCrossleyParameters (
+      double stiffness,
+      double exponent,
+      double dissipation,
+      double friction_coefficient,
+      double transition_velocity) :
+    stiffness (stiffness),
+    exponent (exponent),
+    dissipation (dissipation),
+    friction_coefficient (friction_coefficient),
+    transition_velocity (transition_velocity)
+  {}
+
+  /// Stiffness \f$k\f$ of the contact.
+  double stiffness;
+  /// Exponent \f$n\f$ of the penetration depth (1.5 for Hertzian contact).
+  double exponent;
+  /// Dissipation coefficient \f$c\f$ (in s/m).
+  double dissipation;
+  /// Friction coefficient \f$\mu\f$.
+  double friction_coefficient;
+  /// Tangential velocity \f$v_s\f$ below which friction is regularized.
+  double transition_velocity;
+};
+
+/** \brief Computes the external forces of penalty contacts at the contact
+ * points of a ConstraintSet.
+ *
+ * Each distinct pair of body and body point of the contact constraints
+ * in CS results in a single contact force, i.e. the constraint normals
+ * are not used. Other constraint types are ignored. CS has to be bound as
+ * ConstraintSet::Bind() groups the contact constraints by body point.
+ *
+ * \param model the model
+ * \param Q     the generalized positions
+ * \param QDot  the generalized velocities
+ * \param CS    the constraint set whose contact points are used
+ * \param surface the surface the contact points may penetrate
+ * \param parameters the parameters of the contact model
+ * \param f_ext (output) external forces in base coordinates of size
+ * Model::mBodies.size() that can be passed to ForwardDynamics(). Values
+ * of bodies without contacts are set to zero.
+ * \param update_kinematics whether the kinematics of the model should be
+ * updated from Q and QDot (defaults to true)
+ *
+ * \returns the number of penetrating contact points
+ */
+RBDL_DLLAPI
+unsigned int CalcContactPenaltyForces (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    const ConstraintSet &CS,
+    const ContactSurface &surface,
+    const HuntCrossleyParameters &parameters,
+    std::vector<Math::SpatialVector> &f_ext,
+    bool update_kinematics = true
+    );
+
+/** \brief Computes forward dynamics with penalty contacts.
+ *
+ * Evaluates CalcContactPenaltyForces(), adds the external forces f_ext
+ * and passes the sum to ForwardDynamics().
+ *
+ * \param model the model
+ * \param Q     the generalized positions
+ * \param QDot  the generalized velocities
+ * \param Tau   the generalized forces
+ * \param CS    the constraint set whose contact points are used
+ * \param surface the surface the contact points may penetrate
+ * \param parameters the parameters of the contact model
+ * \param QDDot (output) the generalized accelerations
+ * \param f_ext External forces acting on the body in base coordinates
+ * in addition to the contact forces (optional, defaults to NULL)
+ * \param f_contact (optional output) the contact forces as external
+ * forces in base coordinates (defaults to NULL)
+ */
+RBDL_DLLAPI
+void ForwardDynamicsContactsPenalty (
+    Model &model,
+    const Math::VectorNd &Q,
+    const Math::VectorNd &QDot,
+    const Math::VectorNd &Tau,
+    const ConstraintSet &CS,
+    const ContactSurface &surface,
+    const HuntCrossleyParameters &parameters,
+    Math::VectorNd &QDDot,
+    std::vector<Math::SpatialVector> *f_ext = NULL,
+    std::vector<Math::SpatialVector> *f_contact = NULL
+    );
+
+/** @} */
+
+} /* namespace RigidBodyDynamics */
+
+/* RBDL_PENALTY_CONTACTS_H */
+#endif
@@ -1539,6 +1539,11 @@ public:
     {
         compute();
     }
+    LLT& compute(const Derived &matrix) {
+      mL = matrix;
+      compute();
+      return *this;
+    }
     LLT compute() {
       for (unsigned int i = 0; i < mL.rows(); i++) {
         for (unsigned int j = 0; j < mL.rows(); j++) {
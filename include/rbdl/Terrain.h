@@ -0,0 +1,201 @@
+/*
+ * RBDL - Rigid Body Dynamics Library
+ * Copyright (c) 2011-2018 Martin Felis <martin@fysx.org>
+ *
+ * Licensed under the zlib license. See LICENSE for more details.
+ */
+
+#ifndef RBDL_TERRAIN_H
+#define RBDL_TERRAIN_H
+
+#include <vector>
+
+#include <rbdl/rbdl_math.h>
+#include <rbdl/rbdl_mathutils.h>
+#include <rbdl/PenaltyContacts.h>
+
+namespace RigidBodyDynamics {
+
+struct Model;
+struct ConstraintSet;
+
+/** \page terrain_page Terrain
+ *
+ * All functions related to uneven terrain are specified in the \ref
+ * terrain_group "Terrain Module".
+ *
+ * \defgroup terrain_group Terrain
+ *
+ * Uneven terrain is described by a Heightfield, i.e. a regular grid of
+ * heights along the z-axis of the base frame. To quickly reject points
+ * that are far above the terrain the heightfield keeps a hierarchy of the
+ * minimum and maximum heights of its cells (similar to mip-maps of
+ * textures) such that bounds of the terrain height over a rectangular
+ * region can be obtained by inspecting at most four cells.
+ *
+ * CalcTerrainContacts() uses these bounds to find the penetrating points
+ * of a batch of candidate body points by recursively splitting the batch
+ * and the result can be turned into contact constraints with
+ * AddTerrainContactConstraints(). As the Heightfield is a ContactSurface
+ * it can also be used with the \ref penalty_contacts_group
+ * "Penalty Contacts Module".
+ *
+ * @{
+ */
+
+/** \brief Terrain that is described by heights on a regular grid.
+ *
+ * The heights are given at the grid points \f$(x_0 + i \Delta x, y_0 + j
+ * \Delta y)\f$ and bilinearly interpolated in between. Outside of the grid
+ * the heights of the border are extended.
+ */
+struct RBDL_DLLAPI Heightfield : public ContactSurface {
+  /** \brief Creates a flat heightfield of a single cell at z = 0. */
+  Heightfield();
+
+  /** \brief Creates a heightfield.
+   *
+   * \param origin the position of grid point (0, 0) (only the x and y
+   * coordinates are used)
+   * \param cell_size_x the distance of the grid points along the x-axis
+   * \param cell_size_y the distance of the grid points along the y-axis
+   * \param heights matrix of size (number of grid points along x) x
+   * (number of grid points along y) that contains at least 2 x 2 heights
+   */
+  Heightfield (
+      const Math::Vector3d &origin,
+      double cell_size_x,
+      double cell_size_y,
+      const Math::MatrixNd &heights);
+
+  /** \brief Replaces the heights and updates the height bounds. */
+  void SetHeights (const Math::MatrixNd &heights);
+
+  /** \brief Computes the (interpolated) height at a position.
+   *
+   * \param x the x-coordinate in base coordinates
+   * \param y the y-coordinate in base coordinates
+   * \param normal (optional output) the unit normal of the terrain at the
+   * position (defaults to NULL)
+   */
+  double CalcHeight (double x, double y, Math::Vector3d *normal = NULL) const;
+
+  /** \brief Computes bounds of the terrain height over a rectangular region.
+   *
+   * The bounds are conservative, i.e. they may be lower (min_height) or
+   * higher (max_height) than the actual extremal heights in the region.
+   */
+  void CalcHeightBounds (
+      double x_min, double y_min,
+      double x_max, double y_max,
+      double &min_height,
+      double &max_height) const;
+
+  /** \brief Computes the penetration of a point into the terrain.
+   *
+   * The depth is the distance to the tangent plane of the terrain below
+   * (or above) the point.
+   */
+  virtual bool CalcPenetration (
+      const Math::Vector3d &point,
+      double &depth,
+      Math::Vector3d &normal) const;
+
+  /// The position of the grid point (0, 0).
+  Math::Vector3d origin;
+  /// The distance of grid points along the x-axis.
+  double cell_size_x;
+  /// The distance of grid points along the y-axis.
+  double cell_size_y;
+  /// The heights at the grid points.
+  Math::MatrixNd heights;
+
+  /** \brief Minimum heights of the cells at all levels.
+   *
+   * Level 0 contains one entry per grid cell, each following level
+   * combines 2 x 2 cells of the previous level.
+   */
+  std::vector<Math::MatrixNd> mMinHeights;
+  /// Maximum heights of the cells at all levels (see mMinHeights).
+  std::vector<Math::MatrixNd> mMaxHeights;
+};
+
+/** \brief A point that penetrates the terrain. */
+struct RBDL_DLLAPI TerrainContact {
+  TerrainContact() :
+    body_id (0),
+    body_point (Math::Vector3d::Zero()),
+    point (Math::Vector3d::Zero()),
+    depth (0.),
+    normal (Math::Vector3d::Zero()),
+    frame (Math::Matrix3d::Identity())
+  {}
+
+  /// The body of the contact point.
+  unsigned int body_id;
+  /// The contact point in body coordinates.
+  Math::Vector3d body_point;
+  /// The contact point in base coordinates.
+  Math::Vector3d point;
+  /// The penetration depth.
+  double depth;
+  /// The unit normal of the terrain at the contact.
+  Math::Vector3d normal;
+  /** The contact frame in base coordinates whose columns are the two
+   * tangents and the normal of the contact. */
+  Math::Matrix3d frame;
+};
+
+/** \brief Finds the points of a batch of body points that penetrate the
+ * terrain.
+ *
+ * The batch is recursively split into groups of nearby points and groups
+ * that are above the maximum terrain height of their bounding box are
+ * rejected without evaluating the terrain for the individual points.
+ *
+ * \param model the model
+ * \param Q the generalized positions
+ * \param body_ids the bodies of the candidate points
+ * \param body_points the candidate points in body coordinates
+ * \param terrain the terrain
+ * \param contacts (output) the penetrating points
+ * \param update_kinematics whether the kinematics of the model should be
+ * updated from Q (defaults to true)
+ *
+ * \returns the number of contacts
+ */
+RBDL_DLLAPI
+unsigned int CalcTerrainContacts (
+    Model &model,
+    const Math::VectorNd &Q,
+    const std::vector<unsigned int> &body_ids,
+    const std::vector<Math::Vector3d> &body_points,
+    const Heightfield &terrain,
+    std::vector<TerrainContact> &contacts,
+    bool update_kinematics = true
+    );
+
+/** \brief Adds contact constraints for terrain contacts to a constraint
+ * set.
+ *
+ * For each contact a contact constraint along the normal and, if
+ * requested, along both tangents of the contact frame is added.
+ *
+ * \param contacts the terrain contacts, e.g. from CalcTerrainContacts()
+ * \param CS the (unbound) constraint set
+ * \param tangential whether constraints along the tangents should be
+ * added (defaults to true)
+ */
+RBDL_DLLAPI
+void AddTerrainContactConstraints (
+    const std::vector<TerrainContact> &contacts,
+    ConstraintSet &CS,
+    bool tangential = true
+    );
+
+/** @} */
+
+} /* namespace RigidBodyDynamics */
+
+/* RBDL_TERRAIN_H */
+#endif
@@ -19,6 +19,9 @@
 #include "rbdl/Joint.h"
 #include "rbdl/Kinematics.h"
 #include "rbdl/Constraints.h"
+#include "rbdl/PenaltyContacts.h"
+#include "rbdl/Terrain.h"
+#include "rbdl/Collision.h"
 
 #include "rbdl/rbdl_utils.h"
 
@@ -60,6 +60,38 @@ RBDL_DLLAPI void CalcCenterOfMass (
   bool update_kinematics = true
 );
 
+/** \brief Computes the Jacobian of the Center of Mass (COM) and
+ * optionally the product of its time derivative with qdot.
+ *
+ * The Jacobian is computed in a single pass from the leaves to the root
+ * using the composite rigid body inertias: the column of a joint is the
+ * linear momentum of the subtree of the joint that is caused by a unit
+ * joint velocity divided by the total mass. The product of the time
+ * derivative with qdot is the COM acceleration for zero joint
+ * accelerations.
+ *
+ * \param model The model for which we want to compute the COM Jacobian
+ * \param q The current joint positions
+ * \param com_jacobian (output) the Jacobian of the COM in base coordinates
+ * (3 x model.qdot_size)
+ * \param qdot (optional input) A pointer to the current joint velocities
+ * \param com_jacobian_dot_qdot (optional output) the product of the time
+ * derivative of the COM Jacobian with qdot in base coordinates
+ * \param update_kinematics (optional input) whether the kinematics should be updated (defaults to true)
+ *
+ * \note When wanting to compute com_jacobian_dot_qdot one has to provide
+ * qdot. If update_kinematics is false the velocities of the bodies have to
+ * be up to date with qdot.
+ */
+RBDL_DLLAPI void CalcCenterOfMassJacobian (
+  Model &model,
+  const Math::VectorNd &q,
+  Math::MatrixNd &com_jacobian,
+  const Math::VectorNd *qdot = NULL,
+  Math::Vector3d *com_jacobian_dot_qdot = NULL,
+  bool update_kinematics = true
+);
+
 /** \brief Computes the Zero-Moment-Point (ZMP) on a given contact surface.
  *
  * \param model The model for which we want to compute the ZMP
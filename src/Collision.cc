@@ -0,0 +1,499 @@
+/*
+ * RBDL - Rigid Body Dynamics Library
+ * Copyright (c) 2011-2018 Martin Felis <martin@fysx.org>
+ *
+ * Licensed under the zlib license. See LICENSE for more details.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "rbdl/rbdl_mathutils.h"
+#include "rbdl/Logging.h"
+
+#include "rbdl/Model.h"
+#include "rbdl/Constraints.h"
+#include "rbdl/Collision.h"
+
+namespace RigidBodyDynamics {
+
+using namespace Math;
+
+unsigned int CollisionWorld::AddSphere (unsigned int body_id,
+    const SpatialTransform &frame,
+    double radius) {
+  CollisionShape shape;
+  shape.type = CollisionShapeSphere;
+  shape.body_id = body_id;
+  shape.frame = frame;
+  shape.radius = radius;
+
+  shapes.push_back (shape);
+  return shapes.size() - 1;
+}
+
+unsigned int CollisionWorld::AddCapsule (unsigned int body_id,
+    const SpatialTransform &frame,
+    double radius,
+    double half_length) {
+  CollisionShape shape;
+  shape.type = CollisionShapeCapsule;
+  shape.body_id = body_id;
+  shape.frame = frame;
+  shape.radius = radius;
+  shape.half_length = half_length;
+
+  shapes.push_back (shape);
+  return shapes.size() - 1;
+}
+
+unsigned int CollisionWorld::AddBox (unsigned int body_id,
+    const SpatialTransform &frame,
+    const Vector3d &half_extents) {
+  CollisionShape shape;
+  shape.type = CollisionShapeBox;
+  shape.body_id = body_id;
+  shape.frame = frame;
+  shape.half_extents = half_extents;
+
+  shapes.push_back (shape);
+  return shapes.size() - 1;
+}
+
+void CollisionWorld::UpdateTransforms (Model &model) {
+  unsigned int shape_count = shapes.size();
+
+  mShapePositions.resize (shape_count);
+  mShapeOrientations.resize (shape_count);
+  mBodyTransforms.resize (shape_count);
+  mMovableBodies.resize (shape_count);
+  mParentBodies.resize (shape_count);
+  mBoundsMin.resize (shape_count);
+  mBoundsMax.resize (shape_count);
+
+  for (unsigned int i = 0; i < shape_count; i++) {
+    const CollisionShape &shape = shapes[i];
+    unsigned int movable_id = model.GetMovableBodyId (shape.body_id);
+
+    if (model.IsFixedBodyId (shape.body_id)) {
+      const FixedBody &fbody =
+        model.mFixedBodies[shape.body_id - model.fixed_body_discriminator];
+      mBodyTransforms[i] = fbody.mParentTransform * model.X_base[movable_id];
+    } else if (shape.body_id == 0) {
+      mBodyTransforms[i] = SpatialTransform();
+    } else {
+      mBodyTransforms[i] = model.X_base[shape.body_id];
+    }
+
+    mMovableBodies[i] = movable_id;
+    mParentBodies[i] = 0;
+    if (movable_id != 0) {
+      mParentBodies[i] = model.GetParentBodyId (movable_id);
+    }
+
+    SpatialTransform X_shape = shape.frame * mBodyTransforms[i];
+    mShapePositions[i] = X_shape.r;
+    mShapeOrientations[i] = X_shape.E.transpose();
+
+    const Matrix3d &R = mShapeOrientations[i];
+    Vector3d extent (Vector3d::Zero());
+
+    switch (shape.type) {
+      case CollisionShapeSphere:
+        extent = Vector3d (shape.radius, shape.radius, shape.radius);
+        break;
+      case CollisionShapeCapsule:
+        for (unsigned int d = 0; d < 3; d++) {
+          extent[d] = std::fabs (R(d, 2)) * shape.half_length + shape.radius;
+        }
+        break;
+      case CollisionShapeBox:
+        for (unsigned int d = 0; d < 3; d++) {
+          extent[d] = std::fabs (R(d, 0)) * shape.half_extents[0]
+            + std::fabs (R(d, 1)) * shape.half_extents[1]
+            + std::fabs (R(d, 2)) * shape.half_extents[2];
+        }
+        break;
+    }
+
+    mBoundsMin[i] = mShapePositions[i] - extent;
+    mBoundsMax[i] = mShapePositions[i] + extent;
+  }
+}
+
+/** \brief Computes the closest points of two segments [p1, q1] and [p2,
+ * q2].
+ */
+static void CalcClosestPointsSegments (
+    const Vector3d &p1, const Vector3d &q1,
+    const Vector3d &p2, const Vector3d &q2,
+    Vector3d &c1, Vector3d &c2) {
+  const double eps = 1.0e-12;
+
+  Vector3d d1 = q1 - p1;
+  Vector3d d2 = q2 - p2;
+  Vector3d r = p1 - p2;
+  double a = d1.dot (d1);
+  double e = d2.dot (d2);
+  double f = d2.dot (r);
+  double s = 0.;
+  double t = 0.;
+
+  if (a <= eps && e <= eps) {
+    s = 0.;
+    t = 0.;
+  } else if (a <= eps) {
+    s = 0.;
+    t = std::min (std::max (f / e, 0.), 1.);
+  } else {
+    double c = d1.dot (r);
+    if (e <= eps) {
+      t = 0.;
+      s = std::min (std::max (-c / a, 0.), 1.);
+    } else {
+      double b = d1.dot (d2);
+      double denom = a * e - b * b;
+
+      if (denom > eps) {
+        s = std::min (std::max ((b * f - c * e) / denom, 0.), 1.);
+      }
+
+      t = (b * s + f) / e;
+      if (t < 0.) {
+        t = 0.;
+        s = std::min (std::max (-c / a, 0.), 1.);
+      } else if (t > 1.) {
+        t = 1.;
+        s = std::min (std::max ((b - c) / a, 0.), 1.);
+      }
+    }
+  }
+
+  c1 = p1 + d1 * s;
+  c2 = p2 + d2 * t;
+}
+
+/** \brief Computes the contact of two spheres. */
+static bool CollideSpheres (
+    const Vector3d &center_a, double radius_a,
+    const Vector3d &center_b, double radius_b,
+    CollisionContact &contact) {
+  Vector3d delta = center_b - center_a;
+  double distance = delta.norm();
+
+  if (distance >= radius_a + radius_b) {
+    return false;
+  }
+
+  contact.normal = Vector3d (0., 0., 1.);
+  if (distance > 1.0e-12) {
+    contact.normal = delta / distance;
+  }
+
+  contact.depth = radius_a + radius_b - distance;
+  contact.point_a = center_a + contact.normal * radius_a;
+  contact.point_b = center_b - contact.normal * radius_b;
+
+  return true;
+}
+
+/** \brief Computes the contact of a sphere (a) and a box (b). */
+static bool CollideSphereBox (
+    const Vector3d &center, double radius,
+    const Vector3d &box_center, const Matrix3d &box_orientation,
+    const Vector3d &half_extents,
+    CollisionContact &contact) {
+  Vector3d p = box_orientation.transpose() * (center - box_center);
+  Vector3d q;
+  for (unsigned int d = 0; d < 3; d++) {
+    q[d] = std::min (std::max (p[d], -half_extents[d]), half_extents[d]);
+  }
+
+  Vector3d delta = p - q;
+  double distance = delta.norm();
+  Vector3d normal_out;
+
+  if (distance > 1.0e-12) {
+    // sphere center outside of the box
+    if (distance >= radius) {
+      return false;
+    }
+
+    normal_out = box_orientation * (delta / distance);
+    contact.depth = radius - distance;
+    contact.point_b = box_center + box_orientation * q;
+  } else {
+    // sphere center inside of the box: use the closest face
+    unsigned int axis = 0;
+    double face_distance = half_extents[0] - std::fabs (p[0]);
+    for (unsigned int d = 1; d < 3; d++) {
+      if (half_extents[d] - std::fabs (p[d]) < face_distance) {
+        axis = d;
+        face_distance = half_extents[d] - std::fabs (p[d]);
+      }
+    }
+
+    double sign = p[axis] >= 0. ? 1. : -1.;
+    normal_out = Vector3d (box_orientation(0, axis), box_orientation(1, axis),
+        box_orientation(2, axis)) * sign;
+    contact.depth = radius + face_distance;
+    contact.point_b = center + normal_out * face_distance;
+  }
+
+  contact.normal = -normal_out;
+  contact.point_a = center + contact.normal * radius;
+
+  return true;
+}
+
+/** \brief Computes the contacts of the corners of box a inside of box b.
+ */
+static void CollideBoxCorners (
+    const Vector3d &center_a, const Matrix3d &orientation_a,
+    const Vector3d &half_extents_a,
+    const Vector3d &center_b, const Matrix3d &orientation_b,
+    const Vector3d &half_extents_b,
+    std::vector<CollisionContact> &contacts) {
+  for (unsigned int k = 0; k < 8; k++) {
+    Vector3d corner_local (
+        (k & 1) ? half_extents_a[0] : -half_extents_a[0],
+        (k & 2) ? half_extents_a[1] : -half_extents_a[1],
+        (k & 4) ? half_extents_a[2] : -half_extents_a[2]);
+    Vector3d corner = center_a + orientation_a * corner_local;
+    Vector3d p = orientation_b.transpose() * (corner - center_b);
+
+    unsigned int axis = 0;
+    double face_distance = half_extents_b[0] - std::fabs (p[0]);
+    for (unsigned int d = 1; d < 3; d++) {
+      if (half_extents_b[d] - std::fabs (p[d]) < face_distance) {
+        axis = d;
+        face_distance = half_extents_b[d] - std::fabs (p[d]);
+      }
+    }
+
+    if (face_distance <= 0.) {
+      continue;
+    }
+
+    double sign = p[axis] >= 0. ? 1. : -1.;
+    Vector3d normal_out = Vector3d (orientation_b(0, axis),
+        orientation_b(1, axis), orientation_b(2, axis)) * sign;
+
+    CollisionContact contact;
+    contact.normal = -normal_out;
+    contact.depth = face_distance;
+    contact.point_a = corner;
+    contact.point_b = corner + normal_out * face_distance;
+    contacts.push_back (contact);
+  }
+}
+
+/** \brief Swaps the roles of shape a and shape b of a contact. */
+static void FlipContact (CollisionContact &contact) {
+  std::swap (contact.point_a, contact.point_b);
+  contact.normal = -contact.normal;
+}
+
+/** \brief Computes the contacts of two shapes whose types are ordered,
+ * i.e. shapes[a].type <= shapes[b].type.
+ */
+static void CollideShapes (
+    const CollisionWorld &world,
+    unsigned int a,
+    unsigned int b,
+    std::vector<CollisionContact> &contacts) {
+  const CollisionShape &shape_a = world.shapes[a];
+  const CollisionShape &shape_b = world.shapes[b];
+  const Vector3d &center_a = world.mShapePositions[a];
+  const Vector3d &center_b = world.mShapePositions[b];
+  const Matrix3d &orientation_a = world.mShapeOrientations[a];
+  const Matrix3d &orientation_b = world.mShapeOrientations[b];
+
+  Vector3d axis_a (orientation_a(0, 2), orientation_a(1, 2), orientation_a(2, 2));
+  Vector3d axis_b (orientation_b(0, 2), orientation_b(1, 2), orientation_b(2, 2));
+
+  CollisionContact contact;
+
+  if (shape_a.type == CollisionShapeSphere) {
+    if (shape_b.type == CollisionShapeSphere) {
+      if (CollideSpheres (center_a, shape_a.radius, center_b, shape_b.radius,
+            contact)) {
+        contacts.push_back (contact);
+      }
+    } else if (shape_b.type == CollisionShapeCapsule) {
+      Vector3d c_a, c_b;
+      CalcClosestPointsSegments (center_a, center_a,
+          center_b - axis_b * shape_b.half_length,
+          center_b + axis_b * shape_b.half_length, c_a, c_b);
+      if (CollideSpheres (c_a, shape_a.radius, c_b, shape_b.radius, contact)) {
+        contacts.push_back (contact);
+      }
+    } else if (shape_b.type == CollisionShapeBox) {
+      if (CollideSphereBox (center_a, shape_a.radius, center_b,
+            orientation_b, shape_b.half_extents, contact)) {
+        contacts.push_back (contact);
+      }
+    }
+  } else if (shape_a.type == CollisionShapeCapsule) {
+    Vector3d p_a = center_a - axis_a * shape_a.half_length;
+    Vector3d q_a = center_a + axis_a * shape_a.half_length;
+
+    if (shape_b.type == CollisionShapeCapsule) {
+      Vector3d c_a, c_b;
+      CalcClosestPointsSegments (p_a, q_a,
+          center_b - axis_b * shape_b.half_length,
+          center_b + axis_b * shape_b.half_length, c_a, c_b);
+      if (CollideSpheres (c_a, shape_a.radius, c_b, shape_b.radius, contact)) {
+        contacts.push_back (contact);
+      }
+    } else if (shape_b.type == CollisionShapeBox) {
+      // alternating projections onto the box and the capsule axis converge
+      // to the point of the axis that is closest to the box
+      Vector3d c_a = center_a;
+      for (unsigned int iter = 0; iter < 32; iter++) {
+        Vector3d p = orientation_b.transpose() * (c_a - center_b);
+        for (unsigned int d = 0; d < 3; d++) {
+          p[d] = std::min (std::max (p[d], -shape_b.half_extents[d]),
+              shape_b.half_extents[d]);
+        }
+        Vector3d c_b = center_b + orientation_b * p;
+        Vector3d c_a_prev = c_a;
+        CalcClosestPointsSegments (p_a, q_a, c_b, c_b, c_a, c_b);
+
+        if ((c_a - c_a_prev).squaredNorm() < 1.0e-20) {
+          break;
+        }
+      }
+
+      if (CollideSphereBox (c_a, shape_a.radius, center_b, orientation_b,
+            shape_b.half_extents, contact)) {
+        contacts.push_back (contact);
+      }
+    }
+  } else if (shape_a.type == CollisionShapeBox
+      && shape_b.type == CollisionShapeBox) {
+    CollideBoxCorners (center_a, orientation_a, shape_a.half_extents,
+        center_b, orientation_b, shape_b.half_extents, contacts);
+
+    unsigned int first_flipped = contacts.size();
+    CollideBoxCorners (center_b, orientation_b, shape_b.half_extents,
+        center_a, orientation_a, shape_a.half_extents, contacts);
+    for (unsigned int k = first_flipped; k < contacts.size(); k++) {
+      FlipContact (contacts[k]);
+    }
+  }
+}
+
+unsigned int CollisionWorld::CalcContacts (
+    std::vector<CollisionContact> &contacts) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  contacts.clear();
+
+  unsigned int shape_count = shapes.size();
+  assert (mBoundsMin.size() == shape_count);
+
+  if (mSweepOrder.size() != shape_count) {
+    mSweepOrder.resize (shape_count);
+    for (unsigned int i = 0; i < shape_count; i++) {
+      mSweepOrder[i] = i;
+    }
+  }
+
+  // insertion sort is close to linear as the order of the previous call
+  // is mostly preserved
+  for (unsigned int i = 1; i < shape_count; i++) {
+    unsigned int shape = mSweepOrder[i];
+    double key = mBoundsMin[shape][0];
+    unsigned int j = i;
+    while (j > 0 && mBoundsMin[mSweepOrder[j - 1]][0] > key) {
+      mSweepOrder[j] = mSweepOrder[j - 1];
+      j--;
+    }
+    mSweepOrder[j] = shape;
+  }
+
+  for (unsigned int i = 0; i < shape_count; i++) {
+    unsigned int a = mSweepOrder[i];
+
+    for (unsigned int j = i + 1; j < shape_count; j++) {
+      unsigned int b = mSweepOrder[j];
+
+      if (mBoundsMin[b][0] > mBoundsMax[a][0]) {
+        break;
+      }
+
+      if (mBoundsMin[b][1] > mBoundsMax[a][1]
+          || mBoundsMin[a][1] > mBoundsMax[b][1]
+          || mBoundsMin[b][2] > mBoundsMax[a][2]
+          || mBoundsMin[a][2] > mBoundsMax[b][2]) {
+        continue;
+      }
+
+      if (mMovableBodies[a] == mMovableBodies[b]) {
+        continue;
+      }
+
+      if (exclude_adjacent_bodies
+          && mMovableBodies[a] != 0 && mMovableBodies[b] != 0
+          && (mParentBodies[a] == mMovableBodies[b]
+            || mParentBodies[b] == mMovableBodies[a])) {
+        continue;
+      }
+
+      unsigned int first = a;
+      unsigned int second = b;
+      if (shapes[first].type > shapes[second].type) {
+        std::swap (first, second);
+      }
+
+      unsigned int first_contact = contacts.size();
+      CollideShapes (*this, first, second, contacts);
+
+      for (unsigned int k = first_contact; k < contacts.size(); k++) {
+        CollisionContact &contact = contacts[k];
+        contact.shape_a = first;
+        contact.shape_b = second;
+        contact.body_a = shapes[first].body_id;
+        contact.body_b = shapes[second].body_id;
+        contact.movable_a = mMovableBodies[first];
+        contact.movable_b = mMovableBodies[second];
+
+        const SpatialTransform &X_a = mBodyTransforms[first];
+        const SpatialTransform &X_b = mBodyTransforms[second];
+        contact.body_point_a = X_a.E * (contact.point_a - X_a.r);
+        contact.body_point_b = X_b.E * (contact.point_b - X_b.r);
+      }
+    }
+  }
+
+  return contacts.size();
+}
+
+RBDL_DLLAPI
+unsigned int AddCollisionContactConstraints (
+    const std::vector<CollisionContact> &contacts,
+    ConstraintSet &CS) {
+  unsigned int constraint_count = 0;
+
+  for (unsigned int k = 0; k < contacts.size(); k++) {
+    const CollisionContact &contact = contacts[k];
+
+    if (contact.movable_a == 0 && contact.movable_b != 0) {
+      // the normal pushes body b away from the environment
+      CS.AddContactConstraint (contact.body_b, contact.body_point_b,
+          contact.normal);
+      constraint_count++;
+    } else if (contact.movable_b == 0 && contact.movable_a != 0) {
+      CS.AddContactConstraint (contact.body_a, contact.body_point_a,
+          -contact.normal);
+      constraint_count++;
+    }
+  }
+
+  return constraint_count;
+}
+
+} /* namespace RigidBodyDynamics */
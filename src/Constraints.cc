@@ -5,6 +5,7 @@
  * Licensed under the zlib license. See LICENSE for more details.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <limits>
@@ -31,7 +32,6 @@ void SolveLinearSystem (
   LinearSolver ls
 );
 
-unsigned int GetMovableBodyId (Model& model, unsigned int id);
 
 unsigned int ConstraintSet::AddContactConstraint (
   unsigned int body_id,
@@ -238,6 +238,39 @@ unsigned int ConstraintSet::AddCustomConstraint(
   return n_constr_size - 1;
 }
 
+/** \brief Stores groups of constraint indices contiguously together with
+ * the start of each group.
+ */
+static void FlattenConstraintGroups (
+  const std::vector<std::vector<unsigned int> > &groups,
+  std::vector<unsigned int> &indices,
+  std::vector<unsigned int> &offsets
+  ) {
+  indices.clear();
+  offsets.clear();
+
+  for (unsigned int g = 0; g < groups.size(); g++) {
+    offsets.push_back (indices.size());
+    indices.insert (indices.end(), groups[g].begin(), groups[g].end());
+  }
+  offsets.push_back (indices.size());
+}
+
+/** \brief Checks whether two loop constraints act between the same frames.
+ */
+static bool LoopConstraintsShareFrames (
+  const ConstraintSet &CS,
+  unsigned int c1,
+  unsigned int c2
+  ) {
+  return CS.body_p[c1] == CS.body_p[c2]
+    && CS.body_s[c1] == CS.body_s[c2]
+    && CS.X_p[c1].r == CS.X_p[c2].r
+    && CS.X_s[c1].r == CS.X_s[c2].r
+    && CS.X_p[c1].E == CS.X_p[c2].E
+    && CS.X_s[c1].E == CS.X_s[c2].E;
+}
+
 bool ConstraintSet::Bind (const Model &model) {
   assert (bound == false);
 
@@ -266,6 +299,10 @@ bool ConstraintSet::Bind (const Model &model) {
   GSpi.conservativeResize (6, model.qdot_size);
   GSsi.conservativeResize (6, model.qdot_size);
   GSJ.conservativeResize (6, model.qdot_size);
+  custom_frames.G_p.conservativeResize (6, model.qdot_size);
+  custom_frames.G_p.setZero();
+  custom_frames.G_s.conservativeResize (6, model.qdot_size);
+  custom_frames.G_s.setZero();
 
   // HouseHolderQR crashes if matrix G has more rows than columns.
   GT_qr.compute(G.transpose());
@@ -299,6 +336,44 @@ bool ConstraintSet::Bind (const Model &model) {
   d_multdof3_u = std::vector<Math::Vector3d> (model.mBodies.size()
     , Math::Vector3d::Zero());
 
+  // Group the contact constraints by their body point.
+  std::vector<std::vector<unsigned int> > groups;
+  for (unsigned int i = 0; i < mContactConstraintIndices.size(); i++) {
+    const unsigned int c = mContactConstraintIndices[i];
+
+    unsigned int g = 0;
+    while (g < groups.size()
+        && (body[groups[g][0]] != body[c] || point[groups[g][0]] != point[c])) {
+      g++;
+    }
+
+    if (g == groups.size()) {
+      groups.push_back (std::vector<unsigned int>());
+    }
+    groups[g].push_back (c);
+  }
+  FlattenConstraintGroups (groups, mContactGroupConstraintIndices,
+      mContactGroupOffsets);
+
+  // Group the loop constraints by their frames.
+  groups.clear();
+  for (unsigned int i = 0; i < mLoopConstraintIndices.size(); i++) {
+    const unsigned int c = mLoopConstraintIndices[i];
+
+    unsigned int g = 0;
+    while (g < groups.size()
+        && !LoopConstraintsShareFrames (*this, groups[g][0], c)) {
+      g++;
+    }
+
+    if (g == groups.size()) {
+      groups.push_back (std::vector<unsigned int>());
+    }
+    groups[g].push_back (c);
+  }
+  FlattenConstraintGroups (groups, mLoopGroupConstraintIndices,
+      mLoopGroupOffsets);
+
   bound = true;
 
   return bound;
@@ -475,25 +550,12 @@ void SolveConstrainedSystemNullSpace (
   }
 }
 
-RBDL_DLLAPI
-void CalcConstraintsPositionError (
+static void CalcLoopConstraintsPositionError (
   Model& model,
   const Math::VectorNd &Q,
   ConstraintSet &CS,
-  Math::VectorNd& err,
-  bool update_kinematics
+  Math::VectorNd& err
   ) {
-  assert(err.size() == CS.size());
-
-  if(update_kinematics) {
-    UpdateKinematicsCustom (model, &Q, NULL, NULL);
-  }
-
-  for (unsigned int i = 0; i < CS.mContactConstraintIndices.size(); i++) {
-    const unsigned int c = CS.mContactConstraintIndices[i];
-    err[c] = 0.;
-  }
-
   for (unsigned int i = 0; i < CS.mLoopConstraintIndices.size(); i++) {
     const unsigned int lci = CS.mLoopConstraintIndices[i];
 
@@ -540,99 +602,162 @@ void CalcConstraintsPositionError (
     // Project the error on the constraint axis to find the actual error.
     err[lci] = CS.constraintAxis[lci].transpose() * d;
   }
-
-  for (unsigned int i = 0; i < CS.mCustomConstraintIndices.size(); i++) {
-    const unsigned int cci = CS.mCustomConstraintIndices[i];
-    CS.mCustomConstraints[i]->CalcPositionError(model,cci,Q,CS,err, cci);
-  }
 }
 
-RBDL_DLLAPI
-void CalcConstraintsJacobian (
+static void CalcContactConstraintsJacobian (
   Model &model,
   const Math::VectorNd &Q,
   ConstraintSet &CS,
-  Math::MatrixNd &G,
-  bool update_kinematics
+  Math::MatrixNd &G
   ) {
-  if (update_kinematics) {
-    UpdateKinematicsCustom (model, &Q, NULL, NULL);
-  }
+  assert (CS.bound);
 
-  // variables to check whether we need to recompute G.
-  unsigned int prev_body_id_1 = 0;
-  unsigned int prev_body_id_2 = 0;
-  SpatialTransform prev_body_X_1;
-  SpatialTransform prev_body_X_2;
-
-  for (unsigned int i = 0; i < CS.mContactConstraintIndices.size(); i++) {
-    const unsigned int c = CS.mContactConstraintIndices[i];
+  // The point Jacobian is computed once for each group of constraints on
+  // the same body point.
+  for (unsigned int g = 0; g + 1 < CS.mContactGroupOffsets.size(); g++) {
+    const unsigned int c0 =
+      CS.mContactGroupConstraintIndices[CS.mContactGroupOffsets[g]];
 
-    // only compute the matrix Gi if actually needed
-    if (prev_body_id_1 != CS.body[c]
-        || prev_body_X_1.r != CS.point[c]) {
+    CS.Gi.setZero();
+    CalcPointJacobian (model, Q, CS.body[c0], CS.point[c0], CS.Gi, false);
 
-      // Compute the jacobian for the point.
-      CS.Gi.setZero();
-      CalcPointJacobian (model, Q, CS.body[c], CS.point[c], CS.Gi, false);
+    for (unsigned int k = CS.mContactGroupOffsets[g];
+        k < CS.mContactGroupOffsets[g + 1]; k++) {
+      const unsigned int c = CS.mContactGroupConstraintIndices[k];
 
-      // Update variables for optimization check.
-      prev_body_id_1 = CS.body[c];
-      prev_body_X_1 = Xtrans(CS.point[c]);
-    }
-
-    for(unsigned int j = 0; j < model.dof_count; j++) {
-      Vector3d gaxis (CS.Gi(0,j), CS.Gi(1,j), CS.Gi(2,j));
-      G(c,j) = gaxis.transpose() * CS.normal[c];
+      for(unsigned int j = 0; j < model.dof_count; j++) {
+        Vector3d gaxis (CS.Gi(0,j), CS.Gi(1,j), CS.Gi(2,j));
+        G(c,j) = gaxis.transpose() * CS.normal[c];
+      }
     }
   }
+}
+
+static void CalcLoopConstraintsJacobian (
+  Model &model,
+  const Math::VectorNd &Q,
+  ConstraintSet &CS,
+  Math::MatrixNd &G
+  ) {
+  assert (CS.bound);
 
   // Variables used for computations.
-  Vector3d normal;
   SpatialVector axis;
   Vector3d pos_p;
   Matrix3d rot_p;
   SpatialTransform X_0p;
 
-  for (unsigned int i = 0; i < CS.mLoopConstraintIndices.size(); i++) {
-    const unsigned int c = CS.mLoopConstraintIndices[i];
-
-    // Only recompute variables if necessary.
-    if( prev_body_id_1 != CS.body_p[c]
-        || prev_body_id_2 != CS.body_s[c]
-        || prev_body_X_1.r != CS.X_p[c].r
-        || prev_body_X_2.r != CS.X_s[c].r
-        || prev_body_X_1.E != CS.X_p[c].E
-        || prev_body_X_2.E != CS.X_s[c].E) {
-
-      // Compute the 6D jacobians of the two contact points.
-      CS.GSpi.setZero();
-      CS.GSsi.setZero();
-      CalcPointJacobian6D(model, Q, CS.body_p[c], CS.X_p[c].r, CS.GSpi, false);
-      CalcPointJacobian6D(model, Q, CS.body_s[c], CS.X_s[c].r, CS.GSsi, false);
-      CS.GSJ = CS.GSsi - CS.GSpi;
-
-      // Compute position and rotation matrix from predecessor body to base.
-      pos_p = CalcBodyToBaseCoordinates (model, Q, CS.body_p[c], CS.X_p[c].r
-          , false);
-      rot_p = CalcBodyWorldOrientation (model, Q, CS.body_p[c]
-          , false).transpose()* CS.X_p[c].E;
-      X_0p = SpatialTransform (rot_p, pos_p);
-
-      // Update variables for optimization check.
-      prev_body_id_1 = CS.body_p[c];
-      prev_body_id_2 = CS.body_s[c];
-      prev_body_X_1 = CS.X_p[c];
-      prev_body_X_2 = CS.X_s[c];
+  // The frame Jacobians are computed once for each group of constraints
+  // between the same frames.
+  for (unsigned int g = 0; g + 1 < CS.mLoopGroupOffsets.size(); g++) {
+    const unsigned int c0 =
+      CS.mLoopGroupConstraintIndices[CS.mLoopGroupOffsets[g]];
+
+    // Compute the 6D jacobians of the two contact points.
+    CS.GSpi.setZero();
+    CS.GSsi.setZero();
+    CalcPointJacobian6D(model, Q, CS.body_p[c0], CS.X_p[c0].r, CS.GSpi, false);
+    CalcPointJacobian6D(model, Q, CS.body_s[c0], CS.X_s[c0].r, CS.GSsi, false);
+    CS.GSJ = CS.GSsi - CS.GSpi;
+
+    // Compute position and rotation matrix from predecessor body to base.
+    pos_p = CalcBodyToBaseCoordinates (model, Q, CS.body_p[c0], CS.X_p[c0].r
+        , false);
+    rot_p = CalcBodyWorldOrientation (model, Q, CS.body_p[c0]
+        , false).transpose()* CS.X_p[c0].E;
+    X_0p = SpatialTransform (rot_p, pos_p);
+
+    for (unsigned int k = CS.mLoopGroupOffsets[g];
+        k < CS.mLoopGroupOffsets[g + 1]; k++) {
+      const unsigned int c = CS.mLoopGroupConstraintIndices[k];
+
+      // Express the constraint axis in the base frame.
+      axis = X_0p.apply(CS.constraintAxis[c]);
+
+      // Compute the constraint Jacobian row.
+      G.block(c, 0, 1, model.dof_count) = axis.transpose() * CS.GSJ;
     }
+  }
+}
 
-    // Express the constraint axis in the base frame.
-    axis = X_0p.apply(CS.constraintAxis[c]);
+static void CalcConstraintFrameKinematics (
+  Model &model,
+  const Math::VectorNd &Q,
+  const Math::VectorNd &QDot,
+  ConstraintSet &CS,
+  unsigned int c,
+  CustomConstraintFrameKinematics &frames
+  ) {
+  frames.E_p = CalcBodyWorldOrientation (model, Q, CS.body_p[c], false
+      ).transpose() * CS.X_p[c].E;
+  frames.E_s = CalcBodyWorldOrientation (model, Q, CS.body_s[c], false
+      ).transpose() * CS.X_s[c].E;
+
+  frames.r_p = CalcBodyToBaseCoordinates (model, Q, CS.body_p[c], CS.X_p[c].r
+      , false);
+  frames.r_s = CalcBodyToBaseCoordinates (model, Q, CS.body_s[c], CS.X_s[c].r
+      , false);
+
+  frames.v_p = CalcPointVelocity6D (model, Q, QDot, CS.body_p[c], CS.X_p[c].r
+      , false);
+  frames.v_s = CalcPointVelocity6D (model, Q, QDot, CS.body_s[c], CS.X_s[c].r
+      , false);
+
+  // The kinematics were updated with QDDot = 0, i.e. these are the velocity
+  // product accelerations.
+  frames.a_p = CalcPointAcceleration6D (model, Q, QDot, CS.QDDot_0
+      , CS.body_p[c], CS.X_p[c].r, false);
+  frames.a_s = CalcPointAcceleration6D (model, Q, QDot, CS.QDDot_0
+      , CS.body_s[c], CS.X_s[c].r, false);
+
+  frames.G_p.setZero();
+  frames.G_s.setZero();
+  CalcPointJacobian6D (model, Q, CS.body_p[c], CS.X_p[c].r, frames.G_p, false);
+  CalcPointJacobian6D (model, Q, CS.body_s[c], CS.X_s[c].r, frames.G_s, false);
+}
 
-    // Compute the constraint Jacobian row.
-    G.block(c, 0, 1, model.dof_count) = axis.transpose() * CS.GSJ;
+RBDL_DLLAPI
+void CalcConstraintsPositionError (
+  Model& model,
+  const Math::VectorNd &Q,
+  ConstraintSet &CS,
+  Math::VectorNd& err,
+  bool update_kinematics
+  ) {
+  assert(err.size() == CS.size());
+
+  if(update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, NULL, NULL);
   }
 
+  for (unsigned int i = 0; i < CS.mContactConstraintIndices.size(); i++) {
+    const unsigned int c = CS.mContactConstraintIndices[i];
+    err[c] = 0.;
+  }
+
+  CalcLoopConstraintsPositionError (model, Q, CS, err);
+
+  for (unsigned int i = 0; i < CS.mCustomConstraintIndices.size(); i++) {
+    const unsigned int cci = CS.mCustomConstraintIndices[i];
+    CS.mCustomConstraints[i]->CalcPositionError(model,cci,Q,CS,err, cci);
+  }
+}
+
+RBDL_DLLAPI
+void CalcConstraintsJacobian (
+  Model &model,
+  const Math::VectorNd &Q,
+  ConstraintSet &CS,
+  Math::MatrixNd &G,
+  bool update_kinematics
+  ) {
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, NULL, NULL);
+  }
+
+  CalcContactConstraintsJacobian (model, Q, CS, G);
+  CalcLoopConstraintsJacobian (model, Q, CS, G);
+
   // Go and get the CustomConstraint Jacobians
   for (unsigned int i = 0; i < CS.mCustomConstraintIndices.size(); i++) {
     const unsigned int cci = CS.mCustomConstraintIndices[i];
@@ -674,126 +799,196 @@ void CalcConstraintsVelocityError (
 }
 
 RBDL_DLLAPI
-void CalcConstrainedSystemVariables (
+void CalcConstraintsTerms (
   Model &model,
   const Math::VectorNd &Q,
   const Math::VectorNd &QDot,
-  const Math::VectorNd &UNUSED(Tau),
   ConstraintSet &CS,
-  std::vector<Math::SpatialVector> *f_ext
+  Math::MatrixNd &G,
+  Math::VectorNd &err,
+  Math::VectorNd &errd,
+  Math::VectorNd &gamma,
+  bool update_kinematics
   ) {
-  // Compute C
-  NonlinearEffects(model, Q, QDot, CS.C, f_ext);
-  assert(CS.H.cols() == model.dof_count && CS.H.rows() == model.dof_count);
-
-  // Compute H
-  CS.H.setZero();
-  CompositeRigidBodyAlgorithm(model, Q, CS.H, false);
+  assert(G.rows() == CS.size() && G.cols() == model.dof_count);
+  assert(err.size() == CS.size());
+  assert(errd.size() == CS.size());
+  assert(gamma.size() == CS.size());
 
-  // Compute G
-  // We have to update model.X_base as they are not automatically computed
-  // by NonlinearEffects()
-  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
-    model.X_base[i] = model.X_lambda[i] * model.X_base[model.lambda[i]];
+  if (update_kinematics) {
+    CS.QDDot_0.setZero();
+    UpdateKinematics (model, Q, QDot, CS.QDDot_0);
   }
-  CalcConstraintsJacobian (model, Q, CS, CS.G, false);
 
-  // Compute position error for Baumgarte Stabilization.
-  CalcConstraintsPositionError (model, Q, CS, CS.err, false);
+  assert (CS.bound);
 
-  // Compute velocity error for Baugarte stabilization.
-  CalcConstraintsVelocityError (model, Q, QDot, CS, CS.errd, false);
-  //CS.errd = CS.G * QDot;
+  // Contact constraints: the Jacobian, velocity and velocity product
+  // acceleration of a contact point are shared by all constraints on it.
+  Vector3d point_vel = Vector3d::Zero();
+  Vector3d point_acc = Vector3d::Zero();
 
-  // Compute gamma
-  unsigned int prev_body_id = 0;
-  Vector3d prev_body_point = Vector3d::Zero();
-  Vector3d gamma_i = Vector3d::Zero();
+  for (unsigned int g = 0; g + 1 < CS.mContactGroupOffsets.size(); g++) {
+    const unsigned int c0 =
+      CS.mContactGroupConstraintIndices[CS.mContactGroupOffsets[g]];
 
-  CS.QDDot_0.setZero();
-  UpdateKinematicsCustom(model, NULL, NULL, &CS.QDDot_0);
+    CS.Gi.setZero();
+    CalcPointJacobian (model, Q, CS.body[c0], CS.point[c0], CS.Gi, false);
+    point_vel = CalcPointVelocity (model, Q, QDot, CS.body[c0], CS.point[c0]
+        , false);
+    point_acc = CalcPointAcceleration (model, Q, QDot, CS.QDDot_0
+        , CS.body[c0], CS.point[c0], false);
 
-  for (unsigned int i = 0; i < CS.mContactConstraintIndices.size(); i++) {
-    const unsigned int c = CS.mContactConstraintIndices[i];
+    for (unsigned int k = CS.mContactGroupOffsets[g];
+        k < CS.mContactGroupOffsets[g + 1]; k++) {
+      const unsigned int c = CS.mContactGroupConstraintIndices[k];
 
-    // only compute point accelerations when necessary
-    if (prev_body_id != CS.body[c] || prev_body_point != CS.point[c]) {
-      gamma_i = CalcPointAcceleration (model, Q, QDot, CS.QDDot_0, CS.body[c]
-          , CS.point[c], false);
-      prev_body_id = CS.body[c];
-      prev_body_point = CS.point[c];
-    }
+      for(unsigned int j = 0; j < model.dof_count; j++) {
+        Vector3d gaxis (CS.Gi(0,j), CS.Gi(1,j), CS.Gi(2,j));
+        G(c,j) = gaxis.transpose() * CS.normal[c];
+      }
+
+      err[c] = 0.;
+      errd[c] = CS.normal[c].dot(point_vel);
 
-    // we also substract ContactData[c].acceleration such that the contact
-    // point will have the desired acceleration
-    CS.gamma[c] = CS.acceleration[c] - CS.normal[c].dot(gamma_i);
+      // we also substract ContactData[c].acceleration such that the contact
+      // point will have the desired acceleration
+      gamma[c] = CS.acceleration[c] - CS.normal[c].dot(point_acc);
+    }
   }
 
+  // Loop constraints: the kinematics of the two frames are shared by all
+  // constraints between the same frames.
+  CustomConstraintFrameKinematics &frames = CS.custom_frames;
 
+  for (unsigned int g = 0; g + 1 < CS.mLoopGroupOffsets.size(); g++) {
+    const unsigned int c0 =
+      CS.mLoopGroupConstraintIndices[CS.mLoopGroupOffsets[g]];
 
-  for (unsigned int i = 0; i < CS.mLoopConstraintIndices.size(); i++) {
-    const unsigned int c = CS.mLoopConstraintIndices[i];
+    CalcConstraintFrameKinematics (model, Q, QDot, CS, c0, frames);
+    CS.GSJ = frames.G_s - frames.G_p;
 
-    // Variables used for computations.
-    Vector3d pos_p;
-    Matrix3d rot_p;
-    SpatialVector vel_p;
-    SpatialVector vel_s;
-    SpatialVector axis;
-    // unsigned int id_p;
-    // unsigned int id_s;
-
-
-    // Express the constraint axis in the base frame.
-    pos_p = CalcBodyToBaseCoordinates (model, Q, CS.body_p[c],
-                                      CS.X_p[c].r,false);
-    rot_p = CalcBodyWorldOrientation (model, Q, CS.body_p[c], false
-                                        ).transpose() * CS.X_p[c].E;
-    axis = SpatialTransform (rot_p, pos_p).apply(CS.constraintAxis[c]);
-
-    // Compute the spatial velocities of the two constrained bodies.
-    vel_p = CalcPointVelocity6D (model, Q, QDot, CS.body_p[c],
-                                  CS.X_p[c].r, false);
-    vel_s = CalcPointVelocity6D (model, Q, QDot, CS.body_s[c],
-                                  CS.X_s[c].r, false);
-
-    // Compute the derivative of the axis wrt the base frame.
-    SpatialVector axis_dot = crossm(vel_p, axis);
-
-    // Compute the velocity product accelerations. These correspond to the
-    // accelerations that the bodies would have if q ddot were 0.
-    SpatialVector acc_p = CalcPointAcceleration6D (model, Q, QDot
-      , VectorNd::Zero(model.dof_count), CS.body_p[c], CS.X_p[c].r, false);
-    SpatialVector acc_s = CalcPointAcceleration6D (model, Q, QDot
-      , VectorNd::Zero(model.dof_count), CS.body_s[c], CS.X_s[c].r, false);
-
-    // Problem here if one of the bodies is fixed...
-    // Compute the value of gamma.
-    CS.gamma[c]
-      // Right hand side term.
-      = - axis.dot(acc_s - acc_p) - axis_dot.dot(vel_s - vel_p)
-      // Baumgarte stabilization term.
-      - 2. * CS.baumgarteParameters[c][0] * CS.errd[c]
-      - CS.baumgarteParameters[c][1] * CS.baumgarteParameters[c][1] * CS.err[c];
-  }
-
-  unsigned int ccid,rows,cols,z;
+    SpatialTransform X_0p (frames.E_p, frames.r_p);
+
+    // Compute the position error, see CalcConstraintsPositionError().
+    Matrix3d rot_ps = frames.E_p.transpose() * frames.E_s;
+    SpatialVector d;
+    d[0] = -0.5 * (rot_ps(1,2) - rot_ps(2,1));
+    d[1] = -0.5 * (rot_ps(2,0) - rot_ps(0,2));
+    d[2] = -0.5 * (rot_ps(0,1) - rot_ps(1,0));
+    d.block<3,1>(3,0) = frames.E_p.transpose() * (frames.r_s - frames.r_p);
+
+    for (unsigned int k = CS.mLoopGroupOffsets[g];
+        k < CS.mLoopGroupOffsets[g + 1]; k++) {
+      const unsigned int c = CS.mLoopGroupConstraintIndices[k];
+
+      // Express the constraint axis in the base frame.
+      SpatialVector axis = X_0p.apply(CS.constraintAxis[c]);
+
+      // Compute the constraint Jacobian row.
+      G.block(c, 0, 1, model.dof_count) = axis.transpose() * CS.GSJ;
+
+      err[c] = CS.constraintAxis[c].transpose() * d;
+
+      // The velocity error equals the Jacobian row times QDot.
+      errd[c] = axis.dot(frames.v_s - frames.v_p);
+
+      // Compute the derivative of the axis wrt the base frame.
+      SpatialVector axis_dot = crossm(frames.v_p, axis);
+
+      // Compute the value of gamma.
+      gamma[c]
+        // Right hand side term.
+        = - axis.dot(frames.a_s - frames.a_p)
+        - axis_dot.dot(frames.v_s - frames.v_p)
+        // Baumgarte stabilization term.
+        - 2. * CS.baumgarteParameters[c][0] * errd[c]
+        - CS.baumgarteParameters[c][1] * CS.baumgarteParameters[c][1] * err[c];
+    }
+  }
+
+  // Custom constraints. The frame kinematics are only computed for the
+  // constraints that request them.
+  bool frames_valid = false;
+  unsigned int prev_frames_id = 0;
+
+  unsigned int ccid,z;
   for(unsigned int i=0; i< CS.mCustomConstraintIndices.size(); i++){
     ccid  = CS.mCustomConstraintIndices[i];
-    rows  = CS.mCustomConstraints[i]->mConstraintCount;
-    cols  = CS.G.cols();
-    CS.mCustomConstraints[i]->CalcGamma(model,ccid,Q,QDot,CS,
-                                        CS.G.block(ccid,0,rows,cols),
-                                        CS.gamma,ccid);
+
+    if (CS.mCustomConstraints[i]->mUsesFrameKinematics
+        && (!frames_valid
+          || !LoopConstraintsShareFrames (CS, prev_frames_id, ccid))) {
+      CalcConstraintFrameKinematics (model, Q, QDot, CS, ccid, frames);
+      frames_valid = true;
+      prev_frames_id = ccid;
+    }
+
+    CS.mCustomConstraints[i]->CalcConstraintTerms(model,ccid,Q,QDot,CS,
+                                                  frames, G, gamma,
+                                                  err, errd, ccid);
     for(unsigned int j=0; j<CS.mCustomConstraints[i]->mConstraintCount;j++){
       z = ccid+j;
-      CS.gamma[z] += (- 2. * CS.baumgarteParameters[z][0] * CS.errd[z]
-                      - CS.baumgarteParameters[z][1]
-                      * CS.baumgarteParameters[z][1] * CS.err[z]);
+      gamma[z] += (- 2. * CS.baumgarteParameters[z][0] * errd[z]
+                   - CS.baumgarteParameters[z][1]
+                   * CS.baumgarteParameters[z][1] * err[z]);
     }
-
   }
+}
 
+RBDL_DLLAPI
+void CalcConstrainedSystemVariables (
+  Model &model,
+  const Math::VectorNd &Q,
+  const Math::VectorNd &QDot,
+  const Math::VectorNd &UNUSED(Tau),
+  ConstraintSet &CS,
+  std::vector<Math::SpatialVector> *f_ext
+  ) {
+  assert(CS.H.cols() == model.dof_count && CS.H.rows() == model.dof_count);
+
+  // Compute H and C (this also updates model.X_base)
+  CS.H.setZero();
+  CalcJointSpaceInertiaAndNonlinearEffects (model, Q, QDot, CS.H, CS.C, NULL,
+      f_ext);
+
+  // The velocity product accelerations are needed for gamma.
+  CS.QDDot_0.setZero();
+  UpdateKinematicsCustom(model, NULL, NULL, &CS.QDDot_0);
+
+  // Compute G, the position and velocity errors for the Baumgarte
+  // stabilization and gamma.
+  CalcConstraintsTerms (model, Q, QDot, CS, CS.G, CS.err, CS.errd, CS.gamma,
+                        false);
+}
+
+/** Adds a step d (of the size of qdot) to the generalized positions Q. */
+static void AddGeneralizedPositionStep (
+  Model &model,
+  const VectorNd &d,
+  VectorNd &Q
+  ) {
+  for (size_t i = 0; i < model.mJoints.size(); ++i) {
+    // If the joint is spherical, translate the corresponding components
+    // of d into a modification in the joint quaternion.
+    if (model.mJoints[i].mJointType == JointTypeSpherical) {
+      Quaternion quat = model.GetQuaternion(i, Q);
+      Vector3d omega = d.block<3,1>(model.mJoints[i].q_index,0);
+      // Convert the 3d representation of the displacement to 4d and sum it
+      // to the components of the quaternion.
+      quat += quat.omegaToQDot(omega);
+      // The quaternion needs to be normalized after the previous sum.
+      quat /= quat.norm();
+      model.SetQuaternion(i, quat, Q);
+    }
+    // If the current joint is not spherical, simply add the corresponding
+    // components of d to Q.
+    else {
+      unsigned int qIdx = model.mJoints[i].q_index;
+      for(size_t j = 0; j < model.mJoints[i].mDoFCount; ++j) {
+        Q[qIdx + j] += d[qIdx + j];
+      }
+    }
+  }
 }
 
 RBDL_DLLAPI
@@ -863,30 +1058,7 @@ bool CalcAssemblyQ (
     d = x.block (0, 0, model.dof_count, 1);
 
     // Update solution.
-    for (size_t i = 0; i < model.mJoints.size(); ++i) {
-      // If the joint is spherical, translate the corresponding components
-      // of d into a modification in the joint quaternion.
-      if (model.mJoints[i].mJointType == JointTypeSpherical) {
-        Quaternion quat = model.GetQuaternion(i, QInit);
-        Vector3d omega = d.block<3,1>(model.mJoints[i].q_index,0);
-        // Convert the 3d representation of the displacement to 4d and sum it
-        // to the components of the quaternion.
-        quat += quat.omegaToQDot(omega);
-        // The quaternion needs to be normalized after the previous sum.
-        quat /= quat.norm();
-        model.SetQuaternion(i, quat, QInit);
-      }
-      // If the current joint is not spherical, simply add the corresponding
-      // components of d to QInit.
-      else {
-        unsigned int qIdx = model.mJoints[i].q_index;
-        for(size_t j = 0; j < model.mJoints[i].mDoFCount; ++j) {
-          QInit[qIdx + j] += d[qIdx + j];
-        }
-        // QInit.block(qIdx, 0, model.mJoints[i].mDoFCount, 1)
-        //   += d.block(model.mJoints[i].q_index, 0, model.mJoints[i].mDoFCount, 1);
-      }
-    }
+    AddGeneralizedPositionStep (model, d, QInit);
 
     // Update the errors.
     CalcConstraintsPositionError (model, QInit, cs, e);
@@ -957,6 +1129,449 @@ void CalcAssemblyQDot (
   QDot = x.block (0, 0, model.dof_count, 1);
 }
 
+/** Computes the correction of minimal norm d = - Y R^{-T} b with G d = -b
+ * from the QR decomposition G^T = Y R stored in CS.GT_qr and CS.Y. */
+static void SolveMinimalNormCorrection (
+  ConstraintSet &CS,
+  const VectorNd &b,
+  VectorNd &y,
+  VectorNd &d
+  ) {
+#ifdef RBDL_USE_SIMPLE_MATH
+  MatrixNd R = CS.GT_qr.matrixR();
+#else
+  const MatrixNd &R = CS.GT_qr.matrixQR();
+#endif
+
+  // forward substitution R^T y = b
+  for (unsigned int i = 0; i < b.size(); i++) {
+    double z = b[i];
+    for (unsigned int j = 0; j < i; j++) {
+      z -= R(j,i) * y[j];
+    }
+    y[i] = z / R(i,i);
+  }
+
+  d = - CS.Y * y;
+}
+
+RBDL_DLLAPI
+bool ProjectOntoConstraints (
+  Model &model,
+  Math::VectorNd &Q,
+  Math::VectorNd &QDot,
+  ConstraintSet &CS,
+  double tolerance,
+  unsigned int max_iter,
+  bool update_factorization
+  ) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (CS.bound);
+
+  if (update_factorization) {
+    CS.G.setZero();
+    CalcConstraintsJacobian (model, Q, CS, CS.G);
+    CS.GT_qr.compute (CS.G.transpose());
+    CS.GT_qr_Q = CS.GT_qr.householderQ();
+    CS.Y = CS.GT_qr_Q.block (0, 0, QDot.rows(), CS.G.rows());
+  } else {
+    // The decomposition of the last null space solve has to be of the size
+    // of the model and constraint set. Bind() initializes Y with zeros
+    // whereas the columns of a computed Y are orthonormal.
+    assert (CS.Y.rows() == model.dof_count);
+    assert (CS.Y.cols() == CS.size());
+#ifndef RBDL_USE_SIMPLE_MATH
+    assert (CS.GT_qr.matrixQR().rows() == model.dof_count);
+    assert (CS.GT_qr.matrixQR().cols() == CS.size());
+#endif
+    assert (CS.size() == 0 || CS.Y.col(0).squaredNorm() > 0.5);
+  }
+
+  VectorNd y (CS.size());
+  VectorNd d (model.dof_count);
+
+  bool converged = false;
+  for (unsigned int it = 0; it < max_iter; it++) {
+    CalcConstraintsPositionError (model, Q, CS, CS.err);
+    if (CS.err.norm() < tolerance) {
+      converged = true;
+      break;
+    }
+
+    SolveMinimalNormCorrection (CS, CS.err, y, d);
+    AddGeneralizedPositionStep (model, d, Q);
+  }
+
+  if (!converged) {
+    CalcConstraintsPositionError (model, Q, CS, CS.err);
+    converged = CS.err.norm() < tolerance;
+  }
+
+  bool velocity_converged = false;
+  for (unsigned int it = 0; it < max_iter; it++) {
+    CalcConstraintsVelocityError (model, Q, QDot, CS, CS.errd, false);
+    if (CS.errd.norm() < tolerance) {
+      velocity_converged = true;
+      break;
+    }
+
+    SolveMinimalNormCorrection (CS, CS.errd, y, d);
+    QDot += d;
+  }
+
+  if (!velocity_converged) {
+    CalcConstraintsVelocityError (model, Q, QDot, CS, CS.errd, false);
+    velocity_converged = CS.errd.norm() < tolerance;
+  }
+
+  return converged && velocity_converged;
+}
+
+/** Selects linearly independent columns of G by Gauss elimination with
+ * full pivoting over the eligible columns. Returns false if G does not
+ * have full row rank. */
+static bool SelectPivotColumns (
+  const MatrixNd &G,
+  std::vector<bool> eligible,
+  std::vector<unsigned int> &pivot_columns
+  ) {
+  MatrixNd A (G);
+  std::vector<bool> row_used (G.rows(), false);
+
+  double scale = 0.;
+  for (unsigned int r = 0; r < G.rows(); r++) {
+    for (unsigned int c = 0; c < G.cols(); c++) {
+      scale = std::max (scale, fabs (G(r,c)));
+    }
+  }
+
+  pivot_columns.clear();
+  for (unsigned int k = 0; k < G.rows(); k++) {
+    double pivot = 0.;
+    unsigned int pivot_row = 0;
+    unsigned int pivot_col = 0;
+
+    for (unsigned int r = 0; r < A.rows(); r++) {
+      if (row_used[r]) {
+        continue;
+      }
+      for (unsigned int c = 0; c < A.cols(); c++) {
+        if (eligible[c] && fabs (A(r,c)) > pivot) {
+          pivot = fabs (A(r,c));
+          pivot_row = r;
+          pivot_col = c;
+        }
+      }
+    }
+
+    if (pivot == 0. || pivot < 1.0e-12 * scale) {
+      return false;
+    }
+
+    row_used[pivot_row] = true;
+    eligible[pivot_col] = false;
+    pivot_columns.push_back (pivot_col);
+
+    for (unsigned int r = 0; r < A.rows(); r++) {
+      if (!row_used[r]) {
+        double factor = A(r, pivot_col) / A(pivot_row, pivot_col);
+        A.row(r) -= factor * A.row(pivot_row);
+      }
+    }
+  }
+
+  return true;
+}
+
+bool CoordinatePartitioning::Bind (
+  Model &model,
+  const VectorNd &Q,
+  ConstraintSet &CS
+  ) {
+  assert (CS.bound);
+
+  MatrixNd G (MatrixNd::Zero (CS.size(), model.dof_count));
+  CalcConstraintsJacobian (model, Q, CS, G);
+
+  // Coordinates of spherical joints cannot be updated by simply adding
+  // the Newton steps and are therefore always independent.
+  std::vector<bool> eligible (model.dof_count, true);
+  for (unsigned int i = 1; i < model.mJoints.size(); i++) {
+    if (model.mJoints[i].mJointType == JointTypeSpherical) {
+      for (unsigned int j = 0; j < 3; j++) {
+        eligible[model.mJoints[i].q_index + j] = false;
+      }
+    }
+  }
+
+  std::vector<unsigned int> pivot_columns;
+  if (!SelectPivotColumns (G, eligible, pivot_columns)) {
+    bound = false;
+    return false;
+  }
+
+  std::vector<bool> is_dependent (model.dof_count, false);
+  for (unsigned int k = 0; k < pivot_columns.size(); k++) {
+    is_dependent[pivot_columns[k]] = true;
+  }
+
+  std::vector<unsigned int> independent_dofs;
+  for (unsigned int i = 0; i < model.dof_count; i++) {
+    if (!is_dependent[i]) {
+      independent_dofs.push_back (i);
+    }
+  }
+
+  return Bind (model, Q, CS, independent_dofs);
+}
+
+bool CoordinatePartitioning::Bind (
+  Model &model,
+  const VectorNd &Q,
+  ConstraintSet &CS,
+  const std::vector<unsigned int> &independent_dofs
+  ) {
+  assert (CS.bound);
+
+  std::vector<bool> is_independent (model.dof_count, false);
+  for (unsigned int i = 0; i < independent_dofs.size(); i++) {
+    is_independent[independent_dofs[i]] = true;
+  }
+
+  independent.clear();
+  dependent.clear();
+  for (unsigned int i = 0; i < model.dof_count; i++) {
+    if (is_independent[i]) {
+      independent.push_back (i);
+    } else {
+      dependent.push_back (i);
+    }
+  }
+
+  if (dependent.size() != CS.size()) {
+    std::cerr << "Error: the number of dependent coordinates ("
+      << dependent.size() << ") does not match the number of constraints ("
+      << CS.size() << ")!" << std::endl;
+    assert (0);
+    abort();
+  }
+
+  for (unsigned int i = 1; i < model.mJoints.size(); i++) {
+    if (model.mJoints[i].mJointType == JointTypeSpherical) {
+      for (unsigned int j = 0; j < 3; j++) {
+        if (!is_independent[model.mJoints[i].q_index + j]) {
+          std::cerr << "Error: coordinates of spherical joints must be "
+            << "independent coordinates!" << std::endl;
+          assert (0);
+          abort();
+        }
+      }
+    }
+  }
+
+  unsigned int m = dependent.size();
+  unsigned int ni = independent.size();
+
+  mG = MatrixNd::Zero (m, model.dof_count);
+  mGd = MatrixNd::Zero (m, m);
+  mGdInvGi = MatrixNd::Zero (m, ni);
+  mT = MatrixNd::Zero (model.dof_count, ni);
+  mHT = MatrixNd::Zero (model.dof_count, ni);
+  mHi = MatrixNd::Zero (ni, ni);
+  mErr = VectorNd::Zero (m);
+  mDelta = VectorNd::Zero (m);
+  mQDDot0 = VectorNd::Zero (model.dof_count);
+  mQDDotIndependent = VectorNd::Zero (ni);
+  mTauIndependent = VectorNd::Zero (ni);
+  mResidual = VectorNd::Zero (model.dof_count);
+
+  UpdateFactorization (model, Q, CS);
+
+  std::vector<unsigned int> pivot_columns;
+  bound = SelectPivotColumns (mGd, std::vector<bool> (m, true),
+      pivot_columns);
+
+  return bound;
+}
+
+void CoordinatePartitioning::UpdateFactorization (
+  Model &model,
+  const VectorNd &Q,
+  ConstraintSet &CS,
+  bool update_kinematics
+  ) {
+  mG.setZero();
+  CalcConstraintsJacobian (model, Q, CS, mG, update_kinematics);
+
+  for (unsigned int k = 0; k < dependent.size(); k++) {
+    mGd.col(k) = mG.col(dependent[k]);
+  }
+  mGd_lu.compute (mGd);
+}
+
+RBDL_DLLAPI
+bool CalcDependentQ (
+  Model &model,
+  Math::VectorNd &Q,
+  ConstraintSet &CS,
+  CoordinatePartitioning &partitioning,
+  double tolerance,
+  unsigned int max_iter
+  ) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (partitioning.bound);
+
+  double err_norm_prev = std::numeric_limits<double>::max();
+
+  for (unsigned int it = 0; it <= max_iter; it++) {
+    CalcConstraintsPositionError (model, Q, CS, partitioning.mErr);
+
+    double err_norm = partitioning.mErr.norm();
+    if (err_norm < tolerance) {
+      return true;
+    }
+
+    if (it == max_iter) {
+      break;
+    }
+
+    // The cached factorization is only updated if it does not reduce the
+    // error sufficiently.
+    if (err_norm > 0.5 * err_norm_prev) {
+      partitioning.UpdateFactorization (model, Q, CS, false);
+    }
+    err_norm_prev = err_norm;
+
+    partitioning.mDelta = partitioning.mGd_lu.solve (partitioning.mErr);
+    for (unsigned int k = 0; k < partitioning.dependent.size(); k++) {
+      Q[partitioning.dependent[k]] -= partitioning.mDelta[k];
+    }
+  }
+
+  return false;
+}
+
+RBDL_DLLAPI
+void CalcDependentQDot (
+  Model &model,
+  const Math::VectorNd &Q,
+  Math::VectorNd &QDot,
+  ConstraintSet &CS,
+  CoordinatePartitioning &partitioning
+  ) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (partitioning.bound);
+
+  partitioning.UpdateFactorization (model, Q, CS);
+
+  // G_d qdot_d = - G_i qdot_i
+  partitioning.mErr.setZero();
+  for (unsigned int j = 0; j < partitioning.independent.size(); j++) {
+    unsigned int i = partitioning.independent[j];
+    partitioning.mErr -= partitioning.mG.col(i) * QDot[i];
+  }
+
+  partitioning.mDelta = partitioning.mGd_lu.solve (partitioning.mErr);
+  for (unsigned int k = 0; k < partitioning.dependent.size(); k++) {
+    QDot[partitioning.dependent[k]] = partitioning.mDelta[k];
+  }
+}
+
+RBDL_DLLAPI
+void ForwardDynamicsConstraintsPartitioned (
+  Model &model,
+  const VectorNd &Q,
+  const VectorNd &QDot,
+  const VectorNd &Tau,
+  ConstraintSet &CS,
+  CoordinatePartitioning &partitioning,
+  VectorNd &QDDot,
+  std::vector<Math::SpatialVector> *f_ext
+  ) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (partitioning.bound);
+
+  CalcConstrainedSystemVariables (model, Q, QDot, Tau, CS, f_ext);
+
+  const std::vector<unsigned int> &independent = partitioning.independent;
+  const std::vector<unsigned int> &dependent = partitioning.dependent;
+
+  // update the cached factorization with the Jacobian at Q
+  partitioning.mG = CS.G;
+  for (unsigned int k = 0; k < dependent.size(); k++) {
+    partitioning.mGd.col(k) = CS.G.col(dependent[k]);
+  }
+  partitioning.mGd_lu.compute (partitioning.mGd);
+
+  for (unsigned int j = 0; j < independent.size(); j++) {
+    partitioning.mErr = CS.G.col(independent[j]);
+    partitioning.mGdInvGi.col(j) = partitioning.mGd_lu.solve (partitioning.mErr);
+  }
+
+  // qdot = T qdot_i and qddot = T qddot_i + qddot_0
+  for (unsigned int j = 0; j < independent.size(); j++) {
+    partitioning.mT(independent[j], j) = 1.;
+    for (unsigned int k = 0; k < dependent.size(); k++) {
+      partitioning.mT(dependent[k], j) = -partitioning.mGdInvGi(k, j);
+    }
+  }
+
+  partitioning.mDelta = partitioning.mGd_lu.solve (CS.gamma);
+  partitioning.mQDDot0.setZero();
+  for (unsigned int k = 0; k < dependent.size(); k++) {
+    partitioning.mQDDot0[dependent[k]] = partitioning.mDelta[k];
+  }
+
+  // T^T H T qddot_i = T^T (tau - C - H qddot_0)
+  partitioning.mResidual = Tau - CS.C;
+#ifdef EIGEN_CORE_H
+  partitioning.mHT.noalias() = CS.H * partitioning.mT;
+  partitioning.mHi.noalias() = partitioning.mT.transpose() * partitioning.mHT;
+  partitioning.mResidual.noalias() -= CS.H * partitioning.mQDDot0;
+  partitioning.mTauIndependent.noalias() =
+    partitioning.mT.transpose() * partitioning.mResidual;
+#else
+  partitioning.mHT = CS.H * partitioning.mT;
+  partitioning.mHi = partitioning.mT.transpose() * partitioning.mHT;
+  partitioning.mResidual -= CS.H * partitioning.mQDDot0;
+  partitioning.mTauIndependent =
+    partitioning.mT.transpose() * partitioning.mResidual;
+#endif
+  partitioning.mHi_llt.compute (partitioning.mHi);
+  partitioning.mQDDotIndependent = partitioning.mHi_llt.solve (
+      partitioning.mTauIndependent);
+
+  QDDot = partitioning.mQDDot0;
+#ifdef EIGEN_CORE_H
+  QDDot.noalias() += partitioning.mT * partitioning.mQDDotIndependent;
+#else
+  QDDot += partitioning.mT * partitioning.mQDDotIndependent;
+#endif
+
+  // The constraint forces follow from the rows of the dependent
+  // coordinates of G^T force = H qddot + C - tau, i.e. G_d^T force = r_d
+  // which reuses the factorization of G_d.
+  partitioning.mResidual = CS.C - Tau;
+#ifdef EIGEN_CORE_H
+  partitioning.mResidual.noalias() += CS.H * QDDot;
+#else
+  partitioning.mResidual += CS.H * QDDot;
+#endif
+  for (unsigned int k = 0; k < dependent.size(); k++) {
+    partitioning.mErr[k] = partitioning.mResidual[dependent[k]];
+  }
+#ifdef RBDL_USE_SIMPLE_MATH
+  CS.force = partitioning.mGd.transpose().partialPivLu().solve (
+      partitioning.mErr);
+#else
+  CS.force = partitioning.mGd_lu.transpose().solve (partitioning.mErr);
+#endif
+}
+
 RBDL_DLLAPI
 void ForwardDynamicsConstraintsDirect (
   Model &model,
@@ -1496,7 +2111,7 @@ void ForwardDynamicsContactsKokkevis (
 
       case ConstraintSet::ContactConstraint:
 
-        movable_body_id = GetMovableBodyId(model, CS.body[ci]);
+        movable_body_id = model.GetMovableBodyId (CS.body[ci]);
 
         // assemble the test force
         LOG << "normal = " << CS.normal[ci].transpose() << std::endl;
@@ -1534,20 +2149,25 @@ void ForwardDynamicsContactsKokkevis (
           UpdateKinematicsCustom(model, NULL, NULL, &CS.QDDot_t);
         }
 
-        for(unsigned int cj = 0; cj < CS.size(); cj++) {
+        // the point acceleration is shared by all constraints on a point
+        for (unsigned int g = 0; g + 1 < CS.mContactGroupOffsets.size(); g++) {
+          const unsigned int c0 =
+            CS.mContactGroupConstraintIndices[CS.mContactGroupOffsets[g]];
           {
             SUPPRESS_LOGGING;
 
             point_accel_t = CalcPointAcceleration(model, Q, QDot, CS.QDDot_t
-              , CS.body[cj], CS.point[cj], false);
+              , CS.body[c0], CS.point[c0], false);
           }
 
-          LOG << "point_accel_0  = " << CS.point_accel_0[ci].transpose()
-            << std::endl;
           LOG << "point_accel_t = " << point_accel_t.transpose() << std::endl;
 
-          CS.K(ci,cj) = CS.normal[cj].dot(point_accel_t - CS.point_accel_0[cj]);
-
+          for (unsigned int k = CS.mContactGroupOffsets[g];
+              k < CS.mContactGroupOffsets[g + 1]; k++) {
+            const unsigned int cj = CS.mContactGroupConstraintIndices[k];
+            CS.K(ci,cj) = CS.normal[cj].dot(point_accel_t
+                - CS.point_accel_0[cj]);
+          }
         }
 
       break;
@@ -1607,6 +2227,30 @@ void ForwardDynamicsContactsKokkevis (
   LOG << "QDDot after applying f_ext: " << QDDot.transpose() << std::endl;
 }
 
+void CustomConstraint::CalcConstraintTerms (
+  Model &model,
+  unsigned int custom_constraint_id,
+  const Math::VectorNd &Q,
+  const Math::VectorNd &QDot,
+  ConstraintSet &CS,
+  const CustomConstraintFrameKinematics &UNUSED(frames),
+  Math::MatrixNd &G,
+  Math::VectorNd &gamma,
+  Math::VectorNd &errPos,
+  Math::VectorNd &errVel,
+  unsigned int startIdx
+  ) {
+  CalcConstraintsJacobianAndConstraintAxis (model, custom_constraint_id, Q,
+                                            CS, G, startIdx, 0);
+  CalcPositionError (model, custom_constraint_id, Q, CS, errPos, startIdx);
+  CalcVelocityError (model, custom_constraint_id, Q, QDot, CS,
+                     G.block(startIdx, 0, mConstraintCount, G.cols()),
+                     errVel, startIdx);
+  CalcGamma (model, custom_constraint_id, Q, QDot, CS,
+             G.block(startIdx, 0, mConstraintCount, G.cols()),
+             gamma, startIdx);
+}
+
 void SolveLinearSystem (
   const MatrixNd& A,
   const VectorNd& b,
@@ -1638,14 +2282,4 @@ void SolveLinearSystem (
   }
 }
 
-unsigned int GetMovableBodyId (Model& model, unsigned int id) {
-  if(model.IsFixedBodyId(id)) {
-    unsigned int fbody_id = id - model.fixed_body_discriminator;
-    return model.mFixedBodies[fbody_id].mMovableParent;
-  }
-  else {
-    return id;
-  }
-}
-
 } /* namespace RigidBodyDynamics */
@@ -164,6 +164,280 @@ RBDL_DLLAPI void NonlinearEffects (
   }
 }
 
+/** \brief Computes the 6 x 10 matrix that maps the inertial parameters of
+ * a body to the spatial force I a + v x* I v that is required to move the
+ * body with spatial velocity v and acceleration a.
+ */
+static void CalcBodyRegressor (
+    const SpatialVector &v,
+    const SpatialVector &a,
+    MatrixNd &F) {
+  Vector3d w (v[0], v[1], v[2]);
+  Vector3d v_lin (v[3], v[4], v[5]);
+  Vector3d a_ang (a[0], a[1], a[2]);
+  Vector3d a_lin (a[3], a[4], a[5]);
+
+  for (unsigned int k = 0; k < 10; k++) {
+    SpatialRigidBodyInertia I_unit;
+    switch (k) {
+      case 0: I_unit.m = 1.; break;
+      case 1: I_unit.h[0] = 1.; break;
+      case 2: I_unit.h[1] = 1.; break;
+      case 3: I_unit.h[2] = 1.; break;
+      case 4: I_unit.Ixx = 1.; break;
+      case 5: I_unit.Iyx = 1.; break;
+      case 6: I_unit.Iyy = 1.; break;
+      case 7: I_unit.Izx = 1.; break;
+      case 8: I_unit.Izy = 1.; break;
+      case 9: I_unit.Izz = 1.; break;
+    }
+
+    F.block<6,1>(0, k) = I_unit * a + crossf (v, I_unit * v);
+  }
+}
+
+RBDL_DLLAPI void CalcInertialParameterRegressor (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    const VectorNd &QDDot,
+    MatrixNd &Y,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (Y.rows() == model.qdot_size
+      && Y.cols() == 10 * (model.mBodies.size() - 1));
+
+  if (update_kinematics) {
+    UpdateKinematics (model, Q, QDot, QDDot);
+  }
+
+  SpatialVector spatial_gravity (0., 0., 0., -model.gravity[0], -model.gravity[1], -model.gravity[2]);
+
+  Y.setZero();
+
+  MatrixNd F (MatrixNd::Zero (6, 10));
+  MatrixNd F_lambda (MatrixNd::Zero (6, 10));
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    if (model.mBodies[i].mIsVirtual) {
+      continue;
+    }
+
+    // The kinematics do not contain the gravitational acceleration, which
+    // is therefore added here.
+    CalcBodyRegressor (model.v[i],
+        model.a[i] + model.X_base[i].apply (spatial_gravity), F);
+
+    // The force of body i acts on all joints that support body i.
+    unsigned int col = 10 * (i - 1);
+    unsigned int j = i;
+    while (j != 0) {
+      unsigned int q_index = model.mJoints[j].q_index;
+
+      if (model.mJoints[j].mDoFCount == 1
+          && model.mJoints[j].mJointType != JointTypeCustom) {
+        Y.block(q_index, col, 1, 10) = model.S[j].transpose() * F;
+      } else if (model.mJoints[j].mDoFCount == 3
+          && model.mJoints[j].mJointType != JointTypeCustom) {
+        Y.block(q_index, col, 3, 10) = model.multdof3_S[j].transpose() * F;
+      } else if (model.mJoints[j].mJointType == JointTypeCustom) {
+        unsigned int k = model.mJoints[j].custom_joint_index;
+        Y.block(q_index, col, model.mCustomJoints[k]->mDoFCount, 10)
+          = model.mCustomJoints[k]->S.transpose() * F;
+      }
+
+      if (model.lambda[j] != 0) {
+        F_lambda = model.X_lambda[j].toMatrixTranspose() * F;
+        F = F_lambda;
+      }
+      j = model.lambda[j];
+    }
+  }
+}
+
+RBDL_DLLAPI void CalcInertialParameterRegressor (
+    Model &model,
+    const std::vector<VectorNd> &Q,
+    const std::vector<VectorNd> &QDot,
+    const std::vector<VectorNd> &QDDot,
+    MatrixNd &Y) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  unsigned int sample_count = Q.size();
+  unsigned int param_count = 10 * (model.mBodies.size() - 1);
+
+  assert (QDot.size() == sample_count && QDDot.size() == sample_count);
+  assert (Y.rows() == sample_count * model.qdot_size && Y.cols() == param_count);
+
+  MatrixNd Y_sample (MatrixNd::Zero (model.qdot_size, param_count));
+
+  for (unsigned int s = 0; s < sample_count; s++) {
+    CalcInertialParameterRegressor (model, Q[s], QDot[s], QDDot[s], Y_sample);
+    Y.block(s * model.qdot_size, 0, model.qdot_size, param_count) = Y_sample;
+  }
+}
+
+RBDL_DLLAPI void GetInertialParameters (
+    const Model &model,
+    VectorNd &params) {
+  assert (params.size() == 10 * (model.mBodies.size() - 1));
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    const SpatialRigidBodyInertia &I = model.I[i];
+    unsigned int offset = 10 * (i - 1);
+
+    params[offset + 0] = I.m;
+    params[offset + 1] = I.h[0];
+    params[offset + 2] = I.h[1];
+    params[offset + 3] = I.h[2];
+    params[offset + 4] = I.Ixx;
+    params[offset + 5] = I.Iyx;
+    params[offset + 6] = I.Iyy;
+    params[offset + 7] = I.Izx;
+    params[offset + 8] = I.Izy;
+    params[offset + 9] = I.Izz;
+  }
+}
+
+/** \brief Adds the composite rigid body inertia of body i to its parent
+ * and computes the entries of the joint space inertia matrix that couple
+ * the degrees of freedom of joint i with those of its supporting joints.
+ */
+static void CompositeRigidBodyBackwardStep (
+    Model &model,
+    unsigned int i,
+    MatrixNd &H) {
+  if (model.lambda[i] != 0) {
+    model.Ic[model.lambda[i]] = model.Ic[model.lambda[i]] + model.X_lambda[i].applyTranspose(model.Ic[i]);
+  }
+
+  unsigned int dof_index_i = model.mJoints[i].q_index;
+
+  if (model.mJoints[i].mDoFCount == 1
+      && model.mJoints[i].mJointType != JointTypeCustom) {
+
+    SpatialVector F             = model.Ic[i] * model.S[i];
+    H(dof_index_i, dof_index_i) = model.S[i].dot(F);
+
+    unsigned int j = i;
+    unsigned int dof_index_j = dof_index_i;
+
+    while (model.lambda[j] != 0) {
+      F = model.X_lambda[j].applyTranspose(F);
+      j = model.lambda[j];
+      dof_index_j = model.mJoints[j].q_index;
+
+      if(model.mJoints[j].mJointType != JointTypeCustom) {
+        if (model.mJoints[j].mDoFCount == 1) {
+          H(dof_index_i,dof_index_j) = F.dot(model.S[j]);
+          H(dof_index_j,dof_index_i) = H(dof_index_i,dof_index_j);
+        } else if (model.mJoints[j].mDoFCount == 3) {
+          Vector3d H_temp2 =
+            (F.transpose() * model.multdof3_S[j]).transpose();
+          LOG << F.transpose() << std::endl
+            << model.multdof3_S[j] << std::endl;
+          LOG << H_temp2.transpose() << std::endl;
+
+          H.block<1,3>(dof_index_i,dof_index_j) = H_temp2.transpose();
+          H.block<3,1>(dof_index_j,dof_index_i) = H_temp2;
+        }
+      } else if (model.mJoints[j].mJointType == JointTypeCustom){
+        unsigned int k      = model.mJoints[j].custom_joint_index;
+        unsigned int dof    = model.mCustomJoints[k]->mDoFCount;
+        VectorNd H_temp2    =
+          (F.transpose() * model.mCustomJoints[k]->S).transpose();
+
+        LOG << F.transpose()
+          << std::endl
+          << model.mCustomJoints[j]->S << std::endl;
+
+        LOG << H_temp2.transpose() << std::endl;
+
+        H.block(dof_index_i,dof_index_j,1,dof) = H_temp2.transpose();
+        H.block(dof_index_j,dof_index_i,dof,1) = H_temp2;
+      }
+    }
+  } else if (model.mJoints[i].mDoFCount == 3
+      && model.mJoints[i].mJointType != JointTypeCustom) {
+    Matrix63 F_63 = model.Ic[i].toMatrix() * model.multdof3_S[i];
+    H.block<3,3>(dof_index_i, dof_index_i) = model.multdof3_S[i].transpose() * F_63;
+
+    unsigned int j = i;
+    unsigned int dof_index_j = dof_index_i;
+
+    while (model.lambda[j] != 0) {
+      F_63 = model.X_lambda[j].toMatrixTranspose() * (F_63);
+      j = model.lambda[j];
+      dof_index_j = model.mJoints[j].q_index;
+
+      if(model.mJoints[j].mJointType != JointTypeCustom){
+        if (model.mJoints[j].mDoFCount == 1) {
+          Vector3d H_temp2 = F_63.transpose() * (model.S[j]);
+
+          H.block<3,1>(dof_index_i,dof_index_j) = H_temp2;
+          H.block<1,3>(dof_index_j,dof_index_i) = H_temp2.transpose();
+        } else if (model.mJoints[j].mDoFCount == 3) {
+          Matrix3d H_temp2 = F_63.transpose() * (model.multdof3_S[j]);
+
+          H.block<3,3>(dof_index_i,dof_index_j) = H_temp2;
+          H.block<3,3>(dof_index_j,dof_index_i) = H_temp2.transpose();
+        }
+      } else if (model.mJoints[j].mJointType == JointTypeCustom){
+        unsigned int k = model.mJoints[j].custom_joint_index;
+        unsigned int dof = model.mCustomJoints[k]->mDoFCount;
+
+        MatrixNd H_temp2 = F_63.transpose() * (model.mCustomJoints[k]->S);
+
+        H.block(dof_index_i,dof_index_j,3,dof) = H_temp2;
+        H.block(dof_index_j,dof_index_i,dof,3) = H_temp2.transpose();
+      }
+    }
+  } else if (model.mJoints[i].mJointType == JointTypeCustom) {
+    unsigned int kI = model.mJoints[i].custom_joint_index;
+    unsigned int dofI = model.mCustomJoints[kI]->mDoFCount;
+
+    MatrixNd F_Nd = model.Ic[i].toMatrix()
+      * model.mCustomJoints[kI]->S;
+
+    H.block(dof_index_i, dof_index_i,dofI,dofI)
+      = model.mCustomJoints[kI]->S.transpose() * F_Nd;
+
+    unsigned int j = i;
+    unsigned int dof_index_j = dof_index_i;
+
+    while (model.lambda[j] != 0) {
+      F_Nd = model.X_lambda[j].toMatrixTranspose() * (F_Nd);
+      j = model.lambda[j];
+      dof_index_j = model.mJoints[j].q_index;
+
+      if(model.mJoints[j].mJointType != JointTypeCustom){
+        if (model.mJoints[j].mDoFCount == 1) {
+          MatrixNd H_temp2 = F_Nd.transpose() * (model.S[j]);
+          H.block(   dof_index_i,  dof_index_j,
+              H_temp2.rows(),H_temp2.cols()) = H_temp2;
+          H.block(dof_index_j,dof_index_i,
+              H_temp2.cols(),H_temp2.rows()) = H_temp2.transpose();
+        } else if (model.mJoints[j].mDoFCount == 3) {
+          MatrixNd H_temp2 = F_Nd.transpose() * (model.multdof3_S[j]);
+          H.block(dof_index_i,   dof_index_j,
+              H_temp2.rows(),H_temp2.cols()) = H_temp2;
+          H.block(dof_index_j,   dof_index_i,
+              H_temp2.cols(),H_temp2.rows()) = H_temp2.transpose();
+        }
+      } else if (model.mJoints[j].mJointType == JointTypeCustom){
+        unsigned int k   = model.mJoints[j].custom_joint_index;
+        unsigned int dof = model.mCustomJoints[k]->mDoFCount;
+
+        MatrixNd H_temp2 = F_Nd.transpose() * (model.mCustomJoints[k]->S);
+
+        H.block(dof_index_i,dof_index_j,3,dof) = H_temp2;
+        H.block(dof_index_j,dof_index_i,dof,3) = H_temp2.transpose();
+      }
+    }
+  }
+}
+
 RBDL_DLLAPI void CompositeRigidBodyAlgorithm (
     Model& model,
     const VectorNd &Q,
@@ -181,137 +455,550 @@ RBDL_DLLAPI void CompositeRigidBodyAlgorithm (
   }
 
   for (unsigned int i = model.mBodies.size() - 1; i > 0; i--) {
+    CompositeRigidBodyBackwardStep (model, i, H);
+  }
+}
+
+/** \brief Projects the spatial force f onto the motion subspace of joint i
+ * and stores the result in the entries of Tau that belong to joint i.
+ */
+static void ProjectOnJointMotionSubspace (
+    Model &model,
+    unsigned int i,
+    const SpatialVector &f,
+    VectorNd &Tau) {
+  if(model.mJoints[i].mJointType != JointTypeCustom){
+    if (model.mJoints[i].mDoFCount == 1) {
+      Tau[model.mJoints[i].q_index] = model.S[i].dot(f);
+    } else if (model.mJoints[i].mDoFCount == 3) {
+      Tau.block<3,1>(model.mJoints[i].q_index, 0)
+        = model.multdof3_S[i].transpose() * f;
+    }
+  } else if(model.mJoints[i].mJointType == JointTypeCustom) {
+    unsigned int k = model.mJoints[i].custom_joint_index;
+    Tau.block(model.mJoints[i].q_index,0,
+        model.mCustomJoints[k]->mDoFCount, 1)
+      = model.mCustomJoints[k]->S.transpose() * f;
+  }
+}
+
+RBDL_DLLAPI void CalcJointSpaceInertiaAndNonlinearEffects (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    MatrixNd &H,
+    VectorNd &C,
+    VectorNd *gravity_effects,
+    std::vector<SpatialVector> *f_ext) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (H.rows() == model.dof_count && H.cols() == model.dof_count);
+  assert (C.size() == model.dof_count);
+
+  SpatialVector spatial_gravity (0., 0., 0., -model.gravity[0], -model.gravity[1], -model.gravity[2]);
+
+  // Reset the velocity of the root body
+  model.v[0].setZero();
+  model.a[0] = spatial_gravity;
+
+  for (unsigned int i = 1; i < model.mJointUpdateOrder.size(); i++) {
+    jcalc (model, model.mJointUpdateOrder[i], Q, QDot);
+  }
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    unsigned int lambda = model.lambda[i];
+
+    if (lambda == 0) {
+      model.X_base[i] = model.X_lambda[i];
+    } else {
+      model.X_base[i] = model.X_lambda[i] * model.X_base[lambda];
+    }
+
+    model.v[i] = model.X_lambda[i].apply(model.v[lambda]) + model.v_J[i];
+    model.c[i] = model.c_J[i] + crossm(model.v[i],model.v_J[i]);
+    model.a[i] = model.X_lambda[i].apply(model.a[lambda]) + model.c[i];
+
+    if (!model.mBodies[i].mIsVirtual) {
+      model.f[i] = model.I[i] * model.a[i] + crossf(model.v[i],model.I[i] * model.v[i]);
+    } else {
+      model.f[i].setZero();
+    }
+
+    // As in InverseDynamics() the external forces act on all bodies,
+    // including the virtual bodies of emulated multi dof joints.
+    if (f_ext != NULL && (*f_ext)[i] != SpatialVector::Zero()) {
+      model.f[i] -= model.X_base[i].toMatrixAdjoint() * (*f_ext)[i];
+    }
+
+    model.Ic[i] = model.I[i];
+  }
+
+  for (unsigned int i = model.mBodies.size() - 1; i > 0; i--) {
+    ProjectOnJointMotionSubspace (model, i, model.f[i], C);
+
     if (model.lambda[i] != 0) {
-      model.Ic[model.lambda[i]] = model.Ic[model.lambda[i]] + model.X_lambda[i].applyTranspose(model.Ic[i]);
+      model.f[model.lambda[i]] = model.f[model.lambda[i]] + model.X_lambda[i].applyTranspose(model.f[i]);
     }
 
-    unsigned int dof_index_i = model.mJoints[i].q_index;
+    // Once all children are processed Ic[i] is the inertia of the whole
+    // subtree of body i, which is only accelerated by gravity.
+    if (gravity_effects != NULL) {
+      ProjectOnJointMotionSubspace (model, i,
+          model.Ic[i] * model.X_base[i].apply(spatial_gravity),
+          *gravity_effects);
+    }
 
-    if (model.mJoints[i].mDoFCount == 1
-        && model.mJoints[i].mJointType != JointTypeCustom) {
+    CompositeRigidBodyBackwardStep (model, i, H);
+  }
+}
 
-      SpatialVector F             = model.Ic[i] * model.S[i];
-      H(dof_index_i, dof_index_i) = model.S[i].dot(F);
-
-      unsigned int j = i;
-      unsigned int dof_index_j = dof_index_i;
-
-      while (model.lambda[j] != 0) {
-        F = model.X_lambda[j].applyTranspose(F);
-        j = model.lambda[j];
-        dof_index_j = model.mJoints[j].q_index;
-
-        if(model.mJoints[j].mJointType != JointTypeCustom) {
-          if (model.mJoints[j].mDoFCount == 1) {
-            H(dof_index_i,dof_index_j) = F.dot(model.S[j]);
-            H(dof_index_j,dof_index_i) = H(dof_index_i,dof_index_j);
-          } else if (model.mJoints[j].mDoFCount == 3) {
-            Vector3d H_temp2 =
-              (F.transpose() * model.multdof3_S[j]).transpose();
-            LOG << F.transpose() << std::endl
-              << model.multdof3_S[j] << std::endl;
-            LOG << H_temp2.transpose() << std::endl;
-
-            H.block<1,3>(dof_index_i,dof_index_j) = H_temp2.transpose();
-            H.block<3,1>(dof_index_j,dof_index_i) = H_temp2;
-          }
-        } else if (model.mJoints[j].mJointType == JointTypeCustom){
-          unsigned int k      = model.mJoints[j].custom_joint_index;
-          unsigned int dof    = model.mCustomJoints[k]->mDoFCount;
-          VectorNd H_temp2    =
-            (F.transpose() * model.mCustomJoints[k]->S).transpose();
+/** \brief Computes the time derivative of the motion subspace of the
+ * 3-DoF joint i (in coordinates of body i) that is caused by the joint
+ * velocities.
+ */
+static Matrix63 CalcMultDof3MotionSubspaceDerivative (
+    Model &model,
+    unsigned int i,
+    const VectorNd &Q,
+    const VectorNd &QDot) {
+  Matrix63 S_dot (Matrix63::Zero());
+
+  unsigned int q_index = model.mJoints[i].q_index;
+  double s1 = sin (Q[q_index + 1]);
+  double c1 = cos (Q[q_index + 1]);
+  double s2 = sin (Q[q_index + 2]);
+  double c2 = cos (Q[q_index + 2]);
+  double qdot1 = QDot[q_index + 1];
+  double qdot2 = QDot[q_index + 2];
+
+  if (model.mJoints[i].mJointType == JointTypeEulerZYX) {
+    S_dot(0,0) = - c1 * qdot1;
+    S_dot(1,0) = - s1 * s2 * qdot1 + c1 * c2 * qdot2;
+    S_dot(1,1) = - s2 * qdot2;
+    S_dot(2,0) = - s1 * c2 * qdot1 - c1 * s2 * qdot2;
+    S_dot(2,1) = - c2 * qdot2;
+  } else if (model.mJoints[i].mJointType == JointTypeEulerXYZ) {
+    S_dot(0,0) = - c2 * s1 * qdot1 - s2 * c1 * qdot2;
+    S_dot(0,1) = c2 * qdot2;
+    S_dot(1,0) = s2 * s1 * qdot1 - c2 * c1 * qdot2;
+    S_dot(1,1) = - s2 * qdot2;
+    S_dot(2,0) = c1 * qdot1;
+  } else if (model.mJoints[i].mJointType == JointTypeEulerYXZ) {
+    S_dot(0,0) = - s2 * s1 * qdot1 + c2 * c1 * qdot2;
+    S_dot(0,1) = - s2 * qdot2;
+    S_dot(1,0) = - c2 * s1 * qdot1 - s2 * c1 * qdot2;
+    S_dot(1,1) = - c2 * qdot2;
+    S_dot(2,0) = - c1 * qdot1;
+  } else if (model.mJoints[i].mJointType == JointTypeEulerZXY) {
+    S_dot(0,0) = s2 * s1 * qdot1 - c2 * c1 * qdot2;
+    S_dot(0,1) = - s2 * qdot2;
+    S_dot(1,0) = c1 * qdot1;
+    S_dot(2,0) = - c2 * s1 * qdot1 - s2 * c1 * qdot2;
+    S_dot(2,1) = c2 * qdot2;
+  }
 
-          LOG << F.transpose()
-            << std::endl
-            << model.mCustomJoints[j]->S << std::endl;
+  return S_dot;
+}
 
-          LOG << H_temp2.transpose() << std::endl;
+/** \brief Returns the matrix of the operator \f$\bar{\times}^*\f$ that is
+ * defined by \f$ (f \bar{\times}^*) v = v \times^* f \f$.
+ */
+static SpatialMatrix crossf_bar (const SpatialVector &f) {
+  return SpatialMatrix (
+      0, f[2], -f[1], 0, f[5], -f[4],
+      -f[2], 0, f[0], -f[5], 0, f[3],
+      f[1], -f[0], 0, f[4], -f[3], 0,
+      0, f[5], -f[4], 0, 0, 0,
+      -f[5], 0, f[3], 0, 0, 0,
+      f[4], -f[3], 0, 0, 0, 0
+      );
+}
 
-          H.block(dof_index_i,dof_index_j,1,dof) = H_temp2.transpose();
-          H.block(dof_index_j,dof_index_i,dof,1) = H_temp2;
-        }
+RBDL_DLLAPI void CalcCoriolisMatrix (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    MatrixNd &C,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (C.rows() == model.dof_count && C.cols() == model.dof_count);
+
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, &QDot, NULL);
+  }
+
+  C.setZero();
+
+  // Motion subspaces and their time derivatives in base coordinates
+  MatrixNd Psi (MatrixNd::Zero (6, model.dof_count));
+  MatrixNd Psi_dot (MatrixNd::Zero (6, model.dof_count));
+
+  // Composite inertias and composite Coriolis matrices in base coordinates
+  std::vector<SpatialMatrix> Ic (model.mBodies.size(), SpatialMatrix::Zero());
+  std::vector<SpatialMatrix> Bc (model.mBodies.size(), SpatialMatrix::Zero());
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    if (model.mJoints[i].mJointType == JointTypeCustom) {
+      std::cerr << "Error: CalcCoriolisMatrix() does not support custom joints!" << std::endl;
+      assert (0);
+      abort();
+    }
+
+    unsigned int q_index = model.mJoints[i].q_index;
+    SpatialMatrix X_base = model.X_base[i].toMatrix();
+    SpatialMatrix X_base_inv = model.X_base[i].inverse().toMatrix();
+    SpatialVector v = X_base_inv * model.v[i];
+    SpatialMatrix v_cross = crossm (v);
+
+    if (model.mJoints[i].mDoFCount == 1) {
+      SpatialVector S_dot (SpatialVector::Zero());
+      if (model.mJoints[i].mJointType == JointTypeHelical) {
+        Vector3d omega = model.S[i].block<3,1>(0,0);
+        Vector3d trans = model.S[i].block<3,1>(3,0);
+        S_dot.block<3,1>(3,0) = - QDot[q_index] * omega.cross (trans);
       }
-    } else if (model.mJoints[i].mDoFCount == 3
-        && model.mJoints[i].mJointType != JointTypeCustom) {
-      Matrix63 F_63 = model.Ic[i].toMatrix() * model.multdof3_S[i];
-      H.block<3,3>(dof_index_i, dof_index_i) = model.multdof3_S[i].transpose() * F_63;
 
-      unsigned int j = i;
-      unsigned int dof_index_j = dof_index_i;
+      Psi.col(q_index) = X_base_inv * model.S[i];
+      Psi_dot.col(q_index) = v_cross * Psi.col(q_index) + X_base_inv * S_dot;
+    } else if (model.mJoints[i].mDoFCount == 3) {
+      Psi.block<6,3>(0, q_index) = X_base_inv * model.multdof3_S[i];
+      Psi_dot.block<6,3>(0, q_index) = v_cross * Psi.block<6,3>(0, q_index)
+        + X_base_inv * CalcMultDof3MotionSubspaceDerivative (model, i, Q, QDot);
+    }
 
-      while (model.lambda[j] != 0) {
-        F_63 = model.X_lambda[j].toMatrixTranspose() * (F_63);
-        j = model.lambda[j];
-        dof_index_j = model.mJoints[j].q_index;
+    Ic[i] = X_base.transpose() * model.I[i].toMatrix() * X_base;
+    Bc[i] = 0.5 * (crossf (v) * Ic[i] + crossf_bar (Ic[i] * v) - Ic[i] * v_cross);
+  }
 
-        if(model.mJoints[j].mJointType != JointTypeCustom){
-          if (model.mJoints[j].mDoFCount == 1) {
-            Vector3d H_temp2 = F_63.transpose() * (model.S[j]);
+  for (unsigned int i = model.mBodies.size() - 1; i > 0; i--) {
+    unsigned int q_index_i = model.mJoints[i].q_index;
+    unsigned int dof_count_i = model.mJoints[i].mDoFCount;
+
+    MatrixNd Psi_i = Psi.block(0, q_index_i, 6, dof_count_i);
+    MatrixNd F1 = Ic[i] * Psi_dot.block(0, q_index_i, 6, dof_count_i)
+      + Bc[i] * Psi_i;
+    MatrixNd F2 = Ic[i] * Psi_i;
+    MatrixNd F3 = Bc[i].transpose() * Psi_i;
+
+    C.block(q_index_i, q_index_i, dof_count_i, dof_count_i) = Psi_i.transpose() * F1;
+
+    unsigned int j = i;
+    while (model.lambda[j] != 0) {
+      j = model.lambda[j];
+      unsigned int q_index_j = model.mJoints[j].q_index;
+      unsigned int dof_count_j = model.mJoints[j].mDoFCount;
+
+      C.block(q_index_j, q_index_i, dof_count_j, dof_count_i) =
+        Psi.block(0, q_index_j, 6, dof_count_j).transpose() * F1;
+      C.block(q_index_i, q_index_j, dof_count_i, dof_count_j) =
+        (Psi_dot.block(0, q_index_j, 6, dof_count_j).transpose() * F2
+         + Psi.block(0, q_index_j, 6, dof_count_j).transpose() * F3).transpose();
+    }
 
-            H.block<3,1>(dof_index_i,dof_index_j) = H_temp2;
-            H.block<1,3>(dof_index_j,dof_index_i) = H_temp2.transpose();
-          } else if (model.mJoints[j].mDoFCount == 3) {
-            Matrix3d H_temp2 = F_63.transpose() * (model.multdof3_S[j]);
+    if (model.lambda[i] != 0) {
+      Ic[model.lambda[i]] += Ic[i];
+      Bc[model.lambda[i]] += Bc[i];
+    }
+  }
+}
 
-            H.block<3,3>(dof_index_i,dof_index_j) = H_temp2;
-            H.block<3,3>(dof_index_j,dof_index_i) = H_temp2.transpose();
-          }
-        } else if (model.mJoints[j].mJointType == JointTypeCustom){
-          unsigned int k = model.mJoints[j].custom_joint_index;
-          unsigned int dof = model.mCustomJoints[k]->mDoFCount;
+bool InverseDynamicsDerivatives::Bind (const Model &model) {
+  unsigned int body_count = model.mBodies.size();
 
-          MatrixNd H_temp2 = F_63.transpose() * (model.mCustomJoints[k]->S);
+  bound = false;
 
-          H.block(dof_index_i,dof_index_j,3,dof) = H_temp2;
-          H.block(dof_index_j,dof_index_i,dof,3) = H_temp2.transpose();
-        }
+  for (unsigned int i = 1; i < body_count; i++) {
+    if (model.mJoints[i].mDoFCount != 1
+        || model.mJoints[i].mJointType == JointTypeCustom
+        || model.mJoints[i].mJointType == JointTypeHelical) {
+      LOG << "InverseDynamicsDerivatives: joint of body " << i
+        << " has more than one degree of freedom or a configuration"
+        << " dependent motion subspace" << std::endl;
+      return false;
+    }
+  }
+
+  mDoFBodies.resize (model.dof_count);
+  pair_first.clear();
+  pair_second.clear();
+
+  for (unsigned int i = 1; i < body_count; i++) {
+
+    mDoFBodies[model.mJoints[i].q_index] = i;
+
+    unsigned int j = i;
+    while (j != 0) {
+      pair_first.push_back (model.mJoints[j].q_index);
+      pair_second.push_back (model.mJoints[i].q_index);
+      j = model.lambda[j];
+    }
+  }
+
+  unsigned int pair_count = pair_first.size();
+
+  dtau_dq = MatrixNd::Zero (model.dof_count, model.dof_count);
+  dtau_dqdot = MatrixNd::Zero (model.dof_count, model.dof_count);
+  d2tau_dq_dq = MatrixNd::Zero (model.dof_count, pair_count);
+  d2tau_dqdot_dqdot = MatrixNd::Zero (model.dof_count, pair_count);
+  d2tau_dq_dqdot = MatrixNd::Zero (model.dof_count, pair_count);
+  d2tau_dqdot_dq = MatrixNd::Zero (model.dof_count, pair_count);
+
+  mV.assign (2 * model.dof_count * body_count, SpatialVector::Zero());
+  mA.assign (2 * model.dof_count * body_count, SpatialVector::Zero());
+  mF.assign (2 * model.dof_count * body_count, SpatialVector::Zero());
+  mV2.assign (body_count, SpatialVector::Zero());
+  mA2.assign (body_count, SpatialVector::Zero());
+  mF2.assign (body_count, SpatialVector::Zero());
+  mInSubtree.assign (body_count, false);
+  mSupporting.assign (body_count, false);
+
+  bound = true;
+
+  return true;
+}
+
+/** \brief Marks the bodies in the subtree of body_id and the bodies that
+ * support body_id.
+ */
+static void MarkSubtreeAndSupport (
+    Model &model,
+    unsigned int body_id,
+    InverseDynamicsDerivatives &derivatives) {
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    derivatives.mInSubtree[i] = (i == body_id)
+      || (i > body_id && derivatives.mInSubtree[model.lambda[i]]);
+    derivatives.mSupporting[i] = false;
+  }
+
+  unsigned int j = model.lambda[body_id];
+  while (j != 0) {
+    derivatives.mSupporting[j] = true;
+    j = model.lambda[j];
+  }
+}
+
+/** \brief Propagates the derivatives of the Newton-Euler algorithm with
+ * respect to q (or qdot if wrt_qdot is set) of a degree of freedom and
+ * stores the derivative of tau in column dof of dtau.
+ */
+static void CalcInverseDynamicsFirstOrderDerivative (
+    Model &model,
+    const VectorNd &QDot,
+    unsigned int dof,
+    bool wrt_qdot,
+    InverseDynamicsDerivatives &derivatives,
+    MatrixNd &dtau) {
+  unsigned int body_count = model.mBodies.size();
+  unsigned int offset = (dof + (wrt_qdot ? model.dof_count : 0)) * body_count;
+  unsigned int body_id = derivatives.mDoFBodies[dof];
+
+  SpatialVector *V = &derivatives.mV[offset];
+  SpatialVector *A = &derivatives.mA[offset];
+  SpatialVector *F = &derivatives.mF[offset];
+
+  MarkSubtreeAndSupport (model, body_id, derivatives);
+
+  for (unsigned int i = 1; i < body_count; i++) {
+    if (!derivatives.mInSubtree[i]) {
+      V[i].setZero();
+      A[i].setZero();
+      F[i].setZero();
+      continue;
+    }
+
+    unsigned int lambda = model.lambda[i];
+    const SpatialVector &S = model.S[i];
+
+    V[i] = model.X_lambda[i].apply (V[lambda]);
+    A[i] = model.X_lambda[i].apply (A[lambda]);
+
+    if (i == body_id) {
+      if (wrt_qdot) {
+        V[i] += S;
+        A[i] += crossm (model.v[i], S);
+      } else {
+        V[i] -= crossm (S, model.X_lambda[i].apply (model.v[lambda]));
+        A[i] -= crossm (S, model.X_lambda[i].apply (model.a[lambda]));
       }
-    } else if (model.mJoints[i].mJointType == JointTypeCustom) {
-      unsigned int kI = model.mJoints[i].custom_joint_index;
-      unsigned int dofI = model.mCustomJoints[kI]->mDoFCount;
+    }
 
-      MatrixNd F_Nd = model.Ic[i].toMatrix()
-        * model.mCustomJoints[kI]->S;
-
-      H.block(dof_index_i, dof_index_i,dofI,dofI)
-        = model.mCustomJoints[kI]->S.transpose() * F_Nd;
-
-      unsigned int j = i;
-      unsigned int dof_index_j = dof_index_i;
-
-      while (model.lambda[j] != 0) {
-        F_Nd = model.X_lambda[j].toMatrixTranspose() * (F_Nd);
-        j = model.lambda[j];
-        dof_index_j = model.mJoints[j].q_index;
-
-        if(model.mJoints[j].mJointType != JointTypeCustom){
-          if (model.mJoints[j].mDoFCount == 1) {
-            MatrixNd H_temp2 = F_Nd.transpose() * (model.S[j]);
-            H.block(   dof_index_i,  dof_index_j,
-                H_temp2.rows(),H_temp2.cols()) = H_temp2;
-            H.block(dof_index_j,dof_index_i,
-                H_temp2.cols(),H_temp2.rows()) = H_temp2.transpose();
-          } else if (model.mJoints[j].mDoFCount == 3) {
-            MatrixNd H_temp2 = F_Nd.transpose() * (model.multdof3_S[j]);
-            H.block(dof_index_i,   dof_index_j,
-                H_temp2.rows(),H_temp2.cols()) = H_temp2;
-            H.block(dof_index_j,   dof_index_i,
-                H_temp2.cols(),H_temp2.rows()) = H_temp2.transpose();
-          }
-        } else if (model.mJoints[j].mJointType == JointTypeCustom){
-          unsigned int k   = model.mJoints[j].custom_joint_index;
-          unsigned int dof = model.mCustomJoints[k]->mDoFCount;
+    A[i] += crossm (V[i], S) * QDot[model.mJoints[i].q_index];
 
-          MatrixNd H_temp2 = F_Nd.transpose() * (model.mCustomJoints[k]->S);
+    if (!model.mBodies[i].mIsVirtual) {
+      F[i] = model.I[i] * A[i]
+        + crossf (V[i], model.I[i] * model.v[i])
+        + crossf (model.v[i], model.I[i] * V[i]);
+    } else {
+      F[i].setZero();
+    }
+  }
 
-          H.block(dof_index_i,dof_index_j,3,dof) = H_temp2;
-          H.block(dof_index_j,dof_index_i,dof,3) = H_temp2.transpose();
-        }
+  dtau.col(dof).setZero();
+
+  for (unsigned int i = body_count - 1; i > 0; i--) {
+    if (!derivatives.mInSubtree[i] && !derivatives.mSupporting[i]) {
+      continue;
+    }
+
+    dtau(model.mJoints[i].q_index, dof) = model.S[i].dot (F[i]);
+
+    if (model.lambda[i] != 0) {
+      SpatialVector f = F[i];
+      if (i == body_id && !wrt_qdot) {
+        f += crossf (model.S[i], model.f[i]);
       }
+      F[model.lambda[i]] += model.X_lambda[i].applyTranspose (f);
     }
   }
 }
 
+/** \brief Propagates the mixed second-order derivatives of the
+ * Newton-Euler algorithm with respect to the degrees of freedom dof_a and
+ * dof_b (which is dof_a or supported by it) and stores the derivatives of
+ * tau in column pair of d2tau.
+ */
+static void CalcInverseDynamicsSecondOrderDerivative (
+    Model &model,
+    const VectorNd &QDot,
+    unsigned int dof_a,
+    bool wrt_qdot_a,
+    unsigned int dof_b,
+    bool wrt_qdot_b,
+    InverseDynamicsDerivatives &derivatives,
+    unsigned int pair,
+    MatrixNd &d2tau) {
+  unsigned int body_count = model.mBodies.size();
+  unsigned int body_a = derivatives.mDoFBodies[dof_a];
+  unsigned int body_b = derivatives.mDoFBodies[dof_b];
+
+  const SpatialVector *V_a = &derivatives.mV[(dof_a + (wrt_qdot_a ? model.dof_count : 0)) * body_count];
+  const SpatialVector *A_a = &derivatives.mA[(dof_a + (wrt_qdot_a ? model.dof_count : 0)) * body_count];
+  const SpatialVector *F_a = &derivatives.mF[(dof_a + (wrt_qdot_a ? model.dof_count : 0)) * body_count];
+  const SpatialVector *V_b = &derivatives.mV[(dof_b + (wrt_qdot_b ? model.dof_count : 0)) * body_count];
+  const SpatialVector *A_b = &derivatives.mA[(dof_b + (wrt_qdot_b ? model.dof_count : 0)) * body_count];
+  const SpatialVector *F_b = &derivatives.mF[(dof_b + (wrt_qdot_b ? model.dof_count : 0)) * body_count];
+
+  std::vector<SpatialVector> &V2 = derivatives.mV2;
+  std::vector<SpatialVector> &A2 = derivatives.mA2;
+  std::vector<SpatialVector> &F2 = derivatives.mF2;
+
+  // Both first-order derivatives are only non-zero in the subtree of
+  // body_b and so are the second-order derivatives of the kinematics.
+  MarkSubtreeAndSupport (model, body_b, derivatives);
+
+  for (unsigned int i = 1; i < body_count; i++) {
+    if (!derivatives.mInSubtree[i]) {
+      V2[i].setZero();
+      A2[i].setZero();
+      F2[i].setZero();
+      continue;
+    }
+
+    unsigned int lambda = model.lambda[i];
+    const SpatialVector &S = model.S[i];
+    double qdot = QDot[model.mJoints[i].q_index];
+
+    V2[i] = model.X_lambda[i].apply (V2[lambda]);
+    A2[i] = model.X_lambda[i].apply (A2[lambda]);
+
+    if (i == body_a && !wrt_qdot_a) {
+      V2[i] -= crossm (S, model.X_lambda[i].apply (V_b[lambda]));
+      A2[i] -= crossm (S, model.X_lambda[i].apply (A_b[lambda]));
+    }
+    if (i == body_b && !wrt_qdot_b) {
+      V2[i] -= crossm (S, model.X_lambda[i].apply (V_a[lambda]));
+      A2[i] -= crossm (S, model.X_lambda[i].apply (A_a[lambda]));
+    }
+    if (i == body_a && i == body_b && !wrt_qdot_a && !wrt_qdot_b) {
+      V2[i] += crossm (S, crossm (S, model.X_lambda[i].apply (model.v[lambda])));
+      A2[i] += crossm (S, crossm (S, model.X_lambda[i].apply (model.a[lambda])));
+    }
+
+    A2[i] += crossm (V2[i], S) * qdot;
+    if (i == body_a && wrt_qdot_a) {
+      A2[i] += crossm (V_b[i], S);
+    }
+    if (i == body_b && wrt_qdot_b) {
+      A2[i] += crossm (V_a[i], S);
+    }
+
+    if (!model.mBodies[i].mIsVirtual) {
+      F2[i] = model.I[i] * A2[i]
+        + crossf (V2[i], model.I[i] * model.v[i])
+        + crossf (V_a[i], model.I[i] * V_b[i])
+        + crossf (V_b[i], model.I[i] * V_a[i])
+        + crossf (model.v[i], model.I[i] * V2[i]);
+    } else {
+      F2[i].setZero();
+    }
+  }
+
+  d2tau.col(pair).setZero();
+
+  for (unsigned int i = body_count - 1; i > 0; i--) {
+    if (!derivatives.mInSubtree[i] && !derivatives.mSupporting[i]) {
+      continue;
+    }
+
+    d2tau(model.mJoints[i].q_index, pair) = model.S[i].dot (F2[i]);
+
+    if (model.lambda[i] != 0) {
+      const SpatialVector &S = model.S[i];
+      SpatialVector f = F2[i];
+
+      if (i == body_a && !wrt_qdot_a) {
+        f += crossf (S, F_b[i]);
+      }
+      if (i == body_b && !wrt_qdot_b) {
+        f += crossf (S, F_a[i]);
+      }
+      if (i == body_a && i == body_b && !wrt_qdot_a && !wrt_qdot_b) {
+        f += crossf (S, crossf (S, model.f[i]));
+      }
+
+      F2[model.lambda[i]] += model.X_lambda[i].applyTranspose (f);
+    }
+  }
+}
+
+RBDL_DLLAPI void CalcInverseDynamicsDerivatives (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    const VectorNd &QDDot,
+    VectorNd &Tau,
+    InverseDynamicsDerivatives &derivatives) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (derivatives.bound);
+  assert (derivatives.mDoFBodies.size() == model.dof_count);
+
+  // Values of the velocities, accelerations and accumulated forces
+  InverseDynamics (model, Q, QDot, QDDot, Tau);
+
+  for (unsigned int k = 0; k < model.dof_count; k++) {
+    CalcInverseDynamicsFirstOrderDerivative (model, QDot, k, false,
+        derivatives, derivatives.dtau_dq);
+    CalcInverseDynamicsFirstOrderDerivative (model, QDot, k, true,
+        derivatives, derivatives.dtau_dqdot);
+  }
+
+  for (unsigned int p = 0; p < derivatives.pair_first.size(); p++) {
+    unsigned int dof_a = derivatives.pair_first[p];
+    unsigned int dof_b = derivatives.pair_second[p];
+
+    CalcInverseDynamicsSecondOrderDerivative (model, QDot,
+        dof_a, false, dof_b, false, derivatives, p, derivatives.d2tau_dq_dq);
+    CalcInverseDynamicsSecondOrderDerivative (model, QDot,
+        dof_a, true, dof_b, true, derivatives, p, derivatives.d2tau_dqdot_dqdot);
+    CalcInverseDynamicsSecondOrderDerivative (model, QDot,
+        dof_a, false, dof_b, true, derivatives, p, derivatives.d2tau_dq_dqdot);
+    CalcInverseDynamicsSecondOrderDerivative (model, QDot,
+        dof_a, true, dof_b, false, derivatives, p, derivatives.d2tau_dqdot_dq);
+  }
+}
+
 RBDL_DLLAPI void ForwardDynamics (
     Model &model,
     const VectorNd &Q,
@@ -531,21 +1218,230 @@ RBDL_DLLAPI void ForwardDynamics (
       unsigned int kI = model.mJoints[i].custom_joint_index;
       unsigned int dofI=model.mCustomJoints[kI]->mDoFCount;
 
-      VectorNd qdd_temp = model.mCustomJoints[kI]->Dinv
-        * (  model.mCustomJoints[kI]->u
-            - model.mCustomJoints[kI]->U.transpose()
-            * model.a[i]);
+      VectorNd qdd_temp = model.mCustomJoints[kI]->Dinv
+        * (  model.mCustomJoints[kI]->u
+            - model.mCustomJoints[kI]->U.transpose()
+            * model.a[i]);
+
+      for(unsigned int z=0; z < dofI; ++z){
+        QDDot[q_index+z] = qdd_temp[z];
+      }
+
+      model.a[i] = model.a[i]
+        + model.mCustomJoints[kI]->S * qdd_temp;
+    }
+  }
+
+  LOG << "QDDot = " << QDDot.transpose() << std::endl;
+}
+
+RBDL_DLLAPI void HybridDynamics (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    VectorNd &QDDot,
+    VectorNd &Tau,
+    const std::vector<bool> &qddot_known,
+    std::vector<SpatialVector> *f_ext) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (qddot_known.size() == model.qdot_size);
+
+  SpatialVector spatial_gravity (0., 0., 0., model.gravity[0], model.gravity[1], model.gravity[2]);
+
+  unsigned int i = 0;
+
+  // Motion subspaces of the multi dof joints split into the columns of
+  // the degrees of freedom with known accelerations and known forces
+  // together with the articulated body quantities of the latter.
+  std::vector<MatrixNd> &S_known = model.hybrid_S_known;
+  std::vector<MatrixNd> &S_free = model.hybrid_S_free;
+  std::vector<MatrixNd> &U_free = model.hybrid_U_free;
+  std::vector<MatrixNd> &Dinv_free = model.hybrid_Dinv_free;
+  std::vector<VectorNd> &u_free = model.hybrid_u_free;
+
+  // Reset the velocity of the root body
+  model.v[0].setZero();
+
+  for (i = 1; i < model.mBodies.size(); i++) {
+    unsigned int q_index = model.mJoints[i].q_index;
+    unsigned int lambda = model.lambda[i];
+
+    jcalc (model, i, Q, QDot);
+
+    if (lambda != 0)
+      model.X_base[i] = model.X_lambda[i] * model.X_base[lambda];
+    else
+      model.X_base[i] = model.X_lambda[i];
+
+    model.v[i] = model.X_lambda[i].apply( model.v[lambda]) + model.v_J[i];
+    model.c[i] = model.c_J[i] + crossm(model.v[i],model.v_J[i]);
+    model.I[i].setSpatialMatrix (model.IA[i]);
+
+    model.pA[i] = crossf(model.v[i],model.I[i] * model.v[i]);
+
+    if (f_ext != NULL && (*f_ext)[i] != SpatialVector::Zero()) {
+      LOG << "External force (" << i << ") = " << model.X_base[i].toMatrixAdjoint() * (*f_ext)[i] << std::endl;
+      model.pA[i] -= model.X_base[i].toMatrixAdjoint() * (*f_ext)[i];
+    }
+
+    // Prescribed joint accelerations are treated as an additional bias
+    // acceleration of the body.
+    if (model.mJoints[i].mDoFCount == 1
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      if (qddot_known[q_index]) {
+        model.c[i] += model.S[i] * QDDot[q_index];
+      }
+    } else {
+      MatrixNd S;
+      unsigned int dofI = model.mJoints[i].mDoFCount;
+
+      if (model.mJoints[i].mJointType == JointTypeCustom) {
+        unsigned int kI = model.mJoints[i].custom_joint_index;
+        dofI = model.mCustomJoints[kI]->mDoFCount;
+        S = model.mCustomJoints[kI]->S;
+      } else {
+        S = model.multdof3_S[i];
+      }
+
+      unsigned int known_count = 0;
+      for (unsigned int z = 0; z < dofI; z++) {
+        if (qddot_known[q_index + z]) {
+          known_count++;
+        }
+      }
+
+      S_known[i].resize (6, known_count);
+      S_free[i].resize (6, dofI - known_count);
+
+      unsigned int known_col = 0;
+      unsigned int free_col = 0;
+      for (unsigned int z = 0; z < dofI; z++) {
+        if (qddot_known[q_index + z]) {
+          S_known[i].col(known_col++) = S.col(z);
+          model.c[i] += SpatialVector (S.col(z) * QDDot[q_index + z]);
+        } else {
+          S_free[i].col(free_col++) = S.col(z);
+        }
+      }
+    }
+  }
+
+  LOG << "--- first loop ---" << std::endl;
+
+  for (i = model.mBodies.size() - 1; i > 0; i--) {
+    unsigned int q_index = model.mJoints[i].q_index;
+    unsigned int lambda = model.lambda[i];
+
+    SpatialMatrix Ia = model.IA[i];
+    SpatialVector pa;
+
+    if (model.mJoints[i].mDoFCount == 1
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      if (qddot_known[q_index]) {
+        pa = model.pA[i] + Ia * model.c[i];
+      } else {
+        model.U[i] = model.IA[i] * model.S[i];
+        model.d[i] = model.S[i].dot(model.U[i]);
+        model.u[i] = Tau[q_index] - model.S[i].dot(model.pA[i]);
+
+        Ia -= model.U[i] * (model.U[i] / model.d[i]).transpose();
+        pa = model.pA[i]
+          + Ia * model.c[i]
+          + model.U[i] * model.u[i] / model.d[i];
+      }
+    } else {
+      unsigned int free_count = S_free[i].cols();
+
+      if (free_count == 0) {
+        pa = model.pA[i] + Ia * model.c[i];
+      } else {
+        VectorNd tau_free (free_count);
+        unsigned int free_col = 0;
+        for (unsigned int z = 0; free_col < free_count; z++) {
+          if (!qddot_known[q_index + z]) {
+            tau_free[free_col++] = Tau[q_index + z];
+          }
+        }
+
+        U_free[i] = model.IA[i] * S_free[i];
+#ifdef EIGEN_CORE_H
+        Dinv_free[i] = (S_free[i].transpose() * U_free[i]).inverse().eval();
+#else
+        Dinv_free[i] = (S_free[i].transpose() * U_free[i]).inverse();
+#endif
+        u_free[i] = tau_free - S_free[i].transpose() * model.pA[i];
+
+        Ia -= U_free[i] * Dinv_free[i] * U_free[i].transpose();
+        pa = model.pA[i]
+          + Ia * model.c[i]
+          + U_free[i] * Dinv_free[i] * u_free[i];
+      }
+    }
+
+    if (lambda != 0) {
+#ifdef EIGEN_CORE_H
+      model.IA[lambda].noalias()
+        += model.X_lambda[i].toMatrixTranspose()
+        * Ia * model.X_lambda[i].toMatrix();
+      model.pA[lambda].noalias()
+        += model.X_lambda[i].applyTranspose(pa);
+#else
+      model.IA[lambda]
+        += model.X_lambda[i].toMatrixTranspose()
+        * Ia * model.X_lambda[i].toMatrix();
+      model.pA[lambda] += model.X_lambda[i].applyTranspose(pa);
+#endif
+      LOG << "pA[" << lambda << "] = "
+        << model.pA[lambda].transpose() << std::endl;
+    }
+  }
+
+  model.a[0] = spatial_gravity * -1.;
 
-      for(unsigned int z=0; z < dofI; ++z){
-        QDDot[q_index+z] = qdd_temp[z];
+  for (i = 1; i < model.mBodies.size(); i++) {
+    unsigned int q_index = model.mJoints[i].q_index;
+    unsigned int lambda = model.lambda[i];
+
+    model.a[i] = model.X_lambda[i].apply(model.a[lambda]) + model.c[i];
+    LOG << "a'[" << i << "] = " << model.a[i].transpose() << std::endl;
+
+    if (model.mJoints[i].mDoFCount == 1
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      if (qddot_known[q_index]) {
+        Tau[q_index] = model.S[i].dot(model.IA[i] * model.a[i] + model.pA[i]);
+      } else {
+        QDDot[q_index] = (1./model.d[i]) * (model.u[i] - model.U[i].dot(model.a[i]));
+        model.a[i] = model.a[i] + model.S[i] * QDDot[q_index];
+      }
+    } else {
+      VectorNd qdd_free;
+      if (S_free[i].cols() > 0) {
+        qdd_free = Dinv_free[i] * (u_free[i] - U_free[i].transpose() * model.a[i]);
+        model.a[i] = model.a[i] + SpatialVector (S_free[i] * qdd_free);
       }
 
-      model.a[i] = model.a[i]
-        + model.mCustomJoints[kI]->S * qdd_temp;
+      VectorNd tau_known;
+      if (S_known[i].cols() > 0) {
+        tau_known = S_known[i].transpose()
+          * (model.IA[i] * model.a[i] + model.pA[i]);
+      }
+
+      unsigned int dofI = S_free[i].cols() + S_known[i].cols();
+      unsigned int known_col = 0;
+      unsigned int free_col = 0;
+      for (unsigned int z = 0; z < dofI; z++) {
+        if (qddot_known[q_index + z]) {
+          Tau[q_index + z] = tau_known[known_col++];
+        } else {
+          QDDot[q_index + z] = qdd_free[free_col++];
+        }
+      }
     }
   }
 
   LOG << "QDDot = " << QDDot.transpose() << std::endl;
+  LOG << "Tau = " << Tau.transpose() << std::endl;
 }
 
 RBDL_DLLAPI void ForwardDynamicsLagrangian (
@@ -573,12 +1469,7 @@ RBDL_DLLAPI void ForwardDynamicsLagrangian (
     free_C = true;
   }
 
-  // we set QDDot to zero to compute C properly with the InverseDynamics
-  // method.
-  QDDot.setZero();
-
-  InverseDynamics (model, Q, QDot, QDDot, (*C), f_ext);
-  CompositeRigidBodyAlgorithm (model, Q, *H, false);
+  CalcJointSpaceInertiaAndNonlinearEffects (model, Q, QDot, *H, *C, NULL, f_ext);
 
   LOG << "A = " << std::endl << *H << std::endl;
   LOG << "b = " << std::endl << *C * -1. + Tau << std::endl;
@@ -613,130 +1504,136 @@ RBDL_DLLAPI void ForwardDynamicsLagrangian (
   LOG << "x = " << QDDot << std::endl;
 }
 
-RBDL_DLLAPI void CalcMInvTimesTau ( Model &model,
-    const VectorNd &Q,
-    const VectorNd &Tau,
-    VectorNd &QDDot,
-    bool update_kinematics) {
-
-  LOG << "Q          = " << Q.transpose() << std::endl;
-  LOG << "---" << std::endl;
-
-  // Reset the velocity of the root body
-  model.v[0].setZero();
-  model.a[0].setZero();
-
-  if (update_kinematics) {
-    for (unsigned int i = 1; i < model.mBodies.size(); i++) {
-      jcalc_X_lambda_S (model, model.mJointUpdateOrder[i], Q);
-
-      model.v_J[i].setZero();
-      model.v[i].setZero();
-      model.c[i].setZero();
-      model.pA[i].setZero();
-      model.I[i].setSpatialMatrix (model.IA[i]);
-    }
-  }
-
+/** \brief Computes the articulated body inertias IA and the joint space
+ * projections U, d / Dinv of all bodies for the configuration Q.
+ *
+ * Updates the transformations X_lambda and motion subspaces, resets the
+ * velocity dependent quantities v, c and pA and performs the backward pass
+ * of the Articulated %Body Algorithm for the velocity independent terms.
+ */
+static void CalcArticulatedBodyInertias (Model &model, const VectorNd &Q) {
   for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    jcalc_X_lambda_S (model, model.mJointUpdateOrder[i], Q);
+
+    model.v_J[i].setZero();
+    model.v[i].setZero();
+    model.c[i].setZero();
     model.pA[i].setZero();
+    model.I[i].setSpatialMatrix (model.IA[i]);
   }
 
-  // ClearLogOutput();
-
-  if (update_kinematics) {
-    // Compute Articulate Body Inertias
-    for (unsigned int i = model.mBodies.size() - 1; i > 0; i--) {
-      // unsigned int q_index = model.mJoints[i].q_index;
+  for (unsigned int i = model.mBodies.size() - 1; i > 0; i--) {
+    // unsigned int q_index = model.mJoints[i].q_index;
 
-      if (model.mJoints[i].mDoFCount == 1
-          && model.mJoints[i].mJointType != JointTypeCustom) {
-        model.U[i] = model.IA[i] * model.S[i];
-        model.d[i] = model.S[i].dot(model.U[i]);
-        //      LOG << "u[" << i << "] = " << model.u[i] << std::endl;
-        unsigned int lambda = model.lambda[i];
+    if (model.mJoints[i].mDoFCount == 1
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      model.U[i] = model.IA[i] * model.S[i];
+      model.d[i] = model.S[i].dot(model.U[i]);
+      //      LOG << "u[" << i << "] = " << model.u[i] << std::endl;
+      unsigned int lambda = model.lambda[i];
 
-        if (lambda != 0) {
-          SpatialMatrix Ia = model.IA[i] -
-            model.U[i] * (model.U[i] / model.d[i]).transpose();
+      if (lambda != 0) {
+        SpatialMatrix Ia = model.IA[i] -
+          model.U[i] * (model.U[i] / model.d[i]).transpose();
 #ifdef EIGEN_CORE_H
-          model.IA[lambda].noalias() += model.X_lambda[i].toMatrixTranspose()
-            * Ia
-            * model.X_lambda[i].toMatrix();
+        model.IA[lambda].noalias() += model.X_lambda[i].toMatrixTranspose()
+          * Ia
+          * model.X_lambda[i].toMatrix();
 #else
-          model.IA[lambda] += model.X_lambda[i].toMatrixTranspose()
-            * Ia
-            * model.X_lambda[i].toMatrix();
+        model.IA[lambda] += model.X_lambda[i].toMatrixTranspose()
+          * Ia
+          * model.X_lambda[i].toMatrix();
 #endif
-        }
-      } else if (model.mJoints[i].mDoFCount == 3
-          && model.mJoints[i].mJointType != JointTypeCustom) {
+      }
+    } else if (model.mJoints[i].mDoFCount == 3
+        && model.mJoints[i].mJointType != JointTypeCustom) {
 
-        model.multdof3_U[i] = model.IA[i] * model.multdof3_S[i];
+      model.multdof3_U[i] = model.IA[i] * model.multdof3_S[i];
 
 #ifdef EIGEN_CORE_H
-        model.multdof3_Dinv[i] =
-          (model.multdof3_S[i].transpose()*model.multdof3_U[i]).inverse().eval();
+      model.multdof3_Dinv[i] =
+        (model.multdof3_S[i].transpose()*model.multdof3_U[i]).inverse().eval();
 #else
-        model.multdof3_Dinv[i] =
-          (model.multdof3_S[i].transpose() * model.multdof3_U[i]).inverse();
+      model.multdof3_Dinv[i] =
+        (model.multdof3_S[i].transpose() * model.multdof3_U[i]).inverse();
 #endif
-        //      LOG << "mCustomJoints[kI]->u[" << i << "] = "
-        //<< model.mCustomJoints[kI]->u[i].transpose() << std::endl;
+      //      LOG << "mCustomJoints[kI]->u[" << i << "] = "
+      //<< model.mCustomJoints[kI]->u[i].transpose() << std::endl;
 
-        unsigned int lambda = model.lambda[i];
+      unsigned int lambda = model.lambda[i];
 
-        if (lambda != 0) {
-          SpatialMatrix Ia = model.IA[i]
-            - ( model.multdof3_U[i]
-                * model.multdof3_Dinv[i]
-                * model.multdof3_U[i].transpose());
+      if (lambda != 0) {
+        SpatialMatrix Ia = model.IA[i]
+          - ( model.multdof3_U[i]
+              * model.multdof3_Dinv[i]
+              * model.multdof3_U[i].transpose());
 #ifdef EIGEN_CORE_H
-          model.IA[lambda].noalias() +=
-            model.X_lambda[i].toMatrixTranspose()
-            * Ia
-            * model.X_lambda[i].toMatrix();
+        model.IA[lambda].noalias() +=
+          model.X_lambda[i].toMatrixTranspose()
+          * Ia
+          * model.X_lambda[i].toMatrix();
 #else
-          model.IA[lambda] +=
-            model.X_lambda[i].toMatrixTranspose()
-            * Ia * model.X_lambda[i].toMatrix();
+        model.IA[lambda] +=
+          model.X_lambda[i].toMatrixTranspose()
+          * Ia * model.X_lambda[i].toMatrix();
 #endif
-        }
-      } else if (model.mJoints[i].mJointType == JointTypeCustom) {
-        unsigned int kI     = model.mJoints[i].custom_joint_index;
-        // unsigned int dofI   = model.mCustomJoints[kI]->mDoFCount;
-        model.mCustomJoints[kI]->U = model.IA[i] * model.mCustomJoints[kI]->S;
+      }
+    } else if (model.mJoints[i].mJointType == JointTypeCustom) {
+      unsigned int kI     = model.mJoints[i].custom_joint_index;
+      // unsigned int dofI   = model.mCustomJoints[kI]->mDoFCount;
+      model.mCustomJoints[kI]->U = model.IA[i] * model.mCustomJoints[kI]->S;
 
 #ifdef EIGEN_CORE_H
-        model.mCustomJoints[kI]->Dinv = (model.mCustomJoints[kI]->S.transpose()
-            * model.mCustomJoints[kI]->U
-            ).inverse().eval();
+      model.mCustomJoints[kI]->Dinv = (model.mCustomJoints[kI]->S.transpose()
+          * model.mCustomJoints[kI]->U
+          ).inverse().eval();
 #else
-        model.mCustomJoints[kI]->Dinv=(model.mCustomJoints[kI]->S.transpose()
-            * model.mCustomJoints[kI]->U
-            ).inverse();
+      model.mCustomJoints[kI]->Dinv=(model.mCustomJoints[kI]->S.transpose()
+          * model.mCustomJoints[kI]->U
+          ).inverse();
 #endif
-        //      LOG << "mCustomJoints[kI]->u[" << i << "] = "
-        //<< model.mCustomJoints[kI]->u.transpose() << std::endl;
-        unsigned int lambda = model.lambda[i];
-
-        if (lambda != 0) {
-          SpatialMatrix Ia = model.IA[i]
-            - ( model.mCustomJoints[kI]->U
-                * model.mCustomJoints[kI]->Dinv
-                * model.mCustomJoints[kI]->U.transpose());
+      //      LOG << "mCustomJoints[kI]->u[" << i << "] = "
+      //<< model.mCustomJoints[kI]->u.transpose() << std::endl;
+      unsigned int lambda = model.lambda[i];
+
+      if (lambda != 0) {
+        SpatialMatrix Ia = model.IA[i]
+          - ( model.mCustomJoints[kI]->U
+              * model.mCustomJoints[kI]->Dinv
+              * model.mCustomJoints[kI]->U.transpose());
 #ifdef EIGEN_CORE_H
-          model.IA[lambda].noalias() += model.X_lambda[i].toMatrixTranspose()
-            * Ia
-            * model.X_lambda[i].toMatrix();
+        model.IA[lambda].noalias() += model.X_lambda[i].toMatrixTranspose()
+          * Ia
+          * model.X_lambda[i].toMatrix();
 #else
-          model.IA[lambda] += model.X_lambda[i].toMatrixTranspose()
-            * Ia * model.X_lambda[i].toMatrix();
+        model.IA[lambda] += model.X_lambda[i].toMatrixTranspose()
+          * Ia * model.X_lambda[i].toMatrix();
 #endif
-        }
       }
     }
   }
+}
+
+RBDL_DLLAPI void CalcMInvTimesTau ( Model &model,
+    const VectorNd &Q,
+    const VectorNd &Tau,
+    VectorNd &QDDot,
+    bool update_kinematics) {
+
+  LOG << "Q          = " << Q.transpose() << std::endl;
+  LOG << "---" << std::endl;
+
+  // Reset the velocity of the root body
+  model.v[0].setZero();
+  model.a[0].setZero();
+
+  if (update_kinematics) {
+    CalcArticulatedBodyInertias (model, Q);
+  }
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    model.pA[i].setZero();
+  }
 
   // compute articulated bias forces
   for (unsigned int i = model.mBodies.size() - 1; i > 0; i--) {
@@ -859,4 +1756,329 @@ RBDL_DLLAPI void CalcMInvTimesTau ( Model &model,
   LOG << "QDDot = " << QDDot.transpose() << std::endl;
 }
 
+RBDL_DLLAPI void CalcMInvTimesTau ( Model &model,
+    const VectorNd &Q,
+    const MatrixNd &Tau,
+    MatrixNd &QDDot,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (Tau.rows() == model.qdot_size);
+  assert (QDDot.rows() == model.qdot_size && QDDot.cols() == Tau.cols());
+
+  unsigned int cols = Tau.cols();
+
+  if (update_kinematics) {
+    CalcArticulatedBodyInertias (model, Q);
+  }
+
+  // The articulated bias forces and accelerations of all columns are
+  // stored as 6 x cols blocks for each body such that all sweeps operate
+  // on all columns at once.
+  MatrixNd pA (MatrixNd::Zero (6 * model.mBodies.size(), cols));
+  MatrixNd a (MatrixNd::Zero (6 * model.mBodies.size(), cols));
+  MatrixNd u (MatrixNd::Zero (model.qdot_size, cols));
+  MatrixNd pa (6, cols);
+
+  // compute articulated bias forces
+  for (unsigned int i = model.mBodies.size() - 1; i > 0; i--) {
+    unsigned int q_index = model.mJoints[i].q_index;
+    unsigned int lambda = model.lambda[i];
+
+    if (model.mJoints[i].mDoFCount == 1
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      u.row(q_index) = Tau.row(q_index)
+        - model.S[i].transpose() * pA.block(6 * i, 0, 6, cols);
+
+      if (lambda != 0) {
+        pa = pA.block(6 * i, 0, 6, cols);
+#ifdef EIGEN_CORE_H
+        pa.noalias() += model.U[i] * (u.row(q_index) / model.d[i]);
+#else
+        pa += model.U[i] * (u.row(q_index) / model.d[i]);
+#endif
+      }
+    } else if (model.mJoints[i].mDoFCount == 3
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      u.block(q_index, 0, 3, cols) = Tau.block(q_index, 0, 3, cols)
+        - model.multdof3_S[i].transpose() * pA.block(6 * i, 0, 6, cols);
+
+      if (lambda != 0) {
+        pa = pA.block(6 * i, 0, 6, cols);
+#ifdef EIGEN_CORE_H
+        pa.noalias() += model.multdof3_U[i]
+          * model.multdof3_Dinv[i]
+          * u.block(q_index, 0, 3, cols);
+#else
+        pa += model.multdof3_U[i]
+          * model.multdof3_Dinv[i]
+          * u.block(q_index, 0, 3, cols);
+#endif
+      }
+    } else if (model.mJoints[i].mJointType == JointTypeCustom) {
+      unsigned int kI     = model.mJoints[i].custom_joint_index;
+      unsigned int dofI   = model.mCustomJoints[kI]->mDoFCount;
+
+      u.block(q_index, 0, dofI, cols) = Tau.block(q_index, 0, dofI, cols)
+        - model.mCustomJoints[kI]->S.transpose()
+        * pA.block(6 * i, 0, 6, cols);
+
+      if (lambda != 0) {
+        pa = pA.block(6 * i, 0, 6, cols);
+#ifdef EIGEN_CORE_H
+        pa.noalias() += model.mCustomJoints[kI]->U
+          * model.mCustomJoints[kI]->Dinv
+          * u.block(q_index, 0, dofI, cols);
+#else
+        pa += model.mCustomJoints[kI]->U
+          * model.mCustomJoints[kI]->Dinv
+          * u.block(q_index, 0, dofI, cols);
+#endif
+      }
+    }
+
+    if (lambda != 0) {
+      pA.block(6 * lambda, 0, 6, cols) +=
+        model.X_lambda[i].toMatrixTranspose() * pa;
+    }
+  }
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    unsigned int q_index = model.mJoints[i].q_index;
+    unsigned int lambda = model.lambda[i];
+
+    a.block(6 * i, 0, 6, cols) = model.X_lambda[i].toMatrix()
+      * a.block(6 * lambda, 0, 6, cols);
+
+    if (model.mJoints[i].mDoFCount == 1
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      QDDot.row(q_index) = (1./model.d[i]) * (u.row(q_index)
+          - model.U[i].transpose() * a.block(6 * i, 0, 6, cols));
+      a.block(6 * i, 0, 6, cols) += model.S[i] * QDDot.row(q_index);
+    } else if (model.mJoints[i].mDoFCount == 3
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      QDDot.block(q_index, 0, 3, cols) = model.multdof3_Dinv[i]
+        * (u.block(q_index, 0, 3, cols)
+            - model.multdof3_U[i].transpose() * a.block(6 * i, 0, 6, cols));
+      a.block(6 * i, 0, 6, cols) += model.multdof3_S[i]
+        * QDDot.block(q_index, 0, 3, cols);
+    } else if (model.mJoints[i].mJointType == JointTypeCustom) {
+      unsigned int kI     = model.mJoints[i].custom_joint_index;
+      unsigned int dofI   = model.mCustomJoints[kI]->mDoFCount;
+
+      QDDot.block(q_index, 0, dofI, cols) = model.mCustomJoints[kI]->Dinv
+        * (u.block(q_index, 0, dofI, cols)
+            - model.mCustomJoints[kI]->U.transpose()
+            * a.block(6 * i, 0, 6, cols));
+      a.block(6 * i, 0, 6, cols) += model.mCustomJoints[kI]->S
+        * QDDot.block(q_index, 0, dofI, cols);
+    }
+  }
+}
+
+RBDL_DLLAPI void CalcForwardDynamicsParameterDerivatives (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    const VectorNd &Tau,
+    MatrixNd &QDDot_params,
+    VectorNd *QDDot,
+    std::vector<SpatialVector> *f_ext) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  unsigned int param_count = 10 * (model.mBodies.size() - 1);
+
+  assert (QDDot_params.rows() == model.qdot_size
+      && QDDot_params.cols() == param_count);
+
+  VectorNd qddot (VectorNd::Zero (model.qdot_size));
+  ForwardDynamics (model, Q, QDot, Tau, qddot, f_ext);
+
+  // Differentiating H(q) qddot + C(q, qdot) = Y(q, qdot, qddot) pi + ...
+  // = tau with respect to the parameters pi yields
+  // H dqddot/dpi = -Y(q, qdot, qddot).
+  MatrixNd Y (MatrixNd::Zero (model.qdot_size, param_count));
+  CalcInertialParameterRegressor (model, Q, QDot, qddot, Y);
+
+  // ForwardDynamics() has already computed the articulated body inertias.
+  CalcMInvTimesTau (model, Q, Y, QDDot_params, false);
+  QDDot_params = -QDDot_params;
+
+  if (QDDot != NULL) {
+    *QDDot = qddot;
+  }
+}
+
+RBDL_DLLAPI void CalcBodyInertialParameterJacobian (
+    const Body &body,
+    MatrixNd &J) {
+  assert (J.rows() == 10 && J.cols() == 10);
+
+  double m = body.mMass;
+  const Vector3d &c = body.mCenterOfMass;
+
+  J.setZero();
+
+  // mass and first mass moment h = m c
+  J(0,0) = 1.;
+  for (unsigned int k = 0; k < 3; k++) {
+    J(1 + k, 0) = c[k];
+    J(1 + k, 1 + k) = m;
+  }
+
+  // rotational inertia at the origin I = I_C + m (c^T c 1 - c c^T)
+  Matrix3d C_outer = c * c.transpose();
+  Matrix3d dI_dm = Matrix3d::Identity() * c.squaredNorm() - C_outer;
+  unsigned int rows[6] = { 0, 1, 1, 2, 2, 2 };
+  unsigned int cols[6] = { 0, 0, 1, 0, 1, 2 };
+
+  for (unsigned int e = 0; e < 6; e++) {
+    J(4 + e, 0) = dI_dm(rows[e], cols[e]);
+
+    for (unsigned int k = 0; k < 3; k++) {
+      Vector3d e_k (Vector3d::Zero());
+      e_k[k] = 1.;
+      Matrix3d dI_dc = (Matrix3d::Identity() * 2. * c[k]
+          - e_k * c.transpose() - c * e_k.transpose()) * m;
+      J(4 + e, 1 + k) = dI_dc(rows[e], cols[e]);
+    }
+
+    J(4 + e, 4 + e) = 1.;
+  }
+}
+
+RBDL_DLLAPI void CalcOperationalSpaceInverseInertia (
+    Model &model,
+    const VectorNd &Q,
+    const std::vector<unsigned int> &body_id,
+    const std::vector<Vector3d> &point_position,
+    MatrixNd &LambdaInv,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (body_id.size() == point_position.size());
+  assert (LambdaInv.rows() == 6 * body_id.size()
+      && LambdaInv.cols() == 6 * body_id.size());
+
+  if (update_kinematics) {
+    CalcArticulatedBodyInertias (model, Q);
+
+    for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+      unsigned int lambda = model.lambda[i];
+
+      if (lambda != 0) {
+        model.X_base[i] = model.X_lambda[i] * model.X_base[lambda];
+      } else {
+        model.X_base[i] = model.X_lambda[i];
+      }
+    }
+  }
+
+  // Only the bodies that support one of the operational frames are needed.
+  std::vector<unsigned int> reference_body_id (body_id.size());
+  std::vector<bool> in_support (model.mBodies.size(), false);
+
+  for (unsigned int k = 0; k < body_id.size(); k++) {
+    reference_body_id[k] = body_id[k];
+
+    if (model.IsFixedBodyId(body_id[k])) {
+      unsigned int fbody_id = body_id[k] - model.fixed_body_discriminator;
+      reference_body_id[k] = model.mFixedBodies[fbody_id].mMovableParent;
+    }
+
+    unsigned int j = reference_body_id[k];
+    while (j != 0 && !in_support[j]) {
+      in_support[j] = true;
+      j = model.lambda[j];
+    }
+  }
+
+  // The force propagators chi[i] = X_lambda^T (1 - U D^-1 S^T) map a test
+  // force on body i to the force it transmits to its parent. Omega[i] is
+  // the inverse inertia of body i in body coordinates, i.e. the spatial
+  // acceleration of body i caused by a unit test force on body i.
+  std::vector<SpatialMatrix> chi (model.mBodies.size());
+  std::vector<SpatialMatrix> Omega (model.mBodies.size());
+  Omega[0].setZero();
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    if (!in_support[i]) {
+      continue;
+    }
+
+    SpatialMatrix F = SpatialMatrix::Identity();
+    SpatialMatrix SDinvST;
+
+    if (model.mJoints[i].mDoFCount == 1
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      F -= model.U[i] * (model.S[i] / model.d[i]).transpose();
+      SDinvST = model.S[i] * (model.S[i] / model.d[i]).transpose();
+    } else if (model.mJoints[i].mDoFCount == 3
+        && model.mJoints[i].mJointType != JointTypeCustom) {
+      F -= model.multdof3_U[i] * model.multdof3_Dinv[i]
+        * model.multdof3_S[i].transpose();
+      SDinvST = model.multdof3_S[i] * model.multdof3_Dinv[i]
+        * model.multdof3_S[i].transpose();
+    } else if (model.mJoints[i].mJointType == JointTypeCustom) {
+      unsigned int kI = model.mJoints[i].custom_joint_index;
+      F -= model.mCustomJoints[kI]->U * model.mCustomJoints[kI]->Dinv
+        * model.mCustomJoints[kI]->S.transpose();
+      SDinvST = model.mCustomJoints[kI]->S * model.mCustomJoints[kI]->Dinv
+        * model.mCustomJoints[kI]->S.transpose();
+    }
+
+    chi[i] = model.X_lambda[i].toMatrixTranspose() * F;
+    Omega[i] = chi[i].transpose() * Omega[model.lambda[i]] * chi[i]
+      + SDinvST;
+  }
+
+  // Transformations from body coordinates to the operational frames which
+  // are located at the points and aligned with the base coordinates (the
+  // convention of CalcPointJacobian6D()).
+  std::vector<SpatialMatrix> T (body_id.size());
+  for (unsigned int k = 0; k < body_id.size(); k++) {
+    Vector3d point_base = CalcBodyToBaseCoordinates (model, Q, body_id[k],
+        point_position[k], false);
+    T[k] = (SpatialTransform (Matrix3d::Identity(), point_base)
+        * model.X_base[reference_body_id[k]].inverse()).toMatrix();
+  }
+
+  // The coupling between two frames passes through the inverse inertia of
+  // the nearest common ancestor of their bodies. Parents always have
+  // smaller ids than their children which lets us walk up both branches
+  // simultaneously.
+  for (unsigned int k = 0; k < body_id.size(); k++) {
+    for (unsigned int l = k; l < body_id.size(); l++) {
+      unsigned int i = reference_body_id[k];
+      unsigned int j = reference_body_id[l];
+      SpatialMatrix P_i = SpatialMatrix::Identity();
+      SpatialMatrix P_j = SpatialMatrix::Identity();
+
+      while (i != j) {
+        if (i > j) {
+          P_i = chi[i] * P_i;
+          i = model.lambda[i];
+        } else {
+          P_j = chi[j] * P_j;
+          j = model.lambda[j];
+        }
+      }
+
+      SpatialMatrix Omega_kl;
+      if (i == 0) {
+        Omega_kl.setZero();
+      } else {
+        Omega_kl = P_i.transpose() * Omega[i] * P_j;
+      }
+
+      LambdaInv.block(6 * k, 6 * l, 6, 6) =
+        T[k] * Omega_kl * T[l].transpose();
+      if (l != k) {
+        LambdaInv.block(6 * l, 6 * k, 6, 6) =
+          LambdaInv.block(6 * k, 6 * l, 6, 6).transpose();
+      }
+    }
+  }
+}
+
 } /* namespace RigidBodyDynamics */
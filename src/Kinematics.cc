@@ -429,6 +429,351 @@ RBDL_DLLAPI void CalcBodySpatialJacobian (
   }
 }
 
+/* Computes the motion subspace of joint j in base coordinates and its time
+ * derivative and stores them in the columns q_index ... q_index + dof - 1 of
+ * S_base and S_base_dot.
+ */
+static void CalcJointMotionSubspaceBase (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    unsigned int j,
+    MatrixNd &S_base,
+    MatrixNd &S_base_dot) {
+  const Joint &joint = model.mJoints[j];
+  unsigned int q_index = joint.q_index;
+
+  SpatialMatrix X_base_inv = model.X_base[j].inverse().toMatrix();
+  SpatialMatrix v_base_cross =
+    crossm (model.X_base[j].inverse().apply(model.v[j]));
+
+  if (joint.mJointType != JointTypeCustom && joint.mDoFCount == 1) {
+    // For single DoF joints the apparent derivative of S is proportional
+    // to qdot: c_J = (dS/dq * qdot) * qdot.
+    SpatialVector S_dot (SpatialVector::Zero());
+    if (QDot[q_index] != 0.) {
+      S_dot = model.c_J[j] / QDot[q_index];
+    }
+
+    SpatialVector S_base_j = X_base_inv * model.S[j];
+    S_base.block(0, q_index, 6, 1) = S_base_j;
+    S_base_dot.block(0, q_index, 6, 1) = v_base_cross * S_base_j
+      + X_base_inv * S_dot;
+  } else if (joint.mJointType != JointTypeCustom && joint.mDoFCount == 3) {
+    Matrix63 S_dot (Matrix63::Zero());
+
+    if (joint.mJointType == JointTypeEulerZYX
+        || joint.mJointType == JointTypeEulerXYZ
+        || joint.mJointType == JointTypeEulerYXZ
+        || joint.mJointType == JointTypeEulerZXY) {
+      double s1 = sin (Q[q_index + 1]);
+      double c1 = cos (Q[q_index + 1]);
+      double s2 = sin (Q[q_index + 2]);
+      double c2 = cos (Q[q_index + 2]);
+      double qdot1 = QDot[q_index + 1];
+      double qdot2 = QDot[q_index + 2];
+
+      if (joint.mJointType == JointTypeEulerZYX) {
+        S_dot(0,0) = -c1 * qdot1;
+        S_dot(1,0) = -s1 * s2 * qdot1 + c1 * c2 * qdot2;
+        S_dot(1,1) = -s2 * qdot2;
+        S_dot(2,0) = -s1 * c2 * qdot1 - c1 * s2 * qdot2;
+        S_dot(2,1) = -c2 * qdot2;
+      } else if (joint.mJointType == JointTypeEulerXYZ) {
+        S_dot(0,0) = -s2 * c1 * qdot2 - c2 * s1 * qdot1;
+        S_dot(0,1) = c2 * qdot2;
+        S_dot(1,0) = -c2 * c1 * qdot2 + s2 * s1 * qdot1;
+        S_dot(1,1) = -s2 * qdot2;
+        S_dot(2,0) = c1 * qdot1;
+      } else if (joint.mJointType == JointTypeEulerYXZ) {
+        S_dot(0,0) = c2 * c1 * qdot2 - s2 * s1 * qdot1;
+        S_dot(0,1) = -s2 * qdot2;
+        S_dot(1,0) = -s2 * c1 * qdot2 - c2 * s1 * qdot1;
+        S_dot(1,1) = -c2 * qdot2;
+        S_dot(2,0) = -c1 * qdot1;
+      } else {
+        S_dot(0,0) = -c2 * c1 * qdot2 + s2 * s1 * qdot1;
+        S_dot(0,1) = -s2 * qdot2;
+        S_dot(1,0) = c1 * qdot1;
+        S_dot(2,0) = -s1 * c2 * qdot1 - c1 * s2 * qdot2;
+        S_dot(2,1) = c2 * qdot2;
+      }
+    }
+
+    Matrix63 S_base_j = X_base_inv * model.multdof3_S[j];
+    S_base.block(0, q_index, 6, 3) = S_base_j;
+    S_base_dot.block(0, q_index, 6, 3) = v_base_cross * S_base_j
+      + X_base_inv * S_dot;
+  } else {
+    unsigned int k = joint.custom_joint_index;
+    unsigned int dof_count = model.mCustomJoints[k]->mDoFCount;
+
+    MatrixNd S_dot (MatrixNd::Zero (6, dof_count));
+    if (dof_count == 1) {
+      if (QDot[q_index] != 0.) {
+        S_dot.block(0, 0, 6, 1) = model.c_J[j] / QDot[q_index];
+      }
+    } else {
+      std::cerr << "Error: motion subspace derivative of custom joints with "
+        << "more than one degree of freedom is not supported!" << std::endl;
+      abort();
+    }
+
+    MatrixNd S_base_j = X_base_inv * model.mCustomJoints[k]->S;
+    S_base.block(0, q_index, 6, dof_count) = S_base_j;
+    S_base_dot.block(0, q_index, 6, dof_count) = v_base_cross * S_base_j
+      + X_base_inv * S_dot;
+  }
+}
+
+/* Evaluates the point jacobian derivative of a point given in base
+ * coordinates (point_base) with velocity point_velocity from the motion
+ * subspaces of the joints that support reference_body_id. Only the three
+ * linear rows are written if only_linear is true, otherwise all six rows.
+ * The rows are written into G starting at row_offset.
+ */
+static void CalcPointJacobianDotFromSubspaces (
+    Model &model,
+    unsigned int reference_body_id,
+    const Vector3d &point_base,
+    const Vector3d &point_velocity,
+    const MatrixNd &S_base,
+    const MatrixNd &S_base_dot,
+    MatrixNd &G,
+    unsigned int row_offset,
+    bool only_linear) {
+  unsigned int j = reference_body_id;
+
+  while (j != 0) {
+    unsigned int q_index = model.mJoints[j].q_index;
+    unsigned int dof_count = model.mJoints[j].mDoFCount;
+    if (model.mJoints[j].mJointType == JointTypeCustom) {
+      dof_count =
+        model.mCustomJoints[model.mJoints[j].custom_joint_index]->mDoFCount;
+    }
+
+    for (unsigned int k = q_index; k < q_index + dof_count; k++) {
+      Vector3d omega (S_base(0,k), S_base(1,k), S_base(2,k));
+      Vector3d omega_dot (S_base_dot(0,k), S_base_dot(1,k), S_base_dot(2,k));
+      Vector3d lin_dot = Vector3d (S_base_dot(3,k), S_base_dot(4,k),
+          S_base_dot(5,k))
+        + omega_dot.cross(point_base)
+        + omega.cross(point_velocity);
+
+      if (only_linear) {
+        G.block(row_offset, k, 3, 1) = lin_dot;
+      } else {
+        G.block(row_offset, k, 3, 1) = omega_dot;
+        G.block(row_offset + 3, k, 3, 1) = lin_dot;
+      }
+    }
+
+    j = model.lambda[j];
+  }
+}
+
+/* Computes the base coordinates and the linear velocity of a point and
+ * returns the id of the movable body the point is attached to. */
+static unsigned int CalcPointBaseKinematics (
+    Model &model,
+    const VectorNd &Q,
+    unsigned int body_id,
+    const Vector3d &point_position,
+    Vector3d &point_base,
+    Vector3d &point_velocity) {
+  unsigned int reference_body_id = body_id;
+
+  if (model.IsFixedBodyId(body_id)) {
+    unsigned int fbody_id = body_id - model.fixed_body_discriminator;
+    reference_body_id = model.mFixedBodies[fbody_id].mMovableParent;
+  }
+
+  point_base = CalcBodyToBaseCoordinates (model, Q, body_id, point_position,
+      false);
+
+  SpatialVector v_base =
+    model.X_base[reference_body_id].inverse().apply(model.v[reference_body_id]);
+  point_velocity = Vector3d (v_base[3], v_base[4], v_base[5])
+    + Vector3d (v_base[0], v_base[1], v_base[2]).cross(point_base);
+
+  return reference_body_id;
+}
+
+/* Evaluates the motion subspaces of all joints that support
+ * reference_body_id. */
+static void CalcSupportMotionSubspacesBase (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    unsigned int reference_body_id,
+    MatrixNd &S_base,
+    MatrixNd &S_base_dot) {
+  unsigned int j = reference_body_id;
+
+  while (j != 0) {
+    CalcJointMotionSubspaceBase (model, Q, QDot, j, S_base, S_base_dot);
+    j = model.lambda[j];
+  }
+}
+
+RBDL_DLLAPI void CalcPointJacobianDot (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    unsigned int body_id,
+    const Vector3d &point_position,
+    MatrixNd &G,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  // update the Kinematics if necessary
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, &QDot, NULL);
+  }
+
+  assert (G.rows() == 3 && G.cols() == model.qdot_size );
+
+  Vector3d point_base;
+  Vector3d point_velocity;
+  unsigned int reference_body_id = CalcPointBaseKinematics (model, Q, body_id,
+      point_position, point_base, point_velocity);
+
+  CalcSupportMotionSubspacesBase (model, Q, QDot, reference_body_id,
+      model.S_base, model.S_base_dot);
+
+  CalcPointJacobianDotFromSubspaces (model, reference_body_id, point_base,
+      point_velocity, model.S_base, model.S_base_dot, G, 0, true);
+}
+
+RBDL_DLLAPI void CalcPointJacobianDot (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    const std::vector<unsigned int> &body_id,
+    const std::vector<Vector3d> &point_position,
+    MatrixNd &G,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  // update the Kinematics if necessary
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, &QDot, NULL);
+  }
+
+  assert (body_id.size() == point_position.size());
+  assert (G.rows() == 3 * body_id.size() && G.cols() == model.qdot_size );
+
+  // The motion subspaces are evaluated once for each joint in the union of
+  // the support chains of the points and shared by all points.
+  model.S_base_valid.assign (model.mBodies.size(), false);
+
+  for (unsigned int i = 0; i < body_id.size(); i++) {
+    Vector3d point_base;
+    Vector3d point_velocity;
+    unsigned int reference_body_id = CalcPointBaseKinematics (model, Q,
+        body_id[i], point_position[i], point_base, point_velocity);
+
+    unsigned int j = reference_body_id;
+    while (j != 0 && !model.S_base_valid[j]) {
+      CalcJointMotionSubspaceBase (model, Q, QDot, j, model.S_base,
+          model.S_base_dot);
+      model.S_base_valid[j] = true;
+      j = model.lambda[j];
+    }
+
+    CalcPointJacobianDotFromSubspaces (model, reference_body_id, point_base,
+        point_velocity, model.S_base, model.S_base_dot, G, 3 * i, true);
+  }
+}
+
+RBDL_DLLAPI void CalcPointJacobian6DDot (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    unsigned int body_id,
+    const Vector3d &point_position,
+    MatrixNd &G,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  // update the Kinematics if necessary
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, &QDot, NULL);
+  }
+
+  assert (G.rows() == 6 && G.cols() == model.qdot_size );
+
+  Vector3d point_base;
+  Vector3d point_velocity;
+  unsigned int reference_body_id = CalcPointBaseKinematics (model, Q, body_id,
+      point_position, point_base, point_velocity);
+
+  CalcSupportMotionSubspacesBase (model, Q, QDot, reference_body_id,
+      model.S_base, model.S_base_dot);
+
+  CalcPointJacobianDotFromSubspaces (model, reference_body_id, point_base,
+      point_velocity, model.S_base, model.S_base_dot, G, 0, false);
+}
+
+RBDL_DLLAPI void CalcBodySpatialJacobianDot (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    unsigned int body_id,
+    MatrixNd &G,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  // update the Kinematics if necessary
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, &QDot, NULL);
+  }
+
+  assert (G.rows() == 6 && G.cols() == model.qdot_size );
+
+  unsigned int reference_body_id = body_id;
+
+  SpatialTransform base_to_body;
+
+  if (model.IsFixedBodyId(body_id)) {
+    unsigned int fbody_id = body_id - model.fixed_body_discriminator;
+    reference_body_id = model.mFixedBodies[fbody_id].mMovableParent;
+    base_to_body = model.mFixedBodies[fbody_id].mParentTransform
+      * model.X_base[reference_body_id];
+  } else {
+    base_to_body = model.X_base[reference_body_id];
+  }
+
+  MatrixNd S_base (MatrixNd::Zero (6, model.qdot_size));
+  MatrixNd S_base_dot (MatrixNd::Zero (6, model.qdot_size));
+  CalcSupportMotionSubspacesBase (model, Q, QDot, reference_body_id,
+      S_base, S_base_dot);
+
+  // G = X_body * S_base and the body coordinate frame moves with the
+  // velocity v_body, therefore dG/dt = X_body * (S_base_dot - v_body x S_base).
+  SpatialMatrix X_body = base_to_body.toMatrix();
+  SpatialMatrix v_body_cross = crossm (
+      model.X_base[reference_body_id].inverse().apply(
+        model.v[reference_body_id]));
+
+  unsigned int j = reference_body_id;
+
+  while (j != 0) {
+    unsigned int q_index = model.mJoints[j].q_index;
+    unsigned int dof_count = model.mJoints[j].mDoFCount;
+    if (model.mJoints[j].mJointType == JointTypeCustom) {
+      dof_count =
+        model.mCustomJoints[model.mJoints[j].custom_joint_index]->mDoFCount;
+    }
+
+    G.block(0, q_index, 6, dof_count) = X_body
+      * (S_base_dot.block(0, q_index, 6, dof_count)
+          - v_body_cross * S_base.block(0, q_index, 6, dof_count));
+
+    j = model.lambda[j];
+  }
+}
+
 RBDL_DLLAPI Vector3d CalcPointVelocity (
     Model &model,
     const VectorNd &Q,
@@ -599,6 +944,245 @@ RBDL_DLLAPI SpatialVector CalcPointAcceleration6D(
       + SpatialVector (0, 0, 0, a_dash[0], a_dash[1], a_dash[2]));
 }
 
+/** Writes the pose of a transformation from base to body coordinates.
+ *
+ * The quaternion is computed from the rotation R = E^T with the method
+ * of Shepperd that avoids divisions by small values.
+ */
+static void WriteBodyPose (
+    const SpatialTransform &X,
+    PoseLayout layout,
+    double *pose) {
+  const Matrix3d &E = X.E;
+
+  if (layout == PoseLayoutMatrix3x4) {
+    for (unsigned int i = 0; i < 3; i++) {
+      pose[4 * i] = E(0, i);
+      pose[4 * i + 1] = E(1, i);
+      pose[4 * i + 2] = E(2, i);
+      pose[4 * i + 3] = X.r[i];
+    }
+    return;
+  }
+
+  pose[0] = X.r[0];
+  pose[1] = X.r[1];
+  pose[2] = X.r[2];
+
+  // R(i,j) = E(j,i)
+  double trace = E(0,0) + E(1,1) + E(2,2);
+  double x, y, z, w;
+
+  if (trace > E(0,0) && trace > E(1,1) && trace > E(2,2)) {
+    double s = 2. * sqrt (1. + trace);
+    w = 0.25 * s;
+    x = (E(1,2) - E(2,1)) / s;
+    y = (E(2,0) - E(0,2)) / s;
+    z = (E(0,1) - E(1,0)) / s;
+  } else if (E(0,0) >= E(1,1) && E(0,0) >= E(2,2)) {
+    double s = 2. * sqrt (1. + E(0,0) - E(1,1) - E(2,2));
+    w = (E(1,2) - E(2,1)) / s;
+    x = 0.25 * s;
+    y = (E(1,0) + E(0,1)) / s;
+    z = (E(2,0) + E(0,2)) / s;
+  } else if (E(1,1) >= E(2,2)) {
+    double s = 2. * sqrt (1. - E(0,0) + E(1,1) - E(2,2));
+    w = (E(2,0) - E(0,2)) / s;
+    x = (E(1,0) + E(0,1)) / s;
+    y = 0.25 * s;
+    z = (E(2,1) + E(1,2)) / s;
+  } else {
+    double s = 2. * sqrt (1. - E(0,0) - E(1,1) + E(2,2));
+    w = (E(0,1) - E(1,0)) / s;
+    x = (E(2,0) + E(0,2)) / s;
+    y = (E(2,1) + E(1,2)) / s;
+    z = 0.25 * s;
+  }
+
+  // use the quaternion with non-negative w such that the output is unique
+  double sign = w < 0. ? -1. : 1.;
+  pose[3] = sign * x;
+  pose[4] = sign * y;
+  pose[5] = sign * z;
+  pose[6] = sign * w;
+}
+
+RBDL_DLLAPI unsigned int GetBodyPosesSize (
+    const Model &model,
+    PoseLayout layout,
+    bool fixed_bodies) {
+  unsigned int pose_size = (layout == PoseLayoutMatrix3x4) ? 12 : 7;
+  unsigned int body_count = model.mBodies.size() - 1;
+
+  if (fixed_bodies) {
+    body_count += model.mFixedBodies.size();
+  }
+
+  return pose_size * body_count;
+}
+
+RBDL_DLLAPI void CalcBodyPoses (
+    Model &model,
+    const VectorNd &Q,
+    PoseLayout layout,
+    double *buffer,
+    bool fixed_bodies,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  unsigned int pose_size = (layout == PoseLayoutMatrix3x4) ? 12 : 7;
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    if (update_kinematics) {
+      unsigned int lambda = model.lambda[i];
+
+      jcalc_X_lambda_S (model, i, Q);
+
+      if (lambda != 0) {
+        model.X_base[i] = model.X_lambda[i] * model.X_base[lambda];
+      } else {
+        model.X_base[i] = model.X_lambda[i];
+      }
+    }
+
+    WriteBodyPose (model.X_base[i], layout, buffer + (i - 1) * pose_size);
+  }
+
+  if (fixed_bodies) {
+    double *fixed_buffer = buffer + (model.mBodies.size() - 1) * pose_size;
+
+    for (unsigned int k = 0; k < model.mFixedBodies.size(); k++) {
+      const FixedBody &fbody = model.mFixedBodies[k];
+
+      WriteBodyPose (
+          fbody.mParentTransform * model.X_base[fbody.mMovableParent],
+          layout, fixed_buffer + k * pose_size);
+    }
+  }
+}
+
+RBDL_DLLAPI void CalcBodyPosesBatch (
+    Model &model,
+    const MatrixNd &Qs,
+    PoseLayout layout,
+    double *buffer,
+    bool fixed_bodies) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (Qs.rows() == model.q_size);
+
+  unsigned int poses_size = GetBodyPosesSize (model, layout, fixed_bodies);
+  VectorNd Q (model.q_size);
+
+  for (unsigned int k = 0; k < Qs.cols(); k++) {
+    Q = Qs.col(k);
+    CalcBodyPoses (model, Q, layout, buffer + k * poses_size, fixed_bodies,
+        true);
+  }
+}
+
+void OperationalFrameKinematics::Bind (const Model &model) {
+  unsigned int frame_count = model.mOperationalFrames.size();
+
+  positions = MatrixNd::Zero (3, frame_count);
+  orientations = MatrixNd::Zero (3, 3 * frame_count);
+  velocities = MatrixNd::Zero (6, frame_count);
+  accelerations = MatrixNd::Zero (6, frame_count);
+  jacobians = MatrixNd::Zero (6 * frame_count, model.qdot_size);
+  mMotionSubspaces = MatrixNd::Zero (6, model.qdot_size);
+
+  bound = true;
+}
+
+RBDL_DLLAPI void CalcOperationalFrameKinematics (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd *QDot,
+    const VectorNd *QDDot,
+    OperationalFrameKinematics &kinematics,
+    bool compute_jacobians,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (kinematics.bound);
+  assert (kinematics.positions.cols() == model.mOperationalFrames.size());
+  assert (QDDot == NULL || QDot != NULL);
+
+  if (update_kinematics) {
+    // Reset the velocity and acceleration of the root body
+    model.v[0].setZero();
+    model.a[0].setZero();
+
+    UpdateKinematicsCustom (model, &Q, QDot, QDDot);
+  }
+
+  if (compute_jacobians) {
+    for (unsigned int j = 1; j < model.mBodies.size(); j++) {
+      unsigned int q_index = model.mJoints[j].q_index;
+
+      if (model.mJoints[j].mJointType != JointTypeCustom) {
+        if (model.mJoints[j].mDoFCount == 1) {
+          kinematics.mMotionSubspaces.col(q_index)
+            = model.X_base[j].inverse().apply(model.S[j]);
+        } else if (model.mJoints[j].mDoFCount == 3) {
+          kinematics.mMotionSubspaces.block(0, q_index, 6, 3)
+            = model.X_base[j].inverse().toMatrix() * model.multdof3_S[j];
+        }
+      } else {
+        unsigned int k = model.mJoints[j].custom_joint_index;
+
+        kinematics.mMotionSubspaces.block(0, q_index, 6,
+            model.mCustomJoints[k]->mDoFCount)
+          = model.X_base[j].inverse().toMatrix() * model.mCustomJoints[k]->S;
+      }
+    }
+  }
+
+  for (unsigned int k = 0; k < model.mOperationalFrames.size(); k++) {
+    const OperationalFrame &frame = model.mOperationalFrames[k];
+    unsigned int body_id = frame.movable_body_id;
+
+    SpatialTransform X_frame = frame.movable_transform * model.X_base[body_id];
+    kinematics.positions.col(k) = X_frame.r;
+    kinematics.orientations.block(0, 3 * k, 3, 3) = X_frame.E;
+
+    if (QDot != NULL) {
+      // the frame origin with the orientation of the base
+      SpatialTransform p_X_i (model.X_base[body_id].E.transpose(),
+          frame.movable_transform.r);
+
+      SpatialVector p_v_i = p_X_i.apply(model.v[body_id]);
+      kinematics.velocities.col(k) = p_v_i;
+
+      if (QDDot != NULL) {
+        Vector3d a_dash = Vector3d (p_v_i[0], p_v_i[1], p_v_i[2]
+            ).cross(Vector3d (p_v_i[3], p_v_i[4], p_v_i[5]));
+        kinematics.accelerations.col(k) = p_X_i.apply(model.a[body_id])
+          + SpatialVector (0, 0, 0, a_dash[0], a_dash[1], a_dash[2]);
+      }
+    }
+
+    if (compute_jacobians) {
+      kinematics.jacobians.block(6 * k, 0, 6, model.qdot_size).setZero();
+
+      unsigned int j = body_id;
+      while (j != 0) {
+        unsigned int q_index = model.mJoints[j].q_index;
+
+        for (unsigned int i = q_index; i < q_index + model.mJoints[j].mDoFCount; i++) {
+          Vector3d omega = kinematics.mMotionSubspaces.block(0, i, 3, 1);
+          Vector3d v = kinematics.mMotionSubspaces.block(3, i, 3, 1);
+
+          kinematics.jacobians.block(6 * k, i, 3, 1) = omega;
+          kinematics.jacobians.block(6 * k + 3, i, 3, 1) = v + omega.cross(X_frame.r);
+        }
+
+        j = model.lambda[j];
+      }
+    }
+  }
+}
+
 RBDL_DLLAPI bool InverseKinematics (
     Model &model,
     const VectorNd &Qinit,
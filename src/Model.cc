@@ -35,6 +35,7 @@ Model::Model() {
   q_size = 0;
   qdot_size = 0;
   previously_added_body_id = 0;
+  defer_index_update = false;
 
   gravity = Vector3d (0., -9.81, 0.);
 
@@ -57,6 +58,13 @@ Model::Model() {
   multdof3_u.push_back (Vector3d::Zero());
   multdof3_w_index.push_back (0);
 
+  // Hybrid dynamics
+  hybrid_S_known.push_back (MatrixNd());
+  hybrid_S_free.push_back (MatrixNd());
+  hybrid_U_free.push_back (MatrixNd());
+  hybrid_Dinv_free.push_back (MatrixNd());
+  hybrid_u_free.push_back (VectorNd());
+
   // Dynamic variables
   c.push_back(zero_spatial);
   IA.push_back(SpatialMatrix::Identity());
@@ -67,17 +75,21 @@ Model::Model() {
   d = VectorNd::Zero(1);
 
   f.push_back (zero_spatial);
+  f_penalty.push_back (zero_spatial);
   SpatialRigidBodyInertia rbi(0.,
       Vector3d (0., 0., 0.),
       Matrix3d::Zero(3,3));
   Ic.push_back (rbi);
   I.push_back(rbi);
+  I_body.push_back(rbi);
   hc.push_back (zero_spatial);
   hdotc.push_back (zero_spatial);
 
   // Bodies
   X_lambda.push_back(SpatialTransform());
   X_base.push_back(SpatialTransform());
+  mFixedParent.push_back(0);
+  X_T_fixed.push_back(SpatialTransform());
 
   mBodies.push_back(root_body);
   mBodyNameMap["ROOT"] = 0;
@@ -85,6 +97,57 @@ Model::Model() {
   fixed_body_discriminator = std::numeric_limits<unsigned int>::max() / 2;
 }
 
+/** \brief Updates the quantities that depend on all joints of the model,
+ * i.e. the indices of the quaternion w components, q_size, the workspaces
+ * d, u and S_base and the joint update order.
+ */
+static void UpdateIndexTables (Model &model) {
+  // update the w components of the Quaternions. They are stored at the end
+  // of the q vector
+  unsigned int multdof3_joint_counter = 0;
+  for (unsigned int i = 1; i < model.mJoints.size(); i++) {
+    if (model.mJoints[i].mJointType == JointTypeSpherical) {
+      model.multdof3_w_index[i] = model.dof_count + multdof3_joint_counter;
+      multdof3_joint_counter++;
+    }
+  }
+
+  model.q_size = model.dof_count + multdof3_joint_counter;
+
+  model.d = VectorNd::Zero (model.mBodies.size());
+  model.u = VectorNd::Zero (model.mBodies.size());
+
+  model.S_base = MatrixNd::Zero (6, model.qdot_size);
+  model.S_base_dot = MatrixNd::Zero (6, model.qdot_size);
+  model.S_base_valid.assign (model.mBodies.size(), false);
+
+  // joints of the same type are updated consecutively, the groups are
+  // ordered by the first occurrence of their joint type
+  std::vector<JointType> joint_types;
+  std::vector<std::vector<unsigned int> > joint_ids;
+  for (unsigned int i = 0; i < model.mJoints.size(); i++) {
+    unsigned int type_index = 0;
+    while (type_index < joint_types.size()
+        && joint_types[type_index] != model.mJoints[i].mJointType) {
+      type_index++;
+    }
+
+    if (type_index == joint_types.size()) {
+      joint_types.push_back (model.mJoints[i].mJointType);
+      joint_ids.push_back (std::vector<unsigned int>());
+    }
+
+    joint_ids[type_index].push_back (i);
+  }
+
+  model.mJointUpdateOrder.clear();
+  model.mJointUpdateOrder.reserve (model.mJoints.size());
+  for (unsigned int j = 0; j < joint_ids.size(); j++) {
+    model.mJointUpdateOrder.insert (model.mJointUpdateOrder.end(),
+        joint_ids[j].begin(), joint_ids[j].end());
+  }
+}
+
 unsigned int AddBodyFixedJoint (
     Model &model,
     const unsigned int parent_id,
@@ -95,6 +158,8 @@ unsigned int AddBodyFixedJoint (
   FixedBody fbody = FixedBody::CreateFromBody (body);
   fbody.mMovableParent = parent_id;
   fbody.mParentTransform = joint_frame;
+  fbody.mParent = parent_id;
+  fbody.mJointFrame = joint_frame;
 
   if (model.IsFixedBodyId(parent_id)) {
     FixedBody fixed_parent =
@@ -295,12 +360,14 @@ unsigned int Model::AddBody(
   // If we add the body to a fixed body we have to make sure that we
   // actually add it to its movable parent.
   unsigned int movable_parent_id = parent_id;
+  unsigned int fixed_parent_id = 0;
   SpatialTransform movable_parent_transform;
 
   if (IsFixedBodyId(parent_id)) {
     unsigned int fbody_id = parent_id - fixed_body_discriminator;
     movable_parent_id = mFixedBodies[fbody_id].mMovableParent;
     movable_parent_transform = mFixedBodies[fbody_id].mParentTransform;
+    fixed_parent_id = parent_id;
   }
 
   // structural information
@@ -325,6 +392,8 @@ unsigned int Model::AddBody(
   // Bodies
   X_lambda.push_back(SpatialTransform());
   X_base.push_back(SpatialTransform());
+  mFixedParent.push_back(fixed_parent_id);
+  X_T_fixed.push_back(joint_frame);
   mBodies.push_back(body);
 
   if (body_name.size() != 0) {
@@ -368,21 +437,14 @@ unsigned int Model::AddBody(
   multdof3_u.push_back (Vector3d::Zero());
   multdof3_w_index.push_back (0);
 
-  dof_count = dof_count + joint.mDoFCount;
-
-  // update the w components of the Quaternions. They are stored at the end
-  // of the q vector
-  int multdof3_joint_counter = 0;
-  // int mCustomJoint_joint_counter = 0;
-  for (unsigned int i = 1; i < mJoints.size(); i++) {
-    if (mJoints[i].mJointType == JointTypeSpherical) {
-      multdof3_w_index[i] = dof_count + multdof3_joint_counter;
-      multdof3_joint_counter++;
-    }
-  }
+  // workspace for hybrid dynamics
+  hybrid_S_known.push_back (MatrixNd());
+  hybrid_S_free.push_back (MatrixNd());
+  hybrid_U_free.push_back (MatrixNd());
+  hybrid_Dinv_free.push_back (MatrixNd());
+  hybrid_u_free.push_back (VectorNd());
 
-  q_size = dof_count
-    + multdof3_joint_counter;
+  dof_count = dof_count + joint.mDoFCount;
 
   qdot_size = qdot_size + joint.mDoFCount;
 
@@ -396,10 +458,8 @@ unsigned int Model::AddBody(
   pA.push_back(SpatialVector(0., 0., 0., 0., 0., 0.));
   U.push_back(SpatialVector(0., 0., 0., 0., 0., 0.));
 
-  d = VectorNd::Zero (mBodies.size());
-  u = VectorNd::Zero (mBodies.size());
-
   f.push_back (SpatialVector (0., 0., 0., 0., 0., 0.));
+  f_penalty.push_back (SpatialVector (0., 0., 0., 0., 0., 0.));
 
   SpatialRigidBodyInertia rbi =
     SpatialRigidBodyInertia::createFromMassComInertiaC (body.mMass,
@@ -408,6 +468,7 @@ unsigned int Model::AddBody(
 
   Ic.push_back (rbi);
   I.push_back (rbi);
+  I_body.push_back (rbi);
   hc.push_back (SpatialVector(0., 0., 0., 0., 0., 0.));
   hdotc.push_back (SpatialVector(0., 0., 0., 0., 0., 0.));
 
@@ -423,39 +484,10 @@ unsigned int Model::AddBody(
 
   previously_added_body_id = mBodies.size() - 1;
 
-  mJointUpdateOrder.clear();
-
-  // update the joint order computation
-  std::vector<std::pair<JointType, unsigned int> > joint_types;
-  for (unsigned int i = 0; i < mJoints.size(); i++) {
-    joint_types.push_back(
-        std::pair<JointType, unsigned int> (mJoints[i].mJointType,i));
-    mJointUpdateOrder.push_back (mJoints[i].mJointType);
+  if (!defer_index_update) {
+    UpdateIndexTables (*this);
   }
 
-  mJointUpdateOrder.clear();
-  JointType current_joint_type = JointTypeUndefined;
-  while (joint_types.size() != 0) {
-    current_joint_type = joint_types[0].first;
-
-    std::vector<std::pair<JointType, unsigned int> >::iterator type_iter =
-      joint_types.begin();
-
-    while (type_iter != joint_types.end()) {
-      if (type_iter->first == current_joint_type) {
-        mJointUpdateOrder.push_back (type_iter->second);
-        type_iter = joint_types.erase (type_iter);
-      } else {
-        ++type_iter;
-      }
-    }
-  }
-
-  //  for (unsigned int i = 0; i < mJointUpdateOrder.size(); i++) {
-  //    std::cout << "i = " << i << ": joint_id = " << mJointUpdateOrder[i]
-  // << " joint_type = " << mJoints[mJointUpdateOrder[i]].mJointType << std::endl;
-  //  }
-
   return previously_added_body_id;
 }
 
@@ -493,3 +525,480 @@ unsigned int Model::AddBodyCustomJoint (
   return body_id;
 }
 
+/** \brief Returns the spatial inertia of a fixed body expressed at the
+ * origin of its movable parent.
+ */
+static SpatialRigidBodyInertia CalcFixedBodyParentInertia (
+    const FixedBody &fbody) {
+  SpatialTransform X_parent = fbody.mParentTransform;
+  return X_parent.applyTranspose (
+      SpatialRigidBodyInertia::createFromMassComInertiaC (
+        fbody.mMass,
+        fbody.mCenterOfMass,
+        fbody.mInertia));
+}
+
+/** \brief Recomputes Model::I and Model::mBodies of a movable body from
+ * its own inertia Model::I_body and the fixed bodies merged into it.
+ */
+static void UpdateMergedInertia (Model &model, unsigned int id) {
+  model.I[id] = model.I_body[id];
+  for (unsigned int k = 0; k < model.mFixedBodies.size(); k++) {
+    if (model.mFixedBodies[k].mMovableParent == id) {
+      model.I[id] = model.I[id]
+        + CalcFixedBodyParentInertia (model.mFixedBodies[k]);
+    }
+  }
+
+  const SpatialRigidBodyInertia &rbi = model.I[id];
+  Body &body = model.mBodies[id];
+
+  Matrix3d inertia_origin (
+      rbi.Ixx, rbi.Iyx, rbi.Izx,
+      rbi.Iyx, rbi.Iyy, rbi.Izy,
+      rbi.Izx, rbi.Izy, rbi.Izz);
+
+  body.mMass = rbi.m;
+  body.mCenterOfMass.setZero();
+  if (rbi.m != 0.) {
+    body.mCenterOfMass = rbi.h / rbi.m;
+  }
+
+  Matrix3d com_cross = VectorCrossMatrix (body.mCenterOfMass);
+  body.mInertia = inertia_origin - rbi.m * com_cross * com_cross.transpose();
+}
+
+/** \brief Recomposes the parent transforms of the fixed bodies of a
+ * movable body, the joint frames of the movable bodies and the operational
+ * frames attached to them from their stored relative joint frames.
+ */
+static void UpdateFixedBodyFrames (Model &model, unsigned int movable_id) {
+  // Fixed bodies are stored after their parents, so a single forward pass
+  // composes the transforms of nested fixed bodies.
+  for (unsigned int k = 0; k < model.mFixedBodies.size(); k++) {
+    FixedBody &fbody = model.mFixedBodies[k];
+    if (fbody.mMovableParent != movable_id) {
+      continue;
+    }
+
+    fbody.mParentTransform = fbody.mJointFrame;
+    if (model.IsFixedBodyId (fbody.mParent)) {
+      fbody.mParentTransform = fbody.mJointFrame
+        * model.mFixedBodies[fbody.mParent
+        - model.fixed_body_discriminator].mParentTransform;
+    }
+  }
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    if (model.mFixedParent[i] == 0 || model.lambda[i] != movable_id) {
+      continue;
+    }
+
+    const FixedBody &fbody = model.mFixedBodies[model.mFixedParent[i]
+      - model.fixed_body_discriminator];
+    model.X_T[i] = model.X_T_fixed[i] * fbody.mParentTransform;
+  }
+
+  for (unsigned int j = 0; j < model.mOperationalFrames.size(); j++) {
+    OperationalFrame &frame = model.mOperationalFrames[j];
+    if (!model.IsFixedBodyId (frame.body_id)
+        || frame.movable_body_id != movable_id) {
+      continue;
+    }
+
+    const FixedBody &fbody = model.mFixedBodies[frame.body_id
+      - model.fixed_body_discriminator];
+    frame.movable_transform = frame.body_transform * fbody.mParentTransform;
+  }
+}
+
+void Model::SetJointFrame (unsigned int id,
+    const SpatialTransform &transform) {
+  if (id >= fixed_body_discriminator) {
+    FixedBody &fbody = mFixedBodies[id - fixed_body_discriminator];
+
+    fbody.mJointFrame = transform;
+    if (IsFixedBodyId (fbody.mParent)) {
+      fbody.mJointFrame = transform * mFixedBodies[fbody.mParent
+        - fixed_body_discriminator].mParentTransform.inverse();
+    }
+
+    UpdateFixedBodyFrames (*this, fbody.mMovableParent);
+    UpdateMergedInertia (*this, fbody.mMovableParent);
+    return;
+  }
+
+  unsigned int child_id = id;
+  unsigned int parent_id = lambda[id];
+  if (mBodies[parent_id].mIsVirtual) {
+    while (mBodies[parent_id].mIsVirtual) {
+      child_id = parent_id;
+      parent_id = lambda[child_id];
+    }
+  } else if (id == 0) {
+    return;
+  }
+
+  X_T[child_id] = transform;
+  X_T_fixed[child_id] = transform;
+  if (mFixedParent[child_id] != 0) {
+    X_T_fixed[child_id] = transform * mFixedBodies[mFixedParent[child_id]
+      - fixed_body_discriminator].mParentTransform.inverse();
+  }
+}
+
+unsigned int Model::AddOperationalFrame (
+    unsigned int body_id,
+    const SpatialTransform &frame,
+    const std::string &frame_name) {
+  if (body_id != 0 && !IsBodyId (body_id)) {
+    std::cerr << "Error: invalid body id " << body_id
+      << " in AddOperationalFrame()!" << std::endl;
+    assert (0);
+    abort();
+  }
+
+  if (mOperationalFrameNameMap.find(frame_name)
+      != mOperationalFrameNameMap.end()) {
+    std::cerr << "Error: Operational frame with name '"
+      << frame_name
+      << "' already exists!"
+      << std::endl;
+    assert (0);
+    abort();
+  }
+
+  OperationalFrame operational_frame;
+  operational_frame.name = frame_name;
+  operational_frame.body_id = body_id;
+  operational_frame.body_transform = frame;
+  operational_frame.movable_body_id = body_id;
+  operational_frame.movable_transform = frame;
+
+  if (IsFixedBodyId (body_id)) {
+    const FixedBody &fbody = mFixedBodies[body_id - fixed_body_discriminator];
+    operational_frame.movable_body_id = fbody.mMovableParent;
+    operational_frame.movable_transform = frame * fbody.mParentTransform;
+  }
+
+  mOperationalFrames.push_back (operational_frame);
+  mOperationalFrameNameMap[frame_name] = mOperationalFrames.size() - 1;
+
+  return mOperationalFrames.size() - 1;
+}
+
+void Model::SetBodyInertialProperties (unsigned int id,
+    double mass,
+    const Vector3d &com,
+    const Matrix3d &inertia_C) {
+  if (!IsBodyId (id)) {
+    std::cerr << "Error: invalid body id " << id
+      << " in SetBodyInertialProperties()!" << std::endl;
+    assert (0);
+    abort();
+  }
+
+  if (id >= fixed_body_discriminator) {
+    FixedBody &fbody = mFixedBodies[id - fixed_body_discriminator];
+    fbody.mMass = mass;
+    fbody.mCenterOfMass = com;
+    fbody.mInertia = inertia_C;
+
+    UpdateMergedInertia (*this, fbody.mMovableParent);
+    return;
+  }
+
+  I_body[id] = SpatialRigidBodyInertia::createFromMassComInertiaC (
+      mass, com, inertia_C);
+  UpdateMergedInertia (*this, id);
+}
+
+ModelBuilder::ModelBuilder (Model &model, unsigned int body_count) :
+  model (model),
+  finalized (false) {
+  model.defer_index_update = true;
+
+  if (body_count > 0) {
+    Reserve (body_count);
+  }
+}
+
+ModelBuilder::~ModelBuilder () {
+  if (!finalized) {
+    Finalize();
+  }
+}
+
+void ModelBuilder::Reserve (unsigned int body_count) {
+  unsigned int size = model.mBodies.size() + body_count;
+
+  model.lambda.reserve (size);
+  model.lambda_q.reserve (size);
+  model.mu.reserve (size);
+  model.v.reserve (size);
+  model.a.reserve (size);
+  model.mJoints.reserve (size);
+  model.S.reserve (size);
+  model.v_J.reserve (size);
+  model.c_J.reserve (size);
+  model.X_T.reserve (size);
+  model.multdof3_S.reserve (size);
+  model.multdof3_U.reserve (size);
+  model.multdof3_Dinv.reserve (size);
+  model.multdof3_u.reserve (size);
+  model.multdof3_w_index.reserve (size);
+  model.hybrid_S_known.reserve (size);
+  model.hybrid_S_free.reserve (size);
+  model.hybrid_U_free.reserve (size);
+  model.hybrid_Dinv_free.reserve (size);
+  model.hybrid_u_free.reserve (size);
+  model.c.reserve (size);
+  model.IA.reserve (size);
+  model.pA.reserve (size);
+  model.U.reserve (size);
+  model.f.reserve (size);
+  model.f_penalty.reserve (size);
+  model.I.reserve (size);
+  model.I_body.reserve (size);
+  model.Ic.reserve (size);
+  model.hc.reserve (size);
+  model.hdotc.reserve (size);
+  model.X_lambda.reserve (size);
+  model.X_base.reserve (size);
+  model.mFixedParent.reserve (size);
+  model.X_T_fixed.reserve (size);
+  model.mBodies.reserve (size);
+}
+
+unsigned int ModelBuilder::AddBody (
+    const unsigned int parent_id,
+    const SpatialTransform &joint_frame,
+    const Joint &joint,
+    const Body &body,
+    std::string body_name) {
+  assert (!finalized);
+  return model.AddBody (parent_id, joint_frame, joint, body, body_name);
+}
+
+unsigned int ModelBuilder::AppendBody (
+    const SpatialTransform &joint_frame,
+    const Joint &joint,
+    const Body &body,
+    std::string body_name) {
+  assert (!finalized);
+  return model.AppendBody (joint_frame, joint, body, body_name);
+}
+
+unsigned int ModelBuilder::AddBodyCustomJoint (
+    const unsigned int parent_id,
+    const SpatialTransform &joint_frame,
+    CustomJoint *custom_joint,
+    const Body &body,
+    std::string body_name) {
+  assert (!finalized);
+  return model.AddBodyCustomJoint (parent_id, joint_frame, custom_joint, body,
+      body_name);
+}
+
+void ModelBuilder::Finalize () {
+  unsigned int body_count = model.mBodies.size();
+
+  if (model.lambda.size() != body_count
+      || model.mJoints.size() != body_count
+      || model.X_T.size() != body_count
+      || model.I.size() != body_count) {
+    std::cerr << "Error: inconsistent model structure in "
+      << "ModelBuilder::Finalize()!" << std::endl;
+    assert (0);
+    abort();
+  }
+
+  unsigned int q_index = 0;
+  for (unsigned int i = 1; i < body_count; i++) {
+    if (model.lambda[i] >= i) {
+      std::cerr << "Error: invalid parent " << model.lambda[i]
+        << " of body " << i << " in ModelBuilder::Finalize()!" << std::endl;
+      assert (0);
+      abort();
+    }
+
+    if (model.mJoints[i].q_index != q_index) {
+      std::cerr << "Error: invalid q_index " << model.mJoints[i].q_index
+        << " of joint " << i << " in ModelBuilder::Finalize()!" << std::endl;
+      assert (0);
+      abort();
+    }
+
+    q_index += model.mJoints[i].mDoFCount;
+  }
+
+  if (q_index != model.dof_count || model.dof_count != model.qdot_size) {
+    std::cerr << "Error: invalid number of degrees of freedom in "
+      << "ModelBuilder::Finalize()!" << std::endl;
+    assert (0);
+    abort();
+  }
+
+  UpdateIndexTables (model);
+
+  model.defer_index_update = false;
+  finalized = true;
+}
+
+void ReducedModel::ReduceQ (const VectorNd &Q, VectorNd &Q_reduced) const {
+  assert (Q_reduced.size() == q_map.size());
+
+  for (unsigned int i = 0; i < q_map.size(); i++) {
+    Q_reduced[i] = Q[q_map[i]];
+  }
+}
+
+void ReducedModel::ReduceQDot (const VectorNd &QDot,
+    VectorNd &QDot_reduced) const {
+  assert (QDot_reduced.size() == qdot_map.size());
+
+  for (unsigned int i = 0; i < qdot_map.size(); i++) {
+    QDot_reduced[i] = QDot[qdot_map[i]];
+  }
+}
+
+void ReducedModel::ExpandQ (const VectorNd &Q_reduced, VectorNd &Q) const {
+  assert (Q_reduced.size() == q_map.size());
+
+  Q = q_locked;
+  for (unsigned int i = 0; i < q_map.size(); i++) {
+    Q[q_map[i]] = Q_reduced[i];
+  }
+}
+
+void ReducedModel::ExpandQDot (const VectorNd &QDot_reduced,
+    VectorNd &QDot) const {
+  assert (QDot_reduced.size() == qdot_map.size());
+
+  QDot.setZero();
+  for (unsigned int i = 0; i < qdot_map.size(); i++) {
+    QDot[qdot_map[i]] = QDot_reduced[i];
+  }
+}
+
+RBDL_DLLAPI void RigidBodyDynamics::CreateReducedModel (
+    Model &model,
+    const VectorNd &Q,
+    const std::vector<bool> &locked_dofs,
+    ReducedModel &reduced) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (Q.size() == model.q_size);
+
+  if (locked_dofs.size() != model.qdot_size) {
+    std::cerr << "Error: invalid size " << locked_dofs.size()
+      << " of locked degrees of freedom in CreateReducedModel()!"
+      << std::endl;
+    assert (0);
+    abort();
+  }
+
+  reduced.model = Model();
+  reduced.model.gravity = model.gravity;
+  reduced.q_locked = Q;
+  reduced.body_map.assign (model.mBodies.size(), 0);
+  reduced.fixed_body_map.assign (model.mFixedBodies.size(), 0);
+  reduced.fixed_body_discriminator = model.fixed_body_discriminator;
+
+  std::vector<std::string> body_names (model.mBodies.size());
+  std::vector<std::string> fixed_body_names (model.mFixedBodies.size());
+  for (std::map<std::string, unsigned int>::const_iterator iter
+      = model.mBodyNameMap.begin();
+      iter != model.mBodyNameMap.end();
+      iter++) {
+    if (model.IsFixedBodyId (iter->second)) {
+      fixed_body_names[iter->second - model.fixed_body_discriminator]
+        = iter->first;
+    } else {
+      body_names[iter->second] = iter->first;
+    }
+  }
+
+  std::vector<bool> joint_locked (model.mBodies.size(), false);
+  ModelBuilder builder (reduced.model, model.mBodies.size() - 1);
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    const Joint &joint = model.mJoints[i];
+
+    unsigned int locked_count = 0;
+    for (unsigned int j = 0; j < joint.mDoFCount; j++) {
+      if (locked_dofs[joint.q_index + j]) {
+        locked_count++;
+      }
+    }
+
+    if (locked_count != 0 && locked_count != joint.mDoFCount) {
+      std::cerr << "Error: cannot lock only some degrees of freedom of the "
+        << "joint of body " << i << " in CreateReducedModel()!"
+        << std::endl;
+      assert (0);
+      abort();
+    }
+
+    unsigned int parent_id = reduced.body_map[model.lambda[i]];
+
+    if (locked_count > 0) {
+      // the joint becomes a fixed joint at the configuration Q
+      jcalc_X_lambda_S (model, i, Q);
+
+      joint_locked[i] = true;
+      reduced.body_map[i] = builder.AddBody (parent_id, model.X_lambda[i],
+          Joint (JointTypeFixed), model.mBodies[i], body_names[i]);
+    } else if (joint.mJointType == JointTypeCustom) {
+      reduced.body_map[i] = builder.AddBodyCustomJoint (parent_id,
+          model.X_T[i], model.mCustomJoints[joint.custom_joint_index],
+          model.mBodies[i], body_names[i]);
+    } else {
+      reduced.body_map[i] = builder.AddBody (parent_id, model.X_T[i], joint,
+          model.mBodies[i], body_names[i]);
+    }
+  }
+
+  // The inertias of the fixed bodies are already contained in their
+  // movable parents.
+  for (unsigned int k = 0; k < model.mFixedBodies.size(); k++) {
+    const FixedBody &fbody = model.mFixedBodies[k];
+
+    reduced.fixed_body_map[k] = builder.AddBody (
+        reduced.body_map[fbody.mMovableParent], fbody.mParentTransform,
+        Joint (JointTypeFixed), Body(), fixed_body_names[k]);
+  }
+
+  builder.Finalize();
+
+  for (unsigned int k = 0; k < model.mOperationalFrames.size(); k++) {
+    const OperationalFrame &frame = model.mOperationalFrames[k];
+
+    reduced.model.AddOperationalFrame (
+        reduced.GetReducedBodyId (frame.body_id), frame.body_transform,
+        frame.name);
+  }
+
+  reduced.q_map.assign (reduced.model.q_size, 0);
+  reduced.qdot_map.assign (reduced.model.qdot_size, 0);
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    if (joint_locked[i]) {
+      continue;
+    }
+
+    unsigned int reduced_id = reduced.body_map[i];
+    const Joint &joint = model.mJoints[i];
+    unsigned int reduced_q_index = reduced.model.mJoints[reduced_id].q_index;
+
+    for (unsigned int j = 0; j < joint.mDoFCount; j++) {
+      reduced.q_map[reduced_q_index + j] = joint.q_index + j;
+      reduced.qdot_map[reduced_q_index + j] = joint.q_index + j;
+    }
+
+    if (joint.mJointType == JointTypeSpherical) {
+      reduced.q_map[reduced.model.multdof3_w_index[reduced_id]]
+        = model.multdof3_w_index[i];
+    }
+  }
+}
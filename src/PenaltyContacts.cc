@@ -0,0 +1,143 @@
+/*
+ * RBDL - Rigid Body Dynamics Library
+ * Copyright (c) 2011-2018 Martin Felis <martin@fysx.org>
+ *
+ * Licensed under the zlib license. See LICENSE for more details.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+
+#include "rbdl/rbdl_mathutils.h"
+#include "rbdl/Logging.h"
+
+#include "rbdl/Model.h"
+#include "rbdl/Constraints.h"
+#include "rbdl/Dynamics.h"
+#include "rbdl/Kinematics.h"
+#include "rbdl/PenaltyContacts.h"
+
+namespace RigidBodyDynamics {
+
+using namespace Math;
+
+bool ContactPlane::CalcPenetration (
+    const Vector3d &point,
+    double &depth,
+    Vector3d &contact_normal) const {
+  depth = -normal.dot (point - origin);
+  contact_normal = normal;
+
+  return depth > 0.;
+}
+
+RBDL_DLLAPI
+unsigned int CalcContactPenaltyForces (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    const ConstraintSet &CS,
+    const ContactSurface &surface,
+    const HuntCrossleyParameters &parameters,
+    std::vector<SpatialVector> &f_ext,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (CS.bound);
+  assert (f_ext.size() == model.mBodies.size());
+
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, &QDot, NULL);
+  }
+
+  for (unsigned int i = 0; i < f_ext.size(); i++) {
+    f_ext[i].setZero();
+  }
+
+  unsigned int contact_count = 0;
+
+  // Contact constraints along multiple normals share the same point which
+  // must only result in a single contact force, so only the first
+  // constraint of each group of ConstraintSet::Bind() is evaluated.
+  for (unsigned int g = 0; g + 1 < CS.mContactGroupOffsets.size(); g++) {
+    unsigned int c =
+      CS.mContactGroupConstraintIndices[CS.mContactGroupOffsets[g]];
+
+    Vector3d point_base = CalcBodyToBaseCoordinates (model, Q, CS.body[c],
+        CS.point[c], false);
+
+    double depth;
+    Vector3d normal;
+    if (!surface.CalcPenetration (point_base, depth, normal)) {
+      continue;
+    }
+
+    Vector3d point_velocity = CalcPointVelocity (model, Q, QDot, CS.body[c],
+        CS.point[c], false);
+    double depth_rate = -normal.dot (point_velocity);
+
+    double force_normal = parameters.stiffness
+      * std::pow (depth, parameters.exponent)
+      * (1. + parameters.dissipation * depth_rate);
+
+    // The dissipation must not result in forces that pull the point
+    // towards the surface.
+    if (force_normal <= 0.) {
+      continue;
+    }
+
+    Vector3d velocity_tangential = point_velocity + depth_rate * normal;
+    double transition_velocity = parameters.transition_velocity;
+
+    Vector3d force = force_normal * normal
+      - parameters.friction_coefficient * force_normal * velocity_tangential
+      / std::sqrt (velocity_tangential.squaredNorm()
+          + transition_velocity * transition_velocity);
+
+    LOG << "contact point " << point_base.transpose() << " depth = " << depth
+      << " force = " << force.transpose() << std::endl;
+
+    f_ext[model.GetMovableBodyId (CS.body[c])] +=
+      SpatialTransform (Matrix3d::Identity(), -point_base).applyAdjoint (
+          SpatialVector (0., 0., 0., force[0], force[1], force[2]));
+
+    contact_count++;
+  }
+
+  return contact_count;
+}
+
+RBDL_DLLAPI
+void ForwardDynamicsContactsPenalty (
+    Model &model,
+    const VectorNd &Q,
+    const VectorNd &QDot,
+    const VectorNd &Tau,
+    const ConstraintSet &CS,
+    const ContactSurface &surface,
+    const HuntCrossleyParameters &parameters,
+    VectorNd &QDDot,
+    std::vector<SpatialVector> *f_ext,
+    std::vector<SpatialVector> *f_contact) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  std::vector<SpatialVector> &f_contacts = model.f_penalty;
+
+  CalcContactPenaltyForces (model, Q, QDot, CS, surface, parameters,
+      f_contacts);
+
+  if (f_contact != NULL) {
+    *f_contact = f_contacts;
+  }
+
+  if (f_ext != NULL) {
+    for (unsigned int i = 0; i < f_contacts.size(); i++) {
+      f_contacts[i] += (*f_ext)[i];
+    }
+  }
+
+  ForwardDynamics (model, Q, QDot, Tau, QDDot, &f_contacts);
+}
+
+} /* namespace RigidBodyDynamics */
@@ -0,0 +1,374 @@
+/*
+ * RBDL - Rigid Body Dynamics Library
+ * Copyright (c) 2011-2018 Martin Felis <martin@fysx.org>
+ *
+ * Licensed under the zlib license. See LICENSE for more details.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cassert>
+
+#include "rbdl/rbdl_mathutils.h"
+#include "rbdl/Logging.h"
+
+#include "rbdl/Model.h"
+#include "rbdl/Constraints.h"
+#include "rbdl/Kinematics.h"
+#include "rbdl/Terrain.h"
+
+namespace RigidBodyDynamics {
+
+using namespace Math;
+
+Heightfield::Heightfield() :
+  origin (0., 0., 0.),
+  cell_size_x (1.),
+  cell_size_y (1.) {
+  SetHeights (MatrixNd::Zero (2, 2));
+}
+
+Heightfield::Heightfield (
+    const Vector3d &origin,
+    double cell_size_x,
+    double cell_size_y,
+    const MatrixNd &heights) :
+  origin (origin),
+  cell_size_x (cell_size_x),
+  cell_size_y (cell_size_y) {
+  SetHeights (heights);
+}
+
+void Heightfield::SetHeights (const MatrixNd &new_heights) {
+  if (new_heights.rows() < 2 || new_heights.cols() < 2) {
+    std::cerr << "Error: a heightfield requires at least 2 x 2 heights!"
+      << std::endl;
+    assert (0);
+    abort();
+  }
+
+  heights = new_heights;
+
+  unsigned int cells_x = heights.rows() - 1;
+  unsigned int cells_y = heights.cols() - 1;
+
+  mMinHeights.clear();
+  mMaxHeights.clear();
+  mMinHeights.push_back (MatrixNd::Zero (cells_x, cells_y));
+  mMaxHeights.push_back (MatrixNd::Zero (cells_x, cells_y));
+
+  for (unsigned int i = 0; i < cells_x; i++) {
+    for (unsigned int j = 0; j < cells_y; j++) {
+      double h[4] = {
+        heights(i, j), heights(i + 1, j),
+        heights(i, j + 1), heights(i + 1, j + 1)
+      };
+      mMinHeights[0](i, j) = *std::min_element (h, h + 4);
+      mMaxHeights[0](i, j) = *std::max_element (h, h + 4);
+    }
+  }
+
+  // each level combines 2 x 2 cells of the previous level
+  while (cells_x > 1 || cells_y > 1) {
+    const MatrixNd &min_prev = mMinHeights.back();
+    const MatrixNd &max_prev = mMaxHeights.back();
+    unsigned int cells_x_prev = cells_x;
+    unsigned int cells_y_prev = cells_y;
+
+    cells_x = (cells_x + 1) / 2;
+    cells_y = (cells_y + 1) / 2;
+
+    MatrixNd min_level (MatrixNd::Zero (cells_x, cells_y));
+    MatrixNd max_level (MatrixNd::Zero (cells_x, cells_y));
+
+    for (unsigned int i = 0; i < cells_x; i++) {
+      for (unsigned int j = 0; j < cells_y; j++) {
+        min_level(i, j) = min_prev(2 * i, 2 * j);
+        max_level(i, j) = max_prev(2 * i, 2 * j);
+
+        for (unsigned int ci = 2 * i; ci < std::min (2 * i + 2, cells_x_prev); ci++) {
+          for (unsigned int cj = 2 * j; cj < std::min (2 * j + 2, cells_y_prev); cj++) {
+            min_level(i, j) = std::min (min_level(i, j), min_prev(ci, cj));
+            max_level(i, j) = std::max (max_level(i, j), max_prev(ci, cj));
+          }
+        }
+      }
+    }
+
+    mMinHeights.push_back (min_level);
+    mMaxHeights.push_back (max_level);
+  }
+}
+
+/** \brief Computes the index of the cell that contains a coordinate and
+ * the (clamped) relative position within that cell.
+ */
+static unsigned int CalcCellIndex (
+    double coordinate,
+    double grid_origin,
+    double cell_size,
+    unsigned int cell_count,
+    double &cell_position) {
+  double grid_position = (coordinate - grid_origin) / cell_size;
+
+  if (grid_position <= 0.) {
+    cell_position = 0.;
+    return 0;
+  }
+
+  if (grid_position >= static_cast<double>(cell_count)) {
+    cell_position = 1.;
+    return cell_count - 1;
+  }
+
+  unsigned int index = static_cast<unsigned int>(std::floor (grid_position));
+  if (index > cell_count - 1) {
+    index = cell_count - 1;
+  }
+  cell_position = grid_position - index;
+
+  return index;
+}
+
+double Heightfield::CalcHeight (double x, double y, Vector3d *normal) const {
+  unsigned int cells_x = heights.rows() - 1;
+  unsigned int cells_y = heights.cols() - 1;
+
+  double tx, ty;
+  unsigned int i = CalcCellIndex (x, origin[0], cell_size_x, cells_x, tx);
+  unsigned int j = CalcCellIndex (y, origin[1], cell_size_y, cells_y, ty);
+
+  double h00 = heights(i, j);
+  double h10 = heights(i + 1, j);
+  double h01 = heights(i, j + 1);
+  double h11 = heights(i + 1, j + 1);
+
+  double height = (1. - tx) * (1. - ty) * h00 + tx * (1. - ty) * h10
+    + (1. - tx) * ty * h01 + tx * ty * h11;
+
+  if (normal != NULL) {
+    double dh_dx = ((1. - ty) * (h10 - h00) + ty * (h11 - h01)) / cell_size_x;
+    double dh_dy = ((1. - tx) * (h01 - h00) + tx * (h11 - h10)) / cell_size_y;
+
+    // the border is extended with constant height
+    double grid_x = (x - origin[0]) / cell_size_x;
+    double grid_y = (y - origin[1]) / cell_size_y;
+    if (grid_x < 0. || grid_x > static_cast<double>(cells_x)) {
+      dh_dx = 0.;
+    }
+    if (grid_y < 0. || grid_y > static_cast<double>(cells_y)) {
+      dh_dy = 0.;
+    }
+
+    *normal = Vector3d (-dh_dx, -dh_dy, 1.).normalized();
+  }
+
+  return height;
+}
+
+void Heightfield::CalcHeightBounds (
+    double x_min, double y_min,
+    double x_max, double y_max,
+    double &min_height,
+    double &max_height) const {
+  unsigned int cells_x = heights.rows() - 1;
+  unsigned int cells_y = heights.cols() - 1;
+
+  double t;
+  unsigned int i_min = CalcCellIndex (x_min, origin[0], cell_size_x, cells_x, t);
+  unsigned int i_max = CalcCellIndex (x_max, origin[0], cell_size_x, cells_x, t);
+  unsigned int j_min = CalcCellIndex (y_min, origin[1], cell_size_y, cells_y, t);
+  unsigned int j_max = CalcCellIndex (y_max, origin[1], cell_size_y, cells_y, t);
+
+  // select the finest level at which the region spans at most 2 x 2 cells
+  unsigned int level = 0;
+  while (level + 1 < mMinHeights.size()
+      && ((i_max >> level) - (i_min >> level) > 1
+        || (j_max >> level) - (j_min >> level) > 1)) {
+    level++;
+  }
+
+  min_height = std::numeric_limits<double>::max();
+  max_height = -std::numeric_limits<double>::max();
+
+  for (unsigned int i = i_min >> level; i <= (i_max >> level); i++) {
+    for (unsigned int j = j_min >> level; j <= (j_max >> level); j++) {
+      min_height = std::min (min_height, mMinHeights[level](i, j));
+      max_height = std::max (max_height, mMaxHeights[level](i, j));
+    }
+  }
+}
+
+bool Heightfield::CalcPenetration (
+    const Vector3d &point,
+    double &depth,
+    Vector3d &normal) const {
+  double height = CalcHeight (point[0], point[1], &normal);
+
+  // distance to the tangent plane of the terrain
+  depth = (height - point[2]) * normal[2];
+
+  return depth > 0.;
+}
+
+/** \brief Orders point indices by one coordinate of the points. */
+struct PointCoordinateLess {
+  PointCoordinateLess (const std::vector<Vector3d> &points, unsigned int axis) :
+    points (points), axis (axis) {}
+
+  bool operator() (unsigned int a, unsigned int b) const {
+    return points[a][axis] < points[b][axis];
+  }
+
+  const std::vector<Vector3d> &points;
+  unsigned int axis;
+};
+
+/** \brief Recursively rejects groups of points that are above the terrain
+ * and collects the indices of the penetrating points in the range [begin,
+ * end) of indices.
+ */
+static void FindPenetratingPoints (
+    const Heightfield &terrain,
+    const std::vector<Vector3d> &points,
+    std::vector<unsigned int> &indices,
+    unsigned int begin,
+    unsigned int end,
+    std::vector<unsigned int> &penetrating) {
+  Vector3d lower (points[indices[begin]]);
+  Vector3d upper (points[indices[begin]]);
+
+  for (unsigned int k = begin + 1; k < end; k++) {
+    const Vector3d &point = points[indices[k]];
+    for (unsigned int d = 0; d < 3; d++) {
+      lower[d] = std::min (lower[d], point[d]);
+      upper[d] = std::max (upper[d], point[d]);
+    }
+  }
+
+  double min_height, max_height;
+  terrain.CalcHeightBounds (lower[0], lower[1], upper[0], upper[1],
+      min_height, max_height);
+
+  if (lower[2] > max_height) {
+    return;
+  }
+
+  if (end - begin <= 4) {
+    double depth;
+    Vector3d normal;
+    for (unsigned int k = begin; k < end; k++) {
+      if (terrain.CalcPenetration (points[indices[k]], depth, normal)) {
+        penetrating.push_back (indices[k]);
+      }
+    }
+    return;
+  }
+
+  // split along the larger horizontal extent
+  unsigned int axis = (upper[0] - lower[0] >= upper[1] - lower[1]) ? 0 : 1;
+  unsigned int middle = begin + (end - begin) / 2;
+  std::nth_element (indices.begin() + begin, indices.begin() + middle,
+      indices.begin() + end, PointCoordinateLess (points, axis));
+
+  FindPenetratingPoints (terrain, points, indices, begin, middle, penetrating);
+  FindPenetratingPoints (terrain, points, indices, middle, end, penetrating);
+}
+
+/** \brief Computes a contact frame whose last column is the normal. */
+static Matrix3d CalcContactFrame (const Vector3d &normal) {
+  Vector3d tangent_1 = Vector3d (1., 0., 0.) - normal[0] * normal;
+  if (tangent_1.norm() < 1.0e-6) {
+    tangent_1 = Vector3d (0., 1., 0.) - normal[1] * normal;
+  }
+  tangent_1.normalize();
+  Vector3d tangent_2 = normal.cross (tangent_1);
+
+  Matrix3d frame;
+  for (unsigned int r = 0; r < 3; r++) {
+    frame(r, 0) = tangent_1[r];
+    frame(r, 1) = tangent_2[r];
+    frame(r, 2) = normal[r];
+  }
+
+  return frame;
+}
+
+RBDL_DLLAPI
+unsigned int CalcTerrainContacts (
+    Model &model,
+    const VectorNd &Q,
+    const std::vector<unsigned int> &body_ids,
+    const std::vector<Vector3d> &body_points,
+    const Heightfield &terrain,
+    std::vector<TerrainContact> &contacts,
+    bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (body_ids.size() == body_points.size());
+
+  contacts.clear();
+
+  if (body_ids.size() == 0) {
+    return 0;
+  }
+
+  if (update_kinematics) {
+    UpdateKinematicsCustom (model, &Q, NULL, NULL);
+  }
+
+  std::vector<Vector3d> points (body_ids.size());
+  std::vector<unsigned int> indices (body_ids.size());
+  for (unsigned int k = 0; k < body_ids.size(); k++) {
+    points[k] = CalcBodyToBaseCoordinates (model, Q, body_ids[k],
+        body_points[k], false);
+    indices[k] = k;
+  }
+
+  std::vector<unsigned int> penetrating;
+  FindPenetratingPoints (terrain, points, indices, 0, indices.size(),
+      penetrating);
+
+  // report the contacts in the order of the candidate points
+  std::sort (penetrating.begin(), penetrating.end());
+
+  for (unsigned int k = 0; k < penetrating.size(); k++) {
+    unsigned int index = penetrating[k];
+    TerrainContact contact;
+
+    contact.body_id = body_ids[index];
+    contact.body_point = body_points[index];
+    contact.point = points[index];
+    terrain.CalcPenetration (contact.point, contact.depth, contact.normal);
+    contact.frame = CalcContactFrame (contact.normal);
+
+    contacts.push_back (contact);
+  }
+
+  return contacts.size();
+}
+
+RBDL_DLLAPI
+void AddTerrainContactConstraints (
+    const std::vector<TerrainContact> &contacts,
+    ConstraintSet &CS,
+    bool tangential) {
+  for (unsigned int k = 0; k < contacts.size(); k++) {
+    const TerrainContact &contact = contacts[k];
+    const Matrix3d &frame = contact.frame;
+
+    if (tangential) {
+      CS.AddContactConstraint (contact.body_id, contact.body_point,
+          Vector3d (frame(0, 0), frame(1, 0), frame(2, 0)));
+      CS.AddContactConstraint (contact.body_id, contact.body_point,
+          Vector3d (frame(0, 1), frame(1, 1), frame(2, 1)));
+    }
+
+    CS.AddContactConstraint (contact.body_id, contact.body_point,
+        contact.normal);
+  }
+}
+
+} /* namespace RigidBodyDynamics */
@@ -233,6 +233,79 @@ RBDL_DLLAPI void CalcCenterOfMass (
   }
 }
 
+RBDL_DLLAPI void CalcCenterOfMassJacobian (
+  Model &model,
+  const Math::VectorNd &q,
+  Math::MatrixNd &com_jacobian,
+  const Math::VectorNd *qdot,
+  Math::Vector3d *com_jacobian_dot_qdot,
+  bool update_kinematics) {
+  LOG << "-------- " << __func__ << " --------" << std::endl;
+
+  assert (com_jacobian.rows() == 3 && com_jacobian.cols() == model.qdot_size);
+  assert (com_jacobian_dot_qdot == NULL || qdot != NULL);
+
+  if (update_kinematics)
+    UpdateKinematicsCustom (model, &q, qdot, NULL);
+
+  double mass = 0.;
+  Vector3d momentum_dot (Vector3d::Zero());
+
+  for (size_t i = 1; i < model.mBodies.size(); i++) {
+    model.Ic[i] = model.I[i];
+    mass += model.I[i].m;
+
+    if (com_jacobian_dot_qdot) {
+      // body accelerations for zero joint accelerations
+      unsigned int lambda = model.lambda[i];
+      if (lambda != 0) {
+        model.a[i] = model.X_lambda[i].apply (model.a[lambda]) + model.c[i];
+      } else {
+        model.a[i] = model.c[i];
+      }
+
+      SpatialVector hdot = model.I[i] * model.a[i]
+        + crossf (model.v[i], model.I[i] * model.v[i]);
+      momentum_dot += model.X_base[i].E.transpose()
+        * Vector3d (hdot[3], hdot[4], hdot[5]);
+    }
+  }
+
+  for (size_t i = model.mBodies.size() - 1; i > 0; i--) {
+    unsigned int q_index = model.mJoints[i].q_index;
+    Matrix3d E_T = model.X_base[i].E.transpose();
+
+    // Ic[i] is complete as all children have larger indices
+    if (model.mJoints[i].mJointType != JointTypeCustom) {
+      if (model.mJoints[i].mDoFCount == 1) {
+        SpatialVector h = model.Ic[i] * model.S[i];
+        com_jacobian.block(0, q_index, 3, 1) = E_T * Vector3d (h[3], h[4], h[5]);
+      } else if (model.mJoints[i].mDoFCount == 3) {
+        Matrix63 H = model.Ic[i].toMatrix() * model.multdof3_S[i];
+        com_jacobian.block(0, q_index, 3, 3) = E_T * H.block<3,3>(3,0);
+      }
+    } else {
+      unsigned int k = model.mJoints[i].custom_joint_index;
+      unsigned int dof_count = model.mCustomJoints[k]->mDoFCount;
+
+      MatrixNd H = model.Ic[i].toMatrix() * model.mCustomJoints[k]->S;
+      com_jacobian.block(0, q_index, 3, dof_count)
+        = E_T * H.block(3, 0, 3, dof_count);
+    }
+
+    unsigned int lambda = model.lambda[i];
+    if (lambda != 0) {
+      model.Ic[lambda] = model.Ic[lambda] + model.X_lambda[i].applyTranspose (model.Ic[i]);
+    }
+  }
+
+  com_jacobian /= mass;
+
+  if (com_jacobian_dot_qdot) {
+    *com_jacobian_dot_qdot = momentum_dot / mass;
+  }
+}
+
 RBDL_DLLAPI void CalcZeroMomentPoint (
   Model &model,
   const Math::VectorNd &q,
@@ -0,0 +1,316 @@
+#include "rbdl_tests.h"
+
+#include <iostream>
+
+#include "rbdl/rbdl.h"
+
+using namespace std;
+using namespace RigidBodyDynamics;
+using namespace RigidBodyDynamics::Math;
+
+const double TEST_PREC = 1.0e-12;
+
+struct CollisionBodies {
+  CollisionBodies () {
+    ClearLogOutput();
+    model = new Model;
+    model->gravity = Vector3d (0., 0., -9.81);
+
+    Body body (1., Vector3d (0., 0., 0.), Vector3d (0.1, 0.1, 0.1));
+    unsigned int translation_a = model->AddBody (0, SpatialTransform(),
+        Joint (JointTypeTranslationXYZ), Body());
+    body_a = model->AddBody (translation_a, SpatialTransform(),
+        Joint (JointTypeEulerZYX), body);
+    unsigned int translation_b = model->AddBody (0, SpatialTransform(),
+        Joint (JointTypeTranslationXYZ), Body());
+    body_b = model->AddBody (translation_b, SpatialTransform(),
+        Joint (JointTypeEulerZYX), body);
+    body_c = model->AddBody (body_a, Xtrans (Vector3d (0.5, 0., 0.)),
+        Joint (JointTypeRevoluteZ), body);
+    body_b_fixed = model->AddBody (body_b, Xtrans (Vector3d (0., 0., 0.3)),
+        Joint (JointTypeFixed), body);
+
+    Q = VectorNd::Zero (model->q_size);
+  }
+  ~CollisionBodies () {
+    delete model;
+  }
+
+  Model *model;
+  unsigned int body_a, body_b, body_c, body_b_fixed;
+
+  VectorNd Q;
+};
+
+/** \brief Checks the consistency of the points, normal and depth of a
+ * contact.
+ */
+static void CheckContact (const CollisionContact &contact) {
+  REQUIRE (contact.normal.norm() == Approx (1.));
+  REQUIRE (contact.depth > 0.);
+  REQUIRE_THAT (Vector3d (contact.normal * contact.depth),
+      AllCloseVector(Vector3d (contact.point_a - contact.point_b), 1.0e-10, 1.0e-10));
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_SphereSphere", "") {
+  CollisionWorld world;
+  world.AddSphere (body_a, SpatialTransform(), 0.5);
+  world.AddSphere (body_b, Xtrans (Vector3d (0.1, 0., 0.)), 0.5);
+
+  Q[6] = 0.7;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 1);
+  CheckContact (contacts[0]);
+
+  REQUIRE (contacts[0].body_a == body_a);
+  REQUIRE (contacts[0].body_b == body_b);
+  REQUIRE (contacts[0].depth == Approx (0.2));
+  REQUIRE_THAT (Vector3d (1., 0., 0.), AllCloseVector(contacts[0].normal, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (Vector3d (0.5, 0., 0.), AllCloseVector(contacts[0].body_point_a, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (contacts[0].point_b,
+      AllCloseVector(CalcBodyToBaseCoordinates (*model, Q, body_b,
+          contacts[0].body_point_b, false), TEST_PREC, TEST_PREC));
+
+  // separated spheres
+  Q[6] = 1.2;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+  REQUIRE (world.CalcContacts (contacts) == 0);
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_CapsuleCapsule", "") {
+  CollisionWorld world;
+  world.AddCapsule (body_a, SpatialTransform(), 0.1, 1.);
+  // capsule along the x-axis
+  world.AddCapsule (body_b, Xroty (M_PI * 0.5), 0.1, 1.);
+
+  Q[7] = 0.15;
+  Q[8] = 0.3;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 1);
+  CheckContact (contacts[0]);
+
+  REQUIRE (contacts[0].depth == Approx (0.05));
+  REQUIRE_THAT (Vector3d (0., 1., 0.), AllCloseVector(Vector3d (contacts[0].normal.cwiseAbs()), TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (Vector3d (0., contacts[0].point_a[1], 0.3),
+      AllCloseVector(contacts[0].point_a, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_ShapesOnGroundBox", "") {
+  CollisionWorld world;
+  world.AddBox (0, Xtrans (Vector3d (0., 0., -0.5)), Vector3d (5., 5., 0.5));
+  unsigned int sphere = world.AddSphere (body_a, SpatialTransform(), 0.5);
+  unsigned int capsule = world.AddCapsule (body_b, Xroty (M_PI * 0.5), 0.1,
+      0.4);
+
+  Q[2] = 0.4;
+  Q[3] = 0.3;
+  Q[6] = 2.;
+  Q[8] = 0.05;
+  Q[9] = 0.7;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 2);
+
+  for (unsigned int i = 0; i < contacts.size(); i++) {
+    CheckContact (contacts[i]);
+
+    // the non-box shape is always shape a
+    REQUIRE (contacts[i].body_b == 0);
+    REQUIRE_THAT (Vector3d (0., 0., -1.), AllCloseVector(contacts[i].normal, TEST_PREC, TEST_PREC));
+    REQUIRE (contacts[i].point_b[2] == Approx (0.));
+
+    if (contacts[i].shape_a == sphere) {
+      REQUIRE (contacts[i].depth == Approx (0.1));
+    } else {
+      REQUIRE (contacts[i].shape_a == capsule);
+      REQUIRE (contacts[i].depth == Approx (0.05));
+    }
+  }
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_SphereInsideBox", "") {
+  CollisionWorld world;
+  world.AddBox (0, SpatialTransform(), Vector3d (1., 1., 0.5));
+  world.AddSphere (body_a, SpatialTransform(), 0.1);
+
+  Q[0] = 0.2;
+  Q[2] = 0.3;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 1);
+  CheckContact (contacts[0]);
+
+  REQUIRE (contacts[0].depth == Approx (0.3));
+  REQUIRE_THAT (Vector3d (0., 0., -1.), AllCloseVector(contacts[0].normal, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (Vector3d (0.2, 0., 0.5), AllCloseVector(contacts[0].point_b, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_BoxRestingOnBox", "") {
+  CollisionWorld world;
+  world.AddBox (0, Xtrans (Vector3d (0., 0., -0.5)), Vector3d (5., 5., 0.5));
+  world.AddBox (body_a, SpatialTransform(), Vector3d (0.2, 0.3, 0.2));
+
+  Q[0] = 0.4;
+  Q[2] = 0.19;
+  Q[3] = 0.3;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 4);
+
+  for (unsigned int i = 0; i < contacts.size(); i++) {
+    CheckContact (contacts[i]);
+    REQUIRE (contacts[i].depth == Approx (0.01));
+
+    const CollisionContact &contact = contacts[i];
+    Vector3d ground_point = contact.body_a == 0 ? contact.point_a
+      : contact.point_b;
+    Vector3d body_point = contact.body_a == body_a ? contact.body_point_a
+      : contact.body_point_b;
+    REQUIRE (ground_point[2] == Approx (0.).margin (TEST_PREC));
+    REQUIRE (fabs (body_point[2]) == Approx (0.2));
+    REQUIRE (body_point[2] < 0.);
+  }
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_FixedAndAdjacentBodies", "") {
+  CollisionWorld world;
+  world.AddSphere (body_b_fixed, SpatialTransform(), 0.2);
+  world.AddSphere (body_b, SpatialTransform(), 0.2);
+  world.AddSphere (body_a, SpatialTransform(), 0.3);
+  world.AddSphere (body_c, SpatialTransform(), 0.3);
+
+  // sphere of the fixed body overlaps with its movable parent and body c
+  Q[6] = 0.5;
+  Q[7] = 0.1;
+  Q[8] = -0.6;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 1);
+  CheckContact (contacts[0]);
+
+  const CollisionContact &contact = contacts[0];
+  REQUIRE ((contact.body_a == body_b_fixed || contact.body_b == body_b_fixed));
+  REQUIRE ((contact.body_a == body_c || contact.body_b == body_c));
+
+  Vector3d body_point = contact.body_a == body_b_fixed ? contact.body_point_a
+    : contact.body_point_b;
+  Vector3d point = contact.body_a == body_b_fixed ? contact.point_a
+    : contact.point_b;
+  REQUIRE (body_point.norm() == Approx (0.2));
+  REQUIRE_THAT (point, AllCloseVector(CalcBodyToBaseCoordinates (*model, Q,
+          body_b_fixed, body_point, false), TEST_PREC, TEST_PREC));
+
+  // spheres of body a and its child body c overlap
+  world.exclude_adjacent_bodies = false;
+  REQUIRE (world.CalcContacts (contacts) == 2);
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_BroadphaseMatchesBruteForce", "") {
+  CollisionWorld world;
+  unsigned int bodies[4] = { 0, body_a, body_b, body_b_fixed };
+
+  srand (0);
+  for (unsigned int i = 0; i < 40; i++) {
+    Vector3d offset (
+        (static_cast<double>(rand()) / RAND_MAX - 0.5) * 2.,
+        (static_cast<double>(rand()) / RAND_MAX - 0.5) * 2.,
+        (static_cast<double>(rand()) / RAND_MAX - 0.5) * 2.);
+    double radius = 0.05 + 0.2 * static_cast<double>(rand()) / RAND_MAX;
+    world.AddSphere (bodies[i % 4], Xtrans (offset), radius);
+  }
+
+  for (unsigned int step = 0; step < 5; step++) {
+    Q[0] = 0.1 * step;
+    Q[3] = 0.2 * step;
+    Q[6] = -0.15 * step;
+    Q[10] = 0.3 * step;
+    UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+    world.UpdateTransforms (*model);
+
+    unsigned int contact_count = 0;
+    for (unsigned int i = 0; i < world.shapes.size(); i++) {
+      for (unsigned int j = i + 1; j < world.shapes.size(); j++) {
+        if (world.mMovableBodies[i] == world.mMovableBodies[j]) {
+          continue;
+        }
+
+        double distance = (world.mShapePositions[i]
+            - world.mShapePositions[j]).norm();
+        if (distance < world.shapes[i].radius + world.shapes[j].radius) {
+          contact_count++;
+        }
+      }
+    }
+
+    std::vector<CollisionContact> contacts;
+    REQUIRE (world.CalcContacts (contacts) == contact_count);
+    for (unsigned int i = 0; i < contacts.size(); i++) {
+      CheckContact (contacts[i]);
+    }
+  }
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_CollisionContactConstraints", "") {
+  CollisionWorld world;
+  world.AddBox (0, Xtrans (Vector3d (0., 0., -0.5)), Vector3d (5., 5., 0.5));
+  world.AddSphere (body_a, SpatialTransform(), 0.5);
+  world.AddSphere (body_b, SpatialTransform(), 0.5);
+
+  Q[2] = 0.45;
+  Q[6] = 0.9;
+  Q[8] = 0.45;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 3);
+
+  ConstraintSet CS;
+  REQUIRE (AddCollisionContactConstraints (contacts, CS) == 2);
+  REQUIRE (CS.size() == 2);
+
+  for (unsigned int i = 0; i < CS.size(); i++) {
+    REQUIRE ((CS.body[i] == body_a || CS.body[i] == body_b));
+    REQUIRE_THAT (Vector3d (0., 0., 1.), AllCloseVector(CS.normal[i], TEST_PREC, TEST_PREC));
+    REQUIRE_THAT (Vector3d (0., 0., -0.5), AllCloseVector(CS.point[i], TEST_PREC, TEST_PREC));
+  }
+}
+
+TEST_CASE_METHOD (CollisionBodies, __FILE__"_CollisionContactConstraintsFixedEnvironment", "") {
+  unsigned int ground = model->AddBody (0, Xtrans (Vector3d (0., 0., -0.5)),
+      Joint (JointTypeFixed), Body());
+
+  CollisionWorld world;
+  world.AddBox (ground, SpatialTransform(), Vector3d (5., 5., 0.5));
+  world.AddSphere (body_a, SpatialTransform(), 0.5);
+
+  Q[2] = 0.45;
+  UpdateKinematicsCustom (*model, &Q, NULL, NULL);
+  world.UpdateTransforms (*model);
+
+  std::vector<CollisionContact> contacts;
+  REQUIRE (world.CalcContacts (contacts) == 1);
+  REQUIRE (contacts[0].movable_a == model->GetMovableBodyId (body_a));
+  REQUIRE (contacts[0].movable_b == 0);
+
+  ConstraintSet CS;
+  REQUIRE (AddCollisionContactConstraints (contacts, CS) == 1);
+  REQUIRE (CS.body[0] == body_a);
+  REQUIRE_THAT (Vector3d (0., 0., 1.), AllCloseVector(CS.normal[0], TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (Vector3d (0., 0., -0.5), AllCloseVector(CS.point[0], TEST_PREC, TEST_PREC));
+}
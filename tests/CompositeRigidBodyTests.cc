@@ -7,6 +7,7 @@
 #include "rbdl/Dynamics.h"
 
 #include "Fixtures.h"
+#include "Human36Fixture.h"
 
 using namespace std;
 using namespace RigidBodyDynamics;
@@ -259,3 +260,87 @@ TEST_CASE_METHOD (CompositeRigidBodyFixture, __FILE__"_TestCompositeRigidBodyFor
 
   REQUIRE_THAT (H_ref, AllCloseMatrix(H, TEST_PREC, TEST_PREC));
 }
+
+static void CheckJointSpaceInertiaAndNonlinearEffects (Model &model,
+    const VectorNd &q, const VectorNd &qdot) {
+  MatrixNd H_ref (MatrixNd::Zero (model.qdot_size, model.qdot_size));
+  VectorNd C_ref (VectorNd::Zero (model.qdot_size));
+  VectorNd gravity_ref (VectorNd::Zero (model.qdot_size));
+  CompositeRigidBodyAlgorithm (model, q, H_ref);
+  NonlinearEffects (model, q, qdot, C_ref);
+  NonlinearEffects (model, q, VectorNd::Zero (model.qdot_size), gravity_ref);
+
+  MatrixNd H (MatrixNd::Zero (model.qdot_size, model.qdot_size));
+  VectorNd C (VectorNd::Zero (model.qdot_size));
+  VectorNd gravity (VectorNd::Zero (model.qdot_size));
+  CalcJointSpaceInertiaAndNonlinearEffects (model, q, qdot, H, C, &gravity);
+
+  REQUIRE_THAT (H_ref, AllCloseMatrix(H, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (C_ref, AllCloseVector(C, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (gravity_ref, AllCloseVector(gravity, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_TestJointSpaceInertiaAndNonlinearEffects", "") {
+  randomizeStates();
+
+  CheckJointSpaceInertiaAndNonlinearEffects (*model_emulated, q, qdot);
+  CheckJointSpaceInertiaAndNonlinearEffects (*model_3dof, q, qdot);
+}
+
+TEST_CASE_METHOD (FloatingBase12DoF, __FILE__"_TestJointSpaceInertiaAndNonlinearEffectsExternalForces", "") {
+  for (unsigned int i = 0; i < model->qdot_size; i++) {
+    Q[i] = rand() / static_cast<double>(RAND_MAX);
+    QDot[i] = rand() / static_cast<double>(RAND_MAX);
+  }
+
+  std::vector<SpatialVector> f_ext (model->mBodies.size(), SpatialVector::Zero());
+  f_ext[child_rot_x_id] = SpatialVector (0.1, -0.2, 0.3, 1., 2., -3.);
+
+  VectorNd C_ref (VectorNd::Zero (model->qdot_size));
+  InverseDynamics (*model, Q, QDot, VectorNd::Zero (model->qdot_size), C_ref,
+      &f_ext);
+
+  MatrixNd H (MatrixNd::Zero (model->qdot_size, model->qdot_size));
+  VectorNd C (VectorNd::Zero (model->qdot_size));
+  CalcJointSpaceInertiaAndNonlinearEffects (*model, Q, QDot, H, C, NULL,
+      &f_ext);
+
+  REQUIRE_THAT (C_ref, AllCloseVector(C, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_TestJointSpaceInertiaAndNonlinearEffectsExternalForcesVirtualBody", "") {
+  randomizeStates();
+
+  unsigned int virtual_body_id = 0;
+  for (unsigned int i = 1; i < model_emulated->mBodies.size(); i++) {
+    if (model_emulated->mBodies[i].mIsVirtual) {
+      virtual_body_id = i;
+      break;
+    }
+  }
+  REQUIRE (virtual_body_id != 0);
+
+  std::vector<SpatialVector> f_ext (model_emulated->mBodies.size(),
+      SpatialVector::Zero());
+  f_ext[virtual_body_id] = SpatialVector (0.1, -0.2, 0.3, 1., 2., -3.);
+
+  VectorNd C_ref (VectorNd::Zero (model_emulated->qdot_size));
+  InverseDynamics (*model_emulated, q, qdot,
+      VectorNd::Zero (model_emulated->qdot_size), C_ref, &f_ext);
+
+  MatrixNd H (MatrixNd::Zero (model_emulated->qdot_size,
+        model_emulated->qdot_size));
+  VectorNd C (VectorNd::Zero (model_emulated->qdot_size));
+  CalcJointSpaceInertiaAndNonlinearEffects (*model_emulated, q, qdot, H, C,
+      NULL, &f_ext);
+
+  REQUIRE_THAT (C_ref, AllCloseVector(C, TEST_PREC, TEST_PREC));
+
+  VectorNd qddot_ref (VectorNd::Zero (model_emulated->qdot_size));
+  VectorNd qddot_lagrangian (VectorNd::Zero (model_emulated->qdot_size));
+  ForwardDynamics (*model_emulated, q, qdot, tau, qddot_ref, &f_ext);
+  ForwardDynamicsLagrangian (*model_emulated, q, qdot, tau,
+      qddot_lagrangian, Math::LinearSolverColPivHouseholderQR, &f_ext);
+
+  REQUIRE_THAT (qddot_ref, AllCloseVector(qddot_lagrangian, 1.0e-10, 1.0e-10));
+}
@@ -688,3 +688,56 @@ TEST_CASE_METHOD (Human36, __FILE__"_ForwardDynamicsContactsImpulses", "") {
   REQUIRE_THAT (Vector3d(0., 0., 0.), AllCloseVector(heel_left_velocity, TEST_PREC, TEST_PREC));
   REQUIRE_THAT (Vector3d(0., 0., 0.), AllCloseVector(heel_right_velocity, TEST_PREC, TEST_PREC));
 }
+
+TEST_CASE_METHOD (Human36, __FILE__"_ContactConstraintsGroupedByPoint", "") {
+  randomizeStates();
+
+  Vector3d heel_point (-0.03, 0., -0.03);
+  unsigned int foot_left = body_id_3dof[BodyFootLeft];
+  unsigned int foot_right = body_id_3dof[BodyFootRight];
+
+  // constraints on the same points added in interleaved order
+  ConstraintSet constraints_interleaved;
+  constraints_interleaved.AddContactConstraint (foot_left, heel_point, Vector3d (1., 0., 0.));
+  constraints_interleaved.AddContactConstraint (foot_right, heel_point, Vector3d (1., 0., 0.));
+  constraints_interleaved.AddContactConstraint (foot_left, heel_point, Vector3d (0., 1., 0.));
+  constraints_interleaved.AddContactConstraint (foot_right, heel_point, Vector3d (0., 1., 0.));
+  constraints_interleaved.AddContactConstraint (foot_left, heel_point, Vector3d (0., 0., 1.));
+  constraints_interleaved.AddContactConstraint (foot_right, heel_point, Vector3d (0., 0., 1.));
+  constraints_interleaved.Bind (*model_3dof);
+
+  REQUIRE (constraints_interleaved.mContactGroupOffsets.size() == 3);
+  REQUIRE (constraints_interleaved.mContactGroupOffsets[1] == 3);
+  REQUIRE (constraints_interleaved.mContactGroupConstraintIndices[1] == 2);
+
+  unsigned int dof_count = model_3dof->dof_count;
+  MatrixNd G (MatrixNd::Zero (6, dof_count));
+  VectorNd err (VectorNd::Zero (6));
+  VectorNd errd (VectorNd::Zero (6));
+  VectorNd gamma (VectorNd::Zero (6));
+  CalcConstraintsTerms (*model_3dof, q, qdot, constraints_interleaved, G,
+      err, errd, gamma);
+
+  for (unsigned int c = 0; c < 6; c++) {
+    unsigned int body_id = c % 2 == 0 ? foot_left : foot_right;
+    Vector3d normal = constraints_interleaved.normal[c];
+
+    MatrixNd G_point (MatrixNd::Zero (3, dof_count));
+    CalcPointJacobian (*model_3dof, q, body_id, heel_point, G_point, false);
+    VectorNd G_row = G_point.transpose() * normal;
+    Vector3d point_acc = CalcPointAcceleration (*model_3dof, q, qdot,
+        VectorNd::Zero (dof_count), body_id, heel_point, false);
+
+    REQUIRE_THAT (G_row, AllCloseVector(VectorNd (G.row(c).transpose()), TEST_PREC, TEST_PREC));
+    REQUIRE_THAT (-normal.dot (point_acc), IsClose(gamma[c], TEST_PREC, TEST_PREC));
+  }
+
+  VectorNd qddot_lagrangian (VectorNd::Zero (qddot.size()));
+  ConstraintSet constraints_kokkevis = constraints_interleaved.Copy();
+  constraints_kokkevis.Bind (*model_3dof);
+
+  ForwardDynamicsConstraintsDirect (*model_3dof, q, qdot, tau, constraints_interleaved, qddot_lagrangian);
+  ForwardDynamicsContactsKokkevis (*model_3dof, q, qdot, tau, constraints_kokkevis, qddot);
+
+  REQUIRE_THAT (qddot_lagrangian, AllCloseVector(qddot, TEST_PREC * qddot_lagrangian.norm() * 10., TEST_PREC * qddot_lagrangian.norm() * 10.));
+}
@@ -238,6 +238,50 @@ struct PinJointCustomConstraint : public RigidBodyDynamics::CustomConstraint
 
 
 
+//Same constraint as PinJointCustomConstraint but evaluated in a single call
+//using the frame kinematics precomputed by the ConstraintSet.
+struct FusedPinJointCustomConstraint : public PinJointCustomConstraint
+{
+  FusedPinJointCustomConstraint(unsigned int x0y1z2)
+    : PinJointCustomConstraint(x0y1z2) {
+    mUsesFrameKinematics = true;
+  }
+
+  virtual void CalcConstraintTerms( Model &model,
+                                    unsigned int ccid,
+                                    const Math::VectorNd &UNUSED(Q),
+                                    const Math::VectorNd &UNUSED(QDot),
+                                    ConstraintSet &CS,
+                                    const CustomConstraintFrameKinematics &frames,
+                                    Math::MatrixNd &G,
+                                    Math::VectorNd &gamma,
+                                    Math::VectorNd &errPos,
+                                    Math::VectorNd &errVel,
+                                    unsigned int startIdx)
+  {
+    xP0  = SpatialTransform (frames.E_p, frames.r_p);
+    rmPS = frames.E_p.transpose() * frames.E_s;
+
+    err[0] = -0.5 * (rmPS(1,2) - rmPS(2,1));
+    err[1] = -0.5 * (rmPS(2,0) - rmPS(0,2));
+    err[2] = -0.5 * (rmPS(0,1) - rmPS(1,0));
+    err.block<3,1>(3,0) = frames.E_p.transpose() * (frames.r_s - frames.r_p);
+
+    for(unsigned int i=0; i<TuP.size(); ++i){
+      eT0    = xP0.apply(TuP[i]);
+      eT0Dot = crossm(frames.v_p,eT0);
+      CS.constraintAxis[ccid+i] = TuP[i];
+      G.block(startIdx+i,0,1,model.dof_count)
+          = eT0.transpose()*(frames.G_s - frames.G_p);
+      errPos[startIdx+i] = TuP[i].transpose()*err;
+      errVel[startIdx+i] = eT0.dot((frames.v_s - frames.v_p));
+      gamma[startIdx+i]  = -eT0.dot(frames.a_s - frames.a_p)
+                           -eT0Dot.dot(frames.v_s - frames.v_p);
+    }
+  }
+};
+
+
 struct DoublePerpendicularPendulumCustomConstraint {
   DoublePerpendicularPendulumCustomConstraint()
     : model()
@@ -459,7 +503,7 @@ TEST_CASE (__FILE__"_CustomConstraintCorrectnessTest", "") {
 
   //The constraint errors at the position and velocity level
   //must be zero before the accelerations can be tested.
-  VectorNd target(dbcc.cs.size());
+  VectorNd target = VectorNd::Zero(dbcc.cs.size());
   REQUIRE_THAT(target, AllCloseVector(err, TEST_PREC, TEST_PREC));
   REQUIRE_THAT(target, AllCloseVector(errd, TEST_PREC, TEST_PREC));
 
@@ -501,3 +545,48 @@ TEST_CASE (__FILE__"_CustomConstraintCorrectnessTest", "") {
   REQUIRE_THAT (a020, AllCloseVector(a020c, TEST_PREC, TEST_PREC));
   REQUIRE_THAT (a030, AllCloseVector(a030c, TEST_PREC, TEST_PREC));
 }
+
+TEST_CASE (__FILE__"_CustomConstraintFusedEvaluationTest", "") {
+  DoublePerpendicularPendulumCustomConstraint dbcc;
+
+  FusedPinJointCustomConstraint fusedPJZaxis(2);
+  FusedPinJointCustomConstraint fusedPJYaxis(1);
+
+  ConstraintSet cs;
+  cs.AddCustomConstraint(&fusedPJZaxis, 0, dbcc.idB1, dbcc.X_p1, dbcc.X_s1,
+                         true, 0.1);
+  cs.AddCustomConstraint(&fusedPJYaxis, dbcc.idB1, dbcc.idB2, dbcc.X_p2,
+                         dbcc.X_s2, true, 0.1);
+  cs.Bind(dbcc.model);
+
+  ConstraintSet cs_ref;
+  cs_ref.AddCustomConstraint(&dbcc.ccPJZaxis, 0, dbcc.idB1, dbcc.X_p1,
+                             dbcc.X_s1, true, 0.1);
+  cs_ref.AddCustomConstraint(&dbcc.ccPJYaxis, dbcc.idB1, dbcc.idB2, dbcc.X_p2,
+                             dbcc.X_s2, true, 0.1);
+  cs_ref.Bind(dbcc.model);
+
+  //An arbitrary state that does not satisfy the constraints such that the
+  //errors and Baumgarte terms do not vanish.
+  for(unsigned int i=0; i<dbcc.q.rows(); ++i){
+    dbcc.q[i]  = 0.1 * (i + 1);
+    dbcc.qd[i] = -0.2 * (i + 1);
+    dbcc.tau[i]= 0.05 * i;
+  }
+
+  VectorNd qdd_ref(dbcc.qdd);
+
+  ForwardDynamicsConstraintsDirect(dbcc.model, dbcc.q, dbcc.qd, dbcc.tau,
+                                   cs, dbcc.qdd);
+  ForwardDynamicsConstraintsDirect(dbcc.model, dbcc.q, dbcc.qd, dbcc.tau,
+                                   cs_ref, qdd_ref);
+
+  REQUIRE (cs_ref.err.norm() > 0.);
+  REQUIRE (cs_ref.errd.norm() > 0.);
+
+  REQUIRE_THAT (cs_ref.G, AllCloseMatrix(cs.G, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (cs_ref.err, AllCloseVector(cs.err, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (cs_ref.errd, AllCloseVector(cs.errd, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (cs_ref.gamma, AllCloseVector(cs.gamma, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (qdd_ref, AllCloseVector(dbcc.qdd, TEST_PREC, TEST_PREC));
+}
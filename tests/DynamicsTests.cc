@@ -11,6 +11,7 @@
 #include "rbdl/Constraints.h"
 
 #include "Fixtures.h"
+#include "Human36Fixture.h"
 
 using namespace std;
 using namespace RigidBodyDynamics;
@@ -733,3 +734,621 @@ TEST_CASE_METHOD (FixedBase3DoF, __FILE__"_SolveMInvTimesNonZeroQDotKinematicsUp
 
   REQUIRE_THAT (qddot_solve_llt, AllCloseVector(qddot_minv, TEST_PREC, TEST_PREC));
 }
+
+void CalcDenseOperationalSpaceInverseInertia (Model &model, const VectorNd &q,
+    const std::vector<unsigned int> &body_ids,
+    const std::vector<Vector3d> &points,
+    MatrixNd &LambdaInv) {
+  MatrixNd H (MatrixNd::Zero (model.qdot_size, model.qdot_size));
+  CompositeRigidBodyAlgorithm (model, q, H);
+
+  MatrixNd J (MatrixNd::Zero (6 * body_ids.size(), model.qdot_size));
+  for (unsigned int k = 0; k < body_ids.size(); k++) {
+    MatrixNd G (MatrixNd::Zero (6, model.qdot_size));
+    CalcPointJacobian6D (model, q, body_ids[k], points[k], G);
+    J.block(6 * k, 0, 6, model.qdot_size) = G;
+  }
+
+  LambdaInv = J * H.llt().solve(J.transpose());
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcOperationalSpaceInverseInertia", "") {
+  randomizeStates();
+
+  std::vector<unsigned int> body_ids;
+  std::vector<Vector3d> points;
+  body_ids.push_back (body_id_emulated[BodyFootRight]);
+  points.push_back (Vector3d (0.1, 0., -0.05));
+  body_ids.push_back (body_id_emulated[BodyFootRight]);
+  points.push_back (Vector3d (-0.1, 0., -0.05));
+  body_ids.push_back (body_id_emulated[BodyHandLeft]);
+  points.push_back (Vector3d (0., 0.2, 0.));
+  body_ids.push_back (model_emulated->GetBodyId ("uppertrunk"));
+  points.push_back (Vector3d (0.3, -0.1, 0.2));
+  body_ids.push_back (body_id_emulated[BodyPelvis]);
+  points.push_back (Vector3d (0., 0., 0.));
+
+  MatrixNd LambdaInv (MatrixNd::Zero (6 * body_ids.size(),
+        6 * body_ids.size()));
+  CalcOperationalSpaceInverseInertia (*model_emulated, q, body_ids, points,
+      LambdaInv);
+
+  MatrixNd LambdaInv_ref;
+  CalcDenseOperationalSpaceInverseInertia (*model_emulated, q, body_ids, points,
+      LambdaInv_ref);
+
+  REQUIRE_THAT (LambdaInv_ref, AllCloseMatrix(LambdaInv, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcOperationalSpaceInverseInertia3Dof", "") {
+  randomizeStates();
+
+  std::vector<unsigned int> body_ids;
+  std::vector<Vector3d> points;
+  body_ids.push_back (body_id_3dof[BodyFootRight]);
+  points.push_back (Vector3d (0.1, 0., -0.05));
+  body_ids.push_back (body_id_3dof[BodyFootLeft]);
+  points.push_back (Vector3d (0.1, 0., -0.05));
+  body_ids.push_back (body_id_3dof[BodyHandRight]);
+  points.push_back (Vector3d (0., -0.2, 0.));
+  body_ids.push_back (body_id_3dof[BodyHead]);
+  points.push_back (Vector3d (0., 0., 0.1));
+
+  MatrixNd LambdaInv (MatrixNd::Zero (6 * body_ids.size(),
+        6 * body_ids.size()));
+  CalcOperationalSpaceInverseInertia (*model_3dof, q, body_ids, points,
+      LambdaInv);
+
+  MatrixNd LambdaInv_ref;
+  CalcDenseOperationalSpaceInverseInertia (*model_3dof, q, body_ids, points,
+      LambdaInv_ref);
+
+  // the random configuration may be close to a singularity of the Euler
+  // joints which results in large entries of the inverse inertia
+  REQUIRE_THAT (LambdaInv_ref, AllCloseMatrix(LambdaInv, 1.0e-8, 1.0e-8));
+
+  // reuse the articulated body inertias of a previous call
+  VectorNd qddot_minv (VectorNd::Zero (model_3dof->qdot_size));
+  CalcMInvTimesTau (*model_3dof, q, tau, qddot_minv);
+  UpdateKinematicsCustom (*model_3dof, &q, NULL, NULL);
+
+  MatrixNd LambdaInv_reuse (MatrixNd::Zero (6 * body_ids.size(),
+        6 * body_ids.size()));
+  CalcOperationalSpaceInverseInertia (*model_3dof, q, body_ids, points,
+      LambdaInv_reuse, false);
+
+  REQUIRE_THAT (LambdaInv_ref, AllCloseMatrix(LambdaInv_reuse, 1.0e-8, 1.0e-8));
+}
+
+TEST_CASE_METHOD (TwoArms12DoF, __FILE__"_CalcOperationalSpaceInverseInertiaBranches", "") {
+  for (unsigned int i = 0; i < model->q_size; i++) {
+    q[i] = rand() / static_cast<double>(RAND_MAX);
+  }
+
+  std::vector<unsigned int> body_ids;
+  std::vector<Vector3d> points;
+  body_ids.push_back (right_upper_arm);
+  points.push_back (Vector3d (0., -0.4, 0.));
+  body_ids.push_back (left_upper_arm);
+  points.push_back (Vector3d (0.1, -0.4, 0.));
+
+  MatrixNd LambdaInv (MatrixNd::Zero (12, 12));
+  CalcOperationalSpaceInverseInertia (*model, q, body_ids, points, LambdaInv);
+
+  MatrixNd LambdaInv_ref;
+  CalcDenseOperationalSpaceInverseInertia (*model, q, body_ids, points,
+      LambdaInv_ref);
+
+  REQUIRE_THAT (LambdaInv_ref, AllCloseMatrix(LambdaInv, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (MatrixNd (LambdaInv.block(0, 6, 6, 6)), AllCloseMatrix(MatrixNd (MatrixNd::Zero (6, 6)), TEST_PREC, TEST_PREC));
+}
+
+void CheckHybridDynamics (Model &model, const VectorNd &q,
+    const VectorNd &qdot, const VectorNd &tau,
+    const std::vector<bool> &qddot_known,
+    std::vector<SpatialVector> *f_ext = NULL) {
+  VectorNd qddot_ref (VectorNd::Zero (model.qdot_size));
+  ForwardDynamics (model, q, qdot, tau, qddot_ref, f_ext);
+
+  VectorNd qddot (VectorNd::Zero (model.qdot_size));
+  VectorNd tau_hybrid (VectorNd::Zero (model.qdot_size));
+  for (unsigned int i = 0; i < model.qdot_size; i++) {
+    if (qddot_known[i]) {
+      qddot[i] = qddot_ref[i];
+    } else {
+      tau_hybrid[i] = tau[i];
+    }
+  }
+
+  HybridDynamics (model, q, qdot, qddot, tau_hybrid, qddot_known, f_ext);
+
+  // the random states result in accelerations of large magnitude
+  REQUIRE_THAT (qddot_ref, AllCloseVector(qddot, 1.0e-10, 1.0e-10));
+  REQUIRE_THAT (tau, AllCloseVector(tau_hybrid, 1.0e-10, 1.0e-10));
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_HybridDynamicsSpecialCases", "") {
+  randomizeStates();
+
+  std::vector<bool> all_known (model_emulated->qdot_size, true);
+  VectorNd tau_id (VectorNd::Zero (model_emulated->qdot_size));
+  InverseDynamics (*model_emulated, q, qdot, qddot, tau_id);
+
+  VectorNd qddot_hybrid (qddot);
+  VectorNd tau_hybrid (VectorNd::Zero (model_emulated->qdot_size));
+  HybridDynamics (*model_emulated, q, qdot, qddot_hybrid, tau_hybrid, all_known);
+
+  REQUIRE_THAT (tau_id, AllCloseVector(tau_hybrid, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (qddot, AllCloseVector(qddot_hybrid, 0., 0.));
+
+  std::vector<bool> none_known (model_emulated->qdot_size, false);
+  CheckHybridDynamics (*model_emulated, q, qdot, tau, none_known);
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_HybridDynamicsMixed", "") {
+  randomizeStates();
+
+  std::vector<bool> qddot_known (model_emulated->qdot_size, false);
+  for (unsigned int i = 0; i < model_emulated->qdot_size; i++) {
+    qddot_known[i] = (i % 3 == 0) || (i < 6);
+  }
+
+  CheckHybridDynamics (*model_emulated, q, qdot, tau, qddot_known);
+
+  // the mask also splits the degrees of freedom of the 3-DoF joints
+  CheckHybridDynamics (*model_3dof, q, qdot, tau, qddot_known);
+
+  for (unsigned int i = 0; i < model_3dof->qdot_size; i++) {
+    qddot_known[i] = !qddot_known[i];
+  }
+  CheckHybridDynamics (*model_3dof, q, qdot, tau, qddot_known);
+}
+
+TEST_CASE_METHOD (FloatingBase12DoF, __FILE__"_HybridDynamicsExternalForces", "") {
+  for (unsigned int i = 0; i < model->qdot_size; i++) {
+    Q[i] = rand() / static_cast<double>(RAND_MAX);
+    QDot[i] = rand() / static_cast<double>(RAND_MAX);
+    Tau[i] = rand() / static_cast<double>(RAND_MAX);
+  }
+
+  std::vector<SpatialVector> f_ext (model->mBodies.size(), SpatialVector::Zero());
+  f_ext[child_rot_x_id] = SpatialVector (0.1, -0.2, 0.3, 1., 2., -3.);
+  f_ext[child_2_rot_x_id] = SpatialVector (-0.3, 0.1, 0., 0.5, -1., 2.);
+
+  std::vector<bool> qddot_known (model->qdot_size, false);
+  qddot_known[0] = true;
+  qddot_known[4] = true;
+  qddot_known[7] = true;
+
+  CheckHybridDynamics (*model, Q, QDot, Tau, qddot_known, &f_ext);
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_SolveMInvTimesMatrix", "") {
+  randomizeStates();
+
+  Model *models[] = { model_emulated, model_3dof };
+
+  for (unsigned int m = 0; m < 2; m++) {
+    Model &model = *models[m];
+
+    MatrixNd B (MatrixNd::Zero (model.qdot_size, 5));
+    for (unsigned int i = 0; i < B.rows(); i++) {
+      for (unsigned int j = 0; j < B.cols(); j++) {
+        B(i,j) = rand() / static_cast<double>(RAND_MAX) - 0.5;
+      }
+    }
+
+    MatrixNd X (MatrixNd::Zero (model.qdot_size, B.cols()));
+    CalcMInvTimesTau (model, q, B, X);
+
+    MatrixNd H (MatrixNd::Zero (model.qdot_size, model.qdot_size));
+    CompositeRigidBodyAlgorithm (model, q, H);
+    MatrixNd X_llt = H.llt().solve(B);
+
+    REQUIRE_THAT (X_llt, AllCloseMatrix(X, 1.0e-10, 1.0e-10));
+
+    for (unsigned int j = 0; j < B.cols(); j++) {
+      VectorNd x_column (VectorNd::Zero (model.qdot_size));
+      CalcMInvTimesTau (model, q, VectorNd (B.col(j)), x_column);
+
+      REQUIRE_THAT (x_column, AllCloseVector(VectorNd (X.col(j)), TEST_PREC, TEST_PREC));
+    }
+
+    // reuse the articulated body inertias
+    MatrixNd X_reuse (MatrixNd::Zero (model.qdot_size, B.cols()));
+    CalcMInvTimesTau (model, q, B, X_reuse, false);
+
+    REQUIRE_THAT (X, AllCloseMatrix(X_reuse, 0., 0.));
+  }
+}
+
+/** \brief Sets the i-th entry of the inertial parameters of a body. */
+static void SetInertialParameter (
+    SpatialRigidBodyInertia &I, unsigned int k, double value) {
+  switch (k) {
+    case 0: I.m = value; break;
+    case 1: I.h[0] = value; break;
+    case 2: I.h[1] = value; break;
+    case 3: I.h[2] = value; break;
+    case 4: I.Ixx = value; break;
+    case 5: I.Iyx = value; break;
+    case 6: I.Iyy = value; break;
+    case 7: I.Izx = value; break;
+    case 8: I.Izy = value; break;
+    case 9: I.Izz = value; break;
+  }
+}
+
+TEST_CASE (__FILE__"_ForwardDynamicsParameterDerivatives", "") {
+  Model model;
+  model.gravity = Vector3d (0., -9.81, 0.);
+
+  Joint joints[4] = {
+    Joint (JointTypeEulerZYX),
+    Joint (JointTypeRevoluteX),
+    Joint (JointTypeRevoluteY),
+    Joint (JointTypeRevoluteZ)
+  };
+
+  unsigned int parent_id = 0;
+  for (unsigned int i = 0; i < 4; i++) {
+    Body body (1. + 0.3 * i, Vector3d (0.1, 0.4 - 0.1 * i, 0.05 * i),
+        Vector3d (0.2 + 0.05 * i, 0.3, 0.25 - 0.02 * i));
+    parent_id = model.AddBody (parent_id,
+        Xtrans (Vector3d (0., i > 0 ? 0.5 : 0., 0.)), joints[i], body);
+  }
+
+  unsigned int param_count = 10 * (model.mBodies.size() - 1);
+
+  VectorNd Q (VectorNd::Zero (model.q_size));
+  VectorNd QDot (VectorNd::Zero (model.qdot_size));
+  VectorNd Tau (VectorNd::Zero (model.qdot_size));
+
+  for (unsigned int i = 0; i < model.qdot_size; i++) {
+    Q[i] = 0.1 + 0.2 * i;
+    QDot[i] = 0.5 - 0.15 * i;
+    Tau[i] = -0.3 + 0.25 * i;
+  }
+
+  MatrixNd QDDot_params (MatrixNd::Zero (model.qdot_size, param_count));
+  VectorNd qddot_out (VectorNd::Zero (model.qdot_size));
+  CalcForwardDynamicsParameterDerivatives (model, Q, QDot, Tau,
+      QDDot_params, &qddot_out);
+
+  VectorNd qddot_fd (VectorNd::Zero (model.qdot_size));
+  ForwardDynamics (model, Q, QDot, Tau, qddot_fd);
+  REQUIRE_THAT (qddot_fd, AllCloseVector(qddot_out, TEST_PREC, TEST_PREC));
+
+  VectorNd params (VectorNd::Zero (param_count));
+  GetInertialParameters (model, params);
+
+  // central differences of the forward dynamics of a perturbed model copy
+  double h = 1.0e-6;
+  MatrixNd QDDot_params_fd (MatrixNd::Zero (model.qdot_size, param_count));
+  for (unsigned int p = 0; p < param_count; p++) {
+    unsigned int body_id = p / 10 + 1;
+    Model model_perturbed (model);
+    VectorNd qddot_plus (VectorNd::Zero (model.qdot_size));
+    VectorNd qddot_minus (VectorNd::Zero (model.qdot_size));
+
+    SetInertialParameter (model_perturbed.I[body_id], p % 10, params[p] + h);
+    ForwardDynamics (model_perturbed, Q, QDot, Tau, qddot_plus);
+    SetInertialParameter (model_perturbed.I[body_id], p % 10, params[p] - h);
+    ForwardDynamics (model_perturbed, Q, QDot, Tau, qddot_minus);
+
+    QDDot_params_fd.block(0, p, model.qdot_size, 1) = (qddot_plus - qddot_minus) / (2. * h);
+  }
+
+  REQUIRE_THAT (QDDot_params_fd, AllCloseMatrix(QDDot_params, 1.0e-7, 1.0e-7));
+}
+
+TEST_CASE (__FILE__"_BodyInertialParameterJacobian", "") {
+  Matrix3d inertia_C (
+      0.3, 0.02, -0.01,
+      0.02, 0.4, 0.03,
+      -0.01, 0.03, 0.5);
+  Body body (1.7, Vector3d (0.1, -0.3, 0.2), inertia_C);
+
+  MatrixNd J (MatrixNd::Zero (10, 10));
+  CalcBodyInertialParameterJacobian (body, J);
+
+  double h = 1.0e-6;
+  MatrixNd J_fd (MatrixNd::Zero (10, 10));
+  unsigned int rows[6] = { 0, 1, 1, 2, 2, 2 };
+  unsigned int cols[6] = { 0, 0, 1, 0, 1, 2 };
+
+  for (unsigned int k = 0; k < 10; k++) {
+    VectorNd params[2] = { VectorNd::Zero (10), VectorNd::Zero (10) };
+
+    for (unsigned int s = 0; s < 2; s++) {
+      double delta = (s == 0) ? h : -h;
+      double mass = body.mMass;
+      Vector3d com = body.mCenterOfMass;
+      Matrix3d inertia = body.mInertia;
+
+      if (k == 0) {
+        mass += delta;
+      } else if (k < 4) {
+        com[k - 1] += delta;
+      } else {
+        inertia(rows[k - 4], cols[k - 4]) += delta;
+        if (rows[k - 4] != cols[k - 4]) {
+          inertia(cols[k - 4], rows[k - 4]) += delta;
+        }
+      }
+
+      SpatialRigidBodyInertia I =
+        SpatialRigidBodyInertia::createFromMassComInertiaC (mass, com, inertia);
+      for (unsigned int p = 0; p < 10; p++) {
+        SpatialRigidBodyInertia I_unit;
+        SetInertialParameter (I_unit, p, 1.);
+        params[s][p] = I.m * I_unit.m + I.h.dot (I_unit.h)
+          + I.Ixx * I_unit.Ixx + I.Iyx * I_unit.Iyx + I.Iyy * I_unit.Iyy
+          + I.Izx * I_unit.Izx + I.Izy * I_unit.Izy + I.Izz * I_unit.Izz;
+      }
+    }
+
+    J_fd.block(0, k, 10, 1) = (params[0] - params[1]) / (2. * h);
+  }
+
+  REQUIRE_THAT (J_fd, AllCloseMatrix(J, 1.0e-8, 1.0e-8));
+}
+
+/** \brief Creates a chain that contains all joint types supported by
+ * CalcCoriolisMatrix() apart from spherical joints. */
+static void CreateCoriolisTestChain (Model &model) {
+  model.gravity = Vector3d (0., 0., 0.);
+
+  Body body_a (1.1, Vector3d (0.2, 0.1, -0.1), Vector3d (0.3, 0.2, 0.4));
+  Body body_b (0.7, Vector3d (0.1, -0.2, 0.3), Vector3d (0.2, 0.5, 0.3));
+  Body body_c (1.3, Vector3d (-0.1, 0.3, 0.2), Vector3d (0.4, 0.3, 0.2));
+
+  unsigned int id = model.AddBody (0, Xtrans (Vector3d (0., 0., 0.)),
+      Joint (JointTypeTranslationXYZ), body_a);
+  id = model.AddBody (id, Xtrans (Vector3d (0.1, 0., 0.)),
+      Joint (JointTypeEulerZYX), body_b);
+  id = model.AddBody (id, Xtrans (Vector3d (0., 0.4, 0.)),
+      Joint (JointTypeEulerXYZ), body_c);
+  unsigned int branch = model.AddBody (id, Xtrans (Vector3d (0.3, 0., 0.1)),
+      Joint (JointTypeEulerYXZ), body_a);
+  model.AddBody (branch, Xtrans (Vector3d (0., 0., -0.3)),
+      Joint (SpatialVector (0., 0., 1., 0.2, 0., 0.1)), body_b);
+  id = model.AddBody (id, Xtrans (Vector3d (-0.2, 0.1, 0.)),
+      Joint (JointTypeEulerZXY), body_b);
+  model.AddBody (id, Xtrans (Vector3d (0., 0.2, 0.)),
+      Joint (JointTypeRevoluteY), body_c);
+}
+
+TEST_CASE (__FILE__"_CalcCoriolisMatrix", "") {
+  Model model;
+  CreateCoriolisTestChain (model);
+
+  VectorNd q (VectorNd::Zero (model.q_size));
+  VectorNd qdot (VectorNd::Zero (model.qdot_size));
+  for (unsigned int i = 0; i < model.q_size; i++) {
+    q[i] = 0.3 * sin (1.7 * i + 0.4);
+    qdot[i] = 1.1 * cos (0.9 * i + 0.2);
+  }
+
+  MatrixNd C (MatrixNd::Zero (model.dof_count, model.dof_count));
+  CalcCoriolisMatrix (model, q, qdot, C);
+
+  VectorNd N (VectorNd::Zero (model.dof_count));
+  NonlinearEffects (model, q, qdot, N);
+
+  VectorNd C_qdot = C * qdot;
+  REQUIRE_THAT (C_qdot, AllCloseVector(N, TEST_PREC, TEST_PREC));
+
+  // time derivative of the joint space inertia matrix along qdot
+  double h = 1.0e-6;
+  MatrixNd H_plus (MatrixNd::Zero (model.dof_count, model.dof_count));
+  MatrixNd H_minus (MatrixNd::Zero (model.dof_count, model.dof_count));
+  VectorNd q_plus = q + h * qdot;
+  VectorNd q_minus = q - h * qdot;
+  CompositeRigidBodyAlgorithm (model, q_plus, H_plus);
+  CompositeRigidBodyAlgorithm (model, q_minus, H_minus);
+  MatrixNd H_dot = (H_plus - H_minus) / (2. * h);
+
+  // C + C^T = Mdot is equivalent to Mdot - 2 C being skew-symmetric
+  MatrixNd C_sym = C + C.transpose();
+  REQUIRE_THAT (H_dot, AllCloseMatrix(C_sym, 1.0e-7, 1.0e-7));
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcCoriolisMatrixHuman36", "") {
+  randomizeStates();
+
+  Model *models[2] = { model_emulated, model_3dof };
+
+  for (unsigned int m = 0; m < 2; m++) {
+    Model &model = *models[m];
+
+    MatrixNd C (MatrixNd::Zero (model.dof_count, model.dof_count));
+    CalcCoriolisMatrix (model, q, qdot, C);
+
+    VectorNd N (VectorNd::Zero (model.dof_count));
+    VectorNd G (VectorNd::Zero (model.dof_count));
+    NonlinearEffects (model, q, qdot, N);
+    NonlinearEffects (model, q, VectorNd::Zero (model.dof_count), G);
+
+    VectorNd C_qdot = C * qdot;
+    VectorNd N_velocity = N - G;
+    REQUIRE_THAT (C_qdot, AllCloseVector(N_velocity, TEST_PREC, TEST_PREC));
+  }
+}
+
+TEST_CASE (__FILE__"_CalcCoriolisMatrixSpherical", "") {
+  Model model;
+  model.gravity = Vector3d (0., 0., 0.);
+
+  Body body (1.2, Vector3d (0.1, 0.2, -0.1), Vector3d (0.3, 0.2, 0.4));
+  unsigned int base_id = model.AddBody (0, SpatialTransform(),
+      Joint (JointTypeFloatingBase), body);
+  unsigned int id = model.AddBody (base_id, Xtrans (Vector3d (0., 0.3, 0.)),
+      Joint (JointTypeSpherical), body);
+  model.AddBody (id, Xtrans (Vector3d (0.2, 0., 0.)),
+      Joint (JointTypeRevoluteZ), body);
+
+  VectorNd q (VectorNd::Zero (model.q_size));
+  VectorNd qdot (VectorNd::Zero (model.qdot_size));
+  model.SetQuaternion (base_id,
+      Quaternion (Vector4d (0.1, -0.3, 0.2, 0.92).normalized()), q);
+  model.SetQuaternion (id,
+      Quaternion (Vector4d (-0.2, 0.1, 0.3, 0.9).normalized()), q);
+  for (unsigned int i = 0; i < model.qdot_size; i++) {
+    qdot[i] = 0.8 * cos (1.3 * i + 0.5);
+  }
+
+  MatrixNd C (MatrixNd::Zero (model.dof_count, model.dof_count));
+  CalcCoriolisMatrix (model, q, qdot, C);
+
+  VectorNd N (VectorNd::Zero (model.dof_count));
+  NonlinearEffects (model, q, qdot, N);
+
+  VectorNd C_qdot = C * qdot;
+  REQUIRE_THAT (C_qdot, AllCloseVector(N, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE (__FILE__"_CalcInverseDynamicsDerivatives", "") {
+  Model model;
+  model.gravity = Vector3d (0., -9.81, 0.);
+
+  Body body_a (1.1, Vector3d (0.2, 0.1, -0.1), Vector3d (0.3, 0.2, 0.4));
+  Body body_b (0.7, Vector3d (0.1, -0.2, 0.3), Vector3d (0.2, 0.5, 0.3));
+
+  Joint joint_rot_yx (
+      SpatialVector (0., 1., 0., 0., 0., 0.),
+      SpatialVector (1., 0., 0., 0., 0., 0.)
+      );
+  Joint joint_trans_x (SpatialVector (0., 0., 0., 1., 0., 0.));
+
+  unsigned int id = model.AddBody (0, Xtrans (Vector3d (0., 0., 0.)),
+      joint_trans_x, body_a);
+  id = model.AddBody (id, Xtrans (Vector3d (0.1, 0., 0.)),
+      joint_rot_yx, body_b);
+  unsigned int branch = model.AddBody (id, Xtrans (Vector3d (0., 0.4, 0.)),
+      Joint (JointTypeRevoluteZ), body_a);
+  model.AddBody (branch, Xtrans (Vector3d (0.3, 0., 0.1)),
+      Joint (JointTypeRevolute, Vector3d (0.6, 0., 0.8)), body_b);
+  model.AddBody (id, Xtrans (Vector3d (-0.2, 0.1, 0.)),
+      Joint (JointTypeRevoluteX), body_b);
+
+  unsigned int n = model.dof_count;
+  VectorNd q (VectorNd::Zero (n));
+  VectorNd qdot (VectorNd::Zero (n));
+  VectorNd qddot (VectorNd::Zero (n));
+  VectorNd tau (VectorNd::Zero (n));
+  for (unsigned int i = 0; i < n; i++) {
+    q[i] = 0.4 * sin (1.3 * i + 0.1);
+    qdot[i] = 1.2 * cos (0.7 * i + 0.3);
+    qddot[i] = 0.9 * sin (2.1 * i + 0.5);
+  }
+
+  InverseDynamicsDerivatives derivatives;
+  REQUIRE (derivatives.Bind (model));
+  CalcInverseDynamicsDerivatives (model, q, qdot, qddot, tau, derivatives);
+
+  VectorNd tau_ref (VectorNd::Zero (n));
+  InverseDynamics (model, q, qdot, qddot, tau_ref);
+  REQUIRE_THAT (tau, AllCloseVector(tau_ref, TEST_PREC, TEST_PREC));
+
+  // dense second-order derivatives d2tau[k](i, j)
+  std::vector<MatrixNd> d2tau_dq_dq (n, MatrixNd::Zero (n, n));
+  std::vector<MatrixNd> d2tau_dq_dqdot (n, MatrixNd::Zero (n, n));
+  std::vector<MatrixNd> d2tau_dqdot_dqdot (n, MatrixNd::Zero (n, n));
+  for (unsigned int p = 0; p < derivatives.pair_first.size(); p++) {
+    unsigned int i = derivatives.pair_first[p];
+    unsigned int j = derivatives.pair_second[p];
+    for (unsigned int k = 0; k < n; k++) {
+      d2tau_dq_dq[k](i, j) = derivatives.d2tau_dq_dq(k, p);
+      d2tau_dq_dq[k](j, i) = derivatives.d2tau_dq_dq(k, p);
+      d2tau_dqdot_dqdot[k](i, j) = derivatives.d2tau_dqdot_dqdot(k, p);
+      d2tau_dqdot_dqdot[k](j, i) = derivatives.d2tau_dqdot_dqdot(k, p);
+      d2tau_dq_dqdot[k](i, j) = derivatives.d2tau_dq_dqdot(k, p);
+      d2tau_dq_dqdot[k](j, i) = derivatives.d2tau_dqdot_dq(k, p);
+    }
+  }
+
+  double h = 1.0e-6;
+  InverseDynamicsDerivatives derivatives_plus;
+  InverseDynamicsDerivatives derivatives_minus;
+  derivatives_plus.Bind (model);
+  derivatives_minus.Bind (model);
+
+  for (unsigned int i = 0; i < n; i++) {
+    VectorNd tau_plus (VectorNd::Zero (n));
+    VectorNd tau_minus (VectorNd::Zero (n));
+
+    // derivatives with respect to q_i
+    VectorNd q_plus = q;
+    VectorNd q_minus = q;
+    q_plus[i] += h;
+    q_minus[i] -= h;
+    CalcInverseDynamicsDerivatives (model, q_plus, qdot, qddot, tau_plus,
+        derivatives_plus);
+    CalcInverseDynamicsDerivatives (model, q_minus, qdot, qddot, tau_minus,
+        derivatives_minus);
+
+    VectorNd dtau_dq_fd = (tau_plus - tau_minus) / (2. * h);
+    VectorNd dtau_dq = derivatives.dtau_dq.col(i);
+    REQUIRE_THAT (dtau_dq, AllCloseVector(dtau_dq_fd, 1.0e-7, 1.0e-7));
+
+    MatrixNd d2tau_dq_dq_fd = (derivatives_plus.dtau_dq
+        - derivatives_minus.dtau_dq) / (2. * h);
+    MatrixNd d2tau_dq_dqdot_fd = (derivatives_plus.dtau_dqdot
+        - derivatives_minus.dtau_dqdot) / (2. * h);
+
+    for (unsigned int k = 0; k < n; k++) {
+      VectorNd d2tau_dq_dq_row = d2tau_dq_dq[k].row(i).transpose();
+      VectorNd d2tau_dq_dq_row_fd = d2tau_dq_dq_fd.row(k).transpose();
+      REQUIRE_THAT (d2tau_dq_dq_row,
+          AllCloseVector(d2tau_dq_dq_row_fd, 1.0e-7, 1.0e-7));
+
+      VectorNd d2tau_dq_dqdot_row = d2tau_dq_dqdot[k].row(i).transpose();
+      VectorNd d2tau_dq_dqdot_row_fd = d2tau_dq_dqdot_fd.row(k).transpose();
+      REQUIRE_THAT (d2tau_dq_dqdot_row,
+          AllCloseVector(d2tau_dq_dqdot_row_fd, 1.0e-7, 1.0e-7));
+    }
+
+    // derivatives with respect to qdot_i
+    VectorNd qdot_plus = qdot;
+    VectorNd qdot_minus = qdot;
+    qdot_plus[i] += h;
+    qdot_minus[i] -= h;
+    CalcInverseDynamicsDerivatives (model, q, qdot_plus, qddot, tau_plus,
+        derivatives_plus);
+    CalcInverseDynamicsDerivatives (model, q, qdot_minus, qddot, tau_minus,
+        derivatives_minus);
+
+    VectorNd dtau_dqdot_fd = (tau_plus - tau_minus) / (2. * h);
+    VectorNd dtau_dqdot = derivatives.dtau_dqdot.col(i);
+    REQUIRE_THAT (dtau_dqdot, AllCloseVector(dtau_dqdot_fd, 1.0e-7, 1.0e-7));
+
+    MatrixNd d2tau_dqdot_dqdot_fd = (derivatives_plus.dtau_dqdot
+        - derivatives_minus.dtau_dqdot) / (2. * h);
+
+    for (unsigned int k = 0; k < n; k++) {
+      VectorNd d2tau_dqdot_dqdot_row = d2tau_dqdot_dqdot[k].row(i).transpose();
+      VectorNd d2tau_dqdot_dqdot_row_fd = d2tau_dqdot_dqdot_fd.row(k).transpose();
+      REQUIRE_THAT (d2tau_dqdot_dqdot_row,
+          AllCloseVector(d2tau_dqdot_dqdot_row_fd, 1.0e-7, 1.0e-7));
+    }
+  }
+}
+
+TEST_CASE (__FILE__"_CalcInverseDynamicsDerivativesUnsupportedJoints", "") {
+  Model model;
+  Body body (1.1, Vector3d (0.2, 0.1, -0.1), Vector3d (0.3, 0.2, 0.4));
+
+  unsigned int id = model.AddBody (0, SpatialTransform(),
+      Joint (JointTypeRevoluteX), body);
+
+  InverseDynamicsDerivatives derivatives;
+  REQUIRE (derivatives.Bind (model));
+  REQUIRE (derivatives.bound);
+
+  model.AddBody (id, Xtrans (Vector3d (0., 0.5, 0.)),
+      Joint (JointTypeSpherical), body);
+
+  REQUIRE_FALSE (derivatives.Bind (model));
+  REQUIRE_FALSE (derivatives.bound);
+}
@@ -7,6 +7,8 @@
 #include "rbdl/Model.h"
 #include "rbdl/Dynamics.h"
 
+#include "Human36Fixture.h"
+
 using namespace std;
 using namespace RigidBodyDynamics;
 using namespace RigidBodyDynamics::Math;
@@ -74,3 +76,89 @@ TEST_CASE_METHOD(InverseDynamicsFixture, __FILE__"_TestInverseForwardDynamicsFlo
   REQUIRE_THAT (Tau, AllCloseVector(TauInv, TEST_PREC, TEST_PREC));
 }
 #endif
+
+TEST_CASE_METHOD(Human36, __FILE__"_InertialParameterRegressor", "") {
+  randomizeStates();
+
+  Model *models[] = { model_emulated, model_3dof };
+
+  for (unsigned int m = 0; m < 2; m++) {
+    Model &model = *models[m];
+    unsigned int param_count = 10 * (model.mBodies.size() - 1);
+
+    VectorNd params (VectorNd::Zero (param_count));
+    GetInertialParameters (model, params);
+
+    MatrixNd Y (MatrixNd::Zero (model.qdot_size, param_count));
+    CalcInertialParameterRegressor (model, q, qdot, qddot, Y);
+
+    VectorNd tau_id (VectorNd::Zero (model.qdot_size));
+    InverseDynamics (model, q, qdot, qddot, tau_id);
+
+    // random states result in large generalized forces
+    REQUIRE_THAT (tau_id, AllCloseVector(VectorNd (Y * params), 1.0e-10, 1.0e-10));
+  }
+}
+
+TEST_CASE_METHOD(InverseDynamicsFixture, __FILE__"_InertialParameterRegressorFixedBody", "") {
+  Body body (1.3, Vector3d (0.1, 0.4, -0.2), Vector3d (0.3, 0.5, 0.2));
+  Body fixed_body (0.7, Vector3d (0.5, 0.1, 0.3), Vector3d (0.2, 0.2, 0.4));
+
+  unsigned int body_id = model->AddBody (0, SpatialTransform(),
+      Joint (JointTypeRevoluteZ), body);
+  model->AddBody (body_id, Xtrans (Vector3d (1., 0., 0.)),
+      Joint (JointTypeFixed), fixed_body);
+  model->AddBody (body_id, Xtrans (Vector3d (0., 1., 0.)),
+      Joint (JointTypeRevoluteX), body);
+
+  VectorNd Q (VectorNd::Zero (model->q_size));
+  VectorNd QDot (VectorNd::Zero (model->qdot_size));
+  VectorNd QDDot (VectorNd::Zero (model->qdot_size));
+
+  Q[0] = 0.3; Q[1] = -0.7;
+  QDot[0] = 1.1; QDot[1] = 0.4;
+  QDDot[0] = -0.2; QDDot[1] = 2.1;
+
+  VectorNd params (VectorNd::Zero (20));
+  GetInertialParameters (*model, params);
+
+  MatrixNd Y (MatrixNd::Zero (model->qdot_size, 20));
+  CalcInertialParameterRegressor (*model, Q, QDot, QDDot, Y);
+
+  VectorNd Tau (VectorNd::Zero (model->qdot_size));
+  InverseDynamics (*model, Q, QDot, QDDot, Tau);
+
+  REQUIRE_THAT (Tau, AllCloseVector(VectorNd (Y * params), TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD(Human36, __FILE__"_InertialParameterRegressorBatch", "") {
+  Model &model = *model_3dof;
+  unsigned int param_count = 10 * (model.mBodies.size() - 1);
+  unsigned int sample_count = 4;
+
+  std::vector<VectorNd> Q, QDot, QDDot;
+  for (unsigned int s = 0; s < sample_count; s++) {
+    randomizeStates();
+    Q.push_back (q);
+    QDot.push_back (qdot);
+    QDDot.push_back (qddot);
+  }
+
+  MatrixNd Y (MatrixNd::Zero (sample_count * model.qdot_size, param_count));
+  CalcInertialParameterRegressor (model, Q, QDot, QDDot, Y);
+
+  VectorNd params (VectorNd::Zero (param_count));
+  GetInertialParameters (model, params);
+
+  for (unsigned int s = 0; s < sample_count; s++) {
+    MatrixNd Y_sample (MatrixNd::Zero (model.qdot_size, param_count));
+    CalcInertialParameterRegressor (model, Q[s], QDot[s], QDDot[s], Y_sample);
+
+    REQUIRE_THAT (Y_sample, AllCloseMatrix(MatrixNd (Y.block(s * model.qdot_size, 0, model.qdot_size, param_count)), 0., 0.));
+
+    VectorNd tau_id (VectorNd::Zero (model.qdot_size));
+    InverseDynamics (model, Q[s], QDot[s], QDDot[s], tau_id);
+
+    REQUIRE_THAT (tau_id, AllCloseVector(VectorNd (Y_sample * params), 1.0e-10, 1.0e-10));
+  }
+}
@@ -9,6 +9,7 @@
 #include "rbdl/Kinematics.h"
 #include "rbdl/Dynamics.h"
 
+#include "Fixtures.h"
 #include "Human36Fixture.h"
 
 using namespace std;
@@ -646,3 +647,384 @@ TEST_CASE_METHOD (Human36, __FILE__"_CalcPointAcceleration6D", "") {
 
   REQUIRE_THAT (a_foot_0_ref, AllCloseVector(a_foot_0, TEST_PREC, TEST_PREC));
 }
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcPointJacobianDot", "") {
+  Model *models[2] = { model_emulated, model_3dof };
+  Vector3d point_local (1.1, 2.2, 3.3);
+  double h = 1.0e-7;
+
+  for (unsigned int m = 0; m < 2; m++) {
+    randomizeStates();
+    Model &model_m = *models[m];
+    unsigned int foot_r_id = model_m.GetBodyId ("foot_r");
+    VectorNd qddot_zero (VectorNd::Zero (model_m.qdot_size));
+
+    MatrixNd G_dot (MatrixNd::Zero (3, model_m.qdot_size));
+    CalcPointJacobianDot (model_m, q, qdot, foot_r_id, point_local, G_dot);
+
+    // G_dot * qdot is the acceleration of the point for qddot = 0
+    Vector3d a_ref = CalcPointAcceleration (model_m, q, qdot, qddot_zero,
+        foot_r_id, point_local);
+    Vector3d a_jac = G_dot * qdot;
+
+    REQUIRE_THAT (a_ref, AllCloseVector(a_jac, TEST_PREC, TEST_PREC));
+
+    // Compare with the central difference quotient of the jacobian
+    MatrixNd G_plus (MatrixNd::Zero (3, model_m.qdot_size));
+    MatrixNd G_minus (MatrixNd::Zero (3, model_m.qdot_size));
+    VectorNd q_plus = q + h * qdot;
+    VectorNd q_minus = q - h * qdot;
+    CalcPointJacobian (model_m, q_plus, foot_r_id, point_local, G_plus);
+    CalcPointJacobian (model_m, q_minus, foot_r_id, point_local, G_minus);
+    MatrixNd G_dot_ref = (G_plus - G_minus) / (2. * h);
+
+    REQUIRE_THAT (G_dot_ref, AllCloseMatrix(G_dot, 1.0e-6, 1.0e-6));
+  }
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcPointJacobian6DDot", "") {
+  Model *models[2] = { model_emulated, model_3dof };
+  Vector3d point_local (1.1, 2.2, 3.3);
+
+  for (unsigned int m = 0; m < 2; m++) {
+    randomizeStates();
+    Model &model_m = *models[m];
+    unsigned int body_ids[2] = {
+      model_m.GetBodyId ("foot_r"),
+      model_m.GetBodyId ("uppertrunk")
+    };
+    VectorNd qddot_zero (VectorNd::Zero (model_m.qdot_size));
+
+    for (unsigned int i = 0; i < 2; i++) {
+      MatrixNd G_dot (MatrixNd::Zero (6, model_m.qdot_size));
+      CalcPointJacobian6DDot (model_m, q, qdot, body_ids[i], point_local,
+          G_dot);
+
+      SpatialVector a_ref = CalcPointAcceleration6D (model_m, q, qdot,
+          qddot_zero, body_ids[i], point_local);
+      SpatialVector a_jac = SpatialVector (G_dot * qdot);
+
+      REQUIRE_THAT (a_ref, AllCloseVector(a_jac, TEST_PREC, TEST_PREC));
+    }
+  }
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcBodySpatialJacobianDot", "") {
+  Model *models[2] = { model_emulated, model_3dof };
+  double h = 1.0e-7;
+
+  for (unsigned int m = 0; m < 2; m++) {
+    randomizeStates();
+    Model &model_m = *models[m];
+    unsigned int foot_r_id = model_m.GetBodyId ("foot_r");
+    VectorNd qddot_zero (VectorNd::Zero (model_m.qdot_size));
+
+    MatrixNd G_dot (MatrixNd::Zero (6, model_m.qdot_size));
+    CalcBodySpatialJacobianDot (model_m, q, qdot, foot_r_id, G_dot);
+
+    // G_dot * qdot is the spatial acceleration of the body for qddot = 0
+    UpdateKinematics (model_m, q, qdot, qddot_zero);
+    SpatialVector a_jac = SpatialVector (G_dot * qdot);
+
+    REQUIRE_THAT (model_m.a[foot_r_id], AllCloseVector(a_jac, TEST_PREC, TEST_PREC));
+
+    MatrixNd G_plus (MatrixNd::Zero (6, model_m.qdot_size));
+    MatrixNd G_minus (MatrixNd::Zero (6, model_m.qdot_size));
+    VectorNd q_plus = q + h * qdot;
+    VectorNd q_minus = q - h * qdot;
+    CalcBodySpatialJacobian (model_m, q_plus, foot_r_id, G_plus);
+    CalcBodySpatialJacobian (model_m, q_minus, foot_r_id, G_minus);
+    MatrixNd G_dot_ref = (G_plus - G_minus) / (2. * h);
+
+    REQUIRE_THAT (G_dot_ref, AllCloseMatrix(G_dot, 1.0e-6, 1.0e-6));
+  }
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcPointJacobianDotMultiplePoints", "") {
+  randomizeStates();
+
+  std::vector<unsigned int> body_ids;
+  std::vector<Vector3d> points;
+  body_ids.push_back (model->GetBodyId ("foot_r"));
+  points.push_back (Vector3d (1.1, 2.2, 3.3));
+  body_ids.push_back (model->GetBodyId ("hand_l"));
+  points.push_back (Vector3d (-0.1, 0.2, 0.));
+  body_ids.push_back (model->GetBodyId ("uppertrunk"));
+  points.push_back (Vector3d (0., 0.3, 0.1));
+
+  MatrixNd G_dot (MatrixNd::Zero (3 * body_ids.size(), model->qdot_size));
+  CalcPointJacobianDot (*model, q, qdot, body_ids, points, G_dot);
+
+  for (unsigned int i = 0; i < body_ids.size(); i++) {
+    MatrixNd G_dot_point (MatrixNd::Zero (3, model->qdot_size));
+    CalcPointJacobianDot (*model, q, qdot, body_ids[i], points[i],
+        G_dot_point);
+
+    MatrixNd G_dot_block = G_dot.block(3 * i, 0, 3, model->qdot_size);
+    REQUIRE_THAT (G_dot_point, AllCloseMatrix(G_dot_block, TEST_PREC, TEST_PREC));
+  }
+}
+
+/** \brief Custom joint that translates along the X and Y axes. */
+struct CustomJointTranslationXY : public CustomJoint {
+  CustomJointTranslationXY () {
+    mDoFCount = 2;
+    S = MatrixNd::Zero (6, 2);
+    S(3, 0) = 1.;
+    S(4, 1) = 1.;
+    d_u = MatrixNd::Zero (mDoFCount, 1);
+  }
+
+  virtual void jcalc (Model &model,
+      unsigned int joint_id,
+      const Math::VectorNd &q,
+      const Math::VectorNd &qdot) {
+    jcalc_X_lambda_S (model, joint_id, q);
+
+    unsigned int q_index = model.mJoints[joint_id].q_index;
+    model.v_J[joint_id] = S * Vector2d (qdot[q_index], qdot[q_index + 1]);
+    model.c_J[joint_id].setZero();
+  }
+
+  virtual void jcalc_X_lambda_S (Model &model,
+      unsigned int joint_id,
+      const Math::VectorNd &q) {
+    unsigned int q_index = model.mJoints[joint_id].q_index;
+    model.X_lambda[joint_id] =
+      Xtrans (Vector3d (q[q_index], q[q_index + 1], 0.))
+      * model.X_T[joint_id];
+  }
+};
+
+TEST_CASE (__FILE__"_CalcPointJacobianDotMultiplePointsSupportChains", "") {
+  // Multi DoF custom joints are not supported by CalcPointJacobianDot()
+  // but must not be evaluated for points outside of their subtree.
+  Model model;
+  Body body (1., Vector3d (0.1, 0.2, 0.), Vector3d (0.1, 0.1, 0.1));
+  CustomJointTranslationXY custom_joint;
+
+  unsigned int body_a_id = model.AddBody (0, SpatialTransform(),
+      Joint (JointTypeRevoluteZ), body);
+  unsigned int body_b_id = model.AddBody (body_a_id,
+      Xtrans (Vector3d (1., 0., 0.)), Joint (JointTypeRevoluteY), body);
+  model.AddBodyCustomJoint (0, Xtrans (Vector3d (0., 1., 0.)),
+      &custom_joint, body);
+
+  VectorNd q (VectorNd::Zero (model.q_size));
+  VectorNd qdot (VectorNd::Zero (model.qdot_size));
+  for (unsigned int i = 0; i < model.qdot_size; i++) {
+    q[i] = 0.3 * i + 0.1;
+    qdot[i] = 0.5 - 0.2 * i;
+  }
+
+  std::vector<unsigned int> body_ids;
+  std::vector<Vector3d> points;
+  body_ids.push_back (body_b_id);
+  points.push_back (Vector3d (0.2, 0.3, 0.1));
+  body_ids.push_back (body_a_id);
+  points.push_back (Vector3d (-0.1, 0.2, 0.));
+
+  MatrixNd G_dot (MatrixNd::Zero (3 * body_ids.size(), model.qdot_size));
+  CalcPointJacobianDot (model, q, qdot, body_ids, points, G_dot);
+
+  for (unsigned int i = 0; i < body_ids.size(); i++) {
+    MatrixNd G_dot_point (MatrixNd::Zero (3, model.qdot_size));
+    CalcPointJacobianDot (model, q, qdot, body_ids[i], points[i],
+        G_dot_point);
+
+    MatrixNd G_dot_block = G_dot.block(3 * i, 0, 3, model.qdot_size);
+    REQUIRE_THAT (G_dot_point, AllCloseMatrix(G_dot_block, TEST_PREC, TEST_PREC));
+  }
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcOperationalFrameKinematics", "") {
+  for (unsigned int i = 0; i < q.size(); i++) {
+    q[i] = 0.4 * sin (1.3 * i + 0.1);
+    qdot[i] = 1.2 * cos (0.7 * i + 0.3);
+    qddot[i] = 0.9 * sin (2.1 * i + 0.5);
+  }
+
+  std::vector<unsigned int> body_ids;
+  std::vector<SpatialTransform> frames;
+  body_ids.push_back (model->GetBodyId ("foot_r"));
+  frames.push_back (SpatialTransform (Xrotz (0.3).E, Vector3d (1.1, 2.2, 3.3)));
+  body_ids.push_back (model->GetBodyId ("hand_l"));
+  frames.push_back (SpatialTransform (Xroty (-0.7).E, Vector3d (-0.1, 0.2, 0.)));
+  body_ids.push_back (model->GetBodyId ("uppertrunk"));
+  frames.push_back (SpatialTransform (Xrotx (0.2).E, Vector3d (0., 0.3, 0.1)));
+  body_ids.push_back (0);
+  frames.push_back (SpatialTransform (Xrotz (-0.5).E, Vector3d (0.4, 0., 0.)));
+
+  for (unsigned int i = 0; i < body_ids.size(); i++) {
+    std::ostringstream frame_name;
+    frame_name << "frame_" << i;
+    REQUIRE (i == model->AddOperationalFrame (body_ids[i], frames[i],
+          frame_name.str()));
+  }
+  REQUIRE (2 == model->GetOperationalFrameId ("frame_2"));
+  REQUIRE (std::numeric_limits<unsigned int>::max()
+      == model->GetOperationalFrameId ("unknown"));
+
+  OperationalFrameKinematics kinematics;
+  kinematics.Bind (*model);
+  CalcOperationalFrameKinematics (*model, q, &qdot, &qddot, kinematics);
+
+  for (unsigned int i = 0; i < body_ids.size(); i++) {
+    Vector3d position = kinematics.positions.col(i);
+    Vector3d position_ref = CalcBodyToBaseCoordinates (*model, q,
+        body_ids[i], frames[i].r);
+    REQUIRE_THAT (position_ref, AllCloseVector(position, TEST_PREC, TEST_PREC));
+
+    MatrixNd orientation = kinematics.orientations.block(0, 3 * i, 3, 3);
+    MatrixNd orientation_ref = frames[i].E;
+    if (body_ids[i] != 0) {
+      orientation_ref = frames[i].E
+        * CalcBodyWorldOrientation (*model, q, body_ids[i]);
+    }
+    REQUIRE_THAT (orientation_ref, AllCloseMatrix(orientation, TEST_PREC, TEST_PREC));
+
+    SpatialVector velocity = kinematics.velocities.col(i);
+    SpatialVector acceleration = kinematics.accelerations.col(i);
+    MatrixNd jacobian = kinematics.jacobians.block(6 * i, 0, 6, model->qdot_size);
+
+    SpatialVector velocity_ref (SpatialVector::Zero());
+    SpatialVector acceleration_ref (SpatialVector::Zero());
+    MatrixNd jacobian_ref (MatrixNd::Zero (6, model->qdot_size));
+    if (body_ids[i] != 0) {
+      velocity_ref = CalcPointVelocity6D (*model, q, qdot, body_ids[i],
+          frames[i].r);
+      acceleration_ref = CalcPointAcceleration6D (*model, q, qdot, qddot,
+          body_ids[i], frames[i].r);
+      CalcPointJacobian6D (*model, q, body_ids[i], frames[i].r, jacobian_ref);
+    }
+
+    REQUIRE_THAT (velocity_ref, AllCloseVector(velocity, TEST_PREC, TEST_PREC));
+    REQUIRE_THAT (acceleration_ref, AllCloseVector(acceleration, TEST_PREC, TEST_PREC));
+    REQUIRE_THAT (jacobian_ref, AllCloseMatrix(jacobian, TEST_PREC, TEST_PREC));
+  }
+}
+
+TEST_CASE_METHOD (FixedAndMovableJoint, __FILE__"_OperationalFrameOnMovedFixedBody", "") {
+  unsigned int fixed_body_id = body_b_fixed_id;
+  unsigned int frame_id = model_fixed->AddOperationalFrame (fixed_body_id,
+      Xtrans (Vector3d (0.1, 0.2, 0.3)), "sensor");
+
+  model_fixed->SetJointFrame (fixed_body_id, Xtrans (Vector3d (0., 1., 0.5)));
+
+  Q_fixed[0] = 0.3;
+  Q_fixed[1] = -0.2;
+
+  OperationalFrameKinematics kinematics;
+  kinematics.Bind (*model_fixed);
+  CalcOperationalFrameKinematics (*model_fixed, Q_fixed, NULL, NULL,
+      kinematics, false);
+
+  Vector3d position = kinematics.positions.col(frame_id);
+  Vector3d position_ref = CalcBodyToBaseCoordinates (*model_fixed, Q_fixed,
+      fixed_body_id, Vector3d (0.1, 0.2, 0.3));
+  REQUIRE_THAT (position_ref, AllCloseVector(position, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CalcBodyPoses", "") {
+  for (unsigned int i = 0; i < q.size(); i++) {
+    q[i] = 0.8 * sin (1.7 * i + 0.2);
+  }
+
+  unsigned int body_count = model->mBodies.size() - 1
+    + model->mFixedBodies.size();
+  REQUIRE (7 * body_count
+      == GetBodyPosesSize (*model, PoseLayoutPositionQuaternion));
+  REQUIRE (12 * body_count == GetBodyPosesSize (*model, PoseLayoutMatrix3x4));
+
+  std::vector<double> poses_quat (
+      GetBodyPosesSize (*model, PoseLayoutPositionQuaternion));
+  std::vector<double> poses_mat (
+      GetBodyPosesSize (*model, PoseLayoutMatrix3x4));
+
+  CalcBodyPoses (*model, q, PoseLayoutPositionQuaternion, &poses_quat[0]);
+  CalcBodyPoses (*model, q, PoseLayoutMatrix3x4, &poses_mat[0]);
+
+  for (unsigned int i = 1; i < model->mBodies.size(); i++) {
+    Vector3d position_ref = CalcBodyToBaseCoordinates (*model, q, i,
+        Vector3d::Zero(), false);
+    MatrixNd orientation_ref = CalcBodyWorldOrientation (*model, q, i, false);
+
+    const double *pose = &poses_quat[7 * (i - 1)];
+    Vector3d position (pose[0], pose[1], pose[2]);
+    REQUIRE_THAT (position_ref, AllCloseVector(position, TEST_PREC, TEST_PREC));
+
+    Quaternion quat (pose[3], pose[4], pose[5], pose[6]);
+    REQUIRE (fabs (quat.norm() - 1.) < TEST_PREC);
+    REQUIRE (quat[3] >= 0.);
+    MatrixNd orientation = quat.toMatrix();
+    REQUIRE_THAT (orientation_ref,
+        AllCloseMatrix(orientation, TEST_PREC, TEST_PREC));
+
+    const double *pose_mat = &poses_mat[12 * (i - 1)];
+    for (unsigned int row = 0; row < 3; row++) {
+      for (unsigned int col = 0; col < 3; col++) {
+        REQUIRE (fabs (pose_mat[4 * row + col] - orientation_ref(col, row))
+            < TEST_PREC);
+      }
+      REQUIRE (fabs (pose_mat[4 * row + 3] - position_ref[row]) < TEST_PREC);
+    }
+  }
+
+  // batched poses of several configurations
+  unsigned int count = 3;
+  MatrixNd Qs (model->q_size, count);
+  for (unsigned int k = 0; k < count; k++) {
+    for (unsigned int i = 0; i < model->q_size; i++) {
+      Qs(i, k) = 1.1 * cos (0.9 * i + 0.6 * k);
+    }
+  }
+
+  unsigned int poses_size = GetBodyPosesSize (*model, PoseLayoutMatrix3x4);
+  std::vector<double> poses_batch (count * poses_size);
+  CalcBodyPosesBatch (*model, Qs, PoseLayoutMatrix3x4, &poses_batch[0]);
+
+  for (unsigned int k = 0; k < count; k++) {
+    VectorNd Q_k = Qs.col(k);
+    CalcBodyPoses (*model, Q_k, PoseLayoutMatrix3x4, &poses_mat[0]);
+
+    for (unsigned int i = 0; i < poses_size; i++) {
+      REQUIRE (poses_mat[i] == poses_batch[k * poses_size + i]);
+    }
+  }
+}
+
+TEST_CASE_METHOD (FixedAndMovableJoint, __FILE__"_CalcBodyPosesFixedBody", "") {
+  Q_fixed[0] = 0.3;
+  Q_fixed[1] = -0.2;
+
+  std::vector<double> poses (
+      GetBodyPosesSize (*model_fixed, PoseLayoutPositionQuaternion));
+  REQUIRE (poses.size() == 7 * 3);
+  REQUIRE (GetBodyPosesSize (*model_fixed, PoseLayoutPositionQuaternion, false)
+      == 7 * 2);
+
+  CalcBodyPoses (*model_fixed, Q_fixed, PoseLayoutPositionQuaternion,
+      &poses[0]);
+
+  // body a rotates about the z-axis of the base
+  REQUIRE (fabs (poses[3]) < TEST_PREC);
+  REQUIRE (fabs (poses[4]) < TEST_PREC);
+  REQUIRE (fabs (poses[5] - sin (0.15)) < TEST_PREC);
+  REQUIRE (fabs (poses[6] - cos (0.15)) < TEST_PREC);
+
+  unsigned int fixed_index = model_fixed->mBodies.size() - 1
+    + body_b_fixed_id - model_fixed->fixed_body_discriminator;
+  const double *pose = &poses[7 * fixed_index];
+
+  Vector3d position (pose[0], pose[1], pose[2]);
+  Vector3d position_ref = CalcBodyToBaseCoordinates (*model_fixed, Q_fixed,
+      body_b_fixed_id, Vector3d::Zero());
+  REQUIRE_THAT (position_ref, AllCloseVector(position, TEST_PREC, TEST_PREC));
+
+  MatrixNd orientation = Quaternion (pose[3], pose[4], pose[5],
+      pose[6]).toMatrix();
+  MatrixNd orientation_ref = CalcBodyWorldOrientation (*model_fixed, Q_fixed,
+      body_b_fixed_id);
+  REQUIRE_THAT (orientation_ref,
+      AllCloseMatrix(orientation, TEST_PREC, TEST_PREC));
+}
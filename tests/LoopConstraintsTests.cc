@@ -945,6 +945,71 @@ TEST_CASE_METHOD (SliderCrank3D, __FILE__"_TestSliderCrank3DConstraintsVelocityE
   REQUIRE_THAT (errdRef, AllCloseVector(errd, TEST_PREC, TEST_PREC));
 }
 
+TEST_CASE_METHOD (SliderCrank3D, __FILE__"_TestSliderCrank3DConstraintsTerms", "") {
+  MatrixNd G(MatrixNd::Zero(cs.size(), model.dof_count));
+  VectorNd err(VectorNd::Zero(cs.size()));
+  VectorNd errd(VectorNd::Zero(cs.size()));
+  VectorNd gamma(VectorNd::Zero(cs.size()));
+
+  MatrixNd GRef(MatrixNd::Zero(cs.size(), model.dof_count));
+  VectorNd errRef(VectorNd::Zero(cs.size()));
+  VectorNd errdRef(VectorNd::Zero(cs.size()));
+  VectorNd gammaRef(VectorNd::Zero(cs.size()));
+
+  // A configuration that violates the constraints such that the
+  // stabilization terms do not vanish.
+  q[0] = 0.4;
+  q[1] = 0.25 * M_PI;
+  q[2] = -0.25 * M_PI;
+  q[3] = 0.1;
+  q[4] = 0.2;
+
+  qd[0] = -0.2;
+  qd[1] = 0.1 * M_PI;
+  qd[2] = -0.1 * M_PI;
+  qd[3] = 0.3;
+  qd[4] = 0.1 * M_PI;
+
+  CalcConstraintsTerms(model, q, qd, cs, G, err, errd, gamma);
+
+  CalcConstraintsJacobian(model, q, cs, GRef);
+  CalcConstraintsPositionError(model, q, cs, errRef);
+  CalcConstraintsVelocityError(model, q, qd, cs, errdRef);
+
+  REQUIRE (errRef.norm() > 0.);
+  REQUIRE_THAT (GRef, AllCloseMatrix(G, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+  REQUIRE_THAT (errdRef, AllCloseVector(errd, TEST_PREC, TEST_PREC));
+
+  // Evaluate gamma for each constraint from the point kinematics.
+  VectorNd qddZero(VectorNd::Zero(model.dof_count));
+  UpdateKinematics(model, q, qd, qddZero);
+  for (unsigned int i = 0; i < cs.size(); i++) {
+    Vector3d pos_p = CalcBodyToBaseCoordinates(model, q, cs.body_p[i],
+        cs.X_p[i].r, false);
+    Matrix3d rot_p = CalcBodyWorldOrientation(model, q, cs.body_p[i], false
+        ).transpose() * cs.X_p[i].E;
+    SpatialVector axis = SpatialTransform(rot_p, pos_p).apply(
+        cs.constraintAxis[i]);
+    SpatialVector vel_p = CalcPointVelocity6D(model, q, qd, cs.body_p[i],
+        cs.X_p[i].r, false);
+    SpatialVector vel_s = CalcPointVelocity6D(model, q, qd, cs.body_s[i],
+        cs.X_s[i].r, false);
+    SpatialVector acc_p = CalcPointAcceleration6D(model, q, qd, qddZero,
+        cs.body_p[i], cs.X_p[i].r, false);
+    SpatialVector acc_s = CalcPointAcceleration6D(model, q, qd, qddZero,
+        cs.body_s[i], cs.X_s[i].r, false);
+
+    gammaRef[i] = - axis.dot(acc_s - acc_p)
+      - crossm(vel_p, axis).dot(vel_s - vel_p)
+      - 2. * cs.baumgarteParameters[i][0] * errdRef[i]
+      - cs.baumgarteParameters[i][1] * cs.baumgarteParameters[i][1]
+      * errRef[i];
+  }
+
+  REQUIRE_THAT (gammaRef, AllCloseVector(gamma, TEST_PREC, TEST_PREC));
+}
+
 TEST_CASE_METHOD (SliderCrank3D, __FILE__"_TestSliderCrank3DAssemblyQ", "") {
   VectorNd weights(q.size());
   VectorNd qInit(q.size());
@@ -1253,7 +1318,7 @@ TEST_CASE_METHOD (FloatingFourBarLinkage, __FILE__"_TestFloatingFourBarLinkageCo
 
   CalcConstraintsPositionError(model, q, cs, err);
 
-  VectorNd target(6);
+  VectorNd target = VectorNd::Zero(6);
   REQUIRE_THAT(target, AllCloseVector(err, TEST_PREC, TEST_PREC));
 
   // Test in non-zero position.
@@ -2308,3 +2373,166 @@ TEST_CASE (__FILE__"_ConstraintCorrectnessTest", "") {
   REQUIRE_THAT (a030, AllCloseVector(a030c, TEST_PREC, TEST_PREC));
   */
 }
+
+TEST_CASE_METHOD (FourBarLinkage, __FILE__"_TestFourBarLinkageCoordinatePartitioning", "") {
+  q[0] = M_PI * 3 / 4;
+  q[1] = -0.5 * M_PI;
+  q[2] = M_PI - q[0];
+  q[3] = -q[1];
+  q[4] = q[0] + q[1] - q[2] - q[3];
+
+  CoordinatePartitioning partitioning;
+  REQUIRE (partitioning.Bind (model, q, cs));
+  REQUIRE (2 == partitioning.independent.size());
+  REQUIRE (3 == partitioning.dependent.size());
+
+  VectorNd err (VectorNd::Zero (cs.size()));
+  VectorNd errRef (VectorNd::Zero (cs.size()));
+  MatrixNd G (MatrixNd::Zero (cs.size(), q.size()));
+
+  // move the independent coordinates and solve for the dependent ones
+  VectorNd qIndependent (q);
+  for (unsigned int j = 0; j < partitioning.independent.size(); j++) {
+    qIndependent[partitioning.independent[j]] += 0.05 * (j + 1);
+  }
+  q = qIndependent;
+  REQUIRE (CalcDependentQ (model, q, cs, partitioning));
+
+  CalcConstraintsPositionError (model, q, cs, err);
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+  for (unsigned int j = 0; j < partitioning.independent.size(); j++) {
+    REQUIRE (q[partitioning.independent[j]]
+        == qIndependent[partitioning.independent[j]]);
+  }
+
+  qd[0] = 0.3;
+  qd[1] = -0.2;
+  qd[2] = 0.5;
+  qd[3] = 0.1;
+  qd[4] = -0.4;
+  VectorNd qdIndependent (qd);
+  CalcDependentQDot (model, q, qd, cs, partitioning);
+
+  CalcConstraintsJacobian (model, q, cs, G);
+  err = G * qd;
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+  for (unsigned int j = 0; j < partitioning.independent.size(); j++) {
+    REQUIRE (qd[partitioning.independent[j]]
+        == qdIndependent[partitioning.independent[j]]);
+  }
+
+  // the accelerations and forces match the direct method
+  tau[0] = 1.;
+  tau[1] = -2.;
+  tau[2] = 3.;
+  tau[3] = -5.;
+  tau[4] = 7.;
+
+  VectorNd qddDirect (VectorNd::Zero (q.size()));
+  ForwardDynamicsConstraintsDirect (model, q, qd, tau, cs, qddDirect);
+  VectorNd forceDirect = cs.force;
+
+  VectorNd qddPartitioned (VectorNd::Zero (q.size()));
+  ForwardDynamicsConstraintsPartitioned (model, q, qd, tau, cs, partitioning,
+      qddPartitioned);
+
+  REQUIRE_THAT (qddDirect, AllCloseVector(qddPartitioned, 1e-9, 1e-9));
+  REQUIRE_THAT (forceDirect, AllCloseVector(cs.force, 1e-9, 1e-9));
+
+  // simulate with explicit Euler steps in which the dependent coordinates
+  // are computed from the independent ones
+  double h = 1.0e-3;
+  for (unsigned int i = 0; i < 100; i++) {
+    ForwardDynamicsConstraintsPartitioned (model, q, qd, tau, cs,
+        partitioning, qddPartitioned);
+    qd += h * qddPartitioned;
+    q += h * qd;
+    REQUIRE (CalcDependentQ (model, q, cs, partitioning));
+    CalcDependentQDot (model, q, qd, cs, partitioning);
+  }
+
+  CalcConstraintsPositionError (model, q, cs, err);
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+  CalcConstraintsVelocityError (model, q, qd, cs, err);
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+
+  // user defined independent coordinates
+  std::vector<unsigned int> independent;
+  independent.push_back (0);
+  independent.push_back (2);
+  REQUIRE (partitioning.Bind (model, q, cs, independent));
+  REQUIRE (3 == partitioning.dependent.size());
+  REQUIRE (1 == partitioning.dependent[0]);
+  REQUIRE (3 == partitioning.dependent[1]);
+  REQUIRE (4 == partitioning.dependent[2]);
+}
+
+TEST_CASE_METHOD (FourBarLinkage, __FILE__"_TestFourBarLinkageProjectOntoConstraints", "") {
+  q[0] = M_PI * 3 / 4;
+  q[1] = -0.5 * M_PI;
+  q[2] = M_PI - q[0];
+  q[3] = -q[1];
+  q[4] = q[0] + q[1] - q[2] - q[3];
+
+  qd[0] = 0.3;
+  qd[1] = -0.2;
+  qd[2] = 0.5;
+  qd[3] = 0.1;
+  qd[4] = -0.4;
+
+  tau[0] = 1.;
+  tau[1] = -2.;
+  tau[2] = 3.;
+  tau[3] = -5.;
+  tau[4] = 7.;
+
+  VectorNd errRef (VectorNd::Zero (cs.size()));
+  VectorNd err (VectorNd::Zero (cs.size()));
+  MatrixNd G (MatrixNd::Zero (cs.size(), q.size()));
+
+  VectorNd weights (VectorNd::Constant (q.size(), 1.));
+  VectorNd qdInit (qd);
+  CalcAssemblyQDot (model, q, qdInit, cs, qd, weights);
+
+  // the dynamics solve stores the factorization that is reused
+  ForwardDynamicsConstraintsNullSpace (model, q, qd, tau, cs, qdd);
+
+  // integration step with errors that drift off the constraint manifold
+  double h = 0.01;
+  VectorNd qStep = q + h * qd;
+  VectorNd qdStep = qd + h * qdd;
+  qStep[1] += 1.0e-5;
+  qStep[3] -= 2.0e-5;
+  qdStep[0] -= 3.0e-5;
+  qdStep[4] += 1.0e-5;
+
+  VectorNd qProjected (qStep);
+  VectorNd qdProjected (qdStep);
+  REQUIRE (ProjectOntoConstraints (model, qProjected, qdProjected, cs, 1e-12, 5,
+        false));
+
+  CalcConstraintsPositionError (model, qProjected, cs, err);
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+  CalcConstraintsJacobian (model, qProjected, cs, G);
+  err = G * qdProjected;
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+
+  // the corrections are of the order of the drift
+  CHECK ((qProjected - qStep).norm() < h);
+  CHECK ((qdProjected - qdStep).norm() < h);
+
+  // recomputing the factorization at the drifted positions yields the same
+  // projection
+  VectorNd qUpdated (qStep);
+  VectorNd qdUpdated (qdStep);
+  REQUIRE (ProjectOntoConstraints (model, qUpdated, qdUpdated, cs, 1e-12, 5,
+        true));
+
+  CalcConstraintsPositionError (model, qUpdated, cs, err);
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+  CalcConstraintsJacobian (model, qUpdated, cs, G);
+  err = G * qdUpdated;
+  REQUIRE_THAT (errRef, AllCloseVector(err, TEST_PREC, TEST_PREC));
+  CHECK_THAT (qProjected, AllCloseVector(qUpdated, 1e-8, 1e-8));
+  CHECK_THAT (qdProjected, AllCloseVector(qdUpdated, 1e-8, 1e-8));
+}
@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "Fixtures.h"
+#include "Human36Fixture.h"
 #include "rbdl/rbdl_mathutils.h"
 #include "rbdl/Logging.h"
 
@@ -629,3 +630,418 @@ TEST_CASE (__FILE__"_TestAddFixedBodyToRoot", "") {
   REQUIRE_THAT (Vector3d (2., 0., 0.), AllCloseVector(base_coords, 0., 0.));
 }
 
+
+void BuildMixedJointModel (Model &model, ModelBuilder *builder) {
+  Body body (1., Vector3d (0.1, 0.2, 0.3), Vector3d (1.1, 1.2, 1.3));
+  Joint joint_rot_z (JointTypeRevoluteZ);
+  Joint joint_rot_y (SpatialVector (0., 1., 0., 0., 0., 0.));
+  Joint joint_spherical (JointTypeSpherical);
+  Joint joint_euler (JointTypeEulerZYX);
+  Joint joint_2dof (
+      SpatialVector (0., 0., 1., 0., 0., 0.),
+      SpatialVector (0., 0., 0., 1., 0., 0.)
+      );
+  Joint joint_fixed (JointTypeFixed);
+
+  SpatialTransform frame = Xtrans (Vector3d (0., -0.5, 0.));
+
+  for (unsigned int i = 0; i < 20; i++) {
+    unsigned int parent_id = (i == 0) ? 0 : model.previously_added_body_id;
+    Joint joint = joint_rot_z;
+    if (i % 5 == 1) {
+      joint = joint_spherical;
+    } else if (i % 5 == 2) {
+      joint = joint_euler;
+    } else if (i % 5 == 3) {
+      joint = joint_2dof;
+    } else if (i % 5 == 4) {
+      joint = joint_fixed;
+    } else if (i % 2 == 0) {
+      joint = joint_rot_y;
+      parent_id = (i / 2) % 3;
+    }
+
+    if (builder) {
+      builder->AddBody (parent_id, frame, joint, body);
+    } else {
+      model.AddBody (parent_id, frame, joint, body);
+    }
+  }
+}
+
+TEST_CASE (__FILE__"_ModelBuilder", "") {
+  Model model_reference;
+  BuildMixedJointModel (model_reference, NULL);
+
+  Model model;
+  ModelBuilder builder (model, 32);
+  BuildMixedJointModel (model, &builder);
+  builder.Finalize();
+
+  REQUIRE (model_reference.mBodies.size() == model.mBodies.size());
+  REQUIRE (model_reference.mFixedBodies.size() == model.mFixedBodies.size());
+  REQUIRE (model_reference.dof_count == model.dof_count);
+  REQUIRE (model_reference.q_size == model.q_size);
+  REQUIRE (model_reference.qdot_size == model.qdot_size);
+  REQUIRE (model_reference.lambda == model.lambda);
+  REQUIRE (model_reference.lambda_q == model.lambda_q);
+  REQUIRE (model_reference.multdof3_w_index == model.multdof3_w_index);
+  REQUIRE (model_reference.mJointUpdateOrder == model.mJointUpdateOrder);
+  REQUIRE (model_reference.d.size() == model.d.size());
+  REQUIRE (model_reference.u.size() == model.u.size());
+  REQUIRE (false == model.defer_index_update);
+
+  VectorNd q (VectorNd::Zero (model.q_size));
+  VectorNd qdot (VectorNd::Zero (model.qdot_size));
+  VectorNd tau (VectorNd::Zero (model.qdot_size));
+  for (unsigned int i = 0; i < model.qdot_size; i++) {
+    q[i] = 0.1 * i;
+    qdot[i] = -0.2 * i;
+    tau[i] = 0.3 * i;
+  }
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    if (model.mJoints[i].mJointType == JointTypeSpherical) {
+      model.SetQuaternion (i, Quaternion (0., 0., 0., 1.), q);
+    }
+  }
+
+  VectorNd qddot_reference (VectorNd::Zero (model.qdot_size));
+  VectorNd qddot (VectorNd::Zero (model.qdot_size));
+  ForwardDynamics (model_reference, q, qdot, tau, qddot_reference);
+  ForwardDynamics (model, q, qdot, tau, qddot);
+
+  REQUIRE_THAT (qddot_reference, AllCloseVector(qddot, TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE (__FILE__"_ModelBuilderFinalizeOnDestruction", "") {
+  Model model;
+  {
+    ModelBuilder builder (model);
+    builder.AddBody (0, SpatialTransform(), Joint (JointTypeSpherical),
+        Body (1., Vector3d (0., 0., 0.), Vector3d (1., 1., 1.)));
+    builder.AppendBody (Xtrans (Vector3d (1., 0., 0.)),
+        Joint (JointTypeRevoluteX),
+        Body (1., Vector3d (0., 0., 0.), Vector3d (1., 1., 1.)));
+  }
+
+  REQUIRE (4 == model.dof_count);
+  REQUIRE (5 == model.q_size);
+  REQUIRE (4 == model.multdof3_w_index[1]);
+  REQUIRE (3 == model.d.size());
+}
+
+/** \brief Creates a model of a movable body with a merged fixed body and a
+ * movable child and returns the id of the movable body.
+ */
+static unsigned int CreateModelWithFixedBody (Model &model,
+    const Body &body_a, const Body &body_fixed,
+    const SpatialTransform &fixed_frame) {
+  model.gravity = Vector3d (0., -9.81, 0.);
+
+  unsigned int body_a_id = model.AddBody (0, SpatialTransform(),
+      Joint (JointTypeEulerZYX), body_a);
+  model.AddBody (body_a_id, fixed_frame, Joint (JointTypeFixed),
+      body_fixed);
+  model.AddBody (body_a_id, Xtrans (Vector3d (0., 1., 0.)),
+      Joint (JointTypeRevoluteX), Body (0.8, Vector3d (0., 0.3, 0.),
+        Vector3d (0.1, 0.2, 0.1)));
+
+  return body_a_id;
+}
+
+/** \brief Checks that two models have the same bodies and dynamics. */
+static void CheckEqualDynamics (Model &model, Model &model_reference) {
+  REQUIRE (model.mBodies.size() == model_reference.mBodies.size());
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    REQUIRE_THAT (model_reference.I[i].toMatrix(), AllCloseMatrix(model.I[i].toMatrix(), 1.0e-12, 1.0e-12));
+    REQUIRE (model_reference.mBodies[i].mMass == Approx (model.mBodies[i].mMass));
+    REQUIRE_THAT (model_reference.mBodies[i].mCenterOfMass, AllCloseVector(model.mBodies[i].mCenterOfMass, 1.0e-12, 1.0e-12));
+    REQUIRE_THAT (model_reference.mBodies[i].mInertia, AllCloseMatrix(model.mBodies[i].mInertia, 1.0e-12, 1.0e-12));
+  }
+
+  VectorNd Q (VectorNd::Zero (model.q_size));
+  VectorNd QDot (VectorNd::Zero (model.qdot_size));
+  VectorNd Tau (VectorNd::Zero (model.qdot_size));
+  for (unsigned int i = 0; i < model.qdot_size; i++) {
+    Q[i] = 0.2 * i - 0.3;
+    QDot[i] = 0.4 - 0.1 * i;
+    Tau[i] = 0.5 * i;
+  }
+
+  VectorNd QDDot (VectorNd::Zero (model.qdot_size));
+  VectorNd QDDot_reference (VectorNd::Zero (model.qdot_size));
+  ForwardDynamics (model, Q, QDot, Tau, QDDot);
+  ForwardDynamics (model_reference, Q, QDot, Tau, QDDot_reference);
+
+  REQUIRE_THAT (QDDot_reference, AllCloseVector(QDDot, 1.0e-12, 1.0e-12));
+}
+
+TEST_CASE (__FILE__"_SetBodyInertialPropertiesMovable", "") {
+  Body body_a (1.2, Vector3d (0.1, 0.2, -0.1), Vector3d (0.3, 0.2, 0.4));
+  Body body_a_new (2.1, Vector3d (-0.3, 0.1, 0.2), Vector3d (0.5, 0.1, 0.3));
+  Body body_fixed (0.7, Vector3d (0.2, 0., 0.1), Vector3d (0.1, 0.1, 0.2));
+  SpatialTransform fixed_frame = Xrotz (0.3) * Xtrans (Vector3d (0.5, 0.2, 0.));
+
+  Model model;
+  unsigned int body_a_id =
+    CreateModelWithFixedBody (model, body_a, body_fixed, fixed_frame);
+  Model model_reference;
+  CreateModelWithFixedBody (model_reference, body_a_new, body_fixed, fixed_frame);
+
+  model.SetBodyInertialProperties (body_a_id, body_a_new.mMass,
+      body_a_new.mCenterOfMass, body_a_new.mInertia);
+
+  CheckEqualDynamics (model, model_reference);
+}
+
+TEST_CASE (__FILE__"_SetBodyInertialPropertiesFixed", "") {
+  Body body_a (1.2, Vector3d (0.1, 0.2, -0.1), Vector3d (0.3, 0.2, 0.4));
+  Body body_fixed (0.7, Vector3d (0.2, 0., 0.1), Vector3d (0.1, 0.1, 0.2));
+  Body body_fixed_new (1.4, Vector3d (-0.1, 0.3, 0.), Vector3d (0.2, 0.3, 0.1));
+  SpatialTransform fixed_frame = Xrotz (0.3) * Xtrans (Vector3d (0.5, 0.2, 0.));
+
+  Model model;
+  CreateModelWithFixedBody (model, body_a, body_fixed, fixed_frame);
+  Model model_reference;
+  CreateModelWithFixedBody (model_reference, body_a, body_fixed_new, fixed_frame);
+
+  unsigned int body_fixed_id = model.fixed_body_discriminator;
+  model.SetBodyInertialProperties (body_fixed_id, body_fixed_new.mMass,
+      body_fixed_new.mCenterOfMass, body_fixed_new.mInertia);
+
+  CheckEqualDynamics (model, model_reference);
+}
+
+TEST_CASE (__FILE__"_SetJointFrameFixedBody", "") {
+  Body body_a (1.2, Vector3d (0.1, 0.2, -0.1), Vector3d (0.3, 0.2, 0.4));
+  Body body_fixed (0.7, Vector3d (0.2, 0., 0.1), Vector3d (0.1, 0.1, 0.2));
+  SpatialTransform fixed_frame = Xrotz (0.3) * Xtrans (Vector3d (0.5, 0.2, 0.));
+  SpatialTransform fixed_frame_new = Xroty (-0.2) * Xtrans (Vector3d (0.1, 0.4, 0.3));
+
+  Model model;
+  CreateModelWithFixedBody (model, body_a, body_fixed, fixed_frame);
+  Model model_reference;
+  CreateModelWithFixedBody (model_reference, body_a, body_fixed, fixed_frame_new);
+
+  unsigned int body_fixed_id = model.fixed_body_discriminator;
+  model.SetJointFrame (body_fixed_id, fixed_frame_new);
+
+  SpatialTransform transform_fixed = model.GetJointFrame (body_fixed_id);
+  REQUIRE_THAT (fixed_frame_new.r, AllCloseVector(transform_fixed.r, 0., 0.));
+
+  CheckEqualDynamics (model, model_reference);
+}
+
+/** \brief Creates a model with nested fixed bodies that carry movable
+ * bodies and an operational frame and returns the id of the first fixed
+ * body.
+ */
+static unsigned int CreateModelWithNestedFixedBodies (Model &model,
+    const SpatialTransform &fixed_frame) {
+  Body body (0.7, Vector3d (0.2, 0., 0.1), Vector3d (0.1, 0.1, 0.2));
+
+  unsigned int body_a_id = model.AddBody (0, SpatialTransform(),
+      Joint (JointTypeEulerZYX), body);
+  unsigned int fixed_a_id = model.AddBody (body_a_id, fixed_frame,
+      Joint (JointTypeFixed), body);
+  unsigned int fixed_b_id = model.AddBody (fixed_a_id,
+      Xrotx (0.4) * Xtrans (Vector3d (0., 0.2, 0.3)),
+      Joint (JointTypeFixed), body);
+  model.AddBody (fixed_a_id, Xtrans (Vector3d (0.3, 0., 0.1)),
+      Joint (JointTypeRevoluteY), body);
+  model.AddBody (fixed_b_id, Xroty (0.2) * Xtrans (Vector3d (0., 0.1, 0.)),
+      Joint (SpatialVector (1., 0., 0., 0., 0., 0.),
+        SpatialVector (0., 0., 1., 0., 0., 0.)), body);
+  model.AddOperationalFrame (fixed_b_id,
+      Xtrans (Vector3d (0.1, 0.2, 0.3)), "frame");
+
+  return fixed_a_id;
+}
+
+TEST_CASE (__FILE__"_SetJointFrameFixedBodyDescendants", "") {
+  SpatialTransform fixed_frame = Xrotz (0.3) * Xtrans (Vector3d (0.5, 0.2, 0.));
+  SpatialTransform fixed_frame_new = Xroty (-0.2) * Xtrans (Vector3d (0.1, 0.4, 0.3));
+
+  Model model;
+  unsigned int fixed_id = CreateModelWithNestedFixedBodies (model, fixed_frame);
+  Model model_reference;
+  CreateModelWithNestedFixedBodies (model_reference, fixed_frame_new);
+
+  // repeated updates must not accumulate errors
+  for (unsigned int i = 0; i < 100; i++) {
+    model.SetJointFrame (fixed_id, fixed_frame);
+    model.SetJointFrame (fixed_id, fixed_frame_new);
+  }
+
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    REQUIRE_THAT (model_reference.X_T[i].toMatrix(), AllCloseMatrix(model.X_T[i].toMatrix(), 1.0e-12, 1.0e-12));
+  }
+
+  for (unsigned int k = 0; k < model.mFixedBodies.size(); k++) {
+    REQUIRE_THAT (model_reference.mFixedBodies[k].mParentTransform.toMatrix(), AllCloseMatrix(model.mFixedBodies[k].mParentTransform.toMatrix(), 1.0e-12, 1.0e-12));
+  }
+
+  REQUIRE_THAT (model_reference.mOperationalFrames[0].movable_transform.toMatrix(), AllCloseMatrix(model.mOperationalFrames[0].movable_transform.toMatrix(), 1.0e-12, 1.0e-12));
+
+  CheckEqualDynamics (model, model_reference);
+}
+
+/** \brief Locks all degrees of freedom of a model except those of the
+ * floating base and the right arm and compares the reduced model with the
+ * original one.
+ */
+static void TestReducedModelRightArm (Model &model) {
+  std::vector<bool> locked_dofs (model.qdot_size, true);
+
+  unsigned int body_id = model.GetBodyId ("hand_r");
+  unsigned int trunk_id = model.GetParentBodyId (model.GetBodyId ("uppertrunk"));
+  while (body_id != trunk_id) {
+    const Joint &joint = model.mJoints[body_id];
+    for (unsigned int j = 0; j < joint.mDoFCount; j++) {
+      locked_dofs[joint.q_index + j] = false;
+    }
+    body_id = model.lambda[body_id];
+  }
+
+  body_id = model.GetBodyId ("pelvis");
+  while (body_id != 0) {
+    const Joint &joint = model.mJoints[body_id];
+    for (unsigned int j = 0; j < joint.mDoFCount; j++) {
+      locked_dofs[joint.q_index + j] = false;
+    }
+    body_id = model.lambda[body_id];
+  }
+
+  VectorNd Q (VectorNd::Zero (model.q_size));
+  VectorNd QDot (VectorNd::Zero (model.qdot_size));
+  VectorNd QDDot (VectorNd::Zero (model.qdot_size));
+  for (unsigned int i = 0; i < model.q_size; i++) {
+    Q[i] = 0.5 * sin (1.4 * i + 0.3);
+  }
+
+  ReducedModel reduced;
+  CreateReducedModel (model, Q, locked_dofs, reduced);
+
+  REQUIRE (12 == reduced.model.dof_count);
+  REQUIRE (12 == reduced.q_map.size());
+
+  VectorNd Q_reduced (VectorNd::Zero (reduced.model.q_size));
+  VectorNd QDot_reduced (VectorNd::Zero (reduced.model.qdot_size));
+  VectorNd QDDot_reduced (VectorNd::Zero (reduced.model.qdot_size));
+  reduced.ReduceQ (Q, Q_reduced);
+
+  // the reduced configuration maps back to the locking configuration
+  VectorNd Q_expanded (VectorNd::Zero (model.q_size));
+  reduced.ExpandQ (Q_reduced, Q_expanded);
+  REQUIRE_THAT (Q, AllCloseVector(Q_expanded, TEST_PREC, TEST_PREC));
+
+  // move the unlocked degrees of freedom
+  for (unsigned int i = 0; i < reduced.model.qdot_size; i++) {
+    Q_reduced[i] += 0.2 * cos (0.8 * i);
+    QDot_reduced[i] = 0.9 * sin (1.1 * i + 0.7);
+    QDDot_reduced[i] = 1.3 * cos (0.6 * i + 0.1);
+  }
+  reduced.ExpandQ (Q_reduced, Q);
+  reduced.ExpandQDot (QDot_reduced, QDot);
+  reduced.ExpandQDot (QDDot_reduced, QDDot);
+
+  // all bodies are at the same place
+  Vector3d point (0.1, -0.2, 0.3);
+  UpdateKinematicsCustom (model, &Q, NULL, NULL);
+  UpdateKinematicsCustom (reduced.model, &Q_reduced, NULL, NULL);
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    Vector3d position = CalcBodyToBaseCoordinates (reduced.model, Q_reduced,
+        reduced.GetReducedBodyId (i), point, false);
+    Vector3d position_ref = CalcBodyToBaseCoordinates (model, Q, i, point,
+        false);
+    REQUIRE_THAT (position_ref, AllCloseVector(position, TEST_PREC, TEST_PREC));
+  }
+  for (unsigned int k = 0; k < model.mFixedBodies.size(); k++) {
+    unsigned int fixed_id = model.fixed_body_discriminator + k;
+    Vector3d position = CalcBodyToBaseCoordinates (reduced.model, Q_reduced,
+        reduced.GetReducedBodyId (fixed_id), point, false);
+    Vector3d position_ref = CalcBodyToBaseCoordinates (model, Q, fixed_id,
+        point, false);
+    REQUIRE_THAT (position_ref, AllCloseVector(position, TEST_PREC, TEST_PREC));
+  }
+  REQUIRE (reduced.model.GetBodyId ("hand_r")
+      == reduced.GetReducedBodyId (model.GetBodyId ("hand_r")));
+  REQUIRE (reduced.model.IsFixedBodyId (reduced.model.GetBodyId ("foot_l")));
+
+  // the reduced mass matrix is the submatrix of the unlocked dofs
+  MatrixNd H (MatrixNd::Zero (model.qdot_size, model.qdot_size));
+  MatrixNd H_reduced (MatrixNd::Zero (reduced.model.qdot_size,
+        reduced.model.qdot_size));
+  CompositeRigidBodyAlgorithm (model, Q, H);
+  CompositeRigidBodyAlgorithm (reduced.model, Q_reduced, H_reduced);
+
+  MatrixNd H_ref (MatrixNd::Zero (reduced.model.qdot_size,
+        reduced.model.qdot_size));
+  for (unsigned int i = 0; i < reduced.qdot_map.size(); i++) {
+    for (unsigned int j = 0; j < reduced.qdot_map.size(); j++) {
+      H_ref(i, j) = H(reduced.qdot_map[i], reduced.qdot_map[j]);
+    }
+  }
+  REQUIRE_THAT (H_ref, AllCloseMatrix(H_reduced, 1e-12, 1e-12));
+
+  // as are the generalized forces of the unlocked dofs
+  VectorNd Tau (VectorNd::Zero (model.qdot_size));
+  VectorNd Tau_reduced (VectorNd::Zero (reduced.model.qdot_size));
+  VectorNd Tau_ref (VectorNd::Zero (reduced.model.qdot_size));
+  InverseDynamics (model, Q, QDot, QDDot, Tau);
+  InverseDynamics (reduced.model, Q_reduced, QDot_reduced, QDDot_reduced,
+      Tau_reduced);
+  reduced.ReduceQDot (Tau, Tau_ref);
+  REQUIRE_THAT (Tau_ref, AllCloseVector(Tau_reduced, 1e-12, 1e-12));
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CreateReducedModelEmulated", "") {
+  TestReducedModelRightArm (*model_emulated);
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_CreateReducedModel3Dof", "") {
+  TestReducedModelRightArm (*model_3dof);
+}
+
+TEST_CASE (__FILE__"_CreateReducedModelSpherical", "") {
+  Model model;
+  Body body (1., Vector3d (0.1, 0.2, 0.3), Vector3d (1., 1.2, 1.4));
+
+  unsigned int body_a_id = model.AddBody (0, SpatialTransform(),
+      Joint (JointTypeRevoluteX), body, "body_a");
+  model.AppendBody (Xtrans (Vector3d (1., 0., 0.)),
+      Joint (JointTypeSpherical), body, "body_b");
+  model.AppendBody (Xtrans (Vector3d (0., 1., 0.)),
+      Joint (JointTypeRevoluteY), body, "body_c");
+
+  VectorNd Q (VectorNd::Zero (model.q_size));
+  Q[0] = 0.3;
+  Q[4] = 0.7;
+  model.SetQuaternion (model.GetBodyId ("body_b"),
+      Quaternion::fromAxisAngle (Vector3d (0., 0., 1.), 0.4), Q);
+
+  std::vector<bool> locked_dofs (model.qdot_size, false);
+  locked_dofs[0] = true;
+
+  ReducedModel reduced;
+  CreateReducedModel (model, Q, locked_dofs, reduced);
+
+  REQUIRE (4 == reduced.model.dof_count);
+  REQUIRE (5 == reduced.model.q_size);
+  REQUIRE (reduced.model.IsFixedBodyId (reduced.GetReducedBodyId (body_a_id)));
+
+  VectorNd Q_reduced (VectorNd::Zero (reduced.model.q_size));
+  reduced.ReduceQ (Q, Q_reduced);
+
+  unsigned int reduced_b_id = reduced.model.GetBodyId ("body_b");
+  VectorNd quat = reduced.model.GetQuaternion (reduced_b_id, Q_reduced);
+  VectorNd quat_ref = model.GetQuaternion (model.GetBodyId ("body_b"), Q);
+  REQUIRE_THAT (quat_ref, AllCloseVector(quat, TEST_PREC, TEST_PREC));
+
+  Vector3d position = CalcBodyToBaseCoordinates (reduced.model, Q_reduced,
+      reduced.model.GetBodyId ("body_c"), Vector3d (0.2, 0., 0.));
+  Vector3d position_ref = CalcBodyToBaseCoordinates (model, Q,
+      model.GetBodyId ("body_c"), Vector3d (0.2, 0., 0.));
+  REQUIRE_THAT (position_ref, AllCloseVector(position, TEST_PREC, TEST_PREC));
+}
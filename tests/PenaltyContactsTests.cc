@@ -0,0 +1,205 @@
+#include "rbdl_tests.h"
+
+#include <iostream>
+
+#include "rbdl/rbdl.h"
+
+using namespace std;
+using namespace RigidBodyDynamics;
+using namespace RigidBodyDynamics::Math;
+
+const double TEST_PREC = 1.0e-12;
+
+struct PenaltyContactsBall {
+  PenaltyContactsBall () {
+    ClearLogOutput();
+    model = new Model;
+    model->gravity = Vector3d (0., 0., -9.81);
+
+    Body ball (1., Vector3d (0., 0., 0.), Vector3d (0.01, 0.01, 0.01));
+    unsigned int translation_id = model->AddBody (0, SpatialTransform(),
+        Joint (JointTypeTranslationXYZ), Body());
+    ball_id = model->AddBody (translation_id, SpatialTransform(),
+        Joint (JointTypeEulerZYX), ball);
+
+    contact_point = Vector3d (0., 0., -0.1);
+
+    Q = VectorNd::Zero (model->q_size);
+    QDot = VectorNd::Zero (model->qdot_size);
+    QDDot = VectorNd::Zero (model->qdot_size);
+    Tau = VectorNd::Zero (model->qdot_size);
+    f_ext = std::vector<SpatialVector> (model->mBodies.size(),
+        SpatialVector::Zero());
+  }
+  ~PenaltyContactsBall () {
+    delete model;
+  }
+
+  Model *model;
+  unsigned int ball_id;
+  Vector3d contact_point;
+
+  VectorNd Q;
+  VectorNd QDot;
+  VectorNd QDDot;
+  VectorNd Tau;
+  std::vector<SpatialVector> f_ext;
+};
+
+TEST_CASE (__FILE__"_ContactPlanePenetration", "") {
+  ContactPlane plane (Vector3d (0., 0., 1.), Vector3d (0., 0., 2.));
+
+  double depth = 0.;
+  Vector3d normal (Vector3d::Zero());
+
+  REQUIRE (plane.CalcPenetration (Vector3d (1., 2., 0.75), depth, normal));
+  REQUIRE (depth == Approx (0.25));
+  REQUIRE_THAT (Vector3d (0., 0., 1.), AllCloseVector(normal, TEST_PREC, TEST_PREC));
+
+  REQUIRE_FALSE (plane.CalcPenetration (Vector3d (1., 2., 1.25), depth, normal));
+}
+
+TEST_CASE_METHOD (PenaltyContactsBall, __FILE__"_PenaltyContactAtRest", "") {
+  ConstraintSet CS;
+  CS.AddContactConstraint (ball_id, contact_point, Vector3d (0., 0., 1.));
+  CS.Bind (*model);
+
+  HuntCrossleyParameters parameters;
+  ContactPlane ground;
+
+  Q[2] = 0.09;
+
+  unsigned int contact_count = CalcContactPenaltyForces (*model, Q, QDot,
+      CS, ground, parameters, f_ext);
+  REQUIRE (contact_count == 1);
+
+  double force_normal = parameters.stiffness * pow (0.01, parameters.exponent);
+  Vector3d point_base (0., 0., -0.01);
+  Vector3d force (0., 0., force_normal);
+  Vector3d torque = point_base.cross (force);
+
+  SpatialVector f_expected (torque[0], torque[1], torque[2],
+      force[0], force[1], force[2]);
+  REQUIRE_THAT (f_expected, AllCloseVector(f_ext[ball_id], TEST_PREC, TEST_PREC));
+
+  // no contact above the ground
+  Q[2] = 0.11;
+  contact_count = CalcContactPenaltyForces (*model, Q, QDot, CS, ground,
+      parameters, f_ext);
+  REQUIRE (contact_count == 0);
+  REQUIRE_THAT (SpatialVector (SpatialVector::Zero()), AllCloseVector(f_ext[ball_id], 0., 0.));
+}
+
+TEST_CASE_METHOD (PenaltyContactsBall, __FILE__"_PenaltyContactSharedPoints", "") {
+  ConstraintSet CS_single;
+  CS_single.AddContactConstraint (ball_id, contact_point, Vector3d (1., 0., 0.));
+
+  // contact constraints along three normals (not adjacent in the set)
+  ConstraintSet CS_multiple;
+  CS_multiple.AddContactConstraint (ball_id, contact_point, Vector3d (1., 0., 0.));
+  CS_multiple.AddLoopConstraint (0, ball_id, SpatialTransform(),
+      SpatialTransform(), SpatialVector (0., 0., 0., 1., 0., 0.));
+  CS_multiple.AddContactConstraint (ball_id, contact_point, Vector3d (0., 1., 0.));
+  CS_multiple.AddContactConstraint (ball_id, contact_point, Vector3d (0., 0., 1.));
+  CS_single.Bind (*model);
+  CS_multiple.Bind (*model);
+
+  HuntCrossleyParameters parameters;
+  ContactPlane ground;
+
+  Q[2] = 0.095;
+  QDot[0] = 0.3;
+  QDot[2] = -0.1;
+
+  std::vector<SpatialVector> f_ext_multiple (f_ext);
+
+  REQUIRE (CalcContactPenaltyForces (*model, Q, QDot, CS_single, ground,
+        parameters, f_ext) == 1);
+  REQUIRE (CalcContactPenaltyForces (*model, Q, QDot, CS_multiple, ground,
+        parameters, f_ext_multiple) == 1);
+
+  REQUIRE_THAT (f_ext[ball_id], AllCloseVector(f_ext_multiple[ball_id], TEST_PREC, TEST_PREC));
+}
+
+TEST_CASE_METHOD (PenaltyContactsBall, __FILE__"_PenaltyContactForwardDynamics", "") {
+  ConstraintSet CS;
+  CS.AddContactConstraint (ball_id, contact_point, Vector3d (0., 0., 1.));
+  CS.AddContactConstraint (ball_id, Vector3d (0.05, 0., -0.09), Vector3d (0., 0., 1.));
+  CS.Bind (*model);
+
+  HuntCrossleyParameters parameters (2.0e4, 1.5, 0.8, 0.6, 0.05);
+  ContactPlane ground (Vector3d (0., 0., 0.), Vector3d (0.1, 0., 1.));
+
+  Q[2] = 0.06;
+  Q[3] = 0.1;
+  Q[4] = -0.05;
+  Q[5] = 0.08;
+  QDot[0] = 0.5;
+  QDot[1] = -0.2;
+  QDot[2] = -0.3;
+  QDot[3] = 1.1;
+  Tau[0] = 0.3;
+
+  ForwardDynamicsContactsPenalty (*model, Q, QDot, Tau, CS, ground,
+      parameters, QDDot, NULL, &f_ext);
+
+  // The same accelerations are obtained by mapping the contact forces
+  // with the transposed point Jacobians.
+  VectorNd Tau_contacts (Tau);
+  unsigned int contact_count = 0;
+  for (unsigned int i = 0; i < CS.size(); i++) {
+    Vector3d point_base = CalcBodyToBaseCoordinates (*model, Q, ball_id,
+        CS.point[i]);
+
+    double depth;
+    Vector3d normal;
+    if (!ground.CalcPenetration (point_base, depth, normal)) {
+      continue;
+    }
+    contact_count++;
+
+    Vector3d point_velocity = CalcPointVelocity (*model, Q, QDot, ball_id,
+        CS.point[i]);
+    double depth_rate = -normal.dot (point_velocity);
+    double force_normal = parameters.stiffness
+      * pow (depth, parameters.exponent)
+      * (1. + parameters.dissipation * depth_rate);
+    Vector3d velocity_tangential = point_velocity + depth_rate * normal;
+    Vector3d force_tangential = - parameters.friction_coefficient
+      * force_normal * velocity_tangential
+      / sqrt (velocity_tangential.squaredNorm()
+          + parameters.transition_velocity * parameters.transition_velocity);
+
+    // friction opposes the sliding
+    REQUIRE (force_tangential.dot (velocity_tangential) < 0.);
+
+    MatrixNd G (MatrixNd::Zero (3, model->qdot_size));
+    CalcPointJacobian (*model, Q, ball_id, CS.point[i], G);
+    Tau_contacts += G.transpose() * (force_normal * normal + force_tangential);
+  }
+  REQUIRE (contact_count == 2);
+
+  VectorNd QDDot_jacobian (VectorNd::Zero (model->qdot_size));
+  ForwardDynamics (*model, Q, QDot, Tau_contacts, QDDot_jacobian);
+
+  REQUIRE_THAT (QDDot_jacobian, AllCloseVector(QDDot, 1.0e-10, 1.0e-10));
+
+  // External forces of the caller are applied in addition to the contact
+  // forces.
+  std::vector<SpatialVector> f_user (model->mBodies.size(),
+      SpatialVector::Zero());
+  f_user[ball_id] = SpatialVector (0.1, -0.2, 0.3, 1.5, -0.5, 2.);
+  std::vector<SpatialVector> f_total (f_ext);
+  f_total[ball_id] += f_user[ball_id];
+
+  std::vector<SpatialVector> f_contact;
+  ForwardDynamicsContactsPenalty (*model, Q, QDot, Tau, CS, ground,
+      parameters, QDDot, &f_user, &f_contact);
+
+  REQUIRE_THAT (f_ext[ball_id], AllCloseVector(f_contact[ball_id], 0., 0.));
+
+  VectorNd QDDot_total (VectorNd::Zero (model->qdot_size));
+  ForwardDynamics (*model, Q, QDot, Tau, QDDot_total, &f_total);
+
+  REQUIRE_THAT (QDDot_total, AllCloseVector(QDDot, 1.0e-10, 1.0e-10));
+}
@@ -0,0 +1,142 @@
+#include "rbdl_tests.h"
+
+#include <iostream>
+
+#include "rbdl/rbdl.h"
+
+using namespace std;
+using namespace RigidBodyDynamics;
+using namespace RigidBodyDynamics::Math;
+
+const double TEST_PREC = 1.0e-12;
+
+/** \brief Creates a heightfield with pseudo random heights. */
+static Heightfield CreateRandomHeightfield (unsigned int points_x,
+    unsigned int points_y) {
+  MatrixNd heights (MatrixNd::Zero (points_x, points_y));
+  for (unsigned int i = 0; i < points_x; i++) {
+    for (unsigned int j = 0; j < points_y; j++) {
+      heights(i, j) = 0.1 * sin (0.7 * i) * cos (0.4 * j) + 0.02 * ((i * 7 + j * 13) % 5);
+    }
+  }
+
+  return Heightfield (Vector3d (-1., -2., 0.), 0.1, 0.15, heights);
+}
+
+TEST_CASE (__FILE__"_HeightfieldPlane", "") {
+  MatrixNd heights (MatrixNd::Zero (4, 3));
+  for (unsigned int i = 0; i < 4; i++) {
+    for (unsigned int j = 0; j < 3; j++) {
+      heights(i, j) = 0.5 + 0.2 * (i * 0.5) - 0.1 * (j * 0.25);
+    }
+  }
+
+  Heightfield terrain (Vector3d (1., 2., 0.), 0.5, 0.25, heights);
+
+  Vector3d normal (Vector3d::Zero());
+  double height = terrain.CalcHeight (1.6, 2.3, &normal);
+
+  REQUIRE (height == Approx (0.5 + 0.2 * 0.6 - 0.1 * 0.3));
+  REQUIRE_THAT (Vector3d (-0.2, 0.1, 1.).normalized(), AllCloseVector(normal, TEST_PREC, TEST_PREC));
+
+  double depth;
+  REQUIRE (terrain.CalcPenetration (Vector3d (1.6, 2.3, height - 0.1), depth, normal));
+  REQUIRE (depth == Approx (0.1 * normal[2]));
+  REQUIRE_FALSE (terrain.CalcPenetration (Vector3d (1.6, 2.3, height + 0.1), depth, normal));
+
+  // outside of the grid the border heights are extended
+  REQUIRE (terrain.CalcHeight (0., 2.3, &normal) == Approx (terrain.CalcHeight (1., 2.3)));
+  REQUIRE (normal[0] == 0.);
+}
+
+TEST_CASE (__FILE__"_HeightfieldBounds", "") {
+  Heightfield terrain = CreateRandomHeightfield (37, 23);
+
+  double regions[4][4] = {
+    { -0.95, -1.9, -0.9, -1.85 },
+    { -0.8, -1.5, 1.2, 0.3 },
+    { 0.3, -1.0, 0.9, -0.2 },
+    { -5., -5., 5., 5. }
+  };
+
+  for (unsigned int r = 0; r < 4; r++) {
+    double min_height, max_height;
+    terrain.CalcHeightBounds (regions[r][0], regions[r][1],
+        regions[r][2], regions[r][3], min_height, max_height);
+
+    // sample the region densely
+    for (unsigned int k = 0; k <= 50; k++) {
+      for (unsigned int l = 0; l <= 50; l++) {
+        double x = regions[r][0] + (regions[r][2] - regions[r][0]) * k / 50.;
+        double y = regions[r][1] + (regions[r][3] - regions[r][1]) * l / 50.;
+        double height = terrain.CalcHeight (x, y);
+
+        REQUIRE (height >= min_height - TEST_PREC);
+        REQUIRE (height <= max_height + TEST_PREC);
+      }
+    }
+  }
+
+  // the coarsest level bounds the whole terrain
+  REQUIRE (terrain.mMinHeights.back().rows() == 1);
+  REQUIRE (terrain.mMinHeights.back().cols() == 1);
+}
+
+TEST_CASE (__FILE__"_CalcTerrainContacts", "") {
+  Model model;
+  unsigned int body_id = model.AddBody (0, SpatialTransform(),
+      Joint (JointTypeTranslationXYZ),
+      Body (1., Vector3d (0., 0., 0.), Vector3d (1., 1., 1.)));
+
+  VectorNd Q (VectorNd::Zero (model.q_size));
+  Q[0] = 0.1;
+  Q[1] = -0.3;
+  Q[2] = 0.05;
+
+  Heightfield terrain = CreateRandomHeightfield (37, 23);
+
+  std::vector<unsigned int> body_ids;
+  std::vector<Vector3d> body_points;
+  for (unsigned int k = 0; k < 200; k++) {
+    body_ids.push_back (body_id);
+    body_points.push_back (Vector3d (
+          -1.2 + 0.013 * ((k * 37) % 200),
+          -1.5 + 0.011 * ((k * 71) % 200),
+          -0.1 + 0.001 * ((k * 53) % 200)));
+  }
+
+  std::vector<TerrainContact> contacts;
+  unsigned int contact_count = CalcTerrainContacts (model, Q, body_ids,
+      body_points, terrain, contacts);
+
+  REQUIRE (contact_count == contacts.size());
+  REQUIRE (contact_count > 0);
+  REQUIRE (contact_count < body_points.size());
+
+  // compare with testing each point separately
+  unsigned int c = 0;
+  for (unsigned int k = 0; k < body_points.size(); k++) {
+    Vector3d point = CalcBodyToBaseCoordinates (model, Q, body_id,
+        body_points[k]);
+    double depth;
+    Vector3d normal;
+
+    if (terrain.CalcPenetration (point, depth, normal)) {
+      REQUIRE (c < contacts.size());
+      REQUIRE_THAT (body_points[k], AllCloseVector(contacts[c].body_point, 0., 0.));
+      REQUIRE_THAT (point, AllCloseVector(contacts[c].point, TEST_PREC, TEST_PREC));
+      REQUIRE (depth == Approx (contacts[c].depth));
+      REQUIRE_THAT (normal, AllCloseVector(contacts[c].normal, TEST_PREC, TEST_PREC));
+
+      MatrixNd frame = contacts[c].frame;
+      REQUIRE_THAT (MatrixNd (frame.transpose() * frame), AllCloseMatrix(MatrixNd (MatrixNd::Identity (3, 3)), TEST_PREC, TEST_PREC));
+      c++;
+    }
+  }
+  REQUIRE (c == contacts.size());
+
+  ConstraintSet CS;
+  AddTerrainContactConstraints (contacts, CS);
+  REQUIRE (CS.size() == 3 * contacts.size());
+  REQUIRE_THAT (contacts[0].normal, AllCloseVector(CS.normal[2], 0., 0.));
+}
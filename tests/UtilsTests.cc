@@ -267,6 +267,79 @@ TEST_CASE_METHOD (FixedBase6DoF12DoFFloatingBase, __FILE__"_TestCoMAccelerationU
   TestCoMAccelerationUsingFD (*this, 1e-6);
 }
 
+template <typename T>
+void TestCoMJacobian (
+  T & obj,
+  const double TOL = 1e-7
+) {
+  const double EPS = 1e-7;
+  Model &model = *obj.model;
+
+  VectorNd Q (VectorNd::Zero (model.q_size));
+  VectorNd QDot (VectorNd::Zero (model.qdot_size));
+  VectorNd QDDot_zero (VectorNd::Zero (model.qdot_size));
+  for (unsigned int i = 0; i < model.q_size; i++) {
+    Q[i] = 0.6 * sin (1.9 * i + 0.4);
+  }
+  for (unsigned int i = 0; i < model.qdot_size; i++) {
+    QDot[i] = 0.8 * cos (1.3 * i + 0.2);
+  }
+
+  MatrixNd com_jacobian (MatrixNd::Zero (3, model.qdot_size));
+  Vector3d com_jacobian_dot_qdot (Vector3d::Zero());
+  Utils::CalcCenterOfMassJacobian (model, Q, com_jacobian, &QDot,
+      &com_jacobian_dot_qdot);
+
+  // mass weighted sum of the point Jacobians of the body COMs
+  MatrixNd com_jacobian_ref (MatrixNd::Zero (3, model.qdot_size));
+  MatrixNd point_jacobian (MatrixNd::Zero (3, model.qdot_size));
+  double mass_total = 0.;
+  for (unsigned int i = 1; i < model.mBodies.size(); i++) {
+    point_jacobian.setZero();
+    CalcPointJacobian (model, Q, i, model.mBodies[i].mCenterOfMass,
+        point_jacobian, false);
+    com_jacobian_ref += model.mBodies[i].mMass * point_jacobian;
+    mass_total += model.mBodies[i].mMass;
+  }
+  com_jacobian_ref /= mass_total;
+
+  REQUIRE_THAT (com_jacobian_ref, AllCloseMatrix(com_jacobian, TOL, TOL));
+
+  double mass = 0.;
+  Vector3d com (Vector3d::Zero());
+  Vector3d com_velocity (Vector3d::Zero());
+  Vector3d com_acceleration (Vector3d::Zero());
+  Utils::CalcCenterOfMass (model, Q, QDot, &QDDot_zero, mass, com,
+      &com_velocity, &com_acceleration);
+
+  Vector3d jacobian_qdot = com_jacobian * QDot;
+  REQUIRE_THAT (com_velocity, AllCloseVector(jacobian_qdot, TOL, TOL));
+  REQUIRE_THAT (com_acceleration,
+      AllCloseVector(com_jacobian_dot_qdot, TOL, TOL));
+
+  // compare the derivative product with finite differences
+  MatrixNd com_jacobian_eps (MatrixNd::Zero (3, model.qdot_size));
+  VectorNd Q_eps = Q + EPS * QDot;
+  Utils::CalcCenterOfMassJacobian (model, Q_eps, com_jacobian_eps);
+
+  Vector3d jacobian_dot_qdot_fd = (com_jacobian_eps - com_jacobian) / EPS
+    * QDot;
+  REQUIRE_THAT (com_jacobian_dot_qdot,
+      AllCloseVector(jacobian_dot_qdot_fd, 1e-5, 1e-5));
+}
+
+TEST_CASE_METHOD (FixedJoint2DoF, __FILE__"_TestCoMJacobianFixedJoint2DoF", "") {
+  TestCoMJacobian (*this);
+}
+
+TEST_CASE_METHOD (FixedBase6DoF12DoFFloatingBase, __FILE__"_TestCoMJacobianFixedBase6DoF12DoFFloatingBase", "") {
+  TestCoMJacobian (*this);
+}
+
+TEST_CASE_METHOD (Human36, __FILE__"_TestCoMJacobianHuman36", "") {
+  TestCoMJacobian (*this);
+}
+
 template <typename T>
 void TestZMPComputationForNotMovingSystem(
   T & obj,